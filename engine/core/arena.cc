@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// arena.cc
+//------------------------------------------------------------------------------
+#include "config.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace core
+{
+
+linear_arena::linear_arena(size_t block_size) :
+	block_size_(block_size),
+	current_(0),
+	offset_(0),
+	used_(0)
+{
+}
+
+linear_arena::~linear_arena()
+{
+	for (auto& b : this->blocks_)
+		std::free(b.data);
+}
+
+size_t linear_arena::get_capacity() const
+{
+	size_t capacity = 0;
+
+	for (const auto& b : this->blocks_)
+		capacity += b.size;
+
+	return capacity;
+}
+
+void* linear_arena::do_allocate(size_t bytes, size_t alignment)
+{
+	this->stats_.allocations++;
+	this->stats_.bytes += bytes;
+
+	for (;;)
+	{
+		// blocks past the current one are left over from before a rewind, and are reused in order
+		while (this->current_ < this->blocks_.size())
+		{
+			block& b = this->blocks_[this->current_];
+
+			const uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+			const uintptr_t aligned = (base + this->offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			const size_t end = (aligned - base) + bytes;
+
+			if (end <= b.size)
+			{
+				this->used_ += end - this->offset_;
+				this->offset_ = end;
+				this->stats_.peak = std::max(this->stats_.peak, this->used_);
+
+				return reinterpret_cast<void*>(aligned);
+			}
+
+			this->current_++;
+			this->offset_ = 0;
+		}
+
+		const size_t size = std::max(this->block_size_, bytes + alignment);
+		unsigned char* data = static_cast<unsigned char*>(std::malloc(size));
+
+		if (data == nullptr)
+			throw std::bad_alloc();
+
+		this->stats_.heap_allocations++;
+		this->blocks_.push_back({ data, size });
+		this->current_ = this->blocks_.size() - 1;
+		this->offset_ = 0;
+	}
+}
+
+void linear_arena::rewind(const marker& m)
+{
+	this->current_ = m.block;
+	this->offset_ = m.offset;
+	this->used_ = m.used;
+
+	if (m.block != 0 || m.offset != 0 || this->blocks_.size() < 2)
+		return;
+
+	// fully rewound with a chain of blocks, so merge them into one that fits all of it next time
+	const size_t capacity = this->get_capacity();
+
+	for (auto& b : this->blocks_)
+		std::free(b.data);
+
+	this->blocks_.clear();
+	this->block_size_ = capacity;
+}
+
+static arena_stats frame_stats;
+
+linear_arena& frame_arena()
+{
+	static linear_arena arena(4 << 20);
+	return arena;
+}
+
+const arena_stats& get_frame_stats()
+{
+	return frame_stats;
+}
+
+void end_frame_arena()
+{
+	linear_arena& arena = frame_arena();
+
+	frame_stats = arena.get_stats();
+
+	arena.clear_stats();
+	arena.reset();
+}
+
+linear_arena& scratch_arena()
+{
+	thread_local linear_arena arena(256 << 10);
+	return arena;
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+	Linear arena allocators -- a frame arena rewound once per frame by the
+	manager host, and per-thread scratch arenas rewound by scoped markers.
+	Both are std::pmr memory resources, so standard containers can be
+	pointed at them with std::pmr::vector and friends.
+
+	Arenas grow by chaining blocks from the heap. When fully rewound, a
+	chain is merged into a single block of the combined size, so a steady
+	workload stops touching the heap after its first frames.
+*/
+//------------------------------------------------------------------------------
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace core
+{
+	/// allocation counters, over the current frame or since the last reset of the counters
+	struct arena_stats
+	{
+		size_t allocations = 0;
+		size_t bytes = 0;
+		/// allocations that had to take a new block from the heap
+		size_t heap_allocations = 0;
+		/// largest amount of memory in use at once
+		size_t peak = 0;
+	};
+
+	class linear_arena : public std::pmr::memory_resource
+	{
+	public:
+		/// position in the arena, for rewinding everything allocated after it
+		struct marker
+		{
+			size_t block = 0;
+			size_t offset = 0;
+			size_t used = 0;
+		};
+
+		/// constructor, the first block is allocated on first use
+		explicit linear_arena(size_t block_size = 1 << 20);
+		/// destructor, frees every block
+		~linear_arena();
+
+		linear_arena(const linear_arena&) = delete;
+		linear_arena& operator=(const linear_arena&) = delete;
+
+		/// current position
+		marker get_marker() const { return { this->current_, this->offset_, this->used_ }; }
+		/// release everything allocated since the marker
+		void rewind(const marker& m);
+		/// release everything
+		void reset() { this->rewind(marker()); }
+
+		/// bytes currently allocated
+		size_t get_used() const { return this->used_; }
+		/// bytes of all blocks
+		size_t get_capacity() const;
+
+		const arena_stats& get_stats() const { return this->stats_; }
+		void clear_stats() { this->stats_ = arena_stats(); }
+
+	private:
+		struct block
+		{
+			unsigned char* data;
+			size_t size;
+		};
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		/// individual deallocations are no-ops, memory is released by rewinding
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		std::vector<block> blocks_;
+		size_t block_size_;
+		size_t current_;
+		size_t offset_;
+		size_t used_;
+		arena_stats stats_;
+	};
+
+	/// arena for data that lives until the end of the frame, rewound by manager_host::end_frame -- main thread only
+	linear_arena& frame_arena();
+
+	/// counters of the frame arena over the last completed frame
+	const arena_stats& get_frame_stats();
+
+	/// rewind the frame arena, keeping its counters for get_frame_stats
+	void end_frame_arena();
+
+	/// arena of the calling thread, for temporaries with a scope -- allocate through a scratch_scope
+	linear_arena& scratch_arena();
+
+	/// rewinds the scratch arena of the calling thread to where it was when the scope was opened
+	class scratch_scope
+	{
+	public:
+		/// constructor
+		scratch_scope() : arena_(scratch_arena()), marker_(arena_.get_marker()) {}
+		/// destructor
+		~scratch_scope() { this->arena_.rewind(this->marker_); }
+
+		scratch_scope(const scratch_scope&) = delete;
+		scratch_scope& operator=(const scratch_scope&) = delete;
+
+		/// resource for std::pmr containers, which must not outlive the scope
+		std::pmr::memory_resource* resource() { return &this->arena_; }
+
+	private:
+		linear_arena& arena_;
+		linear_arena::marker marker_;
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+	64-bit FNV-1a hashing, used to fingerprint asset contents.
+*/
+//------------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+namespace core
+{
+	static constexpr uint64_t fnv1a_basis = 0xcbf29ce484222325ull;
+	static constexpr uint64_t fnv1a_prime = 0x100000001b3ull;
+
+	/// hash a block of memory, pass a previous result as seed to continue hashing
+	inline uint64_t fnv1a(const void* data, size_t size, uint64_t seed = fnv1a_basis)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= fnv1a_prime;
+		}
+
+		return hash;
+	}
+}
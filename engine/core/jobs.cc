@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+// jobs.cc
+//------------------------------------------------------------------------------
+#include "config.h"
+#include "jobs.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <string>
+
+namespace core
+{
+
+namespace
+{
+	/// chunk running on this thread, 0 outside of one
+	thread_local uint64_t chunk_key = 0;
+}
+
+job_system::job_system(unsigned threads) :
+	running_(true)
+{
+	if (threads == 0)
+	{
+		unsigned hw = std::thread::hardware_concurrency();
+		threads = hw > 1 ? hw - 1 : 1;
+	}
+
+	for (unsigned i = 0; i < threads; i++)
+	{
+		this->workers_.emplace_back([this, i]()
+		{
+			set_profile_thread_name(("Worker " + std::to_string(i)).c_str());
+			this->worker_loop();
+		});
+	}
+}
+
+job_system::~job_system()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->running_ = false;
+	}
+
+	this->signal_.notify_all();
+
+	for (auto& t : this->workers_)
+		t.join();
+}
+
+job_system& job_system::get()
+{
+	static job_system instance;
+	return instance;
+}
+
+void job_system::submit(std::function<void()> fn, job_counter* counter, job_queue queue)
+{
+	if (counter != nullptr)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+
+		if (queue == job_queue::background)
+			this->background_.push_back({ std::move(fn), counter });
+		else
+			this->queue_.push_back({ std::move(fn), counter });
+	}
+
+	this->signal_.notify_one();
+}
+
+bool job_system::pop(job& out, const job_counter* counter)
+{
+	std::lock_guard<std::mutex> lock(this->mutex_);
+
+	if (!this->queue_.empty())
+	{
+		out = std::move(this->queue_.front());
+		this->queue_.pop_front();
+		return true;
+	}
+
+	if (counter == nullptr)
+		return false;
+
+	// The background queue is short, and only searched when there is no foreground work to help with
+	for (auto it = this->background_.begin(); it != this->background_.end(); ++it)
+	{
+		if (it->counter == counter)
+		{
+			out = std::move(*it);
+			this->background_.erase(it);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void job_system::execute(job& j)
+{
+	{
+		PROFILE_SCOPE("job");
+		j.fn();
+	}
+
+	if (j.counter != nullptr)
+		j.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+bool job_system::run_one()
+{
+	job j;
+
+	if (!this->pop(j, nullptr))
+		return false;
+
+	execute(j);
+	return true;
+}
+
+void job_system::wait(job_counter& counter)
+{
+	while (!counter.is_done())
+	{
+		job j;
+
+		if (this->pop(j, &counter))
+			execute(j);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void job_system::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+
+	// Chunks are keyed by where they fall in the range, not by the thread that ran them
+	const uint64_t dispatch = static_cast<uint64_t>(++this->dispatches_) << 32;
+
+	auto run_chunk = [&fn, dispatch, grain](size_t begin, size_t end)
+	{
+		const uint64_t outer = chunk_key;
+
+		chunk_key = dispatch | (begin / grain);
+		fn(begin, end);
+		chunk_key = outer;
+	};
+
+	// Not worth the queue round-trip for a single chunk
+	if (count <= grain)
+	{
+		run_chunk(0, count);
+		return;
+	}
+
+	job_counter counter;
+
+	for (size_t begin = grain; begin < count; begin += grain)
+	{
+		size_t end = std::min(begin + grain, count);
+		this->submit([&run_chunk, begin, end]() { run_chunk(begin, end); }, &counter);
+	}
+
+	// The calling thread takes the first chunk
+	run_chunk(0, grain);
+
+	this->wait(counter);
+}
+
+uint64_t job_system::get_chunk_key() const
+{
+	if (chunk_key != 0)
+		return chunk_key;
+
+	return (static_cast<uint64_t>(this->dispatches_.load(std::memory_order_relaxed)) << 32) | 0xffffffffu;
+}
+
+void job_system::worker_loop()
+{
+	while (true)
+	{
+		job j;
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex_);
+			this->signal_.wait(lock, [this]()
+			{
+				return !this->running_ || !this->queue_.empty() || !this->background_.empty();
+			});
+
+			// Foreground work goes first, background work only runs on otherwise idle workers
+			std::deque<job>& queue = !this->queue_.empty() ? this->queue_ : this->background_;
+
+			if (queue.empty())
+				return;
+
+			j = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		execute(j);
+	}
+}
+
+} // namespace core
@@ -0,0 +1,87 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+	Simple job system -- a fixed pool of worker threads consuming two shared
+	queues. Foreground jobs are per-frame work that someone is waiting on, and
+	always go first. Background jobs are long-running work such as asset loads,
+	polled for completion rather than waited on.
+
+	Threads waiting on a counter help out by running foreground jobs, or
+	background jobs of that same counter, so nested submission from inside a
+	job does not deadlock, and a frame never picks up an unrelated asset load.
+*/
+//------------------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core
+{
+	/// which queue a job goes in
+	enum class job_queue
+	{
+		foreground,
+		background
+	};
+
+	/// tracks completion of a group of jobs
+	struct job_counter
+	{
+		std::atomic<int> pending { 0 };
+
+		bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	class job_system
+	{
+	public:
+		/// constructor, zero threads means one less than the hardware concurrency
+		job_system(unsigned threads = 0);
+		/// destructor, finishes queued jobs and joins all workers
+		~job_system();
+
+		/// get the shared instance
+		static job_system& get();
+
+		/// queue a job, optionally incrementing a counter until it has run
+		void submit(std::function<void()> job, job_counter* counter = nullptr, job_queue queue = job_queue::foreground);
+		/// block until the counter reaches zero, running foreground jobs and jobs of the counter in the meantime
+		void wait(job_counter& counter);
+		/// run one queued foreground job on the calling thread, returns false if there was none
+		bool run_one();
+
+		/// split [0, count) into chunks of at most grain elements and run them in parallel, blocking
+		void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+		/// order of the parallel_for chunk running on the calling thread -- by dispatch, then by range,
+		/// and work outside of any chunk orders after the chunks dispatched before it
+		uint64_t get_chunk_key() const;
+
+		/// number of worker threads, excluding the calling thread
+		unsigned get_thread_count() const { return static_cast<unsigned>(this->workers_.size()); }
+
+	private:
+		struct job
+		{
+			std::function<void()> fn;
+			job_counter* counter;
+		};
+
+		void worker_loop();
+		/// pop a foreground job, or failing that a background job of the given counter
+		bool pop(job& out, const job_counter* counter);
+		static void execute(job& j);
+
+		std::vector<std::thread> workers_;
+		std::deque<job> queue_;
+		std::deque<job> background_;
+		std::mutex mutex_;
+		std::condition_variable signal_;
+		std::atomic<uint32_t> dispatches_ { 0 };
+		bool running_;
+	};
+}
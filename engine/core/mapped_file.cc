@@ -0,0 +1,96 @@
+//------------------------------------------------------------------------------
+// mapped_file.cc
+//------------------------------------------------------------------------------
+#include "config.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace core
+{
+
+mapped_file::mapped_file() :
+	data_(nullptr),
+	size_(0),
+	mapped_(false)
+{
+}
+
+mapped_file::mapped_file(const std::filesystem::path& path) :
+	mapped_file()
+{
+	this->open(path);
+}
+
+mapped_file::~mapped_file()
+{
+	this->close();
+}
+
+bool mapped_file::open(const std::filesystem::path& path)
+{
+	this->close();
+
+#ifdef _WIN32
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		return false;
+
+	this->fallback_.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(this->fallback_.data()), this->fallback_.size());
+
+	this->data_ = this->fallback_.data();
+	this->size_ = this->fallback_.size();
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+
+	if (ptr == MAP_FAILED)
+		return false;
+
+	this->data_ = static_cast<const unsigned char*>(ptr);
+	this->size_ = static_cast<size_t>(st.st_size);
+	this->mapped_ = true;
+#endif
+
+	return true;
+}
+
+void mapped_file::close()
+{
+#ifndef _WIN32
+	if (this->mapped_)
+		munmap(const_cast<unsigned char*>(this->data_), this->size_);
+#endif
+
+	this->fallback_.clear();
+	this->data_ = nullptr;
+	this->size_ = 0;
+	this->mapped_ = false;
+}
+
+} // namespace core
@@ -0,0 +1,46 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+	Read-only memory-mapped file. Falls back to reading the whole file
+	into memory where mmap is not available.
+*/
+//------------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace core
+{
+	class mapped_file
+	{
+	public:
+		/// constructor
+		mapped_file();
+		/// constructor, maps the file right away
+		explicit mapped_file(const std::filesystem::path& path);
+		/// destructor, unmaps the file
+		~mapped_file();
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		/// map a file, closing any previously mapped one
+		bool open(const std::filesystem::path& path);
+		/// unmap the file
+		void close();
+
+		/// true if a file is mapped
+		bool is_open() const { return this->data_ != nullptr; }
+		/// start of the mapped bytes
+		const unsigned char* data() const { return this->data_; }
+		/// size of the mapped file in bytes
+		size_t size() const { return this->size_; }
+
+	private:
+		const unsigned char* data_;
+		size_t size_;
+		bool mapped_;
+		std::vector<unsigned char> fallback_;
+	};
+}
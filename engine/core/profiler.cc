@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+// profiler.cc
+//------------------------------------------------------------------------------
+#include "config.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace core
+{
+
+namespace
+{
+	/// zones kept per thread, older ones are overwritten
+	const size_t ring_size = 1 << 15;
+
+	/// ring of one thread, locked by its owner for each zone and by readers, so the lock is rarely contended
+	struct thread_ring
+	{
+		std::mutex lock;
+		std::vector<profile_event> events;
+		size_t head = 0;
+		size_t count = 0;
+		uint32_t index = 0;
+		uint32_t depth = 0;
+		std::string name;
+	};
+
+	std::mutex registry_lock;
+	std::vector<std::unique_ptr<thread_ring>> registry;
+	std::unordered_set<std::string> names;
+
+	/// zones of the last completed frame, and the start of the one in progress
+	std::vector<profile_event> frame_events;
+	uint64_t frame_start = 0;
+	uint64_t frame_end = 0;
+	uint64_t current_start = 0;
+
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	thread_ring& get_ring()
+	{
+		thread_local thread_ring* ring = nullptr;
+
+		if (ring == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registry_lock);
+
+			registry.emplace_back(std::make_unique<thread_ring>());
+			ring = registry.back().get();
+			ring->index = static_cast<uint32_t>(registry.size() - 1);
+			ring->name = "Thread " + std::to_string(ring->index);
+		}
+
+		return *ring;
+	}
+
+	/// the ring must be locked
+	void push_event(thread_ring& ring, const profile_event& event)
+	{
+		// Allocated on the first zone, so naming a thread that is never profiled costs nothing
+		if (ring.events.empty())
+			ring.events.resize(ring_size);
+
+		ring.events[ring.head] = event;
+		ring.head = (ring.head + 1) % ring_size;
+		ring.count = std::min(ring.count + 1, ring_size);
+	}
+
+	/// call fn with every zone of a ring, oldest first -- the ring must be locked
+	template<typename F>
+	void for_each_event(const thread_ring& ring, F&& fn)
+	{
+		const size_t first = (ring.head + ring_size - ring.count) % ring_size;
+
+		for (size_t i = 0; i < ring.count; i++)
+			fn(ring.events[(first + i) % ring_size]);
+	}
+
+	void write_json_string(FILE* file, const char* str)
+	{
+		fputc('"', file);
+
+		for (; *str != '\0'; str++)
+		{
+			if (*str == '"' || *str == '\\')
+				fputc('\\', file);
+
+			if (static_cast<unsigned char>(*str) >= 0x20)
+				fputc(*str, file);
+		}
+
+		fputc('"', file);
+	}
+}
+
+namespace detail
+{
+	std::atomic<bool> profiling { false };
+
+	uint32_t enter_zone()
+	{
+		return get_ring().depth++;
+	}
+
+	void record_zone(const char* name, uint64_t start, uint32_t depth)
+	{
+		const uint64_t end = profile_now();
+		thread_ring& ring = get_ring();
+
+		ring.depth = depth;
+
+		std::lock_guard<std::mutex> lock(ring.lock);
+		push_event(ring, { name, start, end, depth, ring.index });
+	}
+}
+
+void set_profiling(bool enabled)
+{
+	detail::profiling.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t profile_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void set_profile_thread_name(const char* name)
+{
+	thread_ring& ring = get_ring();
+
+	std::lock_guard<std::mutex> lock(ring.lock);
+	ring.name = name;
+}
+
+std::string get_profile_thread_name(uint32_t thread)
+{
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	if (thread >= registry.size())
+		return std::string();
+
+	std::lock_guard<std::mutex> ring_lock(registry[thread]->lock);
+	return registry[thread]->name;
+}
+
+uint32_t add_profile_track(const char* name)
+{
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	registry.emplace_back(std::make_unique<thread_ring>());
+
+	thread_ring& ring = *registry.back();
+	ring.index = static_cast<uint32_t>(registry.size() - 1);
+	ring.name = name;
+
+	return ring.index;
+}
+
+void record_profile_zone(uint32_t track, const char* name, uint64_t start, uint64_t end, uint32_t depth)
+{
+	if (!is_profiling())
+		return;
+
+	thread_ring* ring;
+
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		if (track >= registry.size())
+			return;
+
+		ring = registry[track].get();
+	}
+
+	std::lock_guard<std::mutex> lock(ring->lock);
+	push_event(*ring, { name, start, end, depth, track });
+}
+
+const char* intern_profile_name(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	// Elements of a node-based set keep their address
+	return names.emplace(name).first->c_str();
+}
+
+void end_profile_frame()
+{
+	const uint64_t now = profile_now();
+
+	const uint64_t start = current_start;
+	current_start = now;
+
+	// While not recording, the last recorded frame stays up for inspection
+	if (!is_profiling())
+		return;
+
+	frame_events.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		for (auto& ring : registry)
+		{
+			std::lock_guard<std::mutex> ring_lock(ring->lock);
+
+			// Zones that straddle the frame boundary are left out
+			for_each_event(*ring, [start, now](const profile_event& e)
+			{
+				if (e.start >= start && e.end <= now)
+					frame_events.emplace_back(e);
+			});
+		}
+	}
+
+	std::sort(frame_events.begin(), frame_events.end(), [](const profile_event& a, const profile_event& b)
+	{
+		return (a.thread != b.thread) ? a.thread < b.thread : a.start < b.start;
+	});
+
+	frame_start = start;
+	frame_end = now;
+}
+
+const std::vector<profile_event>& get_profile_frame()
+{
+	return frame_events;
+}
+
+uint64_t get_profile_frame_start()
+{
+	return frame_start;
+}
+
+uint64_t get_profile_frame_end()
+{
+	return frame_end;
+}
+
+bool export_chrome_trace(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "w");
+
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Err: Failed to open %s for writing\n", path.c_str());
+		return false;
+	}
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+	bool first = true;
+	size_t count = 0;
+
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	for (auto& ring : registry)
+	{
+		std::lock_guard<std::mutex> ring_lock(ring->lock);
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", ring->index);
+		write_json_string(file, ring->name.c_str());
+		fputs("}}", file);
+		first = false;
+
+		for_each_event(*ring, [&](const profile_event& e)
+		{
+			fputs(",\n{\"name\":", file);
+			write_json_string(file, e.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					e.thread, e.start / 1000.0, (e.end - e.start) / 1000.0);
+			count++;
+		});
+	}
+
+	fputs("\n]}\n", file);
+	fclose(file);
+
+	printf("Profiler: wrote %lu zones to %s\n", count, path.c_str());
+	return true;
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+	Scoped CPU profiler -- zones are recorded into a ring buffer per thread,
+	and the zones of the last completed frame are kept for display. All
+	rings can be written out as Chrome trace_event JSON, for chrome://tracing
+	or Perfetto.
+
+	Recording is off by default. A disabled zone costs one relaxed atomic
+	load, and defining GOBLIN_NO_PROFILER compiles PROFILE_SCOPE out entirely.
+
+	Zone names are not copied, so they must outlive the profiler -- string
+	literals, or names from intern_profile_name.
+*/
+//------------------------------------------------------------------------------
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace core
+{
+	/// a completed zone, with times in nanoseconds since the profiler started
+	struct profile_event
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+		uint32_t depth;
+		uint32_t thread;
+	};
+
+	namespace detail
+	{
+		extern std::atomic<bool> profiling;
+		void record_zone(const char* name, uint64_t start, uint32_t depth);
+		uint32_t enter_zone();
+	}
+
+	/// turn recording on or off
+	void set_profiling(bool enabled);
+	/// whether zones are being recorded
+	inline bool is_profiling() { return detail::profiling.load(std::memory_order_relaxed); }
+
+	/// nanoseconds since the profiler started
+	uint64_t profile_now();
+
+	/// name the calling thread in the timeline and in exported traces
+	void set_profile_thread_name(const char* name);
+	/// name of a profiled thread, by the index in profile_event::thread
+	std::string get_profile_thread_name(uint32_t thread);
+
+	/// add a row that is not tied to a thread, for zones timed elsewhere such as on the GPU
+	uint32_t add_profile_track(const char* name);
+	/// record a zone on a row from add_profile_track, with times from profile_now -- does nothing unless profiling
+	void record_profile_zone(uint32_t track, const char* name, uint64_t start, uint64_t end, uint32_t depth);
+
+	/// copy of a name that lives as long as the profiler, for zone names built at runtime
+	const char* intern_profile_name(const std::string& name);
+
+	/// end the current frame, keeping its zones for get_profile_frame -- main thread only
+	void end_profile_frame();
+	/// zones of the last completed frame, ordered by thread and start
+	const std::vector<profile_event>& get_profile_frame();
+	/// start and end of the last completed frame
+	uint64_t get_profile_frame_start();
+	uint64_t get_profile_frame_end();
+
+	/// write every zone still held by the rings as Chrome trace_event JSON
+	bool export_chrome_trace(const std::string& path);
+
+	/// records the time between construction and destruction as a zone
+	class profile_scope
+	{
+	public:
+		/// constructor, does nothing unless profiling
+		explicit profile_scope(const char* name) : name_(nullptr)
+		{
+			if (!is_profiling())
+				return;
+
+			this->name_ = name;
+			this->depth_ = detail::enter_zone();
+			this->start_ = profile_now();
+		}
+
+		/// destructor
+		~profile_scope()
+		{
+			if (this->name_ != nullptr)
+				detail::record_zone(this->name_, this->start_, this->depth_);
+		}
+
+		profile_scope(const profile_scope&) = delete;
+		profile_scope& operator=(const profile_scope&) = delete;
+
+	private:
+		const char* name_;
+		uint64_t start_ = 0;
+		uint32_t depth_ = 0;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef GOBLIN_NO_PROFILER
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) core::profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#endif
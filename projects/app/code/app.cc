@@ -14,6 +14,8 @@
 
 #include "app.h"
 #include "loader.h"
+#include "core/arena.h"
+#include "core/profiler.h"
 #include "gltf_loader.h"
 #include "quat.h"
 
@@ -59,6 +61,21 @@ namespace efiilj
 					{
 						ImGui::Begin("Managers");
 						editor->show_entity_gui();
+
+						const core::arena_stats& frame = core::get_frame_stats();
+						ImGui::Text("Frame arena: %lu allocations, %.1f KB, %lu from the heap", 
+								frame.allocations, frame.bytes / 1024.0f, frame.heap_allocations);
+
+						if (ImGui::TreeNode("Textures"))
+						{
+							textures->on_editor_gui();
+							ImGui::TreePop();
+						}
+
+						ImGui::End();
+
+						ImGui::Begin("Profiler");
+						profiler->show();
 						ImGui::End();
 					});
 
@@ -83,6 +100,10 @@ namespace efiilj
 		entities = std::make_shared<entity_manager>();
 		// The editor handles GUI invokation and scene graph visualization
 		editor = std::make_shared<entity_editor>(entities, managers);
+		// The profiler window shows the zones of the last frame, once recording is turned on
+		profiler = std::make_shared<profiler_window>();
+
+		core::set_profile_thread_name("Main");
 
 		// Servers -- hold resources which may be re-used between components
 		shaders = std::make_shared<shader_server>();
@@ -90,6 +111,11 @@ namespace efiilj
 		meshes = std::make_shared<mesh_server>();
 		materials = std::make_shared<material_server>();
 		gltf = std::make_shared<gltf_model_server>();
+		watcher = std::make_shared<asset_watcher>();
+
+		// Vertex layout -- fixed before any mesh is built, and compiled into every shader
+		meshes->set_vertex_layout(layout_compact);
+		shaders->set_global_defines(meshes->get_layout_defines());
 
 		// Managers -- hold data which is unique to a single component, 
 		// which may (but doesn't need to) refer to shared data in servers.
@@ -123,6 +149,7 @@ namespace efiilj
 		managers->register_manager(rfwd, 'RFWD');
 		managers->register_manager(rdbg, 'RDBG');
 		managers->register_manager(gltf, 'GLTF');
+		managers->register_manager(watcher, 'WTCH');
 
 		// Run setup on all registered managers
 		managers->setup();
@@ -159,6 +186,7 @@ namespace efiilj
 
 		material_id mtrl_cube = materials->create();
 		materials->set_base_color(mtrl_cube, vector4(1, 1, 1, 1));
+		mtrl_cube = materials->deduplicate(mtrl_cube);
 		meshes->set_material(mesh_cube, mtrl_cube);
 		mesh_instances->set_material(miid_cube, mtrl_cube);
 
@@ -172,15 +200,21 @@ namespace efiilj
 
 #define NUM_CUBES 4
 
+		std::vector<entity_id> cubes;
+		entities->create_many(NUM_CUBES, cubes);
+
+		// Components registered in bulk get consecutive ids, in the order of the entities
+		const transform_id trf_cubes = transforms->register_entities(cubes);
+		const mesh_instance_id miid_cubes = mesh_instances->register_entities(cubes);
+		const meta_id meta_cubes = metadata->register_entities(cubes);
+
 		for (size_t i = 0; i < NUM_CUBES; i++)
 		{
-			entity_id eid = entities->create();
-
-			transform_id trf_testcube = transforms->register_entity(eid);
+			transform_id trf_testcube = trf_cubes + i;
 			transforms->set_position(trf_testcube, vector3(0, i * 1.1f, 0));
 			transforms->set_scale(trf_testcube, 0.5f);
 
-			mesh_instance_id miid_testcube = mesh_instances->register_entity(eid);
+			mesh_instance_id miid_testcube = miid_cubes + i;
 			mesh_instances->set_mesh(miid_testcube, mesh_cube);
 
 			material_id mtrl_testcube = materials->create();
@@ -188,16 +222,17 @@ namespace efiilj
 			float c = static_cast<float>(i) / static_cast<float>(NUM_CUBES);
 
 			materials->set_base_color(mtrl_testcube, vector4(c, 1.0f - c, 0, 1));
+			mtrl_testcube = materials->deduplicate(mtrl_testcube);
 			mesh_instances->set_material(miid_testcube, mtrl_testcube);
 
-			rfwd->register_entity(eid);
-			colliders->register_entity(eid);
-			physics_id rb_testcube = sim->register_entity(eid);
-
-			meta_id mid = metadata->register_entity(eid);
-			metadata->set_name(mid, "Cube " + std::to_string(i));
+			metadata->set_name(meta_cubes + i, "Cube " + std::to_string(i));
 		}
 
+		// Colliders and bodies take their bounds from the meshes, so they are registered once those are set
+		rfwd->register_entities(cubes);
+		colliders->register_entities(cubes);
+		sim->register_entities(cubes);
+
 		// GLTF
 		
 #define AVOCADO_TEST
@@ -216,7 +251,6 @@ namespace efiilj
 		render_id test_gfx = rdef->register_entity(node);
 		collider_id test_col = colliders->register_entity(node);
 		physics_id test_rb = sim->register_entity(node);
-		gltf->unload(test_mdl);
 #endif
 
 		object_loader sphere("../res/volumes/v_pointlight.obj", meshes);
@@ -235,6 +269,7 @@ namespace efiilj
 
 		material_id mtrl_sphere = materials->create();
 		materials->set_base_color(mtrl_sphere, vector4(1, 0, 1, 1));
+		mtrl_sphere = materials->deduplicate(mtrl_sphere);
 		meshes->set_material(mesh_sphere, mtrl_sphere);
 		mesh_instances->set_material(miid_sphere, mtrl_sphere);
 
@@ -256,6 +291,7 @@ namespace efiilj
 
 		material_id mtrl_hitmarker = materials->create();
 		materials->set_base_color(mtrl_hitmarker, vector4(1, 0, 0, 1));
+		mtrl_hitmarker = materials->deduplicate(mtrl_hitmarker);
 		mesh_instances->set_material(miid_hitmarker, mtrl_hitmarker);
 
 		rfwd->register_entity(e_hitmarker);
@@ -356,7 +392,10 @@ namespace efiilj
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			this->window_->Update();
+			{
+				PROFILE_SCOPE("window_update");
+				this->window_->Update();
+			}
 	
 			if (keys.find(GLFW_KEY_W) != keys.end())
 				transforms->add_position(selected_trf, transforms->get_forward(selected_trf) * CAMERA_SPEED);
@@ -401,7 +440,10 @@ namespace efiilj
 			managers->frame();
 			managers->end_frame();
 
-			this->window_->SwapBuffers();
+			{
+				PROFILE_SCOPE("swap_buffers");
+				this->window_->SwapBuffers();
+			}
 			
 		}
 	}
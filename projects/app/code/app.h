@@ -26,9 +26,11 @@
 #include "def_rend.h"
 #include "dbg_rend.h"
 #include "gltf_loader.h"
+#include "asset_watch.h"
 #include "sim.h"
 #include "phys_data.h"
 #include "editor.h"
+#include "prof_gui.h"
 
 #include <memory>
 
@@ -52,6 +54,7 @@ namespace efiilj
 		std::shared_ptr<entity_manager> entities;
 		std::shared_ptr<manager_host> managers;
 		std::shared_ptr<entity_editor> editor;
+		std::shared_ptr<profiler_window> profiler;
 
 		// Servers hold resources not connected to any particular entity
 		std::shared_ptr<shader_server> shaders;
@@ -74,6 +77,7 @@ namespace efiilj
 		std::shared_ptr<simulator> sim;
 
 		std::shared_ptr<gltf_model_server> gltf;
+		std::shared_ptr<asset_watcher> watcher;
 		
 	public:
 
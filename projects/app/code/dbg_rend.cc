@@ -8,7 +8,7 @@
 namespace efiilj
 {
 	debug_renderer::debug_renderer()
-		: _shader(-1)
+		: _shader(-1), sphere(-1)
 	{
 		printf("Init debug...\n");
 		_name = "Debug renderer";
@@ -16,6 +16,10 @@ namespace efiilj
 
 	debug_renderer::~debug_renderer()
 	{
+		// The volume came from a loader, which handed its reference over
+		if (_meshes)
+			_meshes->remove_ref(sphere);
+
 		printf("Debug renderer exit\n");
 	}
 	
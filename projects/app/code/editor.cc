@@ -1,8 +1,10 @@
 #include "editor.h"
 
 #include "imgui.h"
+#include "core/arena.h"
 
-#include <sstream>
+#include <charconv>
+#include <memory_resource>
 
 namespace efiilj
 {
@@ -18,12 +20,18 @@ namespace efiilj
 	void entity_editor::draw_node(entity_id eid, int depth, int& node_clicked)
 	{
 
-		std::stringstream ss;
+		// The tree is redrawn every frame, so labels and child lists go in the frame arena
+		std::pmr::string label(&core::frame_arena());
+		std::pmr::vector<transform_id> child_nodes(&core::frame_arena());
+		char num[16];
 
-		std::vector<transform_id> child_nodes;
+		const auto append_number = [&](size_t n)
+		{
+			label.append(num, std::to_chars(num, num + sizeof(num), n).ptr);
+		};
 
 		ImGuiTreeNodeFlags node_flags = _base_flags;
-		const bool is_selected = (_selection_mask & (1 << eid)) != 0;
+		const bool is_selected = (eid == _selected_entity);
 
 		if (is_selected)
 			node_flags |= ImGuiTreeNodeFlags_Selected;
@@ -32,9 +40,12 @@ namespace efiilj
 		transform_id trf_id = _transforms->get_component(eid);
 
 		if (_metadata->is_valid(met_id))
-			ss <<  _metadata->get_name(met_id);
+			label.append(_metadata->get_name(met_id));
 		else
-			ss << "Entity " << eid;
+		{
+			label.append("Entity ");
+			append_number(eid);
+		}
 
 		bool has_transform = _transforms->is_valid(trf_id);
 
@@ -49,18 +60,22 @@ namespace efiilj
 			child_nodes.insert(child_nodes.end(), children.begin(), children.end());
 		}
 		else
-			ss << " (virtual)";
+			label.append(" (virtual)");
 
 		bool has_children = child_nodes.size() > 0;
 
 		if (has_children)
-			ss << " [" << child_nodes.size() << "]";
+		{
+			label.append(" [");
+			append_number(child_nodes.size());
+			label.append("]");
+		}
 		else
 			node_flags |= ImGuiTreeNodeFlags_Leaf;
 
 		bool node_open = ImGui::TreeNodeEx(
 				reinterpret_cast<void*>(eid), node_flags, 
-				"%s", ss.str().c_str());
+				"%s", label.c_str());
 
 		if (ImGui::IsItemClicked())
 			node_clicked = eid;
@@ -106,12 +121,14 @@ namespace efiilj
 
 			for (auto eid : ids)
 			{
+				if (!_entities->is_valid(eid))
+					continue;
+
 				draw_node(eid, 0, node_clicked);
 			}
 
 			if (node_clicked != -1)
 			{
-				_selection_mask = (1 << node_clicked);
 				_selected_entity = node_clicked;
 			}
 
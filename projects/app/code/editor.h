@@ -13,7 +13,6 @@ namespace efiilj
 	{
 		private:
 
-			int _selection_mask = (1 << 2);
 			ImGuiTreeNodeFlags _base_flags = 
 				ImGuiTreeNodeFlags_OpenOnArrow 
 				| ImGuiTreeNodeFlags_OpenOnDoubleClick;
@@ -45,7 +44,6 @@ namespace efiilj
 					return;
 
 				_selected_entity = eid;
-				_selection_mask = (1 << eid);
 			}
 	};
 }
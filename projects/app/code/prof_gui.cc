@@ -0,0 +1,135 @@
+#include "prof_gui.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+namespace efiilj
+{
+	namespace
+	{
+		const float bar_height = 18.0f;
+
+		/**
+		 * \brief Colour of a zone, from the hash of its name so that it stays the same between frames.
+		 */
+		ImU32 zone_color(const char* name)
+		{
+			const size_t hash = std::hash<std::string_view>()(name);
+			const float hue = static_cast<float>(hash % 360) / 360.0f;
+
+			float r, g, b;
+			ImGui::ColorConvertHSVtoRGB(hue, 0.55f, 0.8f, r, g, b);
+
+			return ImGui::ColorConvertFloat4ToU32(ImVec4(r, g, b, 1.0f));
+		}
+	}
+
+	profiler_window::profiler_window()
+		: _frame_start(0), _frame_end(0), _is_paused(false), _zoom(1.0f), _trace_path("profile.json")
+	{ }
+
+	void profiler_window::show()
+	{
+		bool recording = core::is_profiling();
+
+		if (ImGui::Checkbox("Record", &recording))
+			core::set_profiling(recording);
+
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &_is_paused);
+
+		ImGui::SameLine();
+
+		if (ImGui::Button("Export trace"))
+		{
+			_status = core::export_chrome_trace(_trace_path)
+				? "Wrote " + _trace_path
+				: "Failed to write " + _trace_path;
+		}
+
+		if (!_status.empty())
+		{
+			ImGui::SameLine();
+			ImGui::TextUnformatted(_status.c_str());
+		}
+
+		// A paused timeline keeps its own copy, as the profiler goes on replacing the frame
+		if (!_is_paused)
+		{
+			_events = core::get_profile_frame();
+			_frame_start = core::get_profile_frame_start();
+			_frame_end = core::get_profile_frame_end();
+		}
+
+		ImGui::Text("Frame: %.3f ms, %lu zones", (_frame_end - _frame_start) / 1e6, _events.size());
+		ImGui::SliderFloat("Zoom", &_zoom, 1.0f, 32.0f, "%.1fx", 2.0f);
+
+		ImGui::BeginChild("Timeline", ImVec2(0, 0), true, ImGuiWindowFlags_HorizontalScrollbar);
+		draw_timeline();
+		ImGui::EndChild();
+	}
+
+	void profiler_window::draw_timeline()
+	{
+		if (_events.empty() || _frame_end <= _frame_start)
+		{
+			ImGui::TextUnformatted(core::is_profiling() ? "Waiting for a frame..." : "Not recording");
+			return;
+		}
+
+		ImDrawList* draw_list = ImGui::GetWindowDrawList();
+
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		const float width = std::max(ImGui::GetContentRegionAvail().x, 64.0f) * _zoom;
+		const double scale = width / static_cast<double>(_frame_end - _frame_start);
+		const float text_height = ImGui::GetTextLineHeight();
+
+		float y = origin.y;
+		size_t i = 0;
+
+		// Events are ordered by thread, so each run of them makes one row
+		while (i < _events.size())
+		{
+			const uint32_t thread = _events[i].thread;
+			const std::string name = core::get_profile_thread_name(thread);
+
+			draw_list->AddText(ImVec2(origin.x, y), ImGui::GetColorU32(ImGuiCol_Text), name.c_str());
+			y += text_height + 2.0f;
+
+			uint32_t max_depth = 0;
+
+			for (; i < _events.size() && _events[i].thread == thread; i++)
+			{
+				const core::profile_event& e = _events[i];
+
+				const float x0 = origin.x + static_cast<float>((e.start - _frame_start) * scale);
+				const float x1 = std::max(origin.x + static_cast<float>((e.end - _frame_start) * scale), x0 + 1.0f);
+				const float y0 = y + e.depth * bar_height;
+
+				const ImVec2 min(x0, y0);
+				const ImVec2 max(x1, y0 + bar_height - 1.0f);
+
+				draw_list->AddRectFilled(min, max, zone_color(e.name));
+
+				// Labels only go on bars wide enough to hold them
+				const ImVec2 label = ImGui::CalcTextSize(e.name);
+
+				if (label.x + 4.0f < x1 - x0)
+					draw_list->AddText(ImVec2(x0 + 2.0f, y0 + (bar_height - label.y) * 0.5f), IM_COL32(0, 0, 0, 255), e.name);
+
+				if (ImGui::IsMouseHoveringRect(min, max))
+					ImGui::SetTooltip("%s\n%.3f ms", e.name, (e.end - e.start) / 1e6);
+
+				max_depth = std::max(max_depth, e.depth);
+			}
+
+			y += (max_depth + 1) * bar_height + 4.0f;
+		}
+
+		// Reserves the drawn area, so that the child window scrolls over all of it
+		ImGui::Dummy(ImVec2(width, y - origin.y));
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "core/profiler.h"
+
+#include <string>
+#include <vector>
+
+namespace efiilj
+{
+	/**
+	 * \brief Timeline of the zones recorded by the profiler over the last frame, one row per thread.
+	 */
+	class profiler_window
+	{
+		private:
+
+			std::vector<core::profile_event> _events;
+			uint64_t _frame_start;
+			uint64_t _frame_end;
+
+			bool _is_paused;
+			float _zoom;
+			std::string _trace_path;
+			std::string _status;
+
+			void draw_timeline();
+
+		public:
+
+			profiler_window();
+
+			void show();
+	};
+}
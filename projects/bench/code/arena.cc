@@ -0,0 +1,150 @@
+#include "bench.h"
+#include "scene.h"
+#include "core/arena.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+
+// Counts every operator new, to check that hot paths stop allocating once their buffers have grown
+static std::atomic<size_t> heap_allocations { 0 };
+
+void* operator new(size_t size)
+{
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* ptr = std::malloc(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Row of overlapping unit cubes, each with a transform, mesh instance and collider.
+		 */
+		void spawn_cubes(bench_scene& scene, int count)
+		{
+			std::vector<vector3> corners;
+
+			for (int i = 0; i < 8; i++)
+				corners.emplace_back(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f);
+
+			// The server takes the vectors it is given
+			std::vector<vector3> positions = corners;
+
+			const mesh_id cube = scene.meshes->create();
+			scene.meshes->set_positions(cube, positions);
+			scene.meshes->set_hull(cube, corners);
+			scene.meshes->set_bounds(cube, vector3(-0.5f, -0.5f, -0.5f), vector3(0.5f, 0.5f, 0.5f));
+
+			for (int i = 0; i < count; i++)
+			{
+				const entity_id eid = scene.entities->create();
+
+				const transform_id trf = scene.transforms->register_entity(eid);
+				scene.transforms->set_position(trf, vector3(i * 0.75f, (i % 3) * 0.1f, 0));
+
+				const mesh_instance_id mesh = scene.mesh_instances->register_entity(eid);
+				scene.mesh_instances->set_mesh(mesh, cube);
+
+				scene.colliders->register_entity(eid);
+			}
+		}
+	}
+
+	bool check_frame_arena()
+	{
+		core::linear_arena arena(1024);
+
+		// Each allocation too big to share a block takes one from the heap
+		for (int i = 0; i < 3; i++)
+			BENCH_CHECK(arena.allocate(600, 16) != nullptr);
+
+		BENCH_CHECK(arena.get_stats().heap_allocations == 3 && arena.get_stats().allocations == 3);
+
+		// Rewinding to a marker keeps what came before it
+		const core::linear_arena::marker marker = arena.get_marker();
+		BENCH_CHECK(arena.allocate(100, 8) != nullptr);
+		arena.rewind(marker);
+		BENCH_CHECK(arena.get_used() == marker.used);
+
+		// A full rewind merges the chain, so the same work next time fits in a single block
+		arena.reset();
+		arena.clear_stats();
+
+		for (int i = 0; i < 3; i++)
+			BENCH_CHECK(arena.allocate(600, 16) != nullptr);
+
+		BENCH_CHECK(arena.get_stats().heap_allocations == 1);
+
+		// Scratch scopes give back what was allocated within them
+		const size_t scratch_used = core::scratch_arena().get_used();
+
+		{
+			core::scratch_scope scratch;
+			std::pmr::vector<int> values(1000, 1, scratch.resource());
+			BENCH_CHECK(core::scratch_arena().get_used() > scratch_used);
+		}
+
+		BENCH_CHECK(core::scratch_arena().get_used() == scratch_used);
+
+		// Collision updates grow their buffers in the first frames, and then leave the heap alone
+		bench_scene scene;
+		spawn_cubes(scene, 64);
+
+		for (int i = 0; i < 4; i++)
+			scene.colliders->test_scene();
+
+		// Neighbours overlap, the next ones along are apart
+		BENCH_CHECK(scene.colliders->test_narrow(0, 1) && scene.colliders->test_narrow(1, 0));
+		BENCH_CHECK(!scene.colliders->test_broad(0, 2));
+		BENCH_CHECK(scene.colliders->get_collisions(0).size() == 1);
+
+		const size_t heap_before = heap_allocations.load();
+		core::scratch_arena().clear_stats();
+
+		for (int i = 0; i < 10; i++)
+			scene.colliders->test_scene();
+
+		BENCH_CHECK(heap_allocations.load() == heap_before);
+		BENCH_CHECK(core::scratch_arena().get_stats().heap_allocations == 0);
+
+		return true;
+	}
+
+	bool bench_frame_arena()
+	{
+		// Times collision updates in steady state, and reports what they allocate
+		bench_scene scene;
+		spawn_cubes(scene, 1000);
+
+		for (int i = 0; i < 4; i++)
+			scene.colliders->test_scene();
+
+		const size_t heap_before = heap_allocations.load();
+		core::scratch_arena().clear_stats();
+
+		const int runs = 100;
+		const float ms = time_ms([&]()
+		{
+			for (int i = 0; i < runs; i++)
+				scene.colliders->test_scene();
+		});
+
+		const size_t heap = heap_allocations.load() - heap_before;
+		const core::arena_stats& scratch = core::scratch_arena().get_stats();
+
+		printf("Frame arena: %d collision updates in %.2f ms, %zu heap allocations, %zu scratch allocations (%zu from the heap), peak %.1f KB\n",
+				runs, ms, heap, scratch.allocations, scratch.heap_allocations, scratch.peak / 1024.0f);
+
+		return heap == 0 && scratch.heap_allocations == 0;
+	}
+}
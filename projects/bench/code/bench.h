@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vector3.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/**
+ * \brief Fails the running check, with the condition and where it was tested.
+ */
+#define BENCH_CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "Check failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+			return false; \
+		} \
+	} while (0)
+
+namespace efiilj
+{
+	/**
+	 * \brief Milliseconds taken by a call.
+	 */
+	template<typename F>
+	float time_ms(F&& fn)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/**
+	 * \brief Unit sphere of rings and segments, with poles shared by their fans.
+	 */
+	void make_sphere(unsigned rings, unsigned segments, std::vector<vector3>& positions, std::vector<unsigned>& indices);
+
+	/**
+	 * \brief Points the GL entry points that building and releasing meshes use at stand-ins that do nothing,
+	 * so that loaders can run without a context. Names are handed out, no data is kept.
+	 */
+	void use_fake_gl();
+
+	// Checks -- quick, and run by default
+	bool check_range_allocator();
+	bool check_indirect_commands();
+	bool check_occlusion();
+	bool check_mesh_cache();
+	bool check_shader_preprocessor();
+	bool check_mesh_optimizer();
+	bool check_mesh_lod();
+	bool check_meshlets();
+	bool check_frame_arena();
+	bool check_handles();
+	bool check_bulk_spawn();
+	bool check_command_buffers();
+	bool check_shared_assets();
+	bool check_texture_cooker();
+	bool check_light_clusters();
+	bool check_light_volumes();
+	bool check_obj_parser();
+
+	// Benchmarks -- slow, read the assets in res, and run only when named
+	bool bench_mesh_cache();
+	bool bench_shader_preprocessor();
+	bool bench_mesh_optimizer();
+	bool bench_mesh_lod();
+	bool bench_meshlets();
+	bool bench_frame_arena();
+	bool bench_handles();
+	bool bench_bulk_spawn();
+	bool bench_command_buffers();
+	bool bench_texture_cooker();
+	bool bench_light_clusters();
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace efiilj
+{
+	bool check_bulk_spawn()
+	{
+		bench_scene scene;
+
+		// Entities spawned one at a time, around which a batch is added and removed
+		std::vector<entity_id> singles;
+
+		for (int i = 0; i < 10; i++)
+		{
+			const entity_id eid = scene.entities->create();
+			const transform_id trf = scene.transforms->register_entity(eid);
+			scene.transforms->set_position(trf, vector3(static_cast<float>(i), 0, 0));
+			singles.push_back(eid);
+		}
+
+		// Freed slots are reused by the batch before the server grows
+		scene.entities->destroy(singles[9]);
+		scene.transforms->unregister_entity(singles[9]);
+		singles.pop_back();
+
+		std::vector<entity_id> batch;
+		scene.entities->create_many(1000, batch);
+
+		BENCH_CHECK(batch.size() == 1000 && scene.entities->get_capacity() == 1009);
+		BENCH_CHECK(handle_index(batch[0]) == 9 && scene.entities->get_recycled() == 1);
+
+		std::vector<entity_id> sorted = batch;
+		std::sort(sorted.begin(), sorted.end());
+		BENCH_CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+		// Components of a batch follow each other in the order of the entities
+		const transform_id first = scene.transforms->register_entities(batch);
+		const mesh_instance_id first_mesh = scene.mesh_instances->register_entities(batch);
+		scene.metadata->register_entities(batch);
+
+		BENCH_CHECK(first == 9 && first_mesh == 0);
+
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			BENCH_CHECK(scene.transforms->get_component(batch[i]) == static_cast<transform_id>(first + i));
+			BENCH_CHECK(scene.transforms->get_entity(static_cast<transform_id>(first + i)) == batch[i]);
+			BENCH_CHECK(scene.mesh_instances->get_component(batch[i]) == static_cast<mesh_instance_id>(first_mesh + i));
+			BENCH_CHECK(scene.metadata->get_component(batch[i]) != -1);
+		}
+
+		// A batch listing an entity twice still removes it once
+		std::vector<entity_id> removed(batch.begin(), batch.begin() + 500);
+		removed.push_back(batch[0]);
+
+		scene.managers->remove_entities(removed);
+		BENCH_CHECK(scene.entities->destroy_many(removed) == 500);
+
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			const bool gone = i < 500;
+
+			BENCH_CHECK(scene.entities->is_valid(batch[i]) != gone);
+			BENCH_CHECK((scene.transforms->get_component(batch[i]) == -1) == gone);
+			BENCH_CHECK((scene.mesh_instances->get_component(batch[i]) == -1) == gone);
+			BENCH_CHECK((scene.metadata->get_component(batch[i]) == -1) == gone);
+		}
+
+		// Entities outside the batch keep their components and data
+		BENCH_CHECK(scene.transforms->get_instances().size() == singles.size() + 500);
+
+		for (size_t i = 0; i < singles.size(); i++)
+		{
+			const transform_id trf = scene.transforms->get_component(singles[i]);
+
+			BENCH_CHECK(trf != -1 && scene.transforms->get_entity(trf) == singles[i]);
+			BENCH_CHECK(scene.transforms->get_position(trf).x == static_cast<float>(i));
+		}
+
+		for (size_t i = 500; i < batch.size(); i++)
+			BENCH_CHECK(scene.transforms->get_entity(scene.transforms->get_component(batch[i])) == batch[i]);
+
+		return true;
+	}
+
+	bool bench_bulk_spawn()
+	{
+		// Spawns and removes a million entities with a transform, mesh instance and metadata each,
+		// one at a time and then through the batch calls, which should take milliseconds
+		const size_t spawn_count = 1000000;
+
+		bench_scene scene;
+		std::vector<entity_id> spawned;
+
+		const float single_create = time_ms([&]()
+		{
+			for (size_t i = 0; i < spawn_count; i++)
+			{
+				entity_id eid = scene.entities->create();
+				scene.transforms->register_entity(eid);
+				scene.mesh_instances->register_entity(eid);
+				scene.metadata->register_entity(eid);
+				spawned.emplace_back(eid);
+			}
+		});
+
+		const float single_destroy = time_ms([&]()
+		{
+			for (entity_id eid : spawned)
+			{
+				scene.transforms->unregister_entity(eid);
+				scene.mesh_instances->unregister_entity(eid);
+				scene.metadata->unregister_entity(eid);
+				scene.entities->destroy(eid);
+			}
+		});
+
+		spawned.clear();
+
+		const float bulk_create = time_ms([&]()
+		{
+			scene.entities->create_many(spawn_count, spawned);
+			scene.transforms->register_entities(spawned);
+			scene.mesh_instances->register_entities(spawned);
+			scene.metadata->register_entities(spawned);
+		});
+
+		const float bulk_destroy = time_ms([&]()
+		{
+			scene.managers->remove_entities(spawned);
+			scene.entities->destroy_many(spawned);
+		});
+
+		printf("Bulk spawn: %zu entities -- one at a time %.1f ms create, %.1f ms destroy; batched %.1f ms create, %.1f ms destroy\n",
+				spawn_count, single_create, single_destroy, bulk_create, bulk_destroy);
+
+		return scene.transforms->get_instances().empty() && scene.entities->get_count() == 0;
+	}
+}
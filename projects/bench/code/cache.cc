@@ -0,0 +1,214 @@
+#include "bench.h"
+#include "mesh_cache.h"
+#include "obj_parse.h"
+#include "gltf_stage.h"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	bool check_mesh_cache()
+	{
+		// A strip of triangles zigzagging through a box, with every stream but tangents
+		std::vector<vector3> positions, normals;
+		std::vector<vector2> uvs;
+		std::vector<vector4> tangents;
+		std::vector<unsigned> indices;
+
+		for (int i = 0; i < 100; i++)
+		{
+			positions.emplace_back(i * 0.1f, (i % 7) * 0.3f, (i % 3) * 1.0f);
+			normals.emplace_back(0, 1, 0);
+			uvs.emplace_back(i / 100.0f, 0.5f);
+		}
+
+		for (unsigned i = 0; i + 2 < 100; i++)
+		{
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+		}
+
+		std::vector<lod_level> lods(1);
+		lods[0].indices = { 0, 1, 2 };
+		lods[0].error = 0.5f;
+
+		const fs::path path = fs::temp_directory_path() / ("bench" MESH_CACHE_EXTENSION);
+		const uint32_t layouts[] =
+		{
+			0,
+			layout_compact,
+			layout_compact | MESH_CACHE_LAYOUT_POOLED,
+			MESH_CACHE_LAYOUT_POOLED
+		};
+
+		for (uint32_t layout : layouts)
+		{
+			std::vector<mesh_cache_source> sources(1);
+			mesh_cache_source& source = sources[0];
+
+			source.positions = &positions;
+			source.normals = &normals;
+			source.uvs = &uvs;
+			source.tangents = &tangents;
+			source.indices = &indices;
+			source.lods = &lods;
+			source.box = bounds(vector3(0, 0, 0), vector3(10, 2, 2));
+			source.optimized = true;
+
+			BENCH_CHECK(mesh_cache::write(path, 42, layout, sources));
+			BENCH_CHECK(!source.hull.empty());
+
+			mesh_cache cache;
+
+			// Stale or differently packed caches are turned down
+			BENCH_CHECK(!cache.open(path, 43, layout));
+			BENCH_CHECK(!cache.open(path, 42, layout ^ layout_interleaved));
+			BENCH_CHECK(cache.open(path, 42, layout));
+			BENCH_CHECK(cache.get_mesh_count() == 1);
+
+			const cooked_mesh& mesh = cache.get_mesh(0);
+
+			// Vertices come back exactly as they would be packed for upload
+			unsigned packed_attribs;
+			const vertex_layout packing = mesh_cache::get_packing(layout, mesh.attribs, packed_attribs);
+
+			vertex_quantization quant;
+			if (packing.flags & layout_quantized_positions)
+				quant = get_quantization(positions);
+
+			std::vector<unsigned char> expected;
+			pack_vertices(packing, packed_attribs, quant, positions, normals, uvs, tangents, expected);
+
+			BENCH_CHECK(mesh.attribs == ((1u << attrib_position) | (1u << attrib_normal) | (1u << attrib_uv)));
+			BENCH_CHECK(mesh.vertex_count == positions.size() && mesh.index_count == indices.size());
+			BENCH_CHECK(mesh.vertex_bytes == expected.size());
+			BENCH_CHECK(memcmp(mesh.vertices, expected.data(), expected.size()) == 0);
+			BENCH_CHECK(memcmp(mesh.positions, positions.data(), positions.size() * sizeof(vector3)) == 0);
+			BENCH_CHECK(memcmp(mesh.indices, indices.data(), indices.size() * sizeof(unsigned)) == 0);
+			BENCH_CHECK(mesh.quant.scale.x == quant.scale.x && mesh.quant.offset.y == quant.offset.y);
+			BENCH_CHECK(mesh.hull_count == source.hull.size());
+			BENCH_CHECK(mesh.lod_count == 1 && mesh.lod_index_count[0] == 3 && mesh.lod_error[0] == 0.5f);
+			BENCH_CHECK(mesh.lod_indices[2] == 2);
+			BENCH_CHECK(mesh.optimized);
+
+			cache.close();
+		}
+
+		// Without LODs the aligned LOD offset of the last mesh still lies within the file
+		const std::vector<lod_level> no_lods;
+		std::vector<mesh_cache_source> sources(1);
+
+		sources[0].positions = &positions;
+		sources[0].normals = &normals;
+		sources[0].uvs = &uvs;
+		sources[0].tangents = &tangents;
+		sources[0].indices = &indices;
+		sources[0].lods = &no_lods;
+
+		BENCH_CHECK(mesh_cache::write(path, 42, MESH_CACHE_LAYOUT_POOLED, sources));
+
+		mesh_cache cache;
+		BENCH_CHECK(cache.open(path, 42, MESH_CACHE_LAYOUT_POOLED));
+		BENCH_CHECK(cache.get_mesh(0).lod_count == 0);
+		cache.close();
+
+		// A file cut short after its table points past its end
+		fs::resize_file(path, fs::file_size(path) / 2);
+		BENCH_CHECK(!cache.open(path, 42, MESH_CACHE_LAYOUT_POOLED));
+
+		fs::remove(path);
+		return true;
+	}
+
+	bool bench_mesh_cache()
+	{
+		// Compares plain OBJ parsing against a cold (parse, cook and write) and warm (mapped) cache load
+		const uint32_t layout = MESH_CACHE_LAYOUT_POOLED;
+
+		for (const auto& entry : fs::directory_iterator("../res/meshes"))
+		{
+			if (entry.path().extension() != ".obj")
+				continue;
+
+			const fs::path cache_path = fs::temp_directory_path() / entry.path().filename().replace_extension(MESH_CACHE_EXTENSION);
+			const uint64_t hash = mesh_cache::hash_file(entry.path());
+
+			bool valid = true;
+
+			float parse = time_ms([&]()
+			{
+				core::mapped_file file(entry.path());
+				obj_mesh mesh;
+				valid = file.is_open() && parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh);
+			});
+
+			if (!valid)
+			{
+				printf("Mesh cache: %s -- failed to parse, skipped\n", entry.path().filename().c_str());
+				continue;
+			}
+
+			float cold = time_ms([&]()
+			{
+				core::mapped_file file(entry.path());
+				obj_mesh mesh;
+				parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh);
+
+				const std::vector<vector4> tangents;
+				const std::vector<lod_level> lods;
+
+				std::vector<mesh_cache_source> sources(1);
+				sources[0].positions = &mesh.positions;
+				sources[0].normals = &mesh.normals;
+				sources[0].uvs = &mesh.uvs;
+				sources[0].tangents = &tangents;
+				sources[0].indices = &mesh.indices;
+				sources[0].lods = &lods;
+				sources[0].box = bounds(mesh.min, mesh.max);
+				sources[0].center = (mesh.min + mesh.max) * 0.5f;
+
+				valid = mesh_cache::write(cache_path, hash, layout, sources);
+			});
+
+			size_t vertices = 0;
+
+			float warm = time_ms([&]()
+			{
+				mesh_cache cache;
+				valid = valid && cache.open(cache_path, hash, layout);
+
+				if (valid)
+					vertices = cache.get_mesh(0).vertex_count;
+			});
+
+			fs::remove(cache_path);
+
+			if (!valid)
+			{
+				printf("Mesh cache: %s -- cache round trip failed\n", entry.path().filename().c_str());
+				return false;
+			}
+
+			const float mb = fs::file_size(entry.path()) / (1024.0f * 1024.0f);
+
+			printf("Mesh cache: %s -- OBJ %.2f ms (%.1f MB/s), cold %.2f ms, warm %.2f ms, %zu vertices\n",
+					entry.path().filename().c_str(), parse, mb * 1000.0f / parse, cold, warm, vertices);
+		}
+
+		// The glTF test assets are staged for reference
+		for (const char* path : { "../res/gltf/Avocado/Avocado.gltf", "../res/gltf/FlightHelmet/FlightHelmet.gltf" })
+		{
+			gltf_package package;
+			float stage = time_ms([&]() { stage_gltf(path, false, package); });
+
+			printf("Mesh cache: %s -- glTF staging %.2f ms (%lu primitives)\n", path, stage, package.primitive_count);
+		}
+
+		return true;
+	}
+}
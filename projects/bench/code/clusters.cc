@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "light_cluster.h"
+
+#include <map>
+#include <random>
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Camera at the origin looking down -z, with a 90 degree square frustum,
+		 * so that a view-space point (x, y, -d) lands at NDC (x / d, y / d).
+		 */
+		void build_clusters(light_clusters& clusters, const std::vector<light_sphere>& lights, float near, float far)
+		{
+			const float pi = 3.14159265f;
+			clusters.build(lights, matrix4(), matrix4::get_perspective(pi * 0.5f, 1.0f, near, far), near, far);
+		}
+
+		/**
+		 * \brief Light indices of one cluster, read back from the grid.
+		 */
+		std::vector<unsigned> get_cluster(const light_clusters& clusters, unsigned index)
+		{
+			const auto& grid = clusters.get_grid();
+			const auto& indices = clusters.get_indices();
+
+			const auto first = indices.begin() + grid[index * 2];
+			return std::vector<unsigned>(first, first + grid[index * 2 + 1]);
+		}
+
+		/**
+		 * \brief Lights in a 4 x 2 x 4 grid over depths 1 to 16, so slices end at 2, 4, 8 and 16,
+		 * with the cluster each one is expected to land in worked out by hand.
+		 */
+		std::vector<light_sphere> get_layout()
+		{
+			return
+			{
+				{ vector3(0.0f, 0.0f, -1.0f), 0.6f },		// 0: reaches through the near plane, so covers all of slice 0
+				{ vector3(0.0f, 0.0f, 5.0f), 1.0f },		// 1: behind the camera
+				{ vector3(2.25f, 1.5f, -3.0f), 0.2f },		// 2: NDC (0.75, 0.5) in slice 1, cluster (3, 1, 1)
+				{ vector3(0.0f, 0.0f, -30.0f), 1.0f },		// 3: past the far plane
+				{ vector3(-4.5f, -3.0f, -6.0f), 0.3f },		// 4: NDC (-0.75, -0.5) in slice 2, cluster (0, 0, 2)
+				{ vector3(2.25f, 1.5f, -3.0f), 0.1f },		// 5: inside light 2, listed after it
+				{ vector3(-0.375f, 0.75f, -1.5f), 0.1f }	// 6: NDC (-0.25, 0.5) in slice 0, cluster (1, 1, 0)
+			};
+		}
+	}
+
+	bool check_light_clusters()
+	{
+		light_clusters clusters(4, 2, 4);
+		build_clusters(clusters, get_layout(), 1.0f, 16.0f);
+
+		// Cluster index is x + y * size_x + z * size_x * size_y, lists keep light order
+		std::map<unsigned, std::vector<unsigned>> expected;
+
+		for (unsigned c = 0; c < 8; c++)
+			expected[c] = { 0 };
+
+		expected[5] = { 0, 6 };
+		expected[15] = { 2, 5 };
+		expected[16] = { 4 };
+
+		BENCH_CHECK(clusters.get_cluster_count() == 32);
+
+		for (unsigned c = 0; c < clusters.get_cluster_count(); c++)
+		{
+			const auto it = expected.find(c);
+			BENCH_CHECK(get_cluster(clusters, c) == (it == expected.end() ? std::vector<unsigned>() : it->second));
+		}
+
+		BENCH_CHECK(clusters.get_indices().size() == 12 && clusters.get_overflow() == 0);
+
+		// Capped at one light, the second light in clusters 5 and 15 is dropped and counted
+		light_clusters capped(4, 2, 4, 1);
+		build_clusters(capped, get_layout(), 1.0f, 16.0f);
+
+		BENCH_CHECK(get_cluster(capped, 5) == std::vector<unsigned>({ 0 }));
+		BENCH_CHECK(get_cluster(capped, 15) == std::vector<unsigned>({ 2 }));
+		BENCH_CHECK(capped.get_overflow() == 2 && capped.get_indices().size() == 10);
+
+		// The count is per build, not accumulated
+		build_clusters(capped, { get_layout()[2] }, 1.0f, 16.0f);
+		BENCH_CHECK(capped.get_overflow() == 0 && get_cluster(capped, 15) == std::vector<unsigned>({ 0 }));
+
+		return true;
+	}
+
+	bool bench_light_clusters()
+	{
+		// Scatters lights through a cube around the camera, and builds the default grid over them
+		const size_t count = 10000;
+		const float near = 0.1f, far = 100.0f, extent = far * 0.5f;
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> offset(-extent, extent);
+		std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+
+		std::vector<light_sphere> lights(count);
+
+		for (auto& light : lights)
+		{
+			light.position = vector3(offset(rng), offset(rng), offset(rng));
+			light.radius = radius(rng);
+		}
+
+		light_clusters clusters;
+
+		const int runs = 10;
+		float total = 0.0f;
+
+		for (int i = 0; i < runs; i++)
+			total += time_ms([&]() { build_clusters(clusters, lights, near, far); });
+
+		printf("Light clustering: %zu lights, %u clusters, %zu references, %zu dropped, %.3f ms average over %d runs\n",
+				count, clusters.get_cluster_count(), clusters.get_indices().size(), clusters.get_overflow(), total / runs, runs);
+
+		return true;
+	}
+}
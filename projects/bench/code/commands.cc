@@ -0,0 +1,169 @@
+#include "bench.h"
+#include "scene.h"
+#include "core/jobs.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Records a parent at x = i and a child attached to it for every pair, from parallel jobs.
+		 * With reverse set, each chunk keys its pairs back to front, so that playback has to follow the keys.
+		 */
+		void spawn_pairs(bench_scene& scene, size_t count, size_t grain, bool reverse)
+		{
+			transform_manager* trf = scene.transforms.get();
+
+			core::job_system::get().parallel_for(count, grain, [&](size_t begin, size_t end)
+			{
+				command_buffer& cmd = scene.managers->get_commands();
+
+				for (size_t i = begin; i < end; i++)
+				{
+					cmd.set_key(reverse ? end - i : i);
+
+					entity_id parent = cmd.create();
+					cmd.add_component(trf, parent, [trf, i](int idx) { trf->set_position(idx, vector3(static_cast<float>(i), 0, 0)); });
+
+					entity_id child = cmd.create();
+					cmd.add_component(trf, child);
+					cmd.reparent(trf, child, parent);
+				}
+			});
+		}
+
+		/**
+		 * \brief Records a destroy for every transform from first onwards, from parallel jobs.
+		 */
+		void destroy_from(bench_scene& scene, size_t first, size_t grain)
+		{
+			std::vector<entity_id> spawned;
+
+			for (size_t i = first; i < scene.transforms->get_instances().size(); i++)
+				spawned.emplace_back(scene.transforms->get_entity(static_cast<transform_id>(i)));
+
+			core::job_system::get().parallel_for(spawned.size(), grain, [&](size_t begin, size_t end)
+			{
+				command_buffer& cmd = scene.managers->get_commands();
+
+				for (size_t i = begin; i < end; i++)
+				{
+					cmd.set_key(i);
+					cmd.destroy(spawned[i]);
+				}
+			});
+		}
+	}
+
+	bool check_command_buffers()
+	{
+		bench_scene scene;
+		transform_manager* trf = scene.transforms.get();
+
+		// Nothing recorded, nothing played, and nothing is created until playback
+		BENCH_CHECK(scene.managers->play_commands() == 0);
+
+		const size_t pair_count = 2000;
+		const size_t grain = 64;
+
+		spawn_pairs(scene, pair_count, grain, true);
+		BENCH_CHECK(trf->get_instances().empty() && scene.entities->get_count() == 0);
+
+		// Chunks play back in range order, and within one by key rather than by recording order
+		BENCH_CHECK(scene.managers->play_commands() == pair_count * 5);
+		BENCH_CHECK(trf->get_instances().size() == pair_count * 2);
+
+		size_t pair = 0;
+
+		for (size_t begin = 0; begin < pair_count; begin += grain)
+		{
+			const size_t end = std::min(begin + grain, pair_count);
+
+			for (size_t i = end; i-- > begin; pair++)
+			{
+				const transform_id parent = static_cast<transform_id>(pair * 2);
+
+				BENCH_CHECK(trf->get_position(parent).x == static_cast<float>(i));
+				BENCH_CHECK(trf->get_parent(parent + 1) == parent);
+			}
+		}
+
+		// Without keys, commands keep the order of the range, and those recorded outside a chunk come after it
+		const size_t base = trf->get_instances().size();
+		const size_t single_count = 1000;
+
+		core::job_system::get().parallel_for(single_count, 32, [&](size_t begin, size_t end)
+		{
+			command_buffer& cmd = scene.managers->get_commands();
+
+			for (size_t i = begin; i < end; i++)
+				cmd.add_component(trf, cmd.create(), [trf, i](int idx) { trf->set_position(idx, vector3(static_cast<float>(i), 0, 0)); });
+		});
+
+		command_buffer& main = scene.managers->get_commands();
+		main.add_component(trf, main.create(), [trf](int idx) { trf->set_position(idx, vector3(-1, 0, 0)); });
+
+		BENCH_CHECK(scene.managers->play_commands() == (single_count + 1) * 2);
+		BENCH_CHECK(trf->get_instances().size() == base + single_count + 1);
+
+		for (size_t i = 0; i < single_count; i++)
+			BENCH_CHECK(trf->get_position(static_cast<transform_id>(base + i)).x == static_cast<float>(i));
+
+		BENCH_CHECK(trf->get_position(static_cast<transform_id>(base + single_count)).x == -1.0f);
+
+		// An entity destroyed twice in a run is removed once, and commands on it afterwards are dropped
+		const entity_id twice = trf->get_entity(static_cast<transform_id>(base + single_count));
+
+		main.destroy(twice);
+		main.destroy(twice);
+		scene.managers->play_commands();
+
+		main.add_component(scene.metadata.get(), twice);
+		main.destroy(twice);
+		scene.managers->play_commands();
+
+		BENCH_CHECK(!scene.entities->is_valid(twice) && scene.metadata->get_component(twice) == -1);
+		BENCH_CHECK(trf->get_instances().size() == base + single_count);
+
+		// Destroys from jobs take everything out as one batch
+		destroy_from(scene, 0, 64);
+		scene.managers->play_commands();
+
+		BENCH_CHECK(trf->get_instances().empty() && scene.entities->get_count() == 0);
+
+		return true;
+	}
+
+	bool bench_command_buffers()
+	{
+		// Spawns pairs of parented entities from parallel jobs through command buffers, then destroys them the same way
+		const size_t pair_count = 50000;
+		const size_t grain = 256;
+
+		bench_scene scene;
+		transform_manager* trf = scene.transforms.get();
+
+		float record = time_ms([&]() { spawn_pairs(scene, pair_count, grain, false); });
+
+		size_t played = 0;
+		float play = time_ms([&]() { played = scene.managers->play_commands(); });
+
+		printf("Command buffers: %zu spawn commands recorded in %.2f ms, played back in %.2f ms\n", played, record, play);
+
+		for (size_t i = 0; i < pair_count; i++)
+		{
+			const transform_id parent = static_cast<transform_id>(i * 2);
+			BENCH_CHECK(trf->get_position(parent).x == static_cast<float>(i) && trf->get_parent(parent + 1) == parent);
+		}
+
+		record = time_ms([&]() { destroy_from(scene, 0, grain); });
+		play = time_ms([&]() { played = scene.managers->play_commands(); });
+
+		printf("Command buffers: %zu destroy commands recorded in %.2f ms, played back in %.2f ms\n", played, record, play);
+
+		return trf->get_instances().empty();
+	}
+}
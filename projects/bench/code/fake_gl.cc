@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace efiilj
+{
+	namespace
+	{
+		// Names handed out by the fake, never 0 so that built meshes look built
+		GLuint next_name = 1;
+
+		// Mapped ranges are written into here and dropped
+		std::vector<unsigned char> mapped;
+
+		void GLAPIENTRY gen_names(GLsizei n, GLuint* names)
+		{
+			for (GLsizei i = 0; i < n; i++)
+				names[i] = next_name++;
+		}
+
+		void GLAPIENTRY delete_names(GLsizei, const GLuint*) { }
+		void GLAPIENTRY bind_name(GLuint) { }
+		void GLAPIENTRY bind_target(GLenum, GLuint) { }
+		void GLAPIENTRY buffer_data(GLenum, GLsizeiptr, const void*, GLenum) { }
+		void GLAPIENTRY buffer_sub_data(GLenum, GLintptr, GLsizeiptr, const void*) { }
+		void GLAPIENTRY attrib_array(GLuint) { }
+		void GLAPIENTRY attrib_pointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { }
+		void GLAPIENTRY attrib_divisor(GLuint, GLuint) { }
+		void GLAPIENTRY attrib_4f(GLuint, GLfloat, GLfloat, GLfloat, GLfloat) { }
+
+		void* GLAPIENTRY map_range(GLenum, GLintptr, GLsizeiptr length, GLbitfield)
+		{
+			mapped.resize(length);
+			return mapped.data();
+		}
+
+		GLboolean GLAPIENTRY unmap(GLenum) { return GL_TRUE; }
+	}
+
+	void use_fake_gl()
+	{
+		__glewGenVertexArrays = gen_names;
+		__glewDeleteVertexArrays = delete_names;
+		__glewBindVertexArray = bind_name;
+		__glewGenBuffers = gen_names;
+		__glewDeleteBuffers = delete_names;
+		__glewBindBuffer = bind_target;
+		__glewBufferData = buffer_data;
+		__glewBufferSubData = buffer_sub_data;
+		__glewEnableVertexAttribArray = attrib_array;
+		__glewDisableVertexAttribArray = attrib_array;
+		__glewVertexAttribPointer = attrib_pointer;
+		__glewVertexAttribDivisor = attrib_divisor;
+		__glewVertexAttrib4f = attrib_4f;
+		__glewMapBufferRange = map_range;
+		__glewUnmapBuffer = unmap;
+	}
+}
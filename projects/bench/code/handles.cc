@@ -0,0 +1,113 @@
+#include "bench.h"
+#include "scene.h"
+
+#include <vector>
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Creates and destroys batches of entities, materials and meshes, freeing every other one first
+		 * and the rest backwards, so that freed slots are reused in a different order each round.
+		 */
+		void churn(bench_scene& scene, int batch)
+		{
+			std::vector<entity_id> ents;
+			std::vector<material_id> mats;
+			std::vector<mesh_id> mshs;
+
+			for (int i = 0; i < batch; i++)
+			{
+				ents.push_back(scene.entities->create());
+				mats.push_back(scene.materials->create());
+				mshs.push_back(scene.meshes->create());
+			}
+
+			for (int pass = 0; pass < 2; pass++)
+			{
+				for (int i = pass; i < batch; i += 2)
+				{
+					const int j = pass ? batch - i : i;
+
+					scene.entities->destroy(ents[j]);
+					scene.materials->destroy(mats[j]);
+					scene.meshes->destroy(mshs[j]);
+				}
+			}
+		}
+	}
+
+	bool check_handles()
+	{
+		bench_scene scene;
+		material_server& materials = *scene.materials;
+
+		// A freed slot is reused under a new generation, and the old handle stays invalid
+		const material_id stale = materials.create();
+		BENCH_CHECK(materials.destroy(stale));
+		BENCH_CHECK(!materials.is_valid(stale) && !materials.destroy(stale));
+
+		const material_id reused = materials.create();
+		BENCH_CHECK(handle_index(reused) == handle_index(stale) && reused != stale);
+		BENCH_CHECK(materials.is_valid(reused) && !materials.is_valid(stale));
+		BENCH_CHECK(materials.get_capacity() == 1 && materials.get_recycled() == 1);
+
+		// Stale handles neither hold nor drop references on what took their slot
+		BENCH_CHECK(!materials.add_ref(stale) && !materials.remove_ref(stale));
+		BENCH_CHECK(materials.get_ref_count(stale) == 0 && materials.get_ref_count(reused) == 1);
+
+		BENCH_CHECK(materials.add_ref(reused) && materials.get_ref_count(reused) == 2);
+		BENCH_CHECK(!materials.remove_ref(reused) && materials.is_valid(reused));
+
+		// Shared content is found until the resource is gone, and stale handles are never published
+		materials.set_shared(stale, 7, 100);
+		BENCH_CHECK(materials.find_shared(7) == -1);
+
+		materials.set_shared(reused, 7, 100);
+		BENCH_CHECK(materials.find_shared(7) == reused && materials.get_ref_count(reused) == 2);
+		BENCH_CHECK(materials.get_saved_bytes() == 100);
+
+		BENCH_CHECK(!materials.remove_ref(reused));
+		BENCH_CHECK(materials.remove_ref(reused) && !materials.is_valid(reused));
+		BENCH_CHECK(materials.find_shared(7) == -1 && materials.get_shared_count() == 0);
+
+		// Servers stop growing once the first batch has been freed
+		const int batch = 256;
+		churn(scene, batch);
+
+		const size_t capacity[3] = {
+			scene.entities->get_capacity(), scene.materials->get_capacity(), scene.meshes->get_capacity() };
+
+		for (int round = 0; round < 20; round++)
+			churn(scene, batch);
+
+		BENCH_CHECK(scene.entities->get_capacity() == capacity[0] && scene.entities->get_count() == 0);
+		BENCH_CHECK(scene.materials->get_capacity() == capacity[1] && scene.materials->get_count() == 0);
+		BENCH_CHECK(scene.meshes->get_capacity() == capacity[2] && scene.meshes->get_count() == 0);
+		BENCH_CHECK(!materials.is_valid(stale) && !materials.is_valid(reused));
+
+		return true;
+	}
+
+	bool bench_handles()
+	{
+		// Times creation under steady churn, and reports the size the servers settle at
+		bench_scene scene;
+
+		const int rounds = 1000;
+		const int batch = 256;
+
+		const float ms = time_ms([&]()
+		{
+			for (int round = 0; round < rounds; round++)
+				churn(scene, batch);
+		});
+
+		printf("Handle churn: %d x %d creations in %.2f ms -- capacity of entities %zu, materials %zu (%zu recycled), meshes %zu\n",
+				rounds, batch * 3, ms, scene.entities->get_capacity(),
+				scene.materials->get_capacity(), scene.materials->get_recycled(), scene.meshes->get_capacity());
+
+		return true;
+	}
+}
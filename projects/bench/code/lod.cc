@@ -0,0 +1,173 @@
+#include "bench.h"
+#include "mesh_lod.h"
+#include "obj_parse.h"
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Closest point on a triangle (Ericson, Real-Time Collision Detection 5.1.5).
+		 */
+		vector3 closest_point(const vector3& p, const vector3& a, const vector3& b, const vector3& c)
+		{
+			const vector3 ab = b - a, ac = c - a, ap = p - a;
+			const float d1 = vector3::dot(ab, ap), d2 = vector3::dot(ac, ap);
+			if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+			const vector3 bp = p - b;
+			const float d3 = vector3::dot(ab, bp), d4 = vector3::dot(ac, bp);
+			if (d3 >= 0.0f && d4 <= d3) return b;
+
+			const float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+			const vector3 cp = p - c;
+			const float d5 = vector3::dot(ab, cp), d6 = vector3::dot(ac, cp);
+			if (d6 >= 0.0f && d5 <= d6) return c;
+
+			const float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+			const float va = d3 * d6 - d5 * d4;
+			if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+			const float denom = 1.0f / (va + vb + vc);
+			return a + ab * (vb * denom) + ac * (vc * denom);
+		}
+
+		/**
+		 * \brief Largest distance from sampled vertices of the full mesh to a level, relative to the mesh extent.
+		 */
+		float get_deviation(const std::vector<vector3>& positions, const lod_level& lod, float extent, size_t samples)
+		{
+			const size_t step = std::max<size_t>(positions.size() / samples, 1);
+			float worst = 0.0f;
+
+			for (size_t v = 0; v < positions.size(); v += step)
+			{
+				const vector3& p = positions[v];
+				float nearest = std::numeric_limits<float>::max();
+
+				for (size_t i = 0; i + 2 < lod.indices.size(); i += 3)
+				{
+					const vector3 q = closest_point(p, positions[lod.indices[i]],
+							positions[lod.indices[i + 1]], positions[lod.indices[i + 2]]);
+
+					nearest = std::min(nearest, (q - p).length());
+				}
+
+				worst = std::max(worst, nearest);
+			}
+
+			return worst / extent;
+		}
+	}
+
+	bool check_mesh_lod()
+	{
+		std::vector<vector3> positions;
+		std::vector<unsigned> indices;
+		make_sphere(32, 64, positions, indices);
+
+		const std::vector<lod_level> chain = generate_lod_chain(positions, indices);
+
+		BENCH_CHECK(!chain.empty() && chain.size() <= MESH_LOD_LEVELS);
+
+		// Diagonal of the bounds, which errors are relative to
+		const float extent = (vector3(1, 1, 1) - vector3(-1, -1, -1)).length();
+
+		size_t previous = indices.size();
+
+		for (const lod_level& lod : chain)
+		{
+			// Every level shrinks, stays within the error bound and only uses vertices of the full mesh
+			BENCH_CHECK(lod.indices.size() % 3 == 0 && lod.indices.size() <= previous * 3 / 4);
+			BENCH_CHECK(lod.error >= 0.0f && lod.error <= MESH_LOD_MAX_ERROR);
+
+			for (unsigned index : lod.indices)
+				BENCH_CHECK(index < positions.size());
+
+			for (size_t i = 0; i < lod.indices.size(); i += 3)
+			{
+				BENCH_CHECK(lod.indices[i] != lod.indices[i + 1] && lod.indices[i + 1] != lod.indices[i + 2]
+						&& lod.indices[i] != lod.indices[i + 2]);
+			}
+
+			// Quadric error is not a strict distance, but sampled vertices stay within the bound the chain is built for
+			BENCH_CHECK(get_deviation(positions, lod, extent, 256) <= MESH_LOD_MAX_ERROR);
+
+			previous = lod.indices.size();
+		}
+
+		// Too small to be worth simplifying
+		std::vector<vector3> small_positions;
+		std::vector<unsigned> small_indices;
+		make_sphere(6, 8, small_positions, small_indices);
+
+		BENCH_CHECK(small_indices.size() / 3 < MESH_LOD_MIN_TRIANGLES);
+		BENCH_CHECK(generate_lod_chain(small_positions, small_indices).empty());
+
+		// Screen size falls with distance, and fills the screen from inside the bounds
+		const bounds box(vector3(-1, -1, -1), vector3(1, 1, 1));
+		const float fov = 1.0f;
+
+		BENCH_CHECK(get_screen_size(box, vector3(0, 0, 0), fov) == std::numeric_limits<float>::max());
+		BENCH_CHECK(get_screen_size(box, vector3(0, 0, 10), fov) > get_screen_size(box, vector3(0, 0, 20), fov));
+
+		// Level 1 takes over below the threshold, level 2 below half of it, but only past the hysteresis margin
+		const float threshold = 0.4f, hysteresis = 0.1f;
+
+		BENCH_CHECK(select_lod(1.0f, 0, 4, threshold, hysteresis) == 0);
+		BENCH_CHECK(select_lod(0.39f, 0, 4, threshold, hysteresis) == 0);
+		BENCH_CHECK(select_lod(0.35f, 0, 4, threshold, hysteresis) == 1);
+		BENCH_CHECK(select_lod(0.41f, 1, 4, threshold, hysteresis) == 1);
+		BENCH_CHECK(select_lod(0.45f, 1, 4, threshold, hysteresis) == 0);
+		BENCH_CHECK(select_lod(0.01f, 0, 4, threshold, hysteresis) == 3);
+		BENCH_CHECK(select_lod(0.01f, 0, 1, threshold, hysteresis) == 0);
+
+		return true;
+	}
+
+	bool bench_mesh_lod()
+	{
+		// Times LOD chain generation on the OBJ assets, and measures how far sampled vertices of the full mesh
+		// end up from each level, against the error reported by the simplifier
+		for (const auto& entry : fs::directory_iterator("../res/meshes"))
+		{
+			if (entry.path().extension() != ".obj")
+				continue;
+
+			core::mapped_file file(entry.path());
+			obj_mesh mesh;
+
+			if (!file.is_open() || !parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh))
+				continue;
+
+			std::vector<lod_level> chain;
+			const float ms = time_ms([&]() { chain = generate_lod_chain(mesh.positions, mesh.indices); });
+
+			printf("Mesh LOD: %s -- %zu triangles, %zu levels in %.2f ms\n",
+					entry.path().filename().c_str(), mesh.indices.size() / 3, chain.size(), ms);
+
+			const float extent = (mesh.max - mesh.min).length();
+
+			for (const auto& lod : chain)
+			{
+				printf("    %zu triangles, simplifier error %.3f%%, sampled deviation %.3f%% (bound %.3f%%)\n",
+						lod.indices.size() / 3, lod.error * 100.0f, get_deviation(mesh.positions, lod, extent, 256) * 100.0f,
+						MESH_LOD_MAX_ERROR * 100.0f);
+			}
+		}
+
+		return true;
+	}
+}
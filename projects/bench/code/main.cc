@@ -0,0 +1,104 @@
+//------------------------------------------------------------------------------
+// main.cc
+//------------------------------------------------------------------------------
+#include "config.h"
+#include "bench.h"
+
+#include <cstring>
+
+namespace
+{
+	struct bench_case
+	{
+		const char* name;
+		bool (*run)();
+
+		// Checks run when no case is named, benchmarks only when asked for
+		bool check;
+	};
+
+	const bench_case cases[] =
+	{
+		{ "range_allocator", efiilj::check_range_allocator, true },
+		{ "indirect_commands", efiilj::check_indirect_commands, true },
+		{ "occlusion", efiilj::check_occlusion, true },
+		{ "mesh_cache", efiilj::check_mesh_cache, true },
+		{ "mesh_cache_load", efiilj::bench_mesh_cache, false },
+		{ "shader_preprocessor", efiilj::check_shader_preprocessor, true },
+		{ "shader_preprocessor_load", efiilj::bench_shader_preprocessor, false },
+		{ "mesh_optimizer", efiilj::check_mesh_optimizer, true },
+		{ "mesh_optimizer_speed", efiilj::bench_mesh_optimizer, false },
+		{ "mesh_lod", efiilj::check_mesh_lod, true },
+		{ "mesh_lod_chain", efiilj::bench_mesh_lod, false },
+		{ "meshlets", efiilj::check_meshlets, true },
+		{ "meshlet_culling", efiilj::bench_meshlets, false },
+		{ "frame_arena", efiilj::check_frame_arena, true },
+		{ "collision_updates", efiilj::bench_frame_arena, false },
+		{ "handles", efiilj::check_handles, true },
+		{ "handle_churn", efiilj::bench_handles, false },
+		{ "bulk_spawn", efiilj::check_bulk_spawn, true },
+		{ "bulk_spawn_million", efiilj::bench_bulk_spawn, false },
+		{ "command_buffers", efiilj::check_command_buffers, true },
+		{ "command_playback", efiilj::bench_command_buffers, false },
+		{ "shared_assets", efiilj::check_shared_assets, true },
+		{ "texture_cooker", efiilj::check_texture_cooker, true },
+		{ "texture_cooker_speed", efiilj::bench_texture_cooker, false },
+		{ "light_clusters", efiilj::check_light_clusters, true },
+		{ "light_clusters_10k", efiilj::bench_light_clusters, false },
+		{ "light_volumes", efiilj::check_light_volumes, true },
+		{ "obj_parser", efiilj::check_obj_parser, true },
+	};
+
+	bool is_selected(const bench_case& c, int argc, const char** argv)
+	{
+		if (argc < 2)
+			return c.check;
+
+		for (int i = 1; i < argc; i++)
+		{
+			if (strcmp(argv[i], "all") == 0 || strcmp(argv[i], c.name) == 0)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+int
+main(int argc, const char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--list") == 0)
+	{
+		for (const bench_case& c : cases)
+			printf("%s%s\n", c.name, c.check ? " (check)" : "");
+
+		return 0;
+	}
+
+	int failed = 0;
+	int ran = 0;
+
+	for (const bench_case& c : cases)
+	{
+		if (!is_selected(c, argc, argv))
+			continue;
+
+		printf("[%s]\n", c.name);
+		ran++;
+
+		if (!c.run())
+		{
+			printf("[%s] FAILED\n", c.name);
+			failed++;
+		}
+	}
+
+	if (ran == 0)
+	{
+		fprintf(stderr, "Nothing to run, see --list\n");
+		return 1;
+	}
+
+	printf("%d of %d passed\n", ran - failed, ran);
+	return failed == 0 ? 0 : 1;
+}
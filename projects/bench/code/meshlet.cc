@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "meshlet.h"
+#include "mesh_opt.h"
+#include "obj_parse.h"
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Triangles of an index buffer, each rotated to start at its lowest index so that winding is kept.
+		 */
+		std::vector<std::array<unsigned, 3>> get_triangles(const std::vector<unsigned>& indices)
+		{
+			std::vector<std::array<unsigned, 3>> triangles;
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				std::array<unsigned, 3> tri = { indices[i], indices[i + 1], indices[i + 2] };
+				std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+				triangles.push_back(tri);
+			}
+
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		}
+
+		meshlet_view get_view(const vector3& camera, const vector3& target, float far, bool backfaces = true)
+		{
+			const matrix4 projection = matrix4::get_perspective(1.0f, 16.0f / 9.0f, 0.1f, far);
+			return meshlet_view(projection * matrix4::get_lookat(camera, target, vector3(0, 1, 0)), matrix4(), camera, backfaces);
+		}
+	}
+
+	bool check_meshlets()
+	{
+		std::vector<vector3> positions;
+		std::vector<unsigned> indices;
+		make_sphere(32, 64, positions, indices);
+
+		const std::vector<std::array<unsigned, 3>> triangles = get_triangles(indices);
+
+		std::vector<meshlet> meshlets;
+		build_meshlets(positions, indices, meshlets);
+
+		// Triangles are only reordered, and every meshlet is the next range of the index buffer
+		BENCH_CHECK(get_triangles(indices) == triangles);
+		BENCH_CHECK(meshlets.size() > 1);
+
+		unsigned next = 0;
+
+		for (const meshlet& m : meshlets)
+		{
+			BENCH_CHECK(m.first_index == next && m.index_count > 0 && m.index_count % 3 == 0);
+			BENCH_CHECK(m.index_count / 3 <= MESHLET_MAX_TRIANGLES);
+
+			const std::set<unsigned> unique(indices.begin() + m.first_index, indices.begin() + m.first_index + m.index_count);
+			BENCH_CHECK(unique.size() <= MESHLET_MAX_VERTICES);
+
+			// The bounding sphere holds every vertex, and the cone every triangle normal
+			for (unsigned v : unique)
+				BENCH_CHECK((positions[v] - m.center).length() <= m.radius * 1.001f);
+
+			for (unsigned i = m.first_index; i < m.first_index + m.index_count; i += 3)
+			{
+				const vector3& a = positions[indices[i]];
+				const vector3 normal = vector3::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a).norm();
+
+				BENCH_CHECK(m.cone_cutoff >= 1.0f || vector3::dot(normal, m.cone_axis) >= 0.0f);
+			}
+
+			next += m.index_count;
+		}
+
+		BENCH_CHECK(next == indices.size());
+
+		std::vector<unsigned char> visible;
+		std::vector<meshlet_range> ranges;
+
+		// From outside, the far side of the sphere faces away
+		const size_t front = cull_meshlets(meshlets, get_view(vector3(0, 0, 4), vector3(0, 0, 0), 100.0f), visible, ranges);
+		BENCH_CHECK(front > 0 && front < meshlets.size());
+
+		// Visible runs are merged into ranges that cover exactly the visible meshlets
+		size_t covered = 0, expected = 0;
+
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			covered += ranges[i].index_count;
+			BENCH_CHECK(i == 0 || ranges[i].first_index > ranges[i - 1].first_index + ranges[i - 1].index_count);
+		}
+
+		for (size_t i = 0; i < meshlets.size(); i++)
+			expected += visible[i] ? meshlets[i].index_count : 0;
+
+		BENCH_CHECK(covered == expected);
+
+		// Nothing is back-facing for double-sided materials, and nothing is drawn behind the camera
+		ranges.clear();
+		BENCH_CHECK(cull_meshlets(meshlets, get_view(vector3(0, 0, 4), vector3(0, 0, 0), 100.0f, false), visible, ranges) == meshlets.size());
+		BENCH_CHECK(ranges.size() == 1 && ranges[0].index_count == indices.size());
+
+		ranges.clear();
+		BENCH_CHECK(cull_meshlets(meshlets, get_view(vector3(0, 0, 4), vector3(0, 0, 8), 100.0f), visible, ranges) == 0);
+		BENCH_CHECK(ranges.empty());
+
+		return true;
+	}
+
+	bool bench_meshlets()
+	{
+		// Splits the OBJ assets into meshlets in vertex cache order, and culls them from six views around each mesh
+		for (const auto& entry : fs::directory_iterator("../res/meshes"))
+		{
+			if (entry.path().extension() != ".obj")
+				continue;
+
+			core::mapped_file file(entry.path());
+			obj_mesh mesh;
+
+			if (!file.is_open() || !parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh))
+				continue;
+
+			optimize_vertex_cache(mesh.indices, mesh.positions.size());
+
+			std::vector<meshlet> meshlets;
+			float ms = time_ms([&]() { build_meshlets(mesh.positions, mesh.indices, meshlets); });
+
+			printf("Meshlets: %s -- %zu triangles, %zu meshlets in %.2f ms, %.1f tris each\n",
+					entry.path().filename().c_str(), mesh.indices.size() / 3, meshlets.size(), ms,
+					meshlets.empty() ? 0.0f : mesh.indices.size() / 3.0f / meshlets.size());
+
+			if (meshlets.empty())
+				continue;
+
+			const vector3 center = (mesh.min + mesh.max) * 0.5f;
+			const float extent = (mesh.max - mesh.min).length();
+			const vector3 views[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, 1, 0.01f }, { 0.3f, 0.1f, 0.4f } };
+
+			std::vector<unsigned char> visible;
+			std::vector<meshlet_range> ranges;
+
+			for (const vector3& dir : views)
+			{
+				// The last view is close enough that the mesh overfills the screen
+				const float distance = &dir == &views[5] ? 0.5f : 1.5f;
+				const meshlet_view view = get_view(center + dir.norm() * extent * distance, center, extent * 10.0f);
+
+				ranges.clear();
+
+				size_t drawn = 0;
+				ms = time_ms([&]() { drawn = cull_meshlets(meshlets, view, visible, ranges); });
+
+				size_t indices = 0;
+				for (const auto& range : ranges)
+					indices += range.index_count;
+
+				printf("    view (%.1f, %.1f, %.1f): %zu/%zu meshlets visible, %.0f%% of triangles in %zu ranges, %.3f ms\n",
+						dir.x, dir.y, dir.z, drawn, meshlets.size(), 100.0f * indices / mesh.indices.size(), ranges.size(), ms);
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+#include "obj_parse.h"
+
+#include <string>
+
+namespace efiilj
+{
+	namespace
+	{
+		bool parse(const std::string& text, obj_mesh& mesh)
+		{
+			return parse_obj(text.data(), text.size(), mesh);
+		}
+
+		const char* triangle = "v 0 0 0\nv 1 0 0\nv 0 1 0\n";
+	}
+
+	bool check_obj_parser()
+	{
+		obj_mesh mesh;
+
+		// v//vn carries normals without uvs
+		BENCH_CHECK(parse(std::string(triangle) + "vn 0 0 1\nf 1//1 2//1 3//1\n", mesh));
+		BENCH_CHECK(mesh.positions.size() == 3 && mesh.normals.size() == 3 && mesh.uvs.empty());
+		BENCH_CHECK(mesh.indices == std::vector<unsigned>({ 0, 1, 2 }));
+		BENCH_CHECK(mesh.normals[2] == vector3(0, 0, 1) && mesh.positions[1] == vector3(1, 0, 0));
+
+		// v/vt carries uvs without normals
+		BENCH_CHECK(parse(std::string(triangle) + "vt 0 0\nvt 1 0\nvt 0 1\nf 1/3 2/2 3/1\n", mesh));
+		BENCH_CHECK(mesh.positions.size() == 3 && mesh.uvs.size() == 3 && mesh.normals.empty());
+		BENCH_CHECK(mesh.uvs[0] == vector2(0, 1) && mesh.uvs[2] == vector2(0, 0));
+
+		// One position with two normals becomes two vertices, and repeated triplets are shared
+		BENCH_CHECK(parse(std::string(triangle) + "v 1 1 0\nvn 0 0 1\nvn 0 0 -1\nf 1//1 2//1 3//1\nf 1//2 3//2 4//2\nf 2//1 4//1 3//1\n", mesh));
+		BENCH_CHECK(mesh.positions.size() == 7);
+		BENCH_CHECK(mesh.indices == std::vector<unsigned>({ 0, 1, 2, 3, 4, 5, 1, 6, 2 }));
+
+		// Negative indices count back from the last vertex read before the face
+		BENCH_CHECK(parse(std::string(triangle) + "f -3 -2 -1\nv 5 5 5\nf 1 -1 2\n", mesh));
+		BENCH_CHECK(mesh.positions.size() == 4 && mesh.positions[3] == vector3(5, 5, 5));
+		BENCH_CHECK(mesh.indices == std::vector<unsigned>({ 0, 1, 2, 0, 3, 1 }));
+		BENCH_CHECK(mesh.min == vector3(0, 0, 0) && mesh.max == vector3(5, 5, 5));
+
+		// N-gons are fanned from their first corner, keeping the winding
+		BENCH_CHECK(parse("v 0 0 0\nv 1 0 0\nv 2 1 0\nv 1 2 0\nv 0 1 0\nf 1 2 3 4 5\n", mesh));
+		BENCH_CHECK(mesh.indices == std::vector<unsigned>({ 0, 1, 2, 0, 2, 3, 0, 3, 4 }));
+
+		// Faces that reach missing or zero vertices, or have too few corners, fail the parse
+		BENCH_CHECK(!parse(std::string(triangle) + "f 1 2 4\n", mesh));
+		BENCH_CHECK(!parse(std::string(triangle) + "f 0 1 2\n", mesh));
+		BENCH_CHECK(!parse(std::string(triangle) + "f -4 -2 -1\n", mesh));
+		BENCH_CHECK(!parse(std::string(triangle) + "f 1 2\n", mesh));
+
+		// Over a megabyte of vertices splits into several chunks, and relative indices reach back across them
+		std::string large;
+
+		for (int i = 0; i < 100000; i++)
+			large += "v " + std::to_string(i) + " 0.000000 0.000000\n";
+
+		large += "f -100000 -50000 -1\n";
+
+		BENCH_CHECK(large.size() > (2u << 20));
+		BENCH_CHECK(parse(large, mesh) && mesh.indices.size() == 3);
+		BENCH_CHECK(mesh.positions[mesh.indices[0]].x == 0.0f);
+		BENCH_CHECK(mesh.positions[mesh.indices[1]].x == 50000.0f);
+		BENCH_CHECK(mesh.positions[mesh.indices[2]].x == 99999.0f);
+
+		return true;
+	}
+}
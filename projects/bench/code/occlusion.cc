@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "occl_rast.h"
+
+#include <vector>
+
+namespace efiilj
+{
+	bool check_occlusion()
+	{
+		const matrix4 view_projection = matrix4::get_perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f)
+			* matrix4::get_lookat(vector3(0, 0, 0), vector3(0, 0, -1), vector3(0, 1, 0));
+
+		// A quad five units down the view axis, wide enough to cover the screen
+		const std::vector<vector3> quad = { { -100, -100, -5 }, { 100, -100, -5 }, { 100, 100, -5 }, { -100, 100, -5 } };
+		const std::vector<unsigned> indices = { 0, 1, 2, 0, 2, 3 };
+
+		occlusion_rasterizer occlusion;
+
+		occlusion.begin(view_projection);
+		occlusion.add_occluder(quad, indices, matrix4());
+		occlusion.rasterize();
+
+		BENCH_CHECK(occlusion.get_occluder_tris() == 2);
+
+		// Every pixel was covered, at the depth of the quad
+		const float* depth = occlusion.get_depth_buffer();
+		const size_t pixels = static_cast<size_t>(occlusion.get_width()) * occlusion.get_height();
+
+		for (size_t i = 0; i < pixels; i++)
+			BENCH_CHECK(depth[i] < 1.0f);
+
+		const bounds behind(vector3(-1, -1, -12), vector3(1, 1, -10));
+		const bounds in_front(vector3(-1, -1, -3), vector3(1, 1, -2));
+		const bounds straddling(vector3(-1, -1, -6), vector3(1, 1, -4));
+
+		BENCH_CHECK(!occlusion.test(behind));
+		BENCH_CHECK(occlusion.test(in_front));
+		BENCH_CHECK(occlusion.test(straddling));
+		BENCH_CHECK(occlusion.get_tested() == 3 && occlusion.get_occluded() == 1);
+
+		// Without occluders nothing is hidden
+		occlusion.begin(view_projection);
+		occlusion.rasterize();
+
+		BENCH_CHECK(occlusion.test(behind));
+
+		return true;
+	}
+}
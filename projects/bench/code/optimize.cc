@@ -0,0 +1,172 @@
+#include "bench.h"
+#include "mesh_opt.h"
+#include "obj_parse.h"
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	namespace
+	{
+		/**
+		 * \brief Flat grid of quads where no triangle shares its corners, in a shuffled order.
+		 */
+		void make_shuffled_grid(unsigned size, obj_mesh& mesh)
+		{
+			for (unsigned y = 0; y < size; y++)
+			{
+				for (unsigned x = 0; x < size; x++)
+				{
+					const vector3 corners[] = { vector3(x, 0, y), vector3(x + 1, 0, y), vector3(x, 0, y + 1), vector3(x + 1, 0, y + 1) };
+
+					for (int corner : { 0, 2, 1, 1, 2, 3 })
+					{
+						mesh.indices.push_back(static_cast<unsigned>(mesh.positions.size()));
+						mesh.positions.push_back(corners[corner]);
+						mesh.normals.emplace_back(0, 1, 0);
+					}
+				}
+			}
+
+			uint32_t seed = 1;
+
+			for (size_t t = mesh.indices.size() / 3 - 1; t > 0; t--)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				std::swap_ranges(&mesh.indices[t * 3], &mesh.indices[t * 3 + 3], &mesh.indices[(seed % (t + 1)) * 3]);
+			}
+		}
+
+		typedef std::array<std::tuple<float, float, float>, 3> triangle_key;
+
+		/**
+		 * \brief Triangles by their corner positions, each rotated to start at its smallest corner so that winding is kept.
+		 */
+		std::vector<triangle_key> get_triangles(const std::vector<vector3>& positions, const std::vector<unsigned>& indices)
+		{
+			std::vector<triangle_key> triangles;
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				triangle_key key;
+
+				for (int c = 0; c < 3; c++)
+				{
+					const vector3& p = positions[indices[i + c]];
+					key[c] = std::make_tuple(p.x, p.y, p.z);
+				}
+
+				std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+				triangles.push_back(key);
+			}
+
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		}
+	}
+
+	bool check_mesh_optimizer()
+	{
+		// A lone triangle misses on every corner, and a second sharing an edge only on its new one
+		BENCH_CHECK(analyze_vertex_cache({ 0, 1, 2 }, 3).transforms == 3);
+		BENCH_CHECK(analyze_vertex_cache({ 0, 1, 2, 2, 1, 3 }, 4).acmr() == 2.0f);
+
+		const unsigned grid = 32;
+		obj_mesh mesh;
+		make_shuffled_grid(grid, mesh);
+
+		const std::vector<triangle_key> triangles = get_triangles(mesh.positions, mesh.indices);
+
+		std::vector<vector3> colors;
+		std::vector<vector4> tangents;
+		mesh_streams streams = { mesh.positions, mesh.normals, colors, mesh.uvs, tangents, mesh.indices };
+
+		const mesh_opt_report report = optimize_mesh(streams);
+
+		// Corners shared by neighbouring quads are merged, and every triangle is kept with its winding
+		BENCH_CHECK(report.vertices_before == grid * grid * 6);
+		BENCH_CHECK(report.vertices_after == (grid + 1) * (grid + 1));
+		BENCH_CHECK(mesh.positions.size() == report.vertices_after && mesh.normals.size() == report.vertices_after);
+		BENCH_CHECK(get_triangles(mesh.positions, mesh.indices) == triangles);
+
+		// The cache is used far better than by the shuffled order, where every corner was its own vertex
+		BENCH_CHECK(report.before.acmr() == 3.0f);
+		BENCH_CHECK(report.after.acmr() < 1.0f);
+
+		// Vertices are numbered in order of first use
+		unsigned next = 0;
+
+		for (unsigned index : mesh.indices)
+		{
+			BENCH_CHECK(index <= next);
+
+			if (index == next)
+				next++;
+		}
+
+		BENCH_CHECK(next == mesh.positions.size());
+
+		// Index buffers that are not triangle lists are left alone
+		std::vector<vector3> positions = { vector3(0, 0, 0), vector3(0, 0, 0), vector3(1, 0, 0), vector3(0, 1, 0) };
+		std::vector<vector3> normals;
+		std::vector<vector2> uvs;
+		std::vector<unsigned> indices = { 0, 2, 3, 1 };
+		mesh_streams partial = { positions, normals, colors, uvs, tangents, indices };
+
+		optimize_mesh(partial);
+		BENCH_CHECK(positions.size() == 4 && indices == std::vector<unsigned>({ 0, 2, 3, 1 }));
+
+		// Bitwise duplicates are merged
+		indices = { 0, 2, 3, 1, 3, 2 };
+		BENCH_CHECK(deduplicate_vertices(partial) == 1);
+		BENCH_CHECK(positions.size() == 3 && indices[3] == indices[0]);
+
+		return true;
+	}
+
+	bool bench_mesh_optimizer()
+	{
+		// Times the mesh optimiser on the OBJ assets, and on a large grid with shuffled, unshared corners
+		auto run = [](const char* name, obj_mesh& mesh)
+		{
+			std::vector<vector3> colors;
+			std::vector<vector4> tangents;
+			mesh_streams streams = { mesh.positions, mesh.normals, colors, mesh.uvs, tangents, mesh.indices };
+
+			const size_t triangles = mesh.indices.size() / 3;
+
+			mesh_opt_report report;
+			const float ms = time_ms([&]() { report = optimize_mesh(streams); });
+
+			printf("Mesh optimiser: %s -- %zu triangles in %.2f ms (%.2f Mtri/s), %zu -> %zu vertices, "
+					"ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+					name, triangles, ms, triangles / (ms * 1000.0f), report.vertices_before, report.vertices_after,
+					report.before.acmr(), report.after.acmr(), report.before.atvr(), report.after.atvr());
+		};
+
+		for (const auto& entry : fs::directory_iterator("../res/meshes"))
+		{
+			if (entry.path().extension() != ".obj")
+				continue;
+
+			core::mapped_file file(entry.path());
+			obj_mesh mesh;
+
+			if (file.is_open() && parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh))
+				run(entry.path().filename().c_str(), mesh);
+		}
+
+		obj_mesh mesh;
+		make_shuffled_grid(700, mesh);
+		run("shuffled grid", mesh);
+
+		return true;
+	}
+}
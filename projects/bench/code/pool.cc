@@ -0,0 +1,101 @@
+#include "bench.h"
+#include "mesh_pool.h"
+
+#include <vector>
+
+namespace efiilj
+{
+	bool check_range_allocator()
+	{
+		range_allocator alloc(100);
+		size_t a, b, c, d;
+
+		BENCH_CHECK(alloc.allocate(30, a) && a == 0);
+		BENCH_CHECK(alloc.allocate(30, b) && b == 30);
+		BENCH_CHECK(alloc.allocate(30, c) && c == 60);
+		BENCH_CHECK(alloc.get_used() == 90 && alloc.get_fragments() == 1);
+
+		// Out of space until something is freed or the range grows
+		BENCH_CHECK(!alloc.allocate(20, d));
+
+		// First fit lands in the hole left by b, before the tail
+		alloc.free(b, 30);
+		BENCH_CHECK(alloc.get_fragments() == 2);
+		BENCH_CHECK(alloc.allocate(10, d) && d == 30);
+		alloc.free(d, 10);
+
+		// Freeing a joins b and the hole into one range, and freeing c joins that to the tail
+		alloc.free(a, 30);
+		BENCH_CHECK(alloc.get_fragments() == 2);
+		alloc.free(c, 30);
+		BENCH_CHECK(alloc.get_fragments() == 1 && alloc.get_used() == 0);
+		BENCH_CHECK(alloc.allocate(100, d) && d == 0);
+
+		// Growing a full allocator appends the new tail as free space
+		alloc.grow(150);
+		BENCH_CHECK(alloc.get_capacity() == 150 && alloc.get_fragments() == 1);
+		BENCH_CHECK(alloc.allocate(50, d) && d == 100);
+		BENCH_CHECK(!alloc.allocate(1, d));
+
+		// Growing with a free tail extends it instead of adding a fragment
+		alloc.free(120, 30);
+		alloc.grow(200);
+		BENCH_CHECK(alloc.get_fragments() == 1);
+		BENCH_CHECK(alloc.allocate(80, d) && d == 120);
+
+		alloc.clear();
+		BENCH_CHECK(alloc.get_used() == 0 && alloc.get_fragments() == 1);
+		BENCH_CHECK(alloc.allocate(200, d) && d == 0);
+
+		return true;
+	}
+
+	bool check_indirect_commands()
+	{
+		pool_entry cube;
+		cube.first_vertex = 100;
+		cube.vertex_count = 24;
+		cube.first_index = 300;
+		cube.index_count = 36;
+
+		pool_entry sphere;
+		sphere.first_vertex = 124;
+		sphere.vertex_count = 500;
+		sphere.first_index = 336;
+		sphere.index_count = 2880;
+
+		pool_entry empty;
+
+		const pool_draw draws[] =
+		{
+			{ cube, 0, true },
+			{ cube, 1, true },
+			{ cube, 2, false },		// Hidden, dropped
+			{ cube, 3, true },		// Slot no longer follows the last command, so a new one starts
+			{ cube, 4, true },
+			{ sphere, 5, true },
+			{ empty, 6, true },		// Nothing to draw, dropped
+			{ sphere, 7, true },
+		};
+
+		std::vector<DrawElementsIndirectCommand> commands;
+		const size_t visible = build_indirect_commands(draws, sizeof(draws) / sizeof(draws[0]), commands);
+
+		BENCH_CHECK(visible == 6);
+		BENCH_CHECK(commands.size() == 4);
+
+		BENCH_CHECK(commands[0].count == 36 && commands[0].first_index == 300 && commands[0].base_vertex == 100);
+		BENCH_CHECK(commands[0].instance_count == 2 && commands[0].base_instance == 0);
+		BENCH_CHECK(commands[1].instance_count == 2 && commands[1].base_instance == 3);
+		BENCH_CHECK(commands[2].count == 2880 && commands[2].base_vertex == 124);
+		BENCH_CHECK(commands[2].instance_count == 1 && commands[2].base_instance == 5);
+		BENCH_CHECK(commands[3].instance_count == 1 && commands[3].base_instance == 7);
+
+		// Commands from an earlier call are never extended
+		const pool_draw next[] = { { sphere, 8, true } };
+		BENCH_CHECK(build_indirect_commands(next, 1, commands) == 1);
+		BENCH_CHECK(commands.size() == 5 && commands[3].instance_count == 1);
+
+		return true;
+	}
+}
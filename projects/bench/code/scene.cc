@@ -0,0 +1,28 @@
+#include "scene.h"
+
+namespace efiilj
+{
+	bench_scene::bench_scene()
+		: managers(std::make_shared<manager_host>()),
+		entities(std::make_shared<entity_manager>()),
+		transforms(std::make_shared<transform_manager>()),
+		metadata(std::make_shared<meta_manager>()),
+		shaders(std::make_shared<shader_server>()),
+		textures(std::make_shared<texture_server>()),
+		meshes(std::make_shared<mesh_server>()),
+		materials(std::make_shared<material_server>()),
+		mesh_instances(std::make_shared<mesh_manager>()),
+		colliders(std::make_shared<collider_manager>())
+	{
+		// Managers look up the ones they depend on when registered, so those go first
+		managers->register_manager(entities, 'ENTS');
+		managers->register_manager(transforms, 'TRFM');
+		managers->register_manager(metadata, 'META');
+		managers->register_manager(shaders, 'SHDR');
+		managers->register_manager(textures, 'TXSR');
+		managers->register_manager(meshes, 'MESR');
+		managers->register_manager(materials, 'MASR');
+		managers->register_manager(mesh_instances, 'MEMR');
+		managers->register_manager(colliders, 'RAYS');
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mgr_host.h"
+#include "entity.h"
+#include "meta_mgr.h"
+#include "trfm_mgr.h"
+#include "shdr_mgr.h"
+#include "tex_srv.h"
+#include "mesh_srv.h"
+#include "mtrl_srv.h"
+#include "mesh_mgr.h"
+#include "phys_data.h"
+
+#include <memory>
+
+namespace efiilj
+{
+	/**
+	 * \brief Managers of a scene without a window. They are registered as the application registers them,
+	 * but never set up, so nothing touches GL as long as meshes and textures are not built.
+	 */
+	struct bench_scene
+	{
+		std::shared_ptr<manager_host> managers;
+		std::shared_ptr<entity_manager> entities;
+		std::shared_ptr<transform_manager> transforms;
+		std::shared_ptr<meta_manager> metadata;
+		std::shared_ptr<shader_server> shaders;
+		std::shared_ptr<texture_server> textures;
+		std::shared_ptr<mesh_server> meshes;
+		std::shared_ptr<material_server> materials;
+		std::shared_ptr<mesh_manager> mesh_instances;
+		std::shared_ptr<collider_manager> colliders;
+
+		bench_scene();
+	};
+}
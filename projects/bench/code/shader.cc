@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "sdr_preproc.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	bool check_shader_preprocessor()
+	{
+		// In-memory files, so that the expansion is checked without touching the disk
+		std::map<fs::path, std::string> files =
+		{
+			{ "sdr/root.sdr", "Begin(VERTEX_SHADER)\n#version 430\nInclude(common.glsl)\nvoid main() {}\nEnd()\n"
+				"Begin(FRAGMENT_SHADER)\n#version 430\nInclude(common.glsl)\nInclude(lib/light.glsl)\nEnd()\n" },
+			{ "sdr/common.glsl", "float common;\n" },
+			{ "sdr/lib/light.glsl", "Include(common.glsl)\nfloat light;\n" },
+			{ "sdr/cycle.sdr", "Begin(VERTEX_SHADER)\nInclude(cycle_a.glsl)\nEnd()\n" },
+			{ "sdr/cycle_a.glsl", "Include(cycle_b.glsl)\n" },
+			{ "sdr/cycle_b.glsl", "Include(cycle_a.glsl)\n" },
+			{ "sdr/missing.sdr", "Begin(VERTEX_SHADER)\nInclude(nowhere.glsl)\nEnd()\n" },
+			{ "sdr/nested.sdr", "Begin(VERTEX_SHADER)\nBegin(FRAGMENT_SHADER)\nEnd()\n" },
+			{ "sdr/unclosed.sdr", "Begin(VERTEX_SHADER)\nvoid main() {}\n" },
+		};
+
+		const shader_preprocessor::file_reader reader = [&files](const fs::path& path, std::string& out)
+		{
+			auto it = files.find(path);
+
+			if (it == files.end())
+				return false;
+
+			out = it->second;
+			return true;
+		};
+
+		shader_source source;
+
+		BENCH_CHECK(shader_preprocessor::process("sdr/root.sdr", source, reader));
+		BENCH_CHECK(source.stages.size() == 2);
+		BENCH_CHECK(source.stages[0].type == "VERTEX_SHADER" && source.stages[1].type == "FRAGMENT_SHADER");
+		BENCH_CHECK(source.stages[0].source == "\n#version 430\nfloat common;\n\nvoid main() {}\n");
+
+		// Includes resolve against the root directory, also from within an included file
+		BENCH_CHECK(source.stages[1].source == "\n#version 430\nfloat common;\n\nfloat common;\n\nfloat light;\n\n");
+
+		// Every file is a dependency once, the root first
+		BENCH_CHECK(source.dependencies.size() == 3);
+		BENCH_CHECK(source.dependencies[0].path == "sdr/root.sdr");
+		BENCH_CHECK(source.dependencies[1].path == "sdr/common.glsl");
+		BENCH_CHECK(source.dependencies[2].path == "sdr/lib/light.glsl");
+
+		const uint64_t hash = source.hash;
+
+		shader_preprocessor::add_defines(source, { "USE_SHADOWS", "MAX_LIGHTS 4" });
+		BENCH_CHECK(source.stages[0].source == "\n#version 430\n#define USE_SHADOWS\n#define MAX_LIGHTS 4\nfloat common;\n\nvoid main() {}\n");
+		BENCH_CHECK(source.hash != hash);
+
+		BENCH_CHECK(!shader_preprocessor::process("sdr/cycle.sdr", source, reader));
+		BENCH_CHECK(!shader_preprocessor::process("sdr/missing.sdr", source, reader));
+		BENCH_CHECK(!shader_preprocessor::process("sdr/nested.sdr", source, reader));
+		BENCH_CHECK(!shader_preprocessor::process("sdr/unclosed.sdr", source, reader));
+
+		// The cache is used while every dependency is unchanged, and dropped when one changes
+		const fs::path dir = fs::temp_directory_path() / "bench_shaders";
+		const fs::path root = dir / "root.sdr";
+
+		fs::create_directories(dir);
+		std::ofstream(root, std::ios::trunc) << "Begin(VERTEX_SHADER)\nInclude(common.glsl)\nEnd()\n";
+		std::ofstream(dir / "common.glsl", std::ios::trunc) << "float a;\n";
+		fs::remove(shader_preprocessor::get_cache_path(root));
+
+		shader_source cold, warm;
+
+		BENCH_CHECK(shader_preprocessor::load(root, cold));
+		BENCH_CHECK(fs::exists(shader_preprocessor::get_cache_path(root)));
+		BENCH_CHECK(shader_preprocessor::read_cache(root, warm));
+		BENCH_CHECK(warm.hash == cold.hash && warm.stages.size() == 1 && warm.stages[0].source == cold.stages[0].source);
+		BENCH_CHECK(warm.dependencies.size() == 2);
+
+		std::ofstream(dir / "common.glsl", std::ios::trunc) << "float b;\n";
+
+		BENCH_CHECK(!shader_preprocessor::read_cache(root, warm));
+		BENCH_CHECK(shader_preprocessor::load(root, warm));
+		BENCH_CHECK(warm.stages[0].source == "\nfloat b;\n\n");
+
+		// Files older than the cache, with the size and time it recorded, are trusted without rehashing
+		const fs::path common = dir / "common.glsl";
+		const auto old_time = fs::last_write_time(common) - std::chrono::hours(1);
+
+		fs::last_write_time(root, old_time);
+		fs::last_write_time(common, old_time);
+		fs::remove(shader_preprocessor::get_cache_path(root));
+
+		BENCH_CHECK(shader_preprocessor::load(root, cold));
+
+		std::ofstream(common, std::ios::trunc) << "float c;\n";
+		fs::last_write_time(common, old_time);
+
+		BENCH_CHECK(shader_preprocessor::read_cache(root, warm) && warm.stages[0].source == "\nfloat b;\n\n");
+
+		// Once its time moves, the file is hashed again and the change is found
+		fs::last_write_time(common, fs::file_time_type::clock::now());
+		BENCH_CHECK(!shader_preprocessor::read_cache(root, warm));
+		BENCH_CHECK(shader_preprocessor::load(root, warm) && warm.stages[0].source == "\nfloat c;\n\n");
+
+		// Counts larger than the rest of the file are rejected before anything is allocated for them
+		auto patch_count = [&root](size_t offset)
+		{
+			const fs::path cache = shader_preprocessor::get_cache_path(root);
+			std::string bytes;
+
+			if (!shader_preprocessor::read_file(cache, bytes) || bytes.size() < offset + 4)
+				return false;
+
+			bytes.replace(offset, 4, "\xff\xff\xff\x7f", 4);
+			std::ofstream(cache, std::ios::binary | std::ios::trunc) << bytes;
+			return true;
+		};
+
+		// Dependency count follows the magic, version and hash, and the stage count follows it
+		BENCH_CHECK(patch_count(16) && !shader_preprocessor::read_cache(root, warm));
+		BENCH_CHECK(shader_preprocessor::load(root, warm) && patch_count(20) && !shader_preprocessor::read_cache(root, warm));
+
+		fs::remove_all(dir);
+		return true;
+	}
+
+	bool bench_shader_preprocessor()
+	{
+		// Times the shader preprocessor against a warm preprocessed-source cache
+		const int iterations = 100;
+
+		for (const auto& entry : fs::directory_iterator("../res/shaders"))
+		{
+			if (entry.path().extension() != ".sdr")
+				continue;
+
+			shader_source source;
+			bool valid = true;
+
+			const float process = time_ms([&]()
+			{
+				for (int i = 0; i < iterations; i++)
+					valid &= shader_preprocessor::process(entry.path(), source);
+			});
+
+			const float cached = time_ms([&]()
+			{
+				for (int i = 0; i < iterations; i++)
+					valid &= shader_preprocessor::load(entry.path(), source);
+			});
+
+			if (!valid)
+			{
+				printf("Shader preprocessor: %s -- failed to load\n", entry.path().filename().c_str());
+				return false;
+			}
+
+			printf("Shader preprocessor: %s -- %.3f ms, cached %.3f ms (%zu files, %zu stages)\n",
+					entry.path().filename().c_str(), process / iterations, cached / iterations,
+					source.dependencies.size(), source.stages.size());
+		}
+
+		return true;
+	}
+}
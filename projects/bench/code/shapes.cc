@@ -0,0 +1,44 @@
+#include "bench.h"
+
+#include <cmath>
+
+namespace efiilj
+{
+	void make_sphere(unsigned rings, unsigned segments, std::vector<vector3>& positions, std::vector<unsigned>& indices)
+	{
+		const float pi = 3.14159265f;
+
+		positions.emplace_back(0, 1, 0);
+
+		for (unsigned r = 1; r < rings; r++)
+		{
+			const float theta = pi * r / rings;
+
+			for (unsigned s = 0; s < segments; s++)
+			{
+				const float phi = 2.0f * pi * s / segments;
+				positions.emplace_back(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			}
+		}
+
+		positions.emplace_back(0, -1, 0);
+
+		const unsigned bottom = static_cast<unsigned>(positions.size()) - 1;
+		auto ring = [segments](unsigned r, unsigned s) { return 1 + (r - 1) * segments + s % segments; };
+
+		for (unsigned s = 0; s < segments; s++)
+		{
+			indices.insert(indices.end(), { 0, ring(1, s + 1), ring(1, s) });
+			indices.insert(indices.end(), { bottom, ring(rings - 1, s), ring(rings - 1, s + 1) });
+		}
+
+		for (unsigned r = 1; r + 1 < rings; r++)
+		{
+			for (unsigned s = 0; s < segments; s++)
+			{
+				indices.insert(indices.end(), { ring(r, s), ring(r, s + 1), ring(r + 1, s) });
+				indices.insert(indices.end(), { ring(r, s + 1), ring(r + 1, s + 1), ring(r + 1, s) });
+			}
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#include "bench.h"
+#include "scene.h"
+#include "loader.h"
+#include "mesh_cache.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace efiilj
+{
+	bool check_shared_assets()
+	{
+		use_fake_gl();
+
+		bench_scene scene;
+		mesh_server& meshes = *scene.meshes;
+
+		const fs::path path = fs::temp_directory_path() / "bench_shared.obj";
+
+		{
+			std::ofstream obj(path);
+			obj << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n";
+		}
+
+		// The second load finds the first by content, and each caller holds its own reference
+		object_loader first(path, scene.meshes);
+		object_loader second(path, scene.meshes);
+
+		const mesh_id mesh = first.get_mesh();
+
+		BENCH_CHECK(first.is_valid() && second.is_valid());
+		BENCH_CHECK(second.get_mesh() == mesh && meshes.get_count() == 1);
+		BENCH_CHECK(meshes.get_ref_count(mesh) == 2 && meshes.get_shared_hits() == 1);
+
+		// The mesh outlives the first release, and its slot is freed with the last
+		BENCH_CHECK(!meshes.remove_ref(mesh) && meshes.is_valid(mesh));
+		BENCH_CHECK(meshes.remove_ref(mesh) && !meshes.is_valid(mesh));
+		BENCH_CHECK(meshes.get_count() == 0 && meshes.get_shared_count() == 0);
+
+		// Nothing is left to share, so loading again builds a new mesh in the freed slot
+		object_loader third(path, scene.meshes);
+
+		BENCH_CHECK(third.is_valid() && third.get_mesh() != mesh);
+		BENCH_CHECK(handle_index(third.get_mesh()) == handle_index(mesh) && meshes.get_recycled() == 1);
+		BENCH_CHECK(meshes.remove_ref(third.get_mesh()) && meshes.get_count() == 0);
+
+		fs::remove(path);
+		fs::remove(mesh_cache::get_cache_path(path));
+
+		return true;
+	}
+}
@@ -0,0 +1,362 @@
+#include "bench.h"
+#include "tex_cook.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace efiilj
+{
+	namespace
+	{
+		// Decoders written from the format specification rather than from the encoder,
+		// so that a palette the encoder gets wrong shows up as error instead of grading itself
+
+		void decode_565(uint16_t packed, int* color)
+		{
+			const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+			color[3] = 255;
+		}
+
+		/**
+		 * \brief BC1 colour block into RGBA texels. BC3 colour always uses the four colour palette.
+		 */
+		void decode_bc1(const unsigned char* in, unsigned char (*texels)[4], bool four_color)
+		{
+			const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+			const uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+
+			int palette[4][4];
+			decode_565(c0, palette[0]);
+			decode_565(c1, palette[1]);
+
+			for (int c = 0; c < 3; c++)
+			{
+				if (four_color || c0 > c1)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+				}
+				else
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+					palette[3][c] = 0;
+				}
+			}
+
+			palette[2][3] = 255;
+			palette[3][3] = (four_color || c0 > c1) ? 255 : 0;
+
+			const uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+
+			for (int t = 0; t < 16; t++)
+			{
+				for (int c = 0; c < 4; c++)
+					texels[t][c] = static_cast<unsigned char>(palette[(bits >> (t * 2)) & 3][c]);
+			}
+		}
+
+		/**
+		 * \brief BC4 block into one channel of RGBA texels.
+		 */
+		void decode_bc4(const unsigned char* in, unsigned char (*texels)[4], int channel)
+		{
+			const int a0 = in[0], a1 = in[1];
+			int palette[8] = { a0, a1 };
+
+			if (a0 > a1)
+			{
+				for (int i = 1; i < 7; i++)
+					palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+			}
+			else
+			{
+				for (int i = 1; i < 5; i++)
+					palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t bits = 0;
+
+			for (int i = 0; i < 6; i++)
+				bits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+
+			for (int t = 0; t < 16; t++)
+				texels[t][channel] = static_cast<unsigned char>(palette[(bits >> (t * 3)) & 7]);
+		}
+
+		unsigned read_bits(const unsigned char* in, int& pos, int count)
+		{
+			unsigned value = 0;
+
+			for (int i = 0; i < count; i++, pos++)
+				value |= ((in[pos >> 3] >> (pos & 7)) & 1u) << i;
+
+			return value;
+		}
+
+		/**
+		 * \brief BC7 block into RGBA texels. Only mode 6 is decoded, as it is the only one the cooker writes.
+		 * \return False for any other mode
+		 */
+		bool decode_bc7(const unsigned char* in, unsigned char (*texels)[4])
+		{
+			static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			int pos = 0;
+
+			if (read_bits(in, pos, 7) != 1u << 6)
+				return false;
+
+			int endpoints[2][4];
+
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints[0][c] = static_cast<int>(read_bits(in, pos, 7));
+				endpoints[1][c] = static_cast<int>(read_bits(in, pos, 7));
+			}
+
+			const int p0 = static_cast<int>(read_bits(in, pos, 1));
+			const int p1 = static_cast<int>(read_bits(in, pos, 1));
+
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints[0][c] = (endpoints[0][c] << 1) | p0;
+				endpoints[1][c] = (endpoints[1][c] << 1) | p1;
+			}
+
+			for (int t = 0; t < 16; t++)
+			{
+				const int w = weights[read_bits(in, pos, t == 0 ? 3 : 4)];
+
+				for (int c = 0; c < 4; c++)
+					texels[t][c] = static_cast<unsigned char>(((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6);
+			}
+
+			return true;
+		}
+
+		/**
+		 * \brief Decodes a level into RGBA8, leaving channels the codec does not store at 0.
+		 */
+		bool decode_level(const std::vector<unsigned char>& data, unsigned width, unsigned height,
+				texture_codec codec, std::vector<unsigned char>& rgba)
+		{
+			const unsigned blocks_x = (width + 3) / 4;
+			const unsigned blocks_y = (height + 3) / 4;
+			const size_t block_size = get_codec_level_size(codec, 4, 4);
+
+			if (data.size() != get_codec_level_size(codec, width, height))
+				return false;
+
+			rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+
+			for (unsigned by = 0; by < blocks_y; by++)
+			{
+				for (unsigned bx = 0; bx < blocks_x; bx++)
+				{
+					const unsigned char* in = &data[(by * blocks_x + bx) * block_size];
+					unsigned char texels[16][4] = {};
+
+					switch (codec)
+					{
+						case texture_codec::bc1:
+							decode_bc1(in, texels, false);
+							break;
+						case texture_codec::bc3:
+							decode_bc1(in + 8, texels, true);
+							decode_bc4(in, texels, 3);
+							break;
+						case texture_codec::bc4:
+							decode_bc4(in, texels, 0);
+							break;
+						case texture_codec::bc5:
+							decode_bc4(in, texels, 0);
+							decode_bc4(in + 8, texels, 1);
+							break;
+						case texture_codec::bc7:
+							if (!decode_bc7(in, texels))
+								return false;
+							break;
+						default:
+							return false;
+					}
+
+					for (unsigned t = 0; t < 16; t++)
+					{
+						const unsigned x = bx * 4 + t % 4, y = by * 4 + t / 4;
+
+						if (x < width && y < height)
+							std::copy(texels[t], texels[t] + 4, &rgba[(static_cast<size_t>(y) * width + x) * 4]);
+					}
+				}
+			}
+
+			return true;
+		}
+
+		/**
+		 * \brief PSNR in dB over the channels a codec stores.
+		 */
+		double get_psnr(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, texture_codec codec)
+		{
+			const int channels = get_codec_channels(codec);
+			double sq_error = 0.0;
+
+			for (size_t i = 0; i < a.size(); i += 4)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					const double d = static_cast<double>(a[i + c]) - b[i + c];
+					sq_error += d * d;
+				}
+			}
+
+			const double mse = sq_error / (a.size() / 4 * channels);
+			return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+		}
+
+		/**
+		 * \brief Smooth colour and alpha gradients with fixed noise, flat patches and hard edges,
+		 * so that every block shape the encoders handle is in the image.
+		 */
+		std::vector<unsigned char> make_image(unsigned width, unsigned height)
+		{
+			std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+			uint32_t seed = 12345;
+
+			for (unsigned y = 0; y < height; y++)
+			{
+				for (unsigned x = 0; x < width; x++)
+				{
+					unsigned char* texel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+
+					seed = seed * 1664525u + 1013904223u;
+					const int noise = static_cast<int>((seed >> 24) & 7) - 4;
+
+					const float u = static_cast<float>(x) / width, v = static_cast<float>(y) / height;
+					const bool flat = (x / 16 + y / 16) % 5 == 0;
+					const bool edge = (x / 8) % 7 == 3;
+
+					int color[4] =
+					{
+						static_cast<int>(255.0f * u),
+						static_cast<int>(127.5f + 127.5f * std::sin(v * 6.0f)),
+						static_cast<int>(255.0f * (1.0f - u * v)),
+						static_cast<int>(255.0f * v)
+					};
+
+					for (int c = 0; c < 4; c++)
+					{
+						if (flat)
+							color[c] = 96;
+						else if (edge)
+							color[c] = 255 - color[c];
+
+						texel[c] = static_cast<unsigned char>(std::clamp(color[c] + noise, 0, 255));
+					}
+				}
+			}
+
+			return rgba;
+		}
+	}
+
+	bool check_texture_cooker()
+	{
+		struct codec_case
+		{
+			texture_codec codec;
+			double min_psnr;
+		};
+
+		// Floors a little under what the encoders reach on the image, to catch quality regressions
+		const codec_case cases[] =
+		{
+			{ texture_codec::bc1, 36.0 },
+			{ texture_codec::bc3, 37.0 },
+			{ texture_codec::bc4, 50.0 },
+			{ texture_codec::bc5, 45.0 },
+			{ texture_codec::bc7, 38.0 }
+		};
+
+		// Not a multiple of the block size, so the edge blocks are partial
+		const unsigned width = 70, height = 38;
+		const std::vector<unsigned char> image = make_image(width, height);
+
+		for (const codec_case& c : cases)
+		{
+			std::vector<unsigned char> encoded, decoded;
+			encode_level(image.data(), width, height, c.codec, encoded);
+
+			BENCH_CHECK(decode_level(encoded, width, height, c.codec, decoded));
+
+			BENCH_CHECK(get_psnr(image, decoded, c.codec) >= c.min_psnr);
+		}
+
+		// Every level of a cooked chain decodes at its own size, near the mip it was encoded from
+		std::vector<std::vector<unsigned char>> mips = { image };
+		cook_mips(mips, width, height, texture_content::color);
+
+		std::vector<unsigned char> pixels = image;
+		cooked_texture cooked;
+		cook_texture(std::move(pixels), width, height, texture_codec::bc7, texture_content::color, cooked);
+
+		BENCH_CHECK(cooked.levels.size() == 7 && mips.size() == cooked.levels.size());
+
+		for (size_t level = 0; level < cooked.levels.size(); level++)
+		{
+			std::vector<unsigned char> decoded;
+			const unsigned w = std::max(1u, width >> level), h = std::max(1u, height >> level);
+
+			BENCH_CHECK(decode_level(cooked.levels[level], w, h, texture_codec::bc7, decoded));
+
+			// Small levels squeeze the whole image into a few blocks, which one subset fits loosely, so this only catches garbage
+			BENCH_CHECK(get_psnr(mips[level], decoded, texture_codec::bc7) >= 18.0);
+		}
+
+		return true;
+	}
+
+	bool bench_texture_cooker()
+	{
+		// Encodes a 2048 square level in every codec, and cooks a full chain, reporting megapixels per second
+		const unsigned size = 2048;
+		const std::vector<unsigned char> image = make_image(size, size);
+		const double megapixels = size * size / 1e6;
+
+		const texture_codec codecs[] =
+			{ texture_codec::bc1, texture_codec::bc3, texture_codec::bc4, texture_codec::bc5, texture_codec::bc7 };
+
+		for (texture_codec codec : codecs)
+		{
+			std::vector<unsigned char> encoded, decoded;
+			const float ms = time_ms([&]() { encode_level(image.data(), size, size, codec, encoded); });
+
+			decode_level(encoded, size, size, codec, decoded);
+
+			printf("Texture cooker: %s %ux%u in %.1f ms (%.1f MP/s), %.2f dB\n",
+					get_codec_name(codec), size, size, ms, megapixels * 1000.0 / ms, get_psnr(image, decoded, codec));
+		}
+
+		std::vector<unsigned char> pixels = image;
+		cooked_texture cooked;
+
+		const float ms = time_ms([&]()
+		{
+			cook_texture(std::move(pixels), size, size, texture_codec::bc7, texture_content::color, cooked);
+		});
+
+		printf("Texture cooker: BC7 chain of %zu levels in %.1f ms (%.1f MP/s)\n",
+				cooked.levels.size(), ms, cooked.texels / 1e6 * 1000.0 / ms);
+
+		return true;
+	}
+}
@@ -0,0 +1,137 @@
+#include "bench.h"
+#include "light_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace efiilj
+{
+	namespace
+	{
+		const float pi = 3.14159265f;
+		const float near = 1.0f, far = 100.0f;
+		const unsigned size = 100;
+
+		/**
+		 * \brief Camera at the origin looking down -z through a 90 degree square frustum, on a square viewport.
+		 */
+		bool get_rect(const light_sphere& sphere, light_rect& rect)
+		{
+			return get_light_rect(sphere, matrix4(), matrix4::get_perspective(pi * 0.5f, 1.0f, near, far), size, size, rect);
+		}
+
+		/**
+		 * \brief Window depth of a point on the view axis, straight through the projection.
+		 */
+		float get_window_depth(float depth)
+		{
+			const vector4 clip = matrix4::get_perspective(pi * 0.5f, 1.0f, near, far) * vector4(0.0f, 0.0f, -depth, 1.0f);
+			return clip.z / clip.w * 0.5f + 0.5f;
+		}
+
+		bool near_equal(float a, float b)
+		{
+			return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+		}
+
+		/**
+		 * \brief Checks the bounds of a cone enclose its apex and points around its base rim.
+		 */
+		bool encloses_cone(const light_sphere& bounds, const vector3& position, const vector3& direction, float range, float cos_outer)
+		{
+			const float slack = 1e-4f * range;
+			const float rim = range * std::sqrt(1.0f - cos_outer * cos_outer) / cos_outer;
+
+			const vector3 right = vector3::cross(vector3(0, 1, 0), direction).norm();
+			const vector3 up = vector3::cross(direction, right);
+
+			if ((position - bounds.position).length() > bounds.radius + slack)
+				return false;
+
+			for (int i = 0; i < 16; i++)
+			{
+				const float angle = 2.0f * pi * i / 16;
+				const vector3 point = position + direction * range + right * (rim * std::cos(angle)) + up * (rim * std::sin(angle));
+
+				if ((point - bounds.position).length() > bounds.radius + slack)
+					return false;
+			}
+
+			return true;
+		}
+	}
+
+	bool check_light_volumes()
+	{
+		light_rect rect;
+
+		// A sphere of radius 1 at depth 10 projects to a disc of NDC radius 1 / sqrt(99), so pixels 44.97 to 55.03
+		BENCH_CHECK(get_rect({ vector3(0.0f, 0.0f, -10.0f), 1.0f }, rect));
+		BENCH_CHECK(rect.x <= 44 && rect.x + rect.width >= 56 && rect.width <= 14);
+		BENCH_CHECK(rect.y <= 44 && rect.y + rect.height >= 56 && rect.height <= 14);
+		BENCH_CHECK(rect.x + rect.width / 2 == 50 && rect.y + rect.height / 2 == 50);
+
+		// Depth bounds hold the near and far surfaces, inside the depth range
+		BENCH_CHECK(rect.min_depth <= get_window_depth(9.0f) && rect.max_depth >= get_window_depth(11.0f));
+		BENCH_CHECK(rect.min_depth > 0.0f && rect.max_depth < 1.0f);
+
+		// A sphere over the right edge is clamped to it, and keeps its vertical extent
+		BENCH_CHECK(get_rect({ vector3(9.0f, 0.0f, -10.0f), 2.0f }, rect));
+		BENCH_CHECK(rect.x + rect.width == 100 && rect.x > 75 && rect.x < 85);
+		BENCH_CHECK(rect.y > 30 && rect.y + rect.height < 70);
+
+		// Off to the side, behind the camera, or short of the near plane, it is culled
+		BENCH_CHECK(!get_rect({ vector3(30.0f, 0.0f, -10.0f), 1.0f }, rect));
+		BENCH_CHECK(!get_rect({ vector3(0.0f, 0.0f, 10.0f), 1.0f }, rect));
+		BENCH_CHECK(!get_rect({ vector3(0.0f, 0.0f, -0.5f), 0.25f }, rect));
+
+		// A sphere around the camera covers the whole screen and depth range
+		BENCH_CHECK(get_rect({ vector3(0.0f, 0.0f, 0.0f), 5.0f }, rect));
+		BENCH_CHECK(rect.x == 0 && rect.y == 0 && rect.width == 100 && rect.height == 100);
+		BENCH_CHECK(rect.min_depth == 0.0f && rect.max_depth == 1.0f);
+
+		const vector3 position(1.0f, 2.0f, 3.0f), direction(0.0f, 0.0f, -1.0f);
+		const float range = 10.0f;
+
+		// 20 degrees is narrow, so the apex and rim lie on a sphere of radius range / (2 cos^2)
+		const float cos_narrow = std::cos(20.0f * pi / 180.0f);
+		const light_sphere narrow = get_cone_bounds(position, direction, range, cos_narrow);
+
+		BENCH_CHECK(near_equal(narrow.radius, range / (2.0f * cos_narrow * cos_narrow)));
+		BENCH_CHECK(near_equal((narrow.position - position).length(), narrow.radius));
+		BENCH_CHECK(encloses_cone(narrow, position, direction, range, cos_narrow));
+
+		// 60 degrees is wide, so the base disc bounds it, radius range * tan
+		const float cos_wide = 0.5f;
+		const light_sphere wide = get_cone_bounds(position, direction, range, cos_wide);
+
+		BENCH_CHECK(near_equal(wide.radius, range * std::sqrt(3.0f)));
+		BENCH_CHECK(wide.position == position + direction * range);
+		BENCH_CHECK(encloses_cone(wide, position, direction, range, cos_wide));
+
+		// Past the widest cone a volume is drawn for, the point light sphere is used
+		const light_sphere point = get_cone_bounds(position, direction, range, 0.05f);
+		BENCH_CHECK(point.position == position && point.radius == range);
+
+		// Both branches agree at 45 degrees, where the sphere through the rim is centred on the base
+		const float cos_half = std::sqrt(0.5f);
+		BENCH_CHECK(near_equal(get_cone_bounds(position, direction, range, cos_half).radius, range));
+
+		// The cone model puts the apex on the light, the base at range, and circumscribes the polygon
+		const unsigned segments = 8;
+		const matrix4 model = get_cone_model(position, direction, range, cos_narrow, segments);
+
+		const vector3 apex = (model * vector4(0.0f, 0.0f, 0.0f, 1.0f)).xyz();
+		const vector3 base = (model * vector4(0.0f, 0.0f, 1.0f, 1.0f)).xyz();
+		const vector3 edge = (model * vector4(1.0f, 0.0f, 1.0f, 1.0f)).xyz() - base;
+
+		const float rim = range * std::tan(20.0f * pi / 180.0f);
+
+		BENCH_CHECK(near_equal((apex - position).length(), 0.0f));
+		BENCH_CHECK(near_equal((base - (position + direction * range)).length(), 0.0f));
+		BENCH_CHECK(near_equal(edge.length(), rim / std::cos(pi / segments)));
+		BENCH_CHECK(near_equal(vector3::dot(edge, direction), 0.0f));
+
+		return true;
+	}
+}
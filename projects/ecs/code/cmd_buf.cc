@@ -0,0 +1,63 @@
+#include "cmd_buf.h"
+#include "core/jobs.h"
+
+#include <utility>
+
+namespace efiilj
+{
+	command_buffer::command_buffer(unsigned index)
+		: _index(index), _pending(0), _chunk(0), _key(0)
+	{ }
+
+	void command_buffer::record(command_type type, entity_id entity, entity_id other,
+			component_base* target, std::function<void(int)> init)
+	{
+		// A key left over from another chunk run on this thread would otherwise depend on scheduling
+		const uint64_t chunk = core::job_system::get().get_chunk_key();
+
+		if (chunk != _chunk)
+		{
+			_chunk = chunk;
+			_key = 0;
+		}
+
+		const unsigned seq = static_cast<unsigned>(_commands.size());
+		_commands.push_back({ type, chunk, _key, seq, _index, entity, other, target, std::move(init) });
+	}
+
+	void command_buffer::set_key(uint64_t key)
+	{
+		// Taken as the chunk's own, so the first command recorded in a new chunk does not start it over at 0
+		_chunk = core::job_system::get().get_chunk_key();
+		_key = key;
+	}
+
+	entity_id command_buffer::create()
+	{
+		// Pending ids count down from -2, as -1 is the invalid id
+		const entity_id pending = -2 - static_cast<entity_id>(_pending++);
+		record(command_type::create, pending);
+
+		return pending;
+	}
+
+	void command_buffer::destroy(entity_id eid)
+	{
+		record(command_type::destroy, eid);
+	}
+
+	void command_buffer::add_component(component_base* mgr, entity_id eid, std::function<void(int)> init)
+	{
+		record(command_type::add_component, eid, -1, mgr, std::move(init));
+	}
+
+	void command_buffer::remove_component(component_base* mgr, entity_id eid)
+	{
+		record(command_type::remove_component, eid, -1, mgr);
+	}
+
+	void command_buffer::reparent(component_base* mgr, entity_id child, entity_id parent)
+	{
+		record(command_type::reparent, child, parent, mgr);
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "eid.h"
+#include "ifmgr.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace efiilj
+{
+	enum class command_type
+	{
+		create,
+		destroy,
+		add_component,
+		remove_component,
+		reparent
+	};
+
+	/**
+	 * \brief Structural change requested by a job, applied when the manager host plays its buffers back.
+	 */
+	struct command
+	{
+		command_type type;
+
+		// Order of playback -- commands are sorted by the parallel_for chunk they were recorded in,
+		// then by key, then by the order they were recorded in
+		uint64_t chunk;
+		uint64_t key;
+		unsigned seq;
+		unsigned buffer;
+
+		entity_id entity;
+		entity_id other;
+		component_base* target;
+
+		// Called with the id of an added component, once it exists
+		std::function<void(int)> init;
+	};
+
+	/**
+	 * \brief Records structural changes on one thread, without touching any manager.
+	 * Entities created through a buffer get a pending id, which can be used in later commands
+	 * of the same buffer and is replaced by the real id on playback.
+	 */
+	class command_buffer
+	{
+		friend class manager_host;
+
+		private:
+
+			std::vector<command> _commands;
+			std::vector<entity_id> _created;
+
+			unsigned _index;
+			unsigned _pending;
+			uint64_t _chunk;
+			uint64_t _key;
+
+			void record(command_type type, entity_id entity, entity_id other = -1,
+					component_base* target = nullptr, std::function<void(int)> init = nullptr);
+
+		public:
+
+			explicit command_buffer(unsigned index);
+
+			/**
+			 * \brief Sets the sort key of the commands recorded after it, within the current parallel_for chunk.
+			 * Chunks already play back in range order, and each one starts over at key 0.
+			 */
+			void set_key(uint64_t key);
+
+			/**
+			 * \return Pending id of the new entity, valid in this buffer until playback
+			 */
+			entity_id create();
+
+			void destroy(entity_id eid);
+
+			/**
+			 * \param init Called on playback with the id of the new component, to set it up -- it must not record commands
+			 */
+			void add_component(component_base* mgr, entity_id eid, std::function<void(int)> init = nullptr);
+
+			void remove_component(component_base* mgr, entity_id eid);
+
+			/**
+			 * \param parent Entity to attach to, -1 to detach
+			 */
+			void reparent(component_base* mgr, entity_id child, entity_id parent);
+
+			bool empty() const
+			{
+				return _commands.empty();
+			}
+
+			size_t size() const
+			{
+				return _commands.size();
+			}
+
+			static bool is_pending(entity_id eid)
+			{
+				return eid < -1;
+			}
+	};
+}
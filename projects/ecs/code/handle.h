@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Handles pack a slot index with the generation of the slot, bumped each time it is freed,
+// so that handles to a destroyed resource stop being valid once its slot is reused.
+// The sign bit is left clear, so that -1 remains the invalid handle.
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_GENERATION_BITS 11
+
+namespace efiilj
+{
+	const int handle_index_mask = (1 << HANDLE_INDEX_BITS) - 1;
+	const unsigned handle_generation_mask = (1u << HANDLE_GENERATION_BITS) - 1;
+
+	inline int handle_index(int handle)
+	{
+		return handle & handle_index_mask;
+	}
+
+	inline unsigned handle_generation(int handle)
+	{
+		return static_cast<unsigned>(handle) >> HANDLE_INDEX_BITS;
+	}
+
+	inline int make_handle(int index, unsigned generation)
+	{
+		return index | static_cast<int>((generation & handle_generation_mask) << HANDLE_INDEX_BITS);
+	}
+
+	/**
+	 * \brief Per-slot column of a server, registered so that reused slots can be reset.
+	 */
+	struct slot_column
+	{
+		virtual ~slot_column() = default;
+
+		/**
+		 * \brief Moves the last element, just appended by append_defaults, into a reused slot.
+		 */
+		virtual void recycle(size_t index) = 0;
+
+		virtual size_t slots() const = 0;
+
+		virtual void reserve_slots(size_t count) = 0;
+	};
+
+	/**
+	 * \brief Vector indexed by handle, which only uses the slot index of it.
+	 */
+	template<typename U>
+	class slot_vector : public std::vector<U>, public slot_column
+	{
+		public:
+
+			using std::vector<U>::vector;
+
+			typename std::vector<U>::reference operator [] (int handle)
+			{ return std::vector<U>::operator[](handle_index(handle)); }
+
+			typename std::vector<U>::const_reference operator [] (int handle) const
+			{ return std::vector<U>::operator[](handle_index(handle)); }
+
+			void recycle(size_t index) override
+			{
+				U value = std::move(this->back());
+				this->pop_back();
+				std::vector<U>::operator[](index) = std::move(value);
+			}
+
+			size_t slots() const override
+			{ return this->size(); }
+
+			void reserve_slots(size_t count) override
+			{ this->reserve(count); }
+	};
+}
@@ -4,6 +4,7 @@
 #include "msg.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace efiilj
 {
@@ -34,6 +35,28 @@ namespace efiilj
 			virtual void draw_entity_gui(entity_id eid) = 0;
 			virtual void register_from_editor(entity_id eid) = 0;
 
+			/**
+			 * \brief Removes every component of a batch of entities, without validating them.
+			 */
+			virtual void remove_entities(const std::vector<entity_id>& eids) = 0;
+
+			/**
+			 * \brief Registers a component to an entity, for callers that only know the manager by its base.
+			 * \return Id of the new component
+			 */
+			virtual int add_entity(entity_id eid) = 0;
+
+			/**
+			 * \brief Removes every component of an entity from this manager.
+			 */
+			virtual void remove_entity(entity_id eid) = 0;
+
+			/**
+			 * \brief Attaches the components of one entity to those of another, for managers with a hierarchy.
+			 * \param parent Entity to attach to, -1 to detach
+			 */
+			virtual void reparent(entity_id, entity_id) { };
+
 			virtual const std::string& get_component_name() const = 0;
 
 			virtual void on_editor_gui() { };
@@ -4,19 +4,64 @@
 #include "mgr_host.h"
 #include "comp.h"
 #include "mgrdata.h"
+#include "core/arena.h"
 
 #include <vector>
 #include <map>
 #include <unordered_map>
-#include <set>
+#include <memory_resource>
 
 #include "imgui.h"
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 
 namespace efiilj
 {
+	/**
+	 * \brief Components of one entity, iterated along the chain that links them in their manager.
+	 */
+	template<class T>
+	class component_list
+	{
+		private:
+
+			const std::vector<T>* _next;
+			T _first;
+
+		public:
+
+			struct iterator
+			{
+				const std::vector<T>* next;
+				T idx;
+
+				T operator * () const { return idx; }
+				iterator& operator ++ () { idx = (*next)[idx]; return *this; }
+				bool operator != (const iterator& other) const { return idx != other.idx; }
+			};
+
+			component_list(const std::vector<T>& next, T first)
+				: _next(&next), _first(first)
+			{ }
+
+			iterator begin() const { return { _next, _first }; }
+			iterator end() const { return { _next, static_cast<T>(-1) }; }
+
+			bool empty() const { return _first == -1; }
+
+			size_t size() const
+			{
+				size_t n = 0;
+
+				for (T idx = _first; idx != -1; idx = (*_next)[idx])
+					n++;
+
+				return n;
+			}
+	};
+
 	template<class T>
 	class manager : public component_base
 	{
@@ -24,12 +69,16 @@ namespace efiilj
 
 			std::shared_ptr<manager_host> _dispatcher;
 
-			std::unordered_map<entity_id, std::set<T>> _instance_mapping;
+			// First component of each entity, by entity slot -- the rest are chained through _com.next.
+			// Kept flat rather than in a map, so that registering components does not allocate per entity.
+			std::vector<T> _first;
 
 			struct
 			{
 				ComponentData<T> instances;
 				ComponentData<entity_id> entities;
+				ComponentData<T> next;
+				ComponentData<T> prev;
 				ComponentData<bool> enabled { true };
 				ComponentData<bool> alive { true };
 				ComponentData<bool> error { false };
@@ -62,12 +111,103 @@ namespace efiilj
 					data->extend();
 			}
 
+			void extend_data(size_t count)
+			{
+				for (Extensible*& data : _ds)
+					data->extend(count);
+			}
+
 			void trim_data()
 			{
 				for (Extensible*& data : _ds)
 					data->trim();
 			}
 
+			void trim_data(size_t count)
+			{
+				for (Extensible*& data : _ds)
+					data->trim(count);
+			}
+
+			/**
+			 * \brief Appends a component to the chain of its entity.
+			 */
+			void link(T idx, entity_id eid)
+			{
+				const size_t index = handle_index(eid);
+
+				if (index >= _first.size())
+					_first.resize(index + 1, static_cast<T>(-1));
+
+				_com.next[idx] = -1;
+				_com.prev[idx] = -1;
+
+				T tail = get_component(eid);
+
+				if (tail == -1)
+				{
+					_first[index] = idx;
+					return;
+				}
+
+				while (_com.next[tail] != -1)
+					tail = _com.next[tail];
+
+				_com.next[tail] = idx;
+				_com.prev[idx] = tail;
+			}
+
+			void unlink(T idx)
+			{
+				const size_t index = handle_index(get_entity(idx));
+				const T prev = _com.prev[idx];
+				const T next = _com.next[idx];
+
+				if (prev != -1)
+					_com.next[prev] = next;
+				else if (_first[index] == idx)
+					_first[index] = next;
+
+				if (next != -1)
+					_com.prev[next] = prev;
+			}
+
+			/**
+			 * \brief Points the chain of a component at its new id, after packing moved it.
+			 */
+			void relink(T to, T from)
+			{
+				const size_t index = handle_index(get_entity(to));
+				const T prev = _com.prev[to];
+				const T next = _com.next[to];
+
+				if (prev != -1)
+					_com.next[prev] = to;
+				else if (_first[index] == from)
+					_first[index] = to;
+
+				if (next != -1)
+					_com.prev[next] = to;
+			}
+
+			/**
+			 * \brief Fills the slot of an unlinked component with the last one.
+			 */
+			void erase(T idx)
+			{
+				T last = static_cast<T>(count - 1);
+
+				if (idx != last)
+				{
+					pack_data(idx, last);
+					_com.instances[idx] = idx;
+					relink(idx, last);
+				}
+
+				trim_data();
+				count--;
+			}
+
 			void add_data(Extensible* data)
 			{
 				_ds.emplace_back(data);
@@ -84,6 +224,8 @@ namespace efiilj
 				add_data({
 						&_com.instances,
 						&_com.entities,
+						&_com.next,
+						&_com.prev,
 						&_com.enabled,
 						&_com.alive,
 						&_com.error});
@@ -109,8 +251,7 @@ namespace efiilj
 				_com.entities[new_id] = eid;
 				_com.instances[new_id] = new_id;
 
-				// Add entity id to instance map
-				_instance_mapping[eid].emplace(new_id);
+				link(new_id, eid);
 
 				count++;
 
@@ -119,12 +260,136 @@ namespace efiilj
 				return new_id;
 			}
 
+			/**
+			 * \brief Registers one component for each entity, growing every column once for the whole batch.
+			 * \return Id of the first component, the rest follow it in the order of the entities
+			 */
+			T register_entities(const std::vector<entity_id>& eids)
+			{
+				if (eids.empty())
+					return -1;
+
+				const size_t n = eids.size();
+				const size_t free = _com.instances.size() - count;
+
+				T first = static_cast<T>(count);
+
+				if (free < n)
+					extend_data(n - free);
+
+				int max_index = -1;
+
+				for (entity_id eid : eids)
+					max_index = std::max(max_index, handle_index(eid));
+
+				if (max_index >= static_cast<int>(_first.size()))
+					_first.resize(max_index + 1, static_cast<T>(-1));
+
+				for (size_t i = 0; i < n; i++)
+				{
+					T new_id = static_cast<T>(first + i);
+
+					_com.entities[new_id] = eids[i];
+					_com.instances[new_id] = new_id;
+
+					link(new_id, eids[i]);
+				}
+
+				count += n;
+
+				for (size_t i = 0; i < n; i++)
+					on_activate(static_cast<T>(first + i));
+
+				return first;
+			}
+
 			bool unregister_entity(entity_id eid)
 			{
-				auto components = get_components(eid);
+				bool removed = false;
 
-				for (auto idx : components)
+				// Removing a component can move another one of the entity, so the first remaining one is looked up each time
+				for (T idx = get_component(eid); idx != -1; idx = get_component(eid))
+				{
 					remove_component(idx);
+					removed = true;
+				}
+
+				return removed;
+			}
+
+			/**
+			 * \brief Removes every component of a batch of entities, validating each entity once the batch is done.
+			 */
+			void unregister_entities(const std::vector<entity_id>& eids)
+			{
+				remove_entities(eids);
+
+				for (entity_id eid : eids)
+					_dispatcher->validate(eid);
+			}
+
+			void remove_entities(const std::vector<entity_id>& eids) override
+			{
+				core::scratch_scope scratch;
+				std::pmr::vector<T> removed(scratch.resource());
+
+				// Unlinked as they are found, so that entities listed twice are only removed once
+				for (entity_id eid : eids)
+				{
+					for (T idx = get_component(eid); idx != -1;)
+					{
+						const T next = _com.next[idx];
+
+						on_deactivate(idx);
+						on_destroy(idx);
+						unlink(idx);
+
+						removed.emplace_back(idx);
+						idx = next;
+					}
+				}
+
+				const size_t n = removed.size();
+
+				if (n == 0)
+					return;
+
+				// A few holes are filled from the back, highest first so that no removed component gets moved
+				if (n * 8 < count)
+				{
+					std::sort(removed.begin(), removed.end(), [](T a, T b) { return a > b; });
+
+					for (T idx : removed)
+						erase(idx);
+
+					return;
+				}
+
+				// Otherwise the remaining components are packed down in one pass
+				std::pmr::vector<unsigned char> flags(count, 0, scratch.resource());
+
+				for (T idx : removed)
+					flags[idx] = 1;
+
+				T write = 0;
+
+				for (T idx = 0; idx < static_cast<T>(count); idx++)
+				{
+					if (flags[idx])
+						continue;
+
+					if (write != idx)
+					{
+						pack_data(write, idx);
+						_com.instances[write] = write;
+						relink(write, idx);
+					}
+
+					write++;
+				}
+
+				trim_data(n);
+				count -= n;
 			}
 
 			void remove_component(T idx)
@@ -145,22 +410,9 @@ namespace efiilj
 			{
 				on_destroy(idx);
 
-				T last = _com.instances[count - 1];
-
-				entity_id eid = get_entity(idx);
-				entity_id last_eid = get_entity(last);
-
-				if (idx != last)
-				{
-					pack_data(idx, last);
-					_instance_mapping[last_eid].erase(last);
-					_instance_mapping[last_eid].emplace(idx);
-				}
-
-				_instance_mapping[eid].erase(idx);
-
-				trim_data();
-				count--;
+				// Unlinked before packing, in case the last component is chained to this one
+				unlink(idx);
+				erase(idx);
 			}
 
 			void register_from_editor(entity_id eid) override
@@ -168,6 +420,16 @@ namespace efiilj
 				register_entity(eid);
 			}
 
+			int add_entity(entity_id eid) override
+			{
+				return register_entity(eid);
+			}
+
+			void remove_entity(entity_id eid) override
+			{
+				unregister_entity(eid);
+			}
+
 			void draw_entity_gui(entity_id eid) override
 			{
 				const auto& components = get_components(eid);
@@ -241,13 +503,22 @@ namespace efiilj
 			const std::vector<T>& get_instances() const
 			{ return _com.instances.data(); }
 
-			const std::set<T>& get_components(entity_id eid)
-			{ return _instance_mapping[eid]; }
+			component_list<T> get_components(entity_id eid) const
+			{ return component_list<T>(_com.next.data(), get_component(eid)); }
 
-			T get_component(entity_id eid)
+			/**
+			 * \brief First component registered to an entity, -1 if it has none.
+			 */
+			T get_component(entity_id eid) const
 			{
-				const auto& components = _instance_mapping[eid];
-				return (components.size() > 0) ? *components.begin() : -1;
+				const size_t index = handle_index(eid);
+
+				if (eid < 0 || index >= _first.size())
+					return -1;
+
+				// The slot may have been taken by a newer entity since
+				const T first = _first[index];
+				return (first != -1 && _com.entities[first] == eid) ? first : -1;
 			}
 	};
 }
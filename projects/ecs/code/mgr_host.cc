@@ -1,11 +1,22 @@
 #include "mgr_host.h"
+#include "entity.h"
+#include "core/arena.h"
+#include "core/profiler.h"
 
 #include "stdio.h"
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 namespace efiilj
 {
+	namespace
+	{
+		std::atomic<uint64_t> next_host_id { 1 };
+	}
+
 	manager_host::manager_host()
+		: _id(next_host_id++)
 	{
 		printf("Init manager host...\n");
 	}
@@ -23,19 +34,27 @@ namespace efiilj
 		fourcc f = { fcc };
 		printf("Registered manager %c%c%c%c ", f.d, f.c, f.b, f.a);
 
+		const char* name = core::intern_profile_name({ f.d, f.c, f.b, f.a });
+
 		if (std::shared_ptr<component_base> cmp = std::dynamic_pointer_cast<component_base>(mgr))
 		{
 			cmp->set_dispatcher(shared_from_this());
 			_components.emplace_back(cmp);
+			_component_names.emplace_back(name);
 			printf("[COMPONENT]");
 		}
 
 		if (std::shared_ptr<server_base> srv = std::dynamic_pointer_cast<server_base>(mgr))
 		{
 			_servers.emplace_back(srv);
+			_server_names.emplace_back(name);
 			printf("[SERVER]");
 		}
 
+		// Commands that create and destroy entities are played back against it
+		if (std::shared_ptr<entity_manager> ents = std::dynamic_pointer_cast<entity_manager>(mgr))
+			_entities = ents;
+
 		_reg.emplace(fcc, std::move(mgr));
 		printf("\n");
 	}
@@ -52,6 +71,160 @@ namespace efiilj
 			mgr->on_validate(eid);
 	}
 
+	void manager_host::remove_entities(const std::vector<entity_id>& eids) const
+	{
+		// The entities are left without components, so there is nothing to validate afterwards
+		for (const auto& mgr : _components)
+			mgr->remove_entities(eids);
+	}
+
+	command_buffer& manager_host::get_commands()
+	{
+		// Cached per thread, so recording only takes the lock the first time a thread asks
+		thread_local uint64_t cached_host = 0;
+		thread_local command_buffer* cached_buffer = nullptr;
+
+		if (cached_host != _id)
+		{
+			std::lock_guard<std::mutex> lock(_buffer_lock);
+
+			_buffers.emplace_back(std::make_unique<command_buffer>(static_cast<unsigned>(_buffers.size())));
+
+			cached_host = _id;
+			cached_buffer = _buffers.back().get();
+		}
+
+		return *cached_buffer;
+	}
+
+	entity_id manager_host::resolve(const command& cmd, entity_id eid) const
+	{
+		if (!command_buffer::is_pending(eid))
+			return eid;
+
+		const auto& created = _buffers[cmd.buffer]->_created;
+		const size_t pending = static_cast<size_t>(-2 - eid);
+
+		return (pending < created.size()) ? created[pending] : -1;
+	}
+
+	size_t manager_host::play_commands()
+	{
+		PROFILE_SCOPE("play_commands");
+
+		_playback.clear();
+
+		for (auto& buffer : _buffers)
+		{
+			for (auto& cmd : buffer->_commands)
+				_playback.emplace_back(&cmd);
+		}
+
+		if (_playback.empty())
+			return 0;
+
+		assert(("Commands need an entity manager to play back", _entities != nullptr)); //NOLINT
+
+		// A chunk runs on one thread, so chunk, key and recording order fix the order without looking at buffers
+		std::sort(_playback.begin(), _playback.end(), [](const command* a, const command* b)
+		{
+			if (a->chunk != b->chunk)
+				return a->chunk < b->chunk;
+
+			if (a->key != b->key)
+				return a->key < b->key;
+
+			return a->seq < b->seq;
+		});
+
+		// Runs of destroys are applied as one batch, before the next command that is not a destroy
+		const auto flush_removed = [this]()
+		{
+			if (_removed.empty())
+				return;
+
+			remove_entities(_removed);
+			_entities->destroy_many(_removed);
+			_removed.clear();
+		};
+
+		for (command* cmd : _playback)
+		{
+			const entity_id eid = resolve(*cmd, cmd->entity);
+
+			if (cmd->type != command_type::destroy)
+				flush_removed();
+
+			switch (cmd->type)
+			{
+				case command_type::create:
+				{
+					auto& created = _buffers[cmd->buffer]->_created;
+					const size_t pending = static_cast<size_t>(-2 - cmd->entity);
+
+					if (created.size() <= pending)
+						created.resize(pending + 1, -1);
+
+					created[pending] = _entities->create();
+					break;
+				}
+
+				case command_type::destroy:
+				{
+					if (_entities->is_valid(eid))
+						_removed.emplace_back(eid);
+
+					break;
+				}
+
+				case command_type::add_component:
+				{
+					if (!_entities->is_valid(eid))
+						break;
+
+					const int idx = cmd->target->add_entity(eid);
+
+					if (cmd->init)
+						cmd->init(idx);
+
+					break;
+				}
+
+				case command_type::remove_component:
+				{
+					if (_entities->is_valid(eid))
+						cmd->target->remove_entity(eid);
+
+					break;
+				}
+
+				case command_type::reparent:
+				{
+					if (_entities->is_valid(eid))
+						cmd->target->reparent(eid, resolve(*cmd, cmd->other));
+
+					break;
+				}
+			}
+		}
+
+		flush_removed();
+
+		const size_t played = _playback.size();
+
+		for (auto& buffer : _buffers)
+		{
+			buffer->_commands.clear();
+			buffer->_created.clear();
+			buffer->_pending = 0;
+			buffer->_key = 0;
+		}
+
+		_playback.clear();
+
+		return played;
+	}
+
 	void manager_host::setup()
 	{
 		for (const auto& srv : _servers)
@@ -63,28 +236,61 @@ namespace efiilj
 
 	void manager_host::begin_frame()
 	{
-		for (const auto& srv : _servers)
-			srv->on_begin_frame();
+		PROFILE_SCOPE("begin_frame");
 
-		for (const auto& com : _components)
-			com->on_begin_frame();
+		for (size_t i = 0; i < _servers.size(); i++)
+		{
+			PROFILE_SCOPE(_server_names[i]);
+			_servers[i]->on_begin_frame();
+		}
+
+		for (size_t i = 0; i < _components.size(); i++)
+		{
+			PROFILE_SCOPE(_component_names[i]);
+			_components[i]->on_begin_frame();
+		}
 	}
 
 	void manager_host::frame()
 	{
-		for (const auto& srv : _servers)
-			srv->on_frame();
+		PROFILE_SCOPE("frame");
 
-		for (const auto& com : _components)
-			com->on_frame();
+		for (size_t i = 0; i < _servers.size(); i++)
+		{
+			PROFILE_SCOPE(_server_names[i]);
+			_servers[i]->on_frame();
+		}
+
+		for (size_t i = 0; i < _components.size(); i++)
+		{
+			PROFILE_SCOPE(_component_names[i]);
+			_components[i]->on_frame();
+		}
+
+		// Sync point for structural changes requested while the managers ran
+		play_commands();
 	}
 
 	void manager_host::end_frame()
 	{
-		for (const auto& srv : _servers)
-			srv->on_end_frame();
+		{
+			PROFILE_SCOPE("end_frame");
 
-		for (const auto& com : _components)
-			com->on_end_frame();
+			for (size_t i = 0; i < _servers.size(); i++)
+			{
+				PROFILE_SCOPE(_server_names[i]);
+				_servers[i]->on_end_frame();
+			}
+
+			for (size_t i = 0; i < _components.size(); i++)
+			{
+				PROFILE_SCOPE(_component_names[i]);
+				_components[i]->on_end_frame();
+			}
+		}
+
+		// Everything allocated from the frame arena this frame is released at once
+		core::end_frame_arena();
+		core::end_profile_frame();
 	}
 }
@@ -2,8 +2,11 @@
 
 #include "ifmgr.h"
 #include "msg.h"
+#include "cmd_buf.h"
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <cassert>
 #include <unordered_map>
@@ -20,6 +23,8 @@ namespace efiilj
 		struct { char a, b, c, d; };
 	};
 
+	class entity_manager;
+
 	class manager_host : public std::enable_shared_from_this<manager_host>
 	{
 		private:
@@ -28,6 +33,23 @@ namespace efiilj
 			std::vector<std::shared_ptr<component_base>> _components;
 			std::vector<std::shared_ptr<server_base>> _servers;
 
+			// FourCC of each component and server, as profiler zone names
+			std::vector<const char*> _component_names;
+			std::vector<const char*> _server_names;
+			std::shared_ptr<entity_manager> _entities;
+
+			// Tells hosts apart in the per-thread buffer cache, where a new host can have the address of a destroyed one
+			const uint64_t _id;
+
+			// One command buffer per thread that has recorded into one, created on first use
+			std::vector<std::unique_ptr<command_buffer>> _buffers;
+			std::mutex _buffer_lock;
+
+			std::vector<command*> _playback;
+			std::vector<entity_id> _removed;
+
+			entity_id resolve(const command& cmd, entity_id eid) const;
+
 		public:
 
 			manager_host();
@@ -47,6 +69,24 @@ namespace efiilj
 			void message(message_type msg, entity_id eid) const;
 			void validate(entity_id eid) const;
 
+			/**
+			 * \brief Removes every component of a batch of entities from all managers, before the entities are destroyed.
+			 */
+			void remove_entities(const std::vector<entity_id>& eids) const;
+
+			/**
+			 * \brief Command buffer of the calling thread, for structural changes requested from jobs.
+			 * Commands are applied by play_commands, which manager_host::frame runs after every manager.
+			 */
+			command_buffer& get_commands();
+
+			/**
+			 * \brief Applies the recorded commands of every thread, sorted by parallel_for chunk, key and recording order,
+			 * so the result does not depend on thread scheduling. Must not run while jobs are recording.
+			 * \return Number of commands applied
+			 */
+			size_t play_commands();
+
 			void begin_frame();
 			void frame();
 			void end_frame();
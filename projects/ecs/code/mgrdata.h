@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 namespace efiilj
@@ -7,7 +8,9 @@ namespace efiilj
 	struct Extensible
 	{ 
 		virtual void extend() = 0;
+		virtual void extend(size_t count) = 0;
 		virtual void trim() = 0;
+		virtual void trim(size_t count) = 0;
 		virtual void pack(int to, int from) = 0;
 		virtual void reset_default(int idx) = 0;
 	};
@@ -45,11 +48,24 @@ namespace efiilj
 					_data.emplace_back();
 			}
 
+			void extend(size_t count) override
+			{
+				if (_has_default)
+					_data.resize(_data.size() + count, _default_value);
+				else
+					_data.resize(_data.size() + count);
+			}
+
 			void trim() override
 			{
 				_data.pop_back();
 			}
 
+			void trim(size_t count) override
+			{
+				_data.erase(_data.end() - count, _data.end());
+			}
+
 			void reset_default(int idx) override
 			{ 
 				if (_has_default)
@@ -1,7 +1,14 @@
 #pragma once
 
 #include "ifmgr.h"
+#include "handle.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <unordered_map>
 #include <vector>
 
 namespace efiilj
@@ -11,22 +18,90 @@ namespace efiilj
 	{
 		protected:
 
-			std::vector<T> _pool;
-			std::vector<bool> _alive;
+			// Current handle of each slot, and whether it is in use
+			slot_vector<T> _pool;
+			slot_vector<bool> _alive;
 
+			// Freed slots, reused by create before the pool grows
+			std::vector<int> _free;
+			std::vector<slot_column*> _columns;
+
+			// Content addressing -- resources published under a hash are shared by reference count
+			slot_vector<unsigned> _refs;
+			slot_vector<uint64_t> _hash;
+			slot_vector<size_t> _bytes;
+			std::unordered_map<uint64_t, T> _shared;
+
+			size_t _shared_hits = 0;
+			size_t _saved_bytes = 0;
+			size_t _recycled = 0;
+
+			/**
+			 * \brief Appends the defaults of a new slot to every column. Reused slots get the appended
+			 * defaults moved into place, so every column filled here must be registered with add_columns.
+			 */
 			virtual void append_defaults(T) = 0;
 
+			void add_columns(std::initializer_list<slot_column*> list)
+			{
+				for (auto column : list)
+					_columns.emplace_back(column);
+			}
+
+			/**
+			 * \brief Stops the program if the pool would outgrow the index bits of a handle, as the
+			 * slot past the last index would spill into the generation and alias another slot.
+			 */
+			void check_index_space(size_t slots) const
+			{
+				if (slots <= static_cast<size_t>(handle_index_mask) + 1)
+					return;
+
+				fprintf(stderr, "Server out of handles: %lu slots, at most %d fit in a handle\n",
+						slots, handle_index_mask + 1);
+				abort();
+			}
+
 		public:
 
 			virtual T create()
 			{
-				T new_id = static_cast<T>(_pool.size());
+				if (_free.empty())
+				{
+					check_index_space(_pool.size() + 1);
+
+					T new_id = static_cast<T>(_pool.size());
 
-				_pool.emplace_back(new_id);
-				_alive.emplace_back(true);
+					_pool.emplace_back(new_id);
+					_alive.emplace_back(true);
+					_refs.emplace_back(1);
+					_hash.emplace_back(0);
+					_bytes.emplace_back(0);
+
+					append_defaults(new_id);
+
+					return new_id;
+				}
+
+				const int index = _free.back();
+				_free.pop_back();
+
+				// The generation was bumped when the slot was freed
+				T new_id = static_cast<T>(make_handle(index, handle_generation(_pool[index])));
+
+				_pool[index] = new_id;
+				_alive[index] = true;
+				_refs[index] = 1;
+				_hash[index] = 0;
+				_bytes[index] = 0;
 
 				append_defaults(new_id);
 
+				for (auto column : _columns)
+					column->recycle(index);
+
+				_recycled++;
+
 				return new_id;
 			}
 
@@ -34,18 +109,217 @@ namespace efiilj
 
 			virtual bool destroy(T id)
 			{
-				_alive[id] = false;
+				if (!server::is_valid(id))
+					return false;
+
+				const int index = handle_index(id);
+
+				unshare(id);
+				_alive[index] = false;
+
+				// Handles to the old generation no longer match the slot
+				_pool[index] = static_cast<T>(make_handle(index, handle_generation(id) + 1));
+				_free.push_back(index);
+
 				return true;
 			}
 
+			/**
+			 * \brief Grows every column to hold a number of slots without reallocating.
+			 */
+			void reserve(size_t capacity)
+			{
+				_pool.reserve(capacity);
+				_alive.reserve(capacity);
+				_refs.reserve(capacity);
+				_hash.reserve(capacity);
+				_bytes.reserve(capacity);
+
+				for (auto column : _columns)
+					column->reserve_slots(capacity);
+			}
+
+			/**
+			 * \brief Creates a batch of resources, reusing freed slots first and growing the columns once for the rest.
+			 * \param ids Receives the new handles, appended in creation order
+			 */
+			void create_many(size_t count, std::vector<T>& ids)
+			{
+				const size_t grow = (count > _free.size()) ? count - _free.size() : 0;
+
+				// Checked up front, so that a batch never stops half way
+				check_index_space(_pool.size() + grow);
+				reserve(_pool.size() + grow);
+				ids.reserve(ids.size() + count);
+
+				for (size_t i = 0; i < count; i++)
+					ids.emplace_back(create());
+			}
+
+			/**
+			 * \brief Destroys a batch of resources, skipping stale handles.
+			 * \return Number of resources destroyed
+			 */
+			size_t destroy_many(const std::vector<T>& ids)
+			{
+				size_t destroyed = 0;
+
+				_free.reserve(_free.size() + ids.size());
+
+				for (T id : ids)
+					destroyed += destroy(id);
+
+				return destroyed;
+			}
+
 			virtual bool is_valid(T id) const
 			{
-				return (id >= 0 && id < static_cast<int>(_pool.size()) && _alive[id]);
+				return (id >= 0 && handle_index(id) < static_cast<int>(_pool.size()) && _pool[id] == id && _alive[id]);
 			}
 
+			/**
+			 * \brief Current handle of every slot, including free ones -- check is_valid before use.
+			 */
 			const std::vector<T>& get_ids()
 			{
 				return _pool;
 			}
+
+			/**
+			 * \brief Number of slots in use.
+			 */
+			size_t get_count() const
+			{
+				return _pool.size() - _free.size();
+			}
+
+			size_t get_capacity() const
+			{
+				return _pool.size();
+			}
+
+			/**
+			 * \brief Number of creations that reused a freed slot.
+			 */
+			size_t get_recycled() const
+			{
+				return _recycled;
+			}
+
+			/**
+			 * \brief Looks up a live resource by content hash, and adds a reference to it if found.
+			 * \return Id of the shared resource, -1 if there is none
+			 */
+			T find_shared(uint64_t hash)
+			{
+				auto it = _shared.find(hash);
+
+				if (it == _shared.end())
+					return static_cast<T>(-1);
+
+				// Left behind by a resource that is gone, its slot may hold something else by now
+				if (!server::is_valid(it->second))
+				{
+					_shared.erase(it);
+					return static_cast<T>(-1);
+				}
+
+				_refs[it->second]++;
+				_shared_hits++;
+				_saved_bytes += _bytes[it->second];
+
+				return it->second;
+			}
+
+			/**
+			 * \brief Publishes a resource under a content hash, so that later lookups of the same content share it.
+			 * \param bytes Size of the resource data, counted as saved on each shared lookup
+			 */
+			void set_shared(T id, uint64_t hash, size_t bytes)
+			{
+				if (!server::is_valid(id))
+					return;
+
+				unshare(id);
+
+				_hash[id] = hash;
+				_bytes[id] = bytes;
+				_shared[hash] = id;
+			}
+
+			/**
+			 * \brief Withdraws a resource from lookups, for resources whose content is about to change.
+			 */
+			void unshare(T id)
+			{
+				if (!server::is_valid(id))
+					return;
+
+				auto it = _shared.find(_hash[id]);
+
+				if (it != _shared.end() && it->second == id)
+					_shared.erase(it);
+
+				_hash[id] = 0;
+			}
+
+			/**
+			 * \brief Adds a reference, unless the handle is stale.
+			 * \return True if the reference was added
+			 */
+			bool add_ref(T id)
+			{
+				if (!server::is_valid(id))
+					return false;
+
+				_refs[id]++;
+				return true;
+			}
+
+			/**
+			 * \brief Drops a reference, destroying the resource along with the last one.
+			 * A stale handle does nothing, rather than dropping a reference to whatever reuses its slot.
+			 * \return True if the resource was destroyed
+			 */
+			bool remove_ref(T id)
+			{
+				if (!server::is_valid(id))
+					return false;
+
+				if (_refs[id] > 1)
+				{
+					_refs[id]--;
+					return false;
+				}
+
+				_refs[id] = 0;
+				return destroy(id);
+			}
+
+			/**
+			 * \brief References held on a resource, 0 for stale handles.
+			 */
+			unsigned get_ref_count(T id) const
+			{
+				return server::is_valid(id) ? _refs[id] : 0;
+			}
+
+			size_t get_shared_count() const
+			{
+				return _shared.size();
+			}
+
+			size_t get_shared_hits() const
+			{
+				return _shared_hits;
+			}
+
+			/**
+			 * \brief Bytes of resource data that shared lookups did not have to create again.
+			 */
+			size_t get_saved_bytes() const
+			{
+				return _saved_bytes;
+			}
 	};
 }
@@ -6,7 +6,7 @@
 namespace exts::gltf
 {
 
-	size_t type_component_count(const std::string& type)
+	inline size_t type_component_count(const std::string& type)
 	{
 		if (type.compare("SCALAR") == 0)
 			return 1;
@@ -26,7 +26,7 @@ namespace exts::gltf
 		return 0;
 	}
 
-	size_t component_type_size(int type) 
+	inline size_t component_type_size(int type) 
 	{
 		switch (type) 
 		{
@@ -48,7 +48,7 @@ namespace exts::gltf
 		}
 	}
 
-	unsigned get_format(int components)
+	inline unsigned get_format(int components)
 	{
 		switch (components)
 		{
@@ -66,7 +66,7 @@ namespace exts::gltf
 		}
 	}
 	
-	unsigned get_type(int bits)
+	inline unsigned get_type(int bits)
 	{
 		switch (bits)
 		{
@@ -82,7 +82,7 @@ namespace exts::gltf
 		}	
 	}
 
-	int get_attribute_type(const std::string& name)
+	inline int get_attribute_type(const std::string& name)
 	{
 		if (name.compare("POSITION") == 0)
 			return 0;
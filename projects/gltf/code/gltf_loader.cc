@@ -1,5 +1,7 @@
 #include "gltf_loader.h"
 #include "gltf_exts.h"
+#include "core/jobs.h"
+#include "core/hash.h"
 
 #define TINYGLTF_IMPLEMENTATION
 
@@ -18,7 +20,10 @@
 #include <sstream>
 #include <GL/glew.h>
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
@@ -29,7 +34,12 @@ namespace efiilj
 {
 
 	gltf_model_server::gltf_model_server()
+		: _budget_ms(2.0f)
 	{
+		add_columns({
+			&_data.uri, &_data.import, &_data.scene, &_data.binary, &_data.open
+		});
+
 		printf("Init gltf...\n");
 	}
 
@@ -42,7 +52,7 @@ namespace efiilj
 	void gltf_model_server::append_defaults(model_id)
 	{
 		_data.uri.emplace_back();
-		_data.model.emplace_back();
+		_data.import.emplace_back();
 		_data.scene.emplace_back();
 		_data.open.emplace_back(false);
 		_data.binary.emplace_back(false);
@@ -50,6 +60,7 @@ namespace efiilj
 	
 	void gltf_model_server::on_register(std::shared_ptr<manager_host> host)
 	{
+		_host = host;
 		_entities = host->get_manager_from_fcc<entity_manager>('ENTS');
 
 		_meshes = host->get_manager_from_fcc<mesh_server>('MESR');
@@ -65,64 +76,170 @@ namespace efiilj
 
 	bool gltf_model_server::load(model_id idx)
 	{
-		tinygltf::TinyGLTF loader;
-		std::string err;
-		std::string warn;
-
-		bool ret;
-		
-		if (_data.binary[idx])
-			ret = loader.LoadBinaryFromFile(&_data.model[idx], &err, &warn, _data.uri[idx]); 
-		else
-			ret = loader.LoadASCIIFromFile(&_data.model[idx], &err, &warn, _data.uri[idx]); 
+		auto imp = std::make_shared<gltf_import>();
+		imp->future = imp->promise.get_future().share();
 
-		if (!warn.empty()) {
-			printf("Warn: %s\n", warn.c_str());
-		}
+		_data.import[idx] = imp;
 
-		if (!err.empty()) {
-			printf("Err: %s\n", err.c_str());
+		imp->state = gltf_load_state::parsing;
+
+		if (!stage_gltf(_data.uri[idx], _data.binary[idx], imp->package))
+		{
+			imp->state = gltf_load_state::failed;
+			imp->promise.set_value(false);
+			return (_data.open[idx] = false);
 		}
 
-		return (_data.open[idx] = ret);
-	
+		imp->state = gltf_load_state::staged;
+		return (_data.open[idx] = true);
+	}
+
+	std::shared_future<bool> gltf_model_server::load_async(model_id idx)
+	{
+		auto imp = std::make_shared<gltf_import>();
+		imp->future = imp->promise.get_future().share();
+		imp->state = gltf_load_state::parsing;
+
+		_data.import[idx] = imp;
+
+		// Copy the arguments, the data columns may be reallocated while the job runs
+		std::filesystem::path uri = _data.uri[idx];
+		bool binary = _data.binary[idx];
+
+		core::job_system::get().submit([imp, uri, binary]()
+				{
+					if (stage_gltf(uri, binary, imp->package))
+					{
+						imp->state.store(gltf_load_state::staged, std::memory_order_release);
+					}
+					else
+					{
+						imp->state.store(gltf_load_state::failed, std::memory_order_release);
+						imp->promise.set_value(false);
+					}
+				}, nullptr, core::job_queue::background);
+
+		return imp->future;
 	}
 
 	bool gltf_model_server::unload(model_id idx)
 	{
-		if (!_data.open[idx])
-			return true;
+		if (!is_valid(idx))
+			return false;
 
-		return false;
+		auto& imp = _data.import[idx];
+
+		// Half registered resources are only held by the import cursors, so they are left to finish first
+		if (imp && imp->state.load(std::memory_order_acquire) == gltf_load_state::registering)
+			return false;
+
+		gltf_scene& scene = _data.scene[idx];
+
+		_host->remove_entities(scene.nodes);
+		_entities->destroy_many(scene.nodes);
+
+		for (mesh_id mid : scene.meshes)
+			_meshes->remove_ref(mid);
+
+		for (material_id mat_id : scene.materials)
+			_materials->remove_ref(mat_id);
+
+		for (texture_id tex_id : scene.textures)
+			_textures->remove_ref(tex_id);
+
+		scene = gltf_scene();
+		imp.reset();
+		_data.open[idx] = false;
+
+		return true;
+	}
+
+	bool gltf_model_server::destroy(model_id idx)
+	{
+		if (!unload(idx))
+			return false;
+
+		return server::destroy(idx);
 	}
 
-	size_t gltf_model_server::calculate_vbo_size(const tinygltf::Model& model, const tinygltf::Primitive& prim)
+	void gltf_model_server::on_begin_frame()
 	{
-		size_t vbo_size = 0;
-		for (auto &attrib : prim.attributes)
+		using clock = std::chrono::steady_clock;
+
+		const auto deadline = clock::now() + std::chrono::duration<float, std::milli>(_budget_ms);
+
+		for (model_id idx : _pool)
 		{
-			tinygltf::Accessor accessor = model.accessors[attrib.second];
-			tinygltf::BufferView view = model.bufferViews[accessor.bufferView];
-			vbo_size += accessor.count * accessor.ByteStride(view); 
+			if (!is_valid(idx) || !_data.import[idx])
+				continue;
+
+			gltf_import& imp = *_data.import[idx];
+			gltf_load_state state = imp.state.load(std::memory_order_acquire);
+
+			if (state == gltf_load_state::staged)
+			{
+				_data.open[idx] = true;
+				imp.state = state = gltf_load_state::registering;
+			}
+
+			if (state != gltf_load_state::registering)
+				continue;
+
+			// Always make some progress, even if an earlier import used up the budget
+			do
+			{
+				if (!register_step(idx, imp))
+				{
+					finish_import(idx, imp);
+					break;
+				}
+			}
+			while (clock::now() < deadline);
+
+			if (clock::now() >= deadline)
+				break;
 		}
+	}
+
+	gltf_load_state gltf_model_server::get_state(model_id idx) const
+	{
+		if (!is_valid(idx) || !_data.import[idx])
+			return gltf_load_state::empty;
 
-		return vbo_size;
+		return _data.import[idx]->state.load(std::memory_order_acquire);
 	}
 
-	accessor_data gltf_model_server::calculate_accessor_data(
-			const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+	float gltf_model_server::get_progress(model_id idx) const
 	{
-		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buf = model.buffers[view.buffer];
+		switch (get_state(idx))
+		{
+			case gltf_load_state::done:
+				return 1.0f;
 
-		const unsigned char* data_start = &buf.data.at(0);
+			case gltf_load_state::registering:
+			{
+				const gltf_import& imp = *_data.import[idx];
+				const gltf_package& pkg = imp.package;
 
-		size_t stride = accessor.ByteStride(view);
-		size_t block_size = stride * accessor.count;
-		size_t offset = view.byteOffset + accessor.byteOffset;
-		size_t size = (accessor.type == TINYGLTF_TYPE_SCALAR) ? 1 : accessor.type;
+				size_t total = pkg.textures.size() + pkg.materials.size() + pkg.primitive_count + pkg.nodes.size();
 
-		return accessor_data { data_start, stride, block_size, offset, size };
+				return 0.5f + 0.5f * (total > 0 ? std::min(1.0f, static_cast<float>(imp.steps_done) / total) : 1.0f);
+			}
+
+			case gltf_load_state::staged:
+				return 0.5f;
+
+			default:
+				return 0.0f;
+		}
+	}
+
+	std::shared_future<bool> gltf_model_server::get_future(model_id idx) const
+	{
+		if (!is_valid(idx) || !_data.import[idx])
+			return std::shared_future<bool>();
+
+		return _data.import[idx]->future;
 	}
 
 	matrix4 gltf_model_server::convert_matrix(const std::vector<double>& m)
@@ -138,157 +255,219 @@ namespace efiilj
 		return mat;
 	}
 
-	void gltf_model_server::get_primitive(entity_id eid, model_id idx, const tinygltf::Primitive& prim)
+	bool gltf_model_server::register_step(model_id idx, gltf_import& imp)
 	{
+		gltf_package& pkg = imp.package;
+
+		if (imp.next_texture < pkg.textures.size())
+			register_texture(idx, imp);
+		else if (imp.next_material < pkg.materials.size())
+			register_material(idx, imp);
+		else if (imp.next_mesh < pkg.meshes.size())
+			register_primitive(idx, imp);
+		else if (imp.next_node < pkg.nodes.size())
+			register_node(idx, imp);
+		else
+			return false;
 
-		vector3 pos_min;
-		vector3 pos_max;
+		imp.steps_done++;
+		return true;
+	}
 
-		const tinygltf::Model& model = _data.model[idx];
+	void gltf_model_server::finish_import(model_id idx, gltf_import& imp)
+	{
+		const mesh_opt_report opt = imp.package.optimization;
 
-		mesh_id mid = _meshes->create();
-	
-		size_t block_offset = 0;
-		for (auto &attrib : prim.attributes)
-		{
+		// Free the staging memory, everything now lives in the servers
+		imp.package = gltf_package();
+		imp.state = gltf_load_state::done;
+		imp.promise.set_value(true);
 
-			tinygltf::Accessor accessor = model.accessors[attrib.second];
-			accessor_data data = calculate_accessor_data(model, accessor);
-			int vaa = gltfe::get_attribute_type(attrib.first);
+		printf("GLTF import finished: %s, %lu nodes\n", _data.uri[idx].c_str(), _data.scene[idx].nodes.size());
 
-			switch (vaa)
-			{
-				case 0:
-				{
-					auto& max = accessor.maxValues;
-					auto& min = accessor.minValues;
+		printf("Optimised meshes: %lu -> %lu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+				opt.vertices_before, opt.vertices_after,
+				opt.before.acmr(), opt.after.acmr(), opt.before.atvr(), opt.after.atvr());
 
-					if (max.size() >= 3 && min.size() >= 3)
-					{
-						pos_max = vector3(
-								static_cast<float>(max[0]), 
-								static_cast<float>(max[1]), 
-								static_cast<float>(max[2]));
+		printf("Shared resources: %lu mesh, %lu texture, %lu material hits, %.2f MB saved\n",
+				_meshes->get_shared_hits(), _textures->get_shared_hits(), _materials->get_shared_hits(),
+				(_meshes->get_saved_bytes() + _textures->get_saved_bytes() + _materials->get_saved_bytes()) / (1024.0f * 1024.0f));
+	}
 
-						pos_min = vector3(
-								static_cast<float>(min[0]), 
-								static_cast<float>(min[1]), 
-								static_cast<float>(min[2]));
+	void gltf_model_server::register_texture(model_id idx, gltf_import& imp)
+	{
+		const int image = static_cast<int>(imp.next_texture);
+		gltf_staged_texture& src = imp.package.textures[imp.next_texture++];
 
-					}
+		auto& usages = imp.textures.emplace_back();
+		usages.fill(-1);
 
-					assert(accessor.type == 3);
+		if (src.pixels.empty())
+			return;
 
-					std::vector<vector3> positions(accessor.count);
-					memcpy(positions.data(), data.data_start + data.offset, data.block_size);
+		// The usage picks the block format and the material slot, so an image sampled as several is cooked for each
+		unsigned mask = 0;
 
-					_meshes->set_positions(mid, positions);
+		for (const auto& mat : imp.package.materials)
+		{
+			const std::pair<int, texture_type> links[] =
+			{
+				{ mat.base_texture, texture_type::tex_base },
+				{ mat.normal_texture, texture_type::tex_normal },
+				{ mat.orm_texture, texture_type::tex_orm },
+				{ mat.emissive_texture, texture_type::tex_emissive }
+			};
 
-					break;
-				}	
+			for (const auto& link : links)
+			{
+				if (link.first == image)
+					mask |= 1u << static_cast<unsigned>(link.second);
+			}
+		}
 
-				case 1:
-				{
-					assert(accessor.type == 3);
+		if (mask == 0)
+			mask = 1u << static_cast<unsigned>(texture_type::tex_default);
 
-					std::vector<vector3> normals(accessor.count);
-					memcpy(normals.data(), data.data_start + data.offset, data.block_size);
+		for (unsigned usage = 0; usage < texture_type_count; usage++)
+		{
+			if (!(mask & (1u << usage)))
+				continue;
 
-					_meshes->set_normals(mid, normals);
-					break;
-				}
+			mask &= ~(1u << usage);
+			usages[usage] = register_usage(idx, src, static_cast<texture_type>(usage), mask == 0);
+		}
 
-				case 2:
-				{
-					assert(accessor.type == 2);
+		std::vector<unsigned char>().swap(src.pixels);
+	}
 
-					std::vector<vector2> uvs(accessor.count);
-					memcpy(uvs.data(), data.data_start + data.offset, data.block_size);
+	texture_id gltf_model_server::register_usage(model_id idx, gltf_staged_texture& src, texture_type usage, bool last)
+	{
+		// Images already loaded, by this or another model, are shared if they were cooked for the same usage
+		const uint64_t hash = core::fnv1a(&usage, sizeof(usage), src.hash);
+		texture_id tex_id = _textures->find_shared(hash);
 
-					_meshes->set_uvs(mid, uvs);
-					break;
-				}
+		if (tex_id >= 0)
+		{
+			_data.scene[idx].textures.emplace_back(tex_id);
+			return tex_id;
+		}
 
-				case 3:
-				{
-					assert(accessor.type == 4);
+		const size_t bytes = src.pixels.size();
 
-					std::vector<vector4> tangents(accessor.count);
-					memcpy(tangents.data(), data.data_start + data.offset, data.block_size);
+		tex_id = _textures->create();
 
-					_meshes->set_tangents(mid, tangents);
-					break;
-				}
+		_textures->set_format(tex_id, src.format);
+		_textures->set_type(tex_id, src.type);
+		_textures->set_name(tex_id, src.name);
+		_textures->set_usage(tex_id, usage);
+		_textures->set_shared(tex_id, hash, bytes);
 
-				default:
-					printf("GLTF format not supported: %s\n",  attrib.first.c_str());
-					break;
+		// 8-bit images are cooked on a worker and stream in; anything wider is buffered directly.
+		// The last usage takes the staged pixels, any before it stream a copy
+		if (src.type == GL_UNSIGNED_BYTE)
+		{
+			std::vector<unsigned char> pixels = last ? std::move(src.pixels) : src.pixels;
+			_textures->stream(tex_id, src.width, src.height, std::move(pixels), src.uri);
+		}
+		else
+		{
+			_textures->generate(tex_id);
+			_textures->bind(tex_id);
+			_textures->buffer(tex_id, src.width, src.height, src.pixels.data());
+			_textures->unbind();
+		}
 
-			}
+		_data.scene[idx].textures.emplace_back(tex_id);
 
-			block_offset += data.block_size;
-		}
+		return tex_id;
+	}
 
-		tinygltf::Accessor index_accessor = model.accessors[prim.indices];
-		accessor_data index_data = calculate_accessor_data(model, index_accessor);
+	void gltf_model_server::link_texture(gltf_import& imp, material_id mat_id, int tex_index, const texture_type& usage)
+	{
+		if (tex_index < 0 || !_materials->is_valid(mat_id))
+			return;
 
-		unsigned short* temp = new unsigned short[index_accessor.count];
-		memcpy(temp, index_data.data_start + index_data.offset, index_data.block_size);
+		texture_id tex_id = imp.textures[tex_index][static_cast<size_t>(usage)];
 
-		std::vector<unsigned> indices(index_accessor.count);
+		if (!_textures->is_valid(tex_id))
+			return;
 
-		for (size_t i = 0; i < index_accessor.count; i++)
-			indices[i] = static_cast<unsigned>(temp[i]);	
+		_materials->add_texture(mat_id, tex_id);
+	}
 
-		_meshes->set_indices(mid, indices);
-		delete[] temp;
+	void gltf_model_server::register_material(model_id idx, gltf_import& imp)
+	{
+		const gltf_staged_material& mat = imp.package.materials[imp.next_material++];
 
-		_meshes->set_bounds(mid, pos_min, pos_max);
+		material_id mat_id = _materials->create();
 
-		mesh_instance_id miid = _mesh_instances->register_entity(eid);
-		_mesh_instances->set_mesh(miid, mid);
+		link_texture(imp, mat_id, mat.base_texture, texture_type::tex_base);
+		link_texture(imp, mat_id, mat.orm_texture, texture_type::tex_orm);
+		link_texture(imp, mat_id, mat.normal_texture, texture_type::tex_normal);
+		link_texture(imp, mat_id, mat.emissive_texture, texture_type::tex_emissive);
 
-		if (prim.material > -1)
-		{
-			const tinygltf::Material& mat = model.materials[prim.material];
-			material_id mat_id = get_material(idx, mat);
-			
-			material_instance_id mat_iid = _material_instances->register_entity(eid);
-			_material_instances->set_material(mat_iid, mat_id);
-			_mesh_instances->set_material(miid, mat_id);
-		}
+		_materials->set_base_color(mat_id, mat.base_color);
+		_materials->set_emissive_factor(mat_id, mat.emissive_factor);
+		_materials->set_metallic_factor(mat_id, mat.metallic_factor);
+		_materials->set_roughness_factor(mat_id, mat.roughness_factor);
+		_materials->set_double_sided(mat_id, mat.double_sided);
+		// Opaque materials ignore alpha, and get a permutation without the cutoff test
+		_materials->set_alpha_cutoff(mat_id, mat.alpha_test ? mat.alpha_cutoff : 0.0f);
 
-		_meshes->build(mid, GL_STATIC_DRAW);
-		_data.scene[idx].meshes.emplace_back(mid);
+		// Identical materials, such as those of repeated models, collapse into one
+		mat_id = _materials->deduplicate(mat_id);
 
+		imp.materials.push_back(mat_id);
+		_data.scene[idx].materials.emplace_back(mat_id);
 	}
 
-
-	void gltf_model_server::get_mesh(entity_id eid, model_id idx, const tinygltf::Mesh& mesh)
+	void gltf_model_server::register_primitive(model_id idx, gltf_import& imp)
 	{
-		for (const auto& prim : mesh.primitives)
+		auto& prims = imp.package.meshes[imp.next_mesh];
+
+		if (imp.meshes.size() <= imp.next_mesh)
+			imp.meshes.emplace_back();
+
+		if (imp.next_primitive < prims.size())
 		{
-			get_primitive(eid, idx, prim);
-		}
-	}
+			gltf_staged_primitive& prim = prims[imp.next_primitive++];
 
-	void gltf_model_server::get_camera(entity_id eid, model_id idx, const tinygltf::Camera& cam)
-	{
-		camera_id cam_id = _cameras->register_entity(eid);
+			mesh_id mid = _meshes->find_shared(prim.hash);
 
-		// TODO: find transform
-		
-		_cameras->set_fov(cam_id, static_cast<float>(cam.perspective.yfov));
-		_cameras->set_near(cam_id, static_cast<float>(cam.perspective.znear));
-		_cameras->set_far(cam_id, static_cast<float>(cam.perspective.zfar));
+			if (mid < 0)
+			{
+				mid = _meshes->create();
+
+				// Staged streams are moved, not copied, into the mesh server
+				_meshes->set_positions(mid, prim.positions);
+				_meshes->set_normals(mid, prim.normals);
+				_meshes->set_uvs(mid, prim.uvs);
+				_meshes->set_tangents(mid, prim.tangents);
+				_meshes->set_indices(mid, prim.indices);
+				_meshes->set_bounds(mid, prim.min, prim.max);
+				_meshes->set_optimized(mid, prim.optimized);
+
+				if (prim.lods_ready)
+					_meshes->set_lods(mid, prim.lods);
+
+				_meshes->build(mid, GL_STATIC_DRAW);
+				_meshes->set_shared(mid, prim.hash, _meshes->get_data_bytes(mid));
+			}
 
-		_data.scene[idx].cameras.emplace_back(cam_id);
+			imp.meshes[imp.next_mesh].push_back(mid);
+			_data.scene[idx].meshes.emplace_back(mid);
+		}
+
+		if (imp.next_primitive >= prims.size())
+		{
+			imp.next_mesh++;
+			imp.next_primitive = 0;
+		}
 	}
 
-	void gltf_model_server::get_node(model_id idx, transform_id parent, const tinygltf::Node& node)
+	void gltf_model_server::register_node(model_id idx, gltf_import& imp)
 	{
-
-		const tinygltf::Model& model = _data.model[idx];
+		const gltf_staged_node& node = imp.package.nodes[imp.next_node++];
 
 		entity_id new_eid = _entities->create();
 
@@ -302,127 +481,72 @@ namespace efiilj
 		_metadata->set_description(met_id, ss.str());
 
 		transform_id trf_id = _transforms->register_entity(new_eid);
+		imp.transforms.push_back(trf_id);
 
-		if (parent != -1)
-			_transforms->set_parent(trf_id, parent);
+		if (node.parent != -1)
+			_transforms->set_parent(trf_id, imp.transforms[node.parent]);
 
-		if (node.translation.size() == 3)
-		{
-			_transforms->set_position(trf_id, vector3(
-						static_cast<float>(node.translation[0]),
-						static_cast<float>(node.translation[1]),
-						static_cast<float>(node.translation[2])));
-		}
+		if (node.has_position)
+			_transforms->set_position(trf_id, node.position);
 
-		if (node.rotation.size() == 3)
-		{
-			_transforms->set_scale(trf_id, vector3(
-						static_cast<float>(node.scale[0]),
-						static_cast<float>(node.scale[1]),
-						static_cast<float>(node.scale[2])));
-		}
+		if (node.has_scale)
+			_transforms->set_scale(trf_id, node.scale);
 
-		// TODO: rotation
-		
 		if (node.camera > -1)
 		{
-			get_camera(new_eid, idx, model.cameras[node.camera]);
-		}
+			const gltf_staged_camera& cam = imp.package.cameras[node.camera];
 
-		if (node.mesh > -1)
-		{
-			get_mesh(new_eid, idx, model.meshes[node.mesh]);
-		}
+			camera_id cam_id = _cameras->register_entity(new_eid);
 
-		for (size_t i = 0; i < node.children.size(); i++) 
-		{
-			get_node(idx, trf_id, model.nodes[node.children[i]]);
-		}
-	}
-
-	bool gltf_model_server::get_nodes(model_id idx)
-	{
+			// TODO: find transform
 
-		if (!is_valid(idx) || !_data.open[idx])
-			return false;
-
-		const tinygltf::Model& model = _data.model[idx];
-		const tinygltf::Scene& scene = _data.model[idx].scenes[model.defaultScene];
-
-		printf("Parsing GLTF file, %lu nodes in default scene %d\n", scene.nodes.size(), model.defaultScene);
+			_cameras->set_fov(cam_id, cam.fov);
+			_cameras->set_near(cam_id, cam.near);
+			_cameras->set_far(cam_id, cam.far);
 
-		for (size_t i = 0; i < scene.nodes.size(); i++)
-		{
-			const tinygltf::Node& node = model.nodes[scene.nodes[i]];
-			get_node(idx, -1, node);
+			_data.scene[idx].cameras.emplace_back(cam_id);
 		}
 
-		return 0;
-	}
-
-	void gltf_model_server::link_texture(model_id idx, material_id mat_id, int tex_index, const texture_type& type)
-	{
-		if (tex_index > -1 && _materials->is_valid(mat_id))
+		if (node.mesh > -1)
 		{
+			const auto& prims = imp.package.meshes[node.mesh];
+			const auto& mids = imp.meshes[node.mesh];
 
-			const tinygltf::Model& model = _data.model[idx];
-			tinygltf::Texture tex_base = model.textures[tex_index];
-			tinygltf::Image src = model.images[tex_base.source];
-			
-			unsigned tex_format = gltfe::get_format(src.component);
-			unsigned tex_type = gltfe::get_type(src.bits);
-
-			texture_id tex_id = _textures->create();
+			for (size_t i = 0; i < mids.size(); i++)
+			{
+				mesh_instance_id miid = _mesh_instances->register_entity(new_eid);
+				_mesh_instances->set_mesh(miid, mids[i]);
 
-			_textures->generate(tex_id);
-			_textures->bind(tex_id);
-			_textures->set_format(tex_id, tex_format);
-			_textures->set_type(tex_id, tex_type);
-			_textures->set_usage(tex_id, type);
-			_textures->set_name(tex_id, tex_base.name);
-			_textures->buffer(tex_id, src.width, src.height, &src.image.at(0));
-			_textures->unbind();
+				if (prims[i].material > -1)
+				{
+					material_id mat_id = imp.materials[prims[i].material];
 
-			_materials->add_texture(mat_id, tex_id);
+					material_instance_id mat_iid = _material_instances->register_entity(new_eid);
+					_material_instances->set_material(mat_iid, mat_id);
+					_mesh_instances->set_material(miid, mat_id);
+				}
+			}
 		}
 	}
 
-	material_id gltf_model_server::get_material(model_id idx, const tinygltf::Material& mat)
+	bool gltf_model_server::get_nodes(model_id idx)
 	{
-		material_id mat_id = _materials->create();
-
-		link_texture(idx, mat_id, mat.pbrMetallicRoughness.baseColorTexture.index, texture_type::tex_base);
-		link_texture(idx, mat_id, mat.pbrMetallicRoughness.metallicRoughnessTexture.index, texture_type::tex_orm);
-		link_texture(idx, mat_id, mat.normalTexture.index, texture_type::tex_normal);
-		link_texture(idx, mat_id, mat.emissiveTexture.index, texture_type::tex_emissive);
-
-		auto& emit = mat.emissiveFactor;
-		auto& base = mat.pbrMetallicRoughness.baseColorFactor;
+		if (!is_valid(idx) || !_data.open[idx] || !_data.import[idx])
+			return false;
 
-		_materials->set_base_color(mat_id, vector4(
-					static_cast<float>(base[0]), 
-					static_cast<float>(base[1]), 
-					static_cast<float>(base[2]), 
-					static_cast<float>(base[3]))); 
+		gltf_import& imp = *_data.import[idx];
 
-		_materials->set_emissive_factor(mat_id, vector3(
-					static_cast<float>(emit[0]), 
-					static_cast<float>(emit[1]), 
-					static_cast<float>(emit[2])));
+		if (imp.state.load(std::memory_order_acquire) != gltf_load_state::staged)
+			return false;
 
-		_materials->set_metallic_factor(mat_id, 
-			static_cast<float>( mat.pbrMetallicRoughness.metallicFactor));
+		printf("Parsing GLTF file, %lu nodes in default scene\n", imp.package.nodes.size());
 
-		_materials->set_roughness_factor(mat_id, 
-			static_cast<float>( mat.pbrMetallicRoughness.roughnessFactor));
+		imp.state = gltf_load_state::registering;
 
-		_materials->set_double_sided(mat_id, mat.doubleSided);
+		while (register_step(idx, imp));
 
-		_materials->set_alpha_cutoff(mat_id, static_cast<float>(mat.alphaCutoff));
+		finish_import(idx, imp);
 
-		_data.scene[idx].materials.emplace_back(mat_id);
-
-		return mat_id;
+		return true;
 	}
 }
-
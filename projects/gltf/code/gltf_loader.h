@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tiny_gltf.h"
+#include "gltf_stage.h"
 
 #include "server.h"
 #include "mgr_host.h"
@@ -16,45 +17,77 @@
 #include "mtrl_srv.h"
 #include "mesh_srv.h"
 
+#include <array>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <future>
 
 namespace efiilj 
 {
 
 	typedef int model_id;
 
-	struct accessor_data
-	{
-		const unsigned char* data_start;
-
-		size_t stride;
-		size_t block_size;
-		size_t offset;
-		size_t size;
-	};
-
+	/**
+	 * \brief Everything a model registered. The model holds one reference on each mesh, material and texture,
+	 * whether it created them or found them shared, and drops them when it is unloaded.
+	 */
 	struct gltf_scene
 	{
 		std::vector<entity_id> nodes;
 		std::vector<mesh_id> meshes;
 		std::vector<material_id> materials;
+		std::vector<texture_id> textures;
 		std::vector<camera_id> cameras;
 	};
 
+	enum class gltf_load_state
+	{
+		empty,
+		parsing,
+		staged,
+		registering,
+		done,
+		failed
+	};
+
+	/**
+	 * \brief In-flight import of a model -- staged on a worker, then registered on the main thread
+	 * a few resources at a time.
+	 */
+	struct gltf_import
+	{
+		std::atomic<gltf_load_state> state { gltf_load_state::empty };
+		gltf_package package;
+
+		// Main thread registration cursors
+		size_t next_texture = 0, next_material = 0, next_mesh = 0, next_primitive = 0, next_node = 0;
+		size_t steps_done = 0;
+
+		// One texture per image and usage, as the usage picks both the block format and the material slot
+		std::vector<std::array<texture_id, texture_type_count>> textures;
+		std::vector<material_id> materials;
+		std::vector<std::vector<mesh_id>> meshes;
+		std::vector<transform_id> transforms;
+
+		std::promise<bool> promise;
+		std::shared_future<bool> future;
+	};
+
 	class gltf_model_server : public server<model_id>
 	{
 	private:
 		
 		struct ModelData
 		{
-			std::vector<std::filesystem::path> uri;	
-			std::vector<tinygltf::Model> model;
-			std::vector<gltf_scene> scene;
-			std::vector<bool> binary;
-			std::vector<bool> open;
+			slot_vector<std::filesystem::path> uri;	
+			slot_vector<std::shared_ptr<gltf_import>> import;
+			slot_vector<gltf_scene> scene;
+			slot_vector<bool> binary;
+			slot_vector<bool> open;
 		} _data;
 
+		std::shared_ptr<manager_host> _host;
 		std::shared_ptr<entity_manager> _entities;
 
 		std::shared_ptr<mesh_server> _meshes;
@@ -67,16 +100,19 @@ namespace efiilj
 		std::shared_ptr<camera_manager> _cameras;
 		std::shared_ptr<meta_manager> _metadata;
 
-		size_t calculate_vbo_size(const tinygltf::Model& model, const tinygltf::Primitive& prim);
-		accessor_data calculate_accessor_data(const tinygltf::Model& model, const tinygltf::Accessor& acc);
+		float _budget_ms;
+
 		matrix4 convert_matrix(const std::vector<double>& m);
 
-		void get_primitive(entity_id eid, model_id idx, const tinygltf::Primitive& prim);
-		void get_camera(entity_id eid, model_id idx, const tinygltf::Camera& cam);
-		void get_mesh(entity_id eid, model_id idx, const tinygltf::Mesh& mesh);
-		void get_node(model_id idx, transform_id parent, const tinygltf::Node&);
-		void link_texture(model_id idx, material_id mat_id, int tex_index, const texture_type& usage);
-		material_id get_material(model_id idx, const tinygltf::Material& mat);
+		void register_texture(model_id idx, gltf_import& imp);
+		texture_id register_usage(model_id idx, gltf_staged_texture& src, texture_type usage, bool last);
+		void register_material(model_id idx, gltf_import& imp);
+		void register_primitive(model_id idx, gltf_import& imp);
+		void register_node(model_id idx, gltf_import& imp);
+		void link_texture(gltf_import& imp, material_id mat_id, int tex_index, const texture_type& usage);
+
+		bool register_step(model_id idx, gltf_import& imp);
+		void finish_import(model_id idx, gltf_import& imp);
 
 	public:
 
@@ -85,14 +121,53 @@ namespace efiilj
 
 		void append_defaults(model_id) override;
 		void on_register(std::shared_ptr<manager_host> host) override;
+		void on_begin_frame() override;
 
+		/**
+		 * \brief Parses and stages the model synchronously, on the calling thread.
+		 */
 		bool load(model_id idx);
+
+		/**
+		 * \brief Parses and stages the model on the job system. Resources and entities are then
+		 * registered during on_begin_frame, within the per-frame time budget.
+		 * \return Future resolving to true once the scene is fully registered, or false on failure
+		 */
+		std::shared_future<bool> load_async(model_id idx);
+
+		/**
+		 * \brief Removes the entities of the model, and drops its references on meshes, materials and textures,
+		 * destroying those no other model or loader holds. Imports still registering cannot be unloaded.
+		 * \return True if nothing of the model is left
+		 */
 		bool unload(model_id idx);
 
+		bool destroy(model_id idx) override;
+
+		/**
+		 * \brief Registers everything staged by load() at once, ignoring the time budget.
+		 */
 		bool get_nodes(model_id idx);
 		bool get_cameras(model_id idx, entity_id eid);
 		bool get_lights(model_id idx, entity_id eid);
 
+		gltf_load_state get_state(model_id idx) const;
+
+		/**
+		 * \brief Returns import progress between 0 and 1; staging counts as the first half.
+		 */
+		float get_progress(model_id idx) const;
+
+		std::shared_future<bool> get_future(model_id idx) const;
+
+		/**
+		 * \brief Sets the main thread time spent registering async imports each frame.
+		 */
+		void set_budget(float ms)
+		{
+			_budget_ms = ms;
+		}
+
 		const gltf_scene& get_scene(model_id idx) const
 		{
 			return _data.scene[idx];
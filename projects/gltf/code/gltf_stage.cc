@@ -0,0 +1,530 @@
+#include "gltf_stage.h"
+#include "gltf_exts.h"
+#include "core/jobs.h"
+#include "core/hash.h"
+
+#include "tiny_gltf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace gltfe = exts::gltf;
+
+namespace efiilj
+{
+	// Keeps the encoded bytes, so images can be decoded in parallel once parsing is done
+	static bool defer_image(tinygltf::Image* image, const int, std::string*, std::string*,
+			int, int, const unsigned char* bytes, int size, void*)
+	{
+		image->image.assign(bytes, bytes + size);
+		image->width = -1;
+		image->height = -1;
+
+		return true;
+	}
+
+	/**
+	 * \brief Strided window into a tinygltf buffer -- elements are read in place, never copied out first.
+	 */
+	struct accessor_view
+	{
+		const unsigned char* data = nullptr;
+		size_t stride = 0;
+		size_t count = 0;
+		int component_type = 0;
+
+		const unsigned char* at(size_t i) const { return data + i * stride; }
+	};
+
+	static accessor_view get_view(const tinygltf::Model& model, int buffer_view, size_t offset, size_t count, 
+			int component_type, size_t element_size)
+	{
+		accessor_view view;
+
+		const tinygltf::BufferView& bv = model.bufferViews[buffer_view];
+
+		view.data = model.buffers[bv.buffer].data.data() + bv.byteOffset + offset;
+		view.stride = bv.byteStride ? bv.byteStride : element_size;
+		view.count = count;
+		view.component_type = component_type;
+
+		return view;
+	}
+
+	static float read_component(const unsigned char* src, int type, bool normalized)
+	{
+		switch (type)
+		{
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+			{
+				float v;
+				memcpy(&v, src, sizeof(v));
+				return v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			{
+				uint8_t v = *src;
+				return normalized ? v / 255.0f : v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+			{
+				int8_t v = static_cast<int8_t>(*src);
+				return normalized ? std::max(v / 127.0f, -1.0f) : v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			{
+				uint16_t v;
+				memcpy(&v, src, sizeof(v));
+				return normalized ? v / 65535.0f : v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+			{
+				int16_t v;
+				memcpy(&v, src, sizeof(v));
+				return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			{
+				uint32_t v;
+				memcpy(&v, src, sizeof(v));
+				return static_cast<float>(v);
+			}
+
+			default:
+				return 0.0f;
+		}
+	}
+
+	static unsigned read_index(const unsigned char* src, int type)
+	{
+		switch (type)
+		{
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				return *src;
+
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			{
+				uint16_t v;
+				memcpy(&v, src, sizeof(v));
+				return v;
+			}
+
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			{
+				uint32_t v;
+				memcpy(&v, src, sizeof(v));
+				return v;
+			}
+
+			default:
+				return 0;
+		}
+	}
+
+	/**
+	 * \brief Reads a float vector accessor of N components into out, converting integer and normalized
+	 * component types and applying sparse substitution.
+	 */
+	template<typename T, int N>
+	static void read_vectors(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<T>& out)
+	{
+		const int components = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+		const int size = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+
+		if (components != N || size <= 0)
+		{
+			printf("GLTF accessor type mismatch, expected %d components, got %d\n", N, components);
+			return;
+		}
+
+		auto read_element = [&accessor, size](const unsigned char* src, T& dst)
+		{
+			for (int c = 0; c < N; c++)
+				dst[c] = read_component(src + c * size, accessor.componentType, accessor.normalized);
+		};
+
+		// Sparse accessors without a buffer view start out zeroed
+		out.assign(accessor.count, T());
+
+		if (accessor.bufferView > -1)
+		{
+			accessor_view view = get_view(model, accessor.bufferView, accessor.byteOffset, 
+					accessor.count, accessor.componentType, N * size);
+
+			// Tightly packed floats need no conversion, only copying into the vector types,
+			// which are not trivially copyable so can't take the whole block in one memcpy
+			if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && view.stride == N * sizeof(float))
+			{
+				for (size_t i = 0; i < view.count; i++)
+				{
+					float element[N];
+					memcpy(element, view.at(i), sizeof(element));
+
+					for (int c = 0; c < N; c++)
+						out[i][c] = element[c];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < view.count; i++)
+					read_element(view.at(i), out[i]);
+			}
+		}
+
+		if (accessor.sparse.isSparse)
+		{
+			const auto& sparse = accessor.sparse;
+			const int index_size = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(sparse.indices.componentType));
+
+			accessor_view indices = get_view(model, sparse.indices.bufferView, sparse.indices.byteOffset, 
+					sparse.count, sparse.indices.componentType, index_size);
+
+			accessor_view values = get_view(model, sparse.values.bufferView, sparse.values.byteOffset,
+					sparse.count, accessor.componentType, N * size);
+
+			// Sparse views are always tightly packed
+			indices.stride = index_size;
+			values.stride = N * size;
+
+			for (size_t i = 0; i < indices.count; i++)
+			{
+				unsigned target = read_index(indices.at(i), indices.component_type);
+
+				if (target < out.size())
+					read_element(values.at(i), out[target]);
+			}
+		}
+	}
+
+	static void read_indices(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<unsigned>& out)
+	{
+		const int size = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+
+		if (accessor.bufferView < 0 || size <= 0)
+			return;
+
+		accessor_view view = get_view(model, accessor.bufferView, accessor.byteOffset, 
+				accessor.count, accessor.componentType, size);
+
+		out.resize(view.count);
+
+		if (view.component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT && view.stride == sizeof(unsigned))
+		{
+			memcpy(out.data(), view.data, view.count * sizeof(unsigned));
+			return;
+		}
+
+		for (size_t i = 0; i < view.count; i++)
+			out[i] = read_index(view.at(i), view.component_type);
+	}
+
+	template<typename T>
+	static uint64_t hash_stream(const std::vector<T>& data, uint64_t seed)
+	{
+		// The length goes in first, so data moving between streams changes the hash
+		const uint64_t count = data.size();
+
+		seed = core::fnv1a(&count, sizeof(count), seed);
+		return core::fnv1a(data.data(), data.size() * sizeof(T), seed);
+	}
+
+	static void stage_primitive(const tinygltf::Model& model, const tinygltf::Primitive& prim, gltf_staged_primitive& out,
+			mesh_opt_report& report)
+	{
+		for (auto& attrib : prim.attributes)
+		{
+			const tinygltf::Accessor& accessor = model.accessors[attrib.second];
+
+			switch (gltfe::get_attribute_type(attrib.first))
+			{
+				case 0:
+				{
+					auto& max = accessor.maxValues;
+					auto& min = accessor.minValues;
+
+					if (max.size() >= 3 && min.size() >= 3)
+					{
+						out.max = vector3(
+								static_cast<float>(max[0]),
+								static_cast<float>(max[1]),
+								static_cast<float>(max[2]));
+
+						out.min = vector3(
+								static_cast<float>(min[0]),
+								static_cast<float>(min[1]),
+								static_cast<float>(min[2]));
+					}
+
+					read_vectors<vector3, 3>(model, accessor, out.positions);
+					break;
+				}
+
+				case 1:
+					read_vectors<vector3, 3>(model, accessor, out.normals);
+					break;
+
+				case 2:
+					read_vectors<vector2, 2>(model, accessor, out.uvs);
+					break;
+
+				case 3:
+					read_vectors<vector4, 4>(model, accessor, out.tangents);
+					break;
+
+				default:
+					printf("GLTF format not supported: %s\n",  attrib.first.c_str());
+					break;
+			}
+		}
+
+		if (prim.indices > -1)
+		{
+			read_indices(model, model.accessors[prim.indices], out.indices);
+		}
+		else
+		{
+			out.indices.resize(out.positions.size());
+
+			for (size_t i = 0; i < out.indices.size(); i++)
+				out.indices[i] = static_cast<unsigned>(i);
+		}
+
+		out.material = prim.material;
+
+		// Optimised here rather than in mesh_server::build, so the work stays on the staging workers
+		if (prim.mode == TINYGLTF_MODE_TRIANGLES || prim.mode == -1)
+		{
+			std::vector<vector3> colors;
+			mesh_streams streams = { out.positions, out.normals, colors, out.uvs, out.tangents, out.indices };
+
+			report = optimize_mesh(streams);
+			out.optimized = true;
+
+			out.lods = generate_lod_chain(out.positions, out.indices);
+			out.lods_ready = true;
+		}
+
+		uint64_t hash = core::fnv1a_basis;
+
+		hash = hash_stream(out.positions, hash);
+		hash = hash_stream(out.normals, hash);
+		hash = hash_stream(out.uvs, hash);
+		hash = hash_stream(out.tangents, hash);
+		hash = hash_stream(out.indices, hash);
+
+		out.hash = hash;
+	}
+
+	static void stage_material(const tinygltf::Model& model, const tinygltf::Material& mat, gltf_staged_material& out)
+	{
+		auto get_image = [&model](int tex_index)
+		{
+			return tex_index > -1 ? model.textures[tex_index].source : -1;
+		};
+
+		auto& emit = mat.emissiveFactor;
+		auto& base = mat.pbrMetallicRoughness.baseColorFactor;
+
+		out.base_color = vector4(
+				static_cast<float>(base[0]),
+				static_cast<float>(base[1]),
+				static_cast<float>(base[2]),
+				static_cast<float>(base[3]));
+
+		out.emissive_factor = vector3(
+				static_cast<float>(emit[0]),
+				static_cast<float>(emit[1]),
+				static_cast<float>(emit[2]));
+
+		out.metallic_factor = static_cast<float>(mat.pbrMetallicRoughness.metallicFactor);
+		out.roughness_factor = static_cast<float>(mat.pbrMetallicRoughness.roughnessFactor);
+		out.alpha_cutoff = static_cast<float>(mat.alphaCutoff);
+		out.alpha_test = mat.alphaMode != "OPAQUE";
+		out.double_sided = mat.doubleSided;
+
+		out.base_texture = get_image(mat.pbrMetallicRoughness.baseColorTexture.index);
+		out.orm_texture = get_image(mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+		out.normal_texture = get_image(mat.normalTexture.index);
+		out.emissive_texture = get_image(mat.emissiveTexture.index);
+	}
+
+	static void stage_node(const tinygltf::Model& model, int parent, const tinygltf::Node& node, gltf_package& package)
+	{
+		const int slot = static_cast<int>(package.nodes.size());
+
+		gltf_staged_node& out = package.nodes.emplace_back();
+
+		out.name = node.name;
+		out.parent = parent;
+		out.camera = node.camera;
+		out.mesh = node.mesh;
+
+		if (node.translation.size() == 3)
+		{
+			out.has_position = true;
+			out.position = vector3(
+					static_cast<float>(node.translation[0]),
+					static_cast<float>(node.translation[1]),
+					static_cast<float>(node.translation[2]));
+		}
+
+		if (node.scale.size() == 3)
+		{
+			out.has_scale = true;
+			out.scale = vector3(
+					static_cast<float>(node.scale[0]),
+					static_cast<float>(node.scale[1]),
+					static_cast<float>(node.scale[2]));
+		}
+
+		// TODO: rotation
+
+		for (int child : node.children)
+			stage_node(model, slot, model.nodes[child], package);
+	}
+
+	bool stage_gltf(const std::filesystem::path& uri, bool binary, gltf_package& package)
+	{
+		tinygltf::TinyGLTF loader;
+		tinygltf::Model model;
+
+		std::string err;
+		std::string warn;
+
+		loader.SetImageLoader(defer_image, nullptr);
+
+		bool ret = binary
+			? loader.LoadBinaryFromFile(&model, &err, &warn, uri)
+			: loader.LoadASCIIFromFile(&model, &err, &warn, uri);
+
+		if (!warn.empty())
+			printf("Warn: %s\n", warn.c_str());
+
+		if (!err.empty())
+			printf("Err: %s\n", err.c_str());
+
+		if (!ret)
+			return false;
+
+		core::job_system& jobs = core::job_system::get();
+
+		// Decode images
+
+		package.textures.resize(model.images.size());
+
+		jobs.parallel_for(model.images.size(), 1, [&model, &package, &uri](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; i++)
+					{
+						tinygltf::Image& image = model.images[i];
+						gltf_staged_texture& out = package.textures[i];
+
+						out.name = image.name;
+
+						if (!image.uri.empty() && image.uri.compare(0, 5, "data:") != 0)
+							out.uri = uri.parent_path() / image.uri;
+
+						if (image.width == -1)
+						{
+							std::vector<unsigned char> encoded;
+							encoded.swap(image.image);
+
+							std::string img_err, img_warn;
+
+							if (!tinygltf::LoadImageData(&image, static_cast<int>(i), &img_err, &img_warn, 0, 0,
+										encoded.data(), static_cast<int>(encoded.size()), nullptr))
+							{
+								printf("Err: %s\n", img_err.c_str());
+								continue;
+							}
+						}
+
+						out.width = image.width;
+						out.height = image.height;
+						out.format = gltfe::get_format(image.component);
+						out.type = gltfe::get_type(image.bits);
+						out.pixels = std::move(image.image);
+
+						const unsigned header[4] = { out.width, out.height, out.format, out.type };
+						uint64_t hash = core::fnv1a(header, sizeof(header));
+
+						if (out.uri.empty())
+							hash = core::fnv1a(out.pixels.data(), out.pixels.size(), hash);
+						else
+						{
+							const std::string path = std::filesystem::absolute(out.uri).lexically_normal().string();
+							hash = core::fnv1a(path.data(), path.size(), hash);
+						}
+
+						out.hash = hash;
+					}
+				});
+
+		// Convert primitives, one job per primitive
+
+		std::vector<std::pair<size_t, size_t>> primitives;
+
+		package.meshes.resize(model.meshes.size());
+
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			package.meshes[m].resize(model.meshes[m].primitives.size());
+
+			for (size_t p = 0; p < model.meshes[m].primitives.size(); p++)
+				primitives.emplace_back(m, p);
+		}
+
+		package.primitive_count = primitives.size();
+
+		std::vector<mesh_opt_report> reports(primitives.size());
+
+		jobs.parallel_for(primitives.size(), 1, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; i++)
+					{
+						auto [m, p] = primitives[i];
+						stage_primitive(model, model.meshes[m].primitives[p], package.meshes[m][p], reports[i]);
+					}
+				});
+
+		for (const auto& report : reports)
+			package.optimization.add(report);
+
+		// Materials, cameras and the node hierarchy are cheap, so stay on this thread
+
+		package.materials.resize(model.materials.size());
+
+		for (size_t i = 0; i < model.materials.size(); i++)
+			stage_material(model, model.materials[i], package.materials[i]);
+
+		for (const auto& cam : model.cameras)
+		{
+			package.cameras.push_back({
+					static_cast<float>(cam.perspective.yfov),
+					static_cast<float>(cam.perspective.znear),
+					static_cast<float>(cam.perspective.zfar) });
+		}
+
+		if (!model.scenes.empty())
+		{
+			const tinygltf::Scene& scene = model.scenes[model.defaultScene > -1 ? model.defaultScene : 0];
+
+			printf("Staged GLTF file, %lu nodes in default scene %d\n", scene.nodes.size(), model.defaultScene);
+
+			for (int node : scene.nodes)
+				stage_node(model, -1, model.nodes[node], package);
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "vector2.h"
+#include "vector3.h"
+#include "vector4.h"
+#include "mesh_opt.h"
+#include "mesh_lod.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace efiilj
+{
+	/**
+	 * \brief Primitive with all vertex streams converted to the engine layout.
+	 */
+	struct gltf_staged_primitive
+	{
+		std::vector<vector3> positions;
+		std::vector<vector3> normals;
+		std::vector<vector2> uvs;
+		std::vector<vector4> tangents;
+		std::vector<unsigned> indices;
+
+		vector3 min, max;
+		int material = -1;
+		bool optimized = false;
+
+		// Simplified levels, generated after optimisation as they index the optimised vertices
+		std::vector<lod_level> lods;
+		bool lods_ready = false;
+
+		// Content hash of all streams, used to share identical meshes
+		uint64_t hash = 0;
+	};
+
+	/**
+	 * \brief Decoded image, ready to be buffered.
+	 */
+	struct gltf_staged_texture
+	{
+		std::string name;
+		std::filesystem::path uri; // Source file for external images, empty if embedded
+		unsigned width = 0, height = 0;
+		unsigned format = 0, type = 0;
+		std::vector<unsigned char> pixels;
+
+		// Hash of the source path for external images, of the pixels for embedded ones
+		uint64_t hash = 0;
+	};
+
+	/**
+	 * \brief Material factors and texture indices into the package texture list (-1 if unused).
+	 */
+	struct gltf_staged_material
+	{
+		vector4 base_color;
+		vector3 emissive_factor;
+		float metallic_factor = 1.0f;
+		float roughness_factor = 1.0f;
+		float alpha_cutoff = 0.5f;
+		bool alpha_test = false;
+		bool double_sided = false;
+
+		int base_texture = -1;
+		int orm_texture = -1;
+		int normal_texture = -1;
+		int emissive_texture = -1;
+	};
+
+	struct gltf_staged_camera
+	{
+		float fov, near, far;
+	};
+
+	/**
+	 * \brief Scene node, stored in depth-first order so parents always precede their children.
+	 */
+	struct gltf_staged_node
+	{
+		std::string name;
+		int parent = -1;
+
+		bool has_position = false, has_scale = false;
+		vector3 position, scale;
+
+		int camera = -1;
+		int mesh = -1;
+	};
+
+	/**
+	 * \brief Everything needed to instantiate a glTF scene, without touching GL or the ECS.
+	 */
+	struct gltf_package
+	{
+		std::vector<gltf_staged_node> nodes;
+		std::vector<std::vector<gltf_staged_primitive>> meshes;
+		std::vector<gltf_staged_material> materials;
+		std::vector<gltf_staged_texture> textures;
+		std::vector<gltf_staged_camera> cameras;
+
+		size_t primitive_count = 0;
+
+		// Vertex cache statistics over every primitive optimised while staging
+		mesh_opt_report optimization;
+	};
+
+	/**
+	 * \brief Parses a glTF file and converts it into a staging package.
+	 * Images and meshes are decoded in parallel on the job system; safe to call from a worker thread.
+	 * \param uri Path to the .gltf or .glb file
+	 * \param binary True if the file is a binary .glb
+	 * \param package Output package
+	 * \return True on success
+	 */
+	bool stage_gltf(const std::filesystem::path& uri, bool binary, gltf_package& package);
+}
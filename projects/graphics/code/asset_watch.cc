@@ -0,0 +1,291 @@
+#include "asset_watch.h"
+#include "core/jobs.h"
+#include "core/mapped_file.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace efiilj
+{
+	static std::string get_key(const std::filesystem::path& path)
+	{
+		return std::filesystem::absolute(path).lexically_normal().string();
+	}
+
+	asset_watcher::asset_watcher()
+		: _fd(-1), _enabled(true), _frame(0), _reloads(0)
+	{
+		printf("Init asset watcher...\n");
+	}
+
+	asset_watcher::~asset_watcher()
+	{
+#ifdef __linux__
+		if (_fd >= 0)
+			close(_fd);
+#endif
+		printf("Asset watcher exit\n");
+	}
+
+	void asset_watcher::on_register(std::shared_ptr<manager_host> host)
+	{
+		_shaders = host->get_manager_from_fcc<shader_server>('SHDR');
+		_textures = host->get_manager_from_fcc<texture_server>('TXSR');
+		_meshes = host->get_manager_from_fcc<mesh_server>('MESR');
+
+#ifdef __linux__
+		_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+		if (_fd < 0)
+			perror("Asset watcher: inotify_init1");
+#else
+		fprintf(stderr, "Asset watcher: file watching is only supported on Linux\n");
+#endif
+	}
+
+	void asset_watcher::on_begin_frame()
+	{
+		if (_fd < 0 || !_enabled)
+			return;
+
+		// Servers keep creating resources after setup, so the uri columns are rescanned now and then
+		if (_frame++ % WATCH_SCAN_FRAMES == 0)
+			scan();
+
+		poll();
+
+		const auto now = std::chrono::steady_clock::now();
+
+		for (auto it = _changed.begin(); it != _changed.end();)
+		{
+			asset_change& change = it->second;
+
+			// Saves tend to arrive as several events, so a file must be quiet for a while first
+			if (now - change.time < std::chrono::milliseconds(WATCH_DEBOUNCE_MS))
+			{
+				++it;
+				continue;
+			}
+
+			auto asset = _assets.find(it->first);
+
+			if (asset == _assets.end())
+			{
+				it = _changed.erase(it);
+				continue;
+			}
+
+			// Retries keep only resources a rescan still finds, as the others were destroyed meanwhile
+			auto& refs = asset->second;
+
+			if (change.pending.empty())
+				change.pending = refs;
+			else
+			{
+				change.pending.erase(std::remove_if(change.pending.begin(), change.pending.end(), [&refs](const asset_ref& ref)
+				{
+					return std::none_of(refs.begin(), refs.end(), [&ref](const asset_ref& r) { return r.kind == ref.kind && r.id == ref.id; });
+				}), change.pending.end());
+			}
+
+			// Resources busy with a previous reload stay pending and are retried on a later frame, the rest are not repeated
+			if (dispatch(change.pending))
+				it = _changed.erase(it);
+			else
+				++it;
+		}
+
+		finish_meshes();
+	}
+
+	void asset_watcher::scan()
+	{
+		_assets.clear();
+
+		for (shader_id idx : _shaders->get_ids())
+		{
+			// Shaders that failed to build are still watched, so only the slot itself is checked
+			if (!_shaders->server::is_valid(idx) || _shaders->get_uri(idx).empty())
+				continue;
+
+			add(_shaders->get_uri(idx), asset_kind::shader, idx);
+
+			// Dependencies include the root file, which add skips as a duplicate
+			for (const auto& dep : _shaders->get_dependencies(idx))
+				add(dep, asset_kind::shader, idx);
+		}
+
+		for (texture_id idx : _textures->get_ids())
+		{
+			if (_textures->is_valid(idx) && !_textures->get_uri(idx).empty())
+				add(_textures->get_uri(idx), asset_kind::texture, idx);
+		}
+
+		for (mesh_id idx : _meshes->get_ids())
+		{
+			if (_meshes->is_valid(idx) && !_meshes->get_uri(idx).empty())
+				add(_meshes->get_uri(idx), asset_kind::mesh, idx);
+		}
+	}
+
+	void asset_watcher::add(const std::filesystem::path& path, asset_kind kind, int id)
+	{
+		const std::string key = get_key(path);
+		auto& refs = _assets[key];
+
+		for (const auto& ref : refs)
+		{
+			if (ref.kind == kind && ref.id == id)
+				return;
+		}
+
+		refs.push_back({ kind, id });
+
+#ifdef __linux__
+		const std::string dir = std::filesystem::path(key).parent_path().string();
+
+		if (_directories.find(dir) != _directories.end())
+			return;
+
+		const int wd = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+		if (wd < 0)
+		{
+			fprintf(stderr, "Asset watcher: failed to watch %s\n", dir.c_str());
+			return;
+		}
+
+		_directories[dir] = wd;
+		_watches[wd] = dir;
+#endif
+	}
+
+	void asset_watcher::poll()
+	{
+#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+
+		const auto now = std::chrono::steady_clock::now();
+
+		while ((length = read(_fd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* ptr = buffer; ptr < buffer + length;)
+			{
+				const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+
+				auto dir = _watches.find(event->wd);
+
+				if (event->len == 0 || dir == _watches.end())
+					continue;
+
+				const std::string key = (dir->second / event->name).string();
+
+				// A new write restarts the reload of everything built from the file
+				if (_assets.find(key) != _assets.end())
+					_changed[key] = { now, {} };
+			}
+		}
+#endif
+	}
+
+	bool asset_watcher::dispatch(std::vector<asset_ref>& refs)
+	{
+		auto started = [this](const asset_ref& ref)
+		{
+			switch (ref.kind)
+			{
+				case asset_kind::shader:
+					return _shaders->reload(ref.id);
+
+				case asset_kind::texture:
+					return _textures->reload(ref.id);
+
+				case asset_kind::mesh:
+					return reload_mesh(ref.id);
+			}
+
+			return true;
+		};
+
+		refs.erase(std::remove_if(refs.begin(), refs.end(), started), refs.end());
+
+		if (refs.empty())
+			_reloads++;
+
+		return refs.empty();
+	}
+
+	bool asset_watcher::reload_mesh(mesh_id idx)
+	{
+		for (const auto& pending : _mesh_reloads)
+		{
+			if (pending->mesh == idx)
+				return false;
+		}
+
+		printf("Reloading mesh %d (%s)\n", idx, _meshes->get_uri(idx).c_str());
+
+		auto reload = std::make_shared<mesh_reload>();
+		reload->mesh = idx;
+		reload->start = std::chrono::steady_clock::now();
+
+		_mesh_reloads.push_back(reload);
+
+		const std::filesystem::path uri = _meshes->get_uri(idx);
+
+		core::job_system::get().submit([reload, uri]()
+				{
+					core::mapped_file file(uri);
+
+					reload->ok = file.is_open()
+						&& parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), reload->data);
+
+					reload->done.store(true, std::memory_order_release);
+				}, nullptr, core::job_queue::background);
+
+		return true;
+	}
+
+	void asset_watcher::finish_meshes()
+	{
+		for (auto it = _mesh_reloads.begin(); it != _mesh_reloads.end();)
+		{
+			mesh_reload& reload = **it;
+
+			if (!reload.done.load(std::memory_order_acquire))
+			{
+				++it;
+				continue;
+			}
+
+			const mesh_id idx = reload.mesh;
+
+			// A file caught mid-write fails to parse, and the old mesh stays until the next save
+			if (!reload.ok)
+				fprintf(stderr, "Mesh %d: failed to parse %s\n", idx, _meshes->get_uri(idx).c_str());
+			else if (_meshes->is_valid(idx))
+			{
+				_meshes->release(idx);
+
+				_meshes->set_positions(idx, reload.data.positions);
+				_meshes->set_normals(idx, reload.data.normals);
+				_meshes->set_uvs(idx, reload.data.uvs);
+				_meshes->set_indices(idx, reload.data.indices);
+				_meshes->set_min(idx, reload.data.min);
+				_meshes->set_max(idx, reload.data.max);
+				_meshes->build(idx);
+
+				printf("Mesh %d reloaded in %.1f ms\n", idx,
+						std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - reload.start).count());
+			}
+
+			it = _mesh_reloads.erase(it);
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ifmgr.h"
+#include "mgr_host.h"
+
+#include "shdr_mgr.h"
+#include "tex_srv.h"
+#include "mesh_srv.h"
+#include "obj_parse.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define WATCH_DEBOUNCE_MS 150
+#define WATCH_SCAN_FRAMES 60
+
+namespace efiilj
+{
+	enum class asset_kind
+	{
+		shader,
+		texture,
+		mesh
+	};
+
+	struct asset_ref
+	{
+		asset_kind kind;
+		int id;
+	};
+
+	/**
+	 * \brief A changed file waiting to settle, and the resources still to reload from it.
+	 * The list is filled on the first dispatch, and emptied again by every new change to the file.
+	 */
+	struct asset_change
+	{
+		std::chrono::steady_clock::time_point time;
+		std::vector<asset_ref> pending;
+	};
+
+	/**
+	 * \brief OBJ data parsed on a worker thread, swapped into its mesh at the start of a frame.
+	 */
+	struct mesh_reload
+	{
+		std::atomic<bool> done { false };
+		bool ok = false;
+
+		mesh_id mesh;
+		obj_mesh data;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	/**
+	 * \brief Watches the source files of shaders, textures and meshes with inotify, and reloads
+	 * the resources built from a file shortly after it stops changing. File paths are taken from the
+	 * uri columns of the servers, and shader includes from their dependency lists.
+	 */
+	class asset_watcher : public server_base
+	{
+		private:
+
+			int _fd;
+			bool _enabled;
+			uint64_t _frame;
+			size_t _reloads;
+
+			// Directories are watched rather than files, as many editors save by replacing the file
+			std::unordered_map<int, std::filesystem::path> _watches;
+			std::unordered_map<std::string, int> _directories;
+
+			std::unordered_map<std::string, std::vector<asset_ref>> _assets;
+			std::unordered_map<std::string, asset_change> _changed;
+			std::vector<std::shared_ptr<mesh_reload>> _mesh_reloads;
+
+			std::shared_ptr<shader_server> _shaders;
+			std::shared_ptr<texture_server> _textures;
+			std::shared_ptr<mesh_server> _meshes;
+
+			void scan();
+			void add(const std::filesystem::path& path, asset_kind kind, int id);
+			void poll();
+
+
+			/**
+			 * \brief Reloads every resource in the list, removing those that were started.
+			 * \return True once the list is empty
+			 */
+			bool dispatch(std::vector<asset_ref>& refs);
+			bool reload_mesh(mesh_id idx);
+			void finish_meshes();
+
+		public:
+
+			asset_watcher();
+			~asset_watcher();
+
+			void on_register(std::shared_ptr<manager_host> host) override;
+			void on_begin_frame() override;
+
+			void set_enabled(bool enabled) { _enabled = enabled; }
+			bool get_enabled() const { return _enabled; }
+
+			size_t get_watched_count() const { return _assets.size(); }
+			size_t get_reload_count() const { return _reloads; }
+	};
+}
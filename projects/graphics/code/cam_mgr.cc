@@ -265,10 +265,10 @@ namespace efiilj
 	}
 
 	const matrix4& camera_manager::get_perspective(camera_id idx) const
-	{ return _data.view[idx]; }
+	{ return _data.perspective[idx]; }
 
 	const matrix4& camera_manager::get_view(camera_id idx) const
-	{ return _data.perspective[idx]; }
+	{ return _data.view[idx]; }
 	
 	transform_id camera_manager::get_transform(camera_id idx) const
 	{ return _data.transform[idx]; }
@@ -1,9 +1,13 @@
 #include "def_rend.h"
 #include "loader.h"
+#include "vertex_layout.h"
+#include "core/arena.h"
+#include "core/profiler.h"
 
 #include "GL/glew.h"
 #include <imgui.h>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <memory>
@@ -13,7 +17,10 @@ namespace efiilj
 	deferred_renderer::deferred_renderer(const renderer_settings& settings) 
 		: 
 		forward_renderer(settings),
-		rbo_(0), depth_texture_(0), target_texture_(0), ubo_(0), quad_vao_(0), quad_vbo_(0)
+		rbo_(0), depth_texture_(0), target_texture_(0), ubo_(0), quad_vao_(0), quad_vbo_(0),
+		_clustered_secondary(-1), _stencil_volume(-1), light_tbo_(0), light_tex_(0), grid_tbo_(0), grid_tex_(0), index_tbo_(0), index_tex_(0),
+		cluster_ms_(0.0f), clustered_(false), v_pointlight_(-1), v_spotlight_(-1), spotlight_segments_(0),
+		stencil_volumes_(false), depth_bounds_(false), lights_drawn_(0), lights_skipped_(0), lights_fullscreen_(0)
 	{
 
 		printf("Init deferred renderer...\n");
@@ -31,11 +38,12 @@ namespace efiilj
 
 		target_texture_ = gen_texture(i++, GL_FLOAT);				// Final
 
+		// Stencil is used to mark pixels inside light volumes
 		depth_texture_ = gen_texture(
-				GL_DEPTH_ATTACHMENT, 
-				GL_DEPTH_COMPONENT32F,
-				GL_DEPTH_COMPONENT,
-				GL_FLOAT
+				GL_DEPTH_STENCIL_ATTACHMENT, 
+				GL_DEPTH32F_STENCIL8,
+				GL_DEPTH_STENCIL,
+				GL_FLOAT_32_UNSIGNED_INT_24_8_REV
 				);
 
 		// Check if framebuffer is ready
@@ -45,6 +53,16 @@ namespace efiilj
 
 	}
 
+	deferred_renderer::~deferred_renderer()
+	{
+		// The volumes came from loaders, which handed their references over
+		if (_meshes)
+		{
+			_meshes->remove_ref(v_pointlight_);
+			_meshes->remove_ref(v_spotlight_);
+		}
+	}
+
 	void deferred_renderer::on_editor_gui()
 	{
 	}
@@ -60,6 +78,41 @@ namespace efiilj
 		ImGui::BulletText("Nodes: %lu", get_instances().size());
 		ImGui::BulletText("Width: %u, Height: %u", settings_.width, settings_.height);
 
+		if (_shaders->is_valid(_stencil_volume))
+			ImGui::Checkbox("Stencil light volumes", &stencil_volumes_);
+
+		ImGui::BulletText("Lights: %lu drawn, %lu off-screen, %lu fullscreen", lights_drawn_, lights_skipped_, lights_fullscreen_);
+		ImGui::BulletText("Depth bounds test: %s", depth_bounds_ ? "yes" : "no");
+
+		ImGui::Checkbox("Frustum culling", &_culling);
+		ImGui::Checkbox("Occlusion culling", &_occlusion_culling);
+		ImGui::BulletText("Visible: %lu, Culled: %lu, Occluded: %lu", _num_visible, _num_culled, _num_occluded);
+		ImGui::BulletText("Occluder triangles: %lu", _occlusion.get_occluder_tris());
+
+		bool occ = _data.occluder[idx];
+		if (ImGui::Checkbox("Occluder", &occ))
+			_data.occluder[idx] = occ;
+
+		if (_shaders->is_valid(_clustered_secondary))
+		{
+			ImGui::Checkbox("Clustered lighting", &clustered_);
+			ImGui::BulletText("Clusters: %u, light references: %lu", 
+					clusters_.get_cluster_count(), clusters_.get_indices().size());
+			ImGui::BulletText("Cluster build: %.3f ms", cluster_ms_);
+
+			if (clusters_.get_overflow() > 0)
+				ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "Dropped %lu light references (cap %u per cluster)",
+						clusters_.get_overflow(), clusters_.get_max_per_cluster());
+		}
+
+		if (_indirect)
+		{
+			ImGui::BulletText("Indirect: %lu draws, %lu commands, %lu batches", 
+					_draws.size(), _commands.size(), _batches.size());
+		}
+
+		draw_gpu_times();
+
 		bool err = _data.error[idx];
 		bool vis = _data.visible[idx];
 
@@ -92,7 +145,11 @@ namespace efiilj
 
 		add_data({
 				&_data.error,
-				&_data.visible});
+				&_data.visible,
+				&_data.occluder,
+				&_data.world_bounds,
+				&_data.bounds_version,
+				&_data.bounds_meshes});
 	}
 
 	void deferred_renderer::on_setup()
@@ -106,9 +163,15 @@ namespace efiilj
 		_shaders->compile(_fallback_primary);
 		_shaders->compile(_fallback_secondary);
 
+		if (settings_.use_indirect)
+			setup_indirect();
+
 		setup_quad();
 		setup_uniforms();
 		setup_volumes();
+		setup_clusters();
+
+		_gpu.setup("GPU: " + _name);
 	}
 
 	unsigned deferred_renderer::gen_texture(unsigned attach, unsigned internal, unsigned format, unsigned type)
@@ -136,7 +199,8 @@ namespace efiilj
 		{
 			case tex_type::component_draw:
 			{
-				std::vector<unsigned> attach;
+				core::scratch_scope scratch;
+				std::pmr::vector<unsigned> attach(scratch.resource());
 
 				for (size_t i = 0; i < textures_.size(); i++)
 				{
@@ -197,6 +261,9 @@ namespace efiilj
 			printf("Uniform block at location 0\n");
 		else
 			fprintf(stderr, "Failed to bind primary deferred uniform block!\n");
+
+		if (_indirect && !(_shaders->use(_fallback_indirect) && _shaders->bind_block(_fallback_indirect, settings_.ubo_camera, 0)))
+			fprintf(stderr, "Failed to bind indirect deferred uniform block!\n");
 	}
 
 	void deferred_renderer::setup_volumes()
@@ -207,8 +274,155 @@ namespace efiilj
 			v_pointlight_ = pl_loader.get_mesh();
 		else 
 			fprintf(stderr, "FATAL: Failed to load point light volume!\n");
+
+		object_loader sl_loader(settings_.spotlight_volume_path, _meshes);
+
+		if (sl_loader.is_valid())
+		{
+			v_spotlight_ = sl_loader.get_mesh();
+
+			// Count the base rim to know how far the polygon falls inside the true cone
+			for (const auto& pos : _meshes->get_positions(v_spotlight_))
+			{
+				if (pos.z > 0.5f && pos.x * pos.x + pos.y * pos.y > 0.5f)
+					spotlight_segments_++;
+			}
+		}
+		else 
+			fprintf(stderr, "Failed to load spotlight volume, falling back to point light volume!\n");
+
+		_stencil_volume = _shaders->create();
+		_shaders->set_uri(_stencil_volume, settings_.stencil_volume_path);
+
+		if (_shaders->compile(_stencil_volume))
+			stencil_volumes_ = settings_.use_stencil_volumes;
+		else
+			fprintf(stderr, "Failed to compile stencil volume shader, light volumes won't be depth tested!\n");
+
+		depth_bounds_ = GLEW_EXT_depth_bounds_test;
 	}	
 
+	void deferred_renderer::setup_clusters()
+	{
+		_clustered_secondary = _shaders->create();
+		_shaders->set_uri(_clustered_secondary, settings_.clustered_lighting_path);
+
+		if (!_shaders->compile(_clustered_secondary) 
+				|| !(_shaders->use(_clustered_secondary) && _shaders->bind_block(_clustered_secondary, settings_.ubo_camera, 0)))
+		{
+			fprintf(stderr, "Failed to setup clustered lighting shader!\n");
+			return;
+		}
+
+		auto gen_buffer_texture = [](unsigned& buffer, unsigned& texture, unsigned format)
+		{
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+			glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_BUFFER, texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+		};
+
+		gen_buffer_texture(light_tbo_, light_tex_, GL_RGBA32F);
+		gen_buffer_texture(grid_tbo_, grid_tex_, GL_RG32UI);
+		gen_buffer_texture(index_tbo_, index_tex_, GL_R32UI);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		clustered_ = settings_.use_clustered;
+	}
+
+	void deferred_renderer::build_clusters(camera_id cam)
+	{
+		light_spheres_.clear();
+		light_texels_.clear();
+
+		for (auto idx : clustered_lights_)
+		{
+			const light_base& base = _lights->get_base(idx);
+			const attenuation_data& att = _lights->get_attenuation(idx);
+			const cutoff_data& cutoff = _lights->get_cutoff(idx);
+			const transform_id trf = _lights->get_transform(idx);
+
+			const vector3 position = _transforms->get_position(trf);
+			const vector3 direction = _transforms->get_forward(trf);
+			const vector3 scale = _transforms->get_scale(trf);
+
+			// Volume meshes have unit radius, so the transform scale is the light radius
+			light_spheres_.push_back({ position, std::max({ scale.x, scale.y, scale.z }) });
+
+			light_texels_.emplace_back(position, static_cast<float>(_lights->get_type(idx)));
+			light_texels_.emplace_back(base.color, base.diffuse_intensity);
+			light_texels_.emplace_back(direction, base.ambient_intensity);
+			light_texels_.emplace_back(att.constant, att.linear, att.exponential, 0.0f);
+			light_texels_.emplace_back(cutoff.inner_angle, cutoff.outer_angle, 0.0f, 0.0f);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		clusters_.build(light_spheres_, 
+				_cameras->get_view(cam), _cameras->get_perspective(cam), 
+				_cameras->get_near(cam), _cameras->get_far(cam));
+
+		cluster_ms_ = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void deferred_renderer::draw_clustered(const vector3& cam_pos)
+	{
+		camera_id cam = _cameras->get_camera();
+
+		build_clusters(cam);
+
+		const auto& grid = clusters_.get_grid();
+		const auto& indices = clusters_.get_indices();
+
+		glBindBuffer(GL_TEXTURE_BUFFER, light_tbo_);
+		glBufferData(GL_TEXTURE_BUFFER, light_texels_.size() * sizeof(vector4), light_texels_.data(), GL_STREAM_DRAW);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, grid_tbo_);
+		glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned), grid.data(), GL_STREAM_DRAW);
+
+		// Keep the index buffer non-empty, even if no cluster references a light
+		unsigned dummy = 0;
+		glBindBuffer(GL_TEXTURE_BUFFER, index_tbo_);
+		glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(unsigned), 
+				indices.empty() ? &dummy : indices.data(), GL_STREAM_DRAW);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		if (!_shaders->use(_clustered_secondary))
+			return;
+
+		attach_textures(tex_type::component_read);
+
+		const unsigned first_unit = textures_.size() + 1;
+
+		glActiveTexture(GL_TEXTURE0 + first_unit);
+		glBindTexture(GL_TEXTURE_BUFFER, light_tex_);
+		glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+		glBindTexture(GL_TEXTURE_BUFFER, grid_tex_);
+		glActiveTexture(GL_TEXTURE0 + first_unit + 2);
+		glBindTexture(GL_TEXTURE_BUFFER, index_tex_);
+
+		_shaders->set_uniform("lights", static_cast<int>(first_unit));
+		_shaders->set_uniform("clusters", static_cast<int>(first_unit + 1));
+		_shaders->set_uniform("light_indices", static_cast<int>(first_unit + 2));
+
+		_shaders->set_uniform(settings_.u_camera, cam_pos);
+		_shaders->set_uniform("cluster_size", vector3(
+					static_cast<float>(clusters_.get_size_x()), 
+					static_cast<float>(clusters_.get_size_y()), 
+					static_cast<float>(clusters_.get_size_z())));
+		_shaders->set_uniform("cluster_screen", vector4(
+					static_cast<float>(settings_.width), static_cast<float>(settings_.height),
+					_cameras->get_near(cam), _cameras->get_far(cam)));
+
+		draw_directional();
+	}
+
 	void deferred_renderer::set_light_uniforms(light_id idx) const
 	{
 		const light_type& type = _lights->get_type(idx);
@@ -234,15 +448,17 @@ namespace efiilj
 	{
 		_shaders->set_uniform("light_mvp", matrix4());
 
-		// Draw screenspace quad
+		// Draw screenspace quad, whose positions are never quantised
+		glVertexAttrib4f(VERTEX_ATTRIB_QUANT_OFFSET, 0.0f, 0.0f, 0.0f, 0.0f);
+		glVertexAttrib4f(VERTEX_ATTRIB_QUANT_SCALE, 1.0f, 1.0f, 1.0f, 0.0f);
+
 		glBindVertexArray(quad_vao_);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 		glBindVertexArray(0);
 	}
 
-	void deferred_renderer::draw_pointlight(const matrix4& model) const
+	void deferred_renderer::draw_volume(mesh_id volume, const matrix4& model, const light_rect& rect) const
 	{
-
 		camera_id cid = _cameras->get_camera();
 
 		const matrix4& v = _cameras->get_view(cid);
@@ -250,15 +466,104 @@ namespace efiilj
 
 		matrix4 mvp = p * v * model;
 
+		glScissor(rect.x, rect.y, rect.width, rect.height);
+
+		if (depth_bounds_)
+			glDepthBoundsEXT(rect.min_depth, rect.max_depth);
+
+		_meshes->bind(volume);
+
+		if (stencil_volumes_)
+		{
+			// Depth-only pass: back faces behind the scene increment, front faces behind it decrement,
+			// leaving a non-zero count only where the scene lies inside the volume.
+			shader_id lighting = _fallback_secondary;
+
+			_shaders->use(_stencil_volume);
+			_shaders->set_uniform("light_mvp", mvp);
+
+			glClear(GL_STENCIL_BUFFER_BIT);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glEnable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+
+			glStencilFunc(GL_ALWAYS, 0, 0);
+			glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+			glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+
+			_meshes->draw_elements(volume);
+
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDisable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+
+			glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+			_shaders->use(lighting);
+		}
+
+		// Back faces only, so the volume still shades when the camera is inside it
 		_shaders->set_uniform("light_mvp", mvp);
 
-		_meshes->bind(v_pointlight_);
-		_meshes->draw_elements(v_pointlight_);
+		glCullFace(GL_FRONT);
+		_meshes->draw_elements(volume);
+		glCullFace(GL_BACK);
+
 		_meshes->unbind();
 	}
 
+	void deferred_renderer::draw_light(light_id idx)
+	{
+		camera_id cam = _cameras->get_camera();
+		transform_id trf = _lights->get_transform(idx);
+
+		const vector3 position = _transforms->get_position(trf);
+		const vector3 scale = _transforms->get_scale(trf);
+
+		// Volume meshes have unit radius, so the transform scale is the light radius
+		const float range = std::max({ scale.x, scale.y, scale.z });
+
+		light_sphere sphere = { position, range };
+		mesh_id volume = v_pointlight_;
+		matrix4 model = _transforms->get_model(trf);
+
+		if (_lights->get_type(idx) == light_type::spotlight && _meshes->is_valid(v_spotlight_))
+		{
+			// The shader lights towards -forward, with the cutoffs stored as cosines
+			const vector3 direction = _transforms->get_forward(trf) * -1.0f;
+			const float cos_outer = _lights->get_cutoff(idx).outer_angle;
+
+			if (cos_outer > LIGHT_MIN_CONE_COS)
+			{
+				sphere = get_cone_bounds(position, direction, range, cos_outer);
+				model = get_cone_model(position, direction, range, cos_outer, spotlight_segments_);
+				volume = v_spotlight_;
+			}
+		}
+
+		light_rect rect;
+
+		if (!get_light_rect(sphere, _cameras->get_view(cam), _cameras->get_perspective(cam), 
+					settings_.width, settings_.height, rect))
+		{
+			lights_skipped_++;
+			return;
+		}
+
+		if (rect.width == static_cast<int>(settings_.width) && rect.height == static_cast<int>(settings_.height))
+			lights_fullscreen_++;
+
+		lights_drawn_++;
+
+		set_light_uniforms(idx);
+		draw_volume(volume, model, rect);
+	}
+
 	void deferred_renderer::on_begin_frame()
 	{
+		_gpu.begin_frame();
+
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rbo_);
 		attach_textures(tex_type::target);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -272,16 +577,17 @@ namespace efiilj
 
 		/* ---------- Geometry Pass ---------- */
 		
-		glDepthMask(GL_TRUE);
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_BLEND);
+		{
+			GPU_PROFILE_SCOPE(_gpu, "geometry");
 
-		attach_textures(tex_type::component_draw);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDepthMask(GL_TRUE);
+			glEnable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
 
-		for (auto& idx : get_instances())
-		{
-			render(idx);
+			attach_textures(tex_type::component_draw);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			render_all();
 		}
 
 		glDepthMask(GL_FALSE);
@@ -290,6 +596,8 @@ namespace efiilj
 		
 		if (_shaders->use(_fallback_secondary))
 		{
+			PROFILE_SCOPE("lighting");
+			GPU_PROFILE_SCOPE(_gpu, "lighting");
 
 			attach_textures(tex_type::target);	
 			attach_textures(tex_type::component_read);
@@ -300,35 +608,57 @@ namespace efiilj
 			glBlendEquation(GL_FUNC_ADD);
 			glBlendFunc(GL_ONE, GL_ONE);
 			glEnable(GL_CULL_FACE);
+			glDisable(GL_DEPTH_TEST);
+
+			if (stencil_volumes_)
+				glEnable(GL_STENCIL_TEST);
+
+			clustered_lights_.clear();
+
+			lights_drawn_ = 0;
+			lights_skipped_ = 0;
+			lights_fullscreen_ = 0;
 
 			for (auto& idx : _lights->get_instances())
 			{
-
-				set_light_uniforms(idx);
+				// Point and spot lights are deferred to the single clustered pass
+				if (clustered_ && _lights->get_type(idx) != light_type::directional)
+				{
+					clustered_lights_.push_back(idx);
+					continue;
+				}
 
 				switch(_lights->get_type(idx))
 				{
 					case light_type::directional:
 					{
+						set_light_uniforms(idx);
+
+						glDisable(GL_SCISSOR_TEST);
+						glDisable(GL_STENCIL_TEST);
+
 						draw_directional();	
+
+						if (stencil_volumes_)
+							glEnable(GL_STENCIL_TEST);
+
 						break;
 					}
 
 					case light_type::spotlight:
 					case light_type::pointlight:
 					{
-						
-						transform_id trf = _lights->get_transform(idx);
-						const matrix4& model = _transforms->get_model(trf);
+						glEnable(GL_SCISSOR_TEST);
+
+						if (depth_bounds_)
+							glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
 
-						vector3 cam_dir = cam_pos - _transforms->get_position(trf);
+						draw_light(idx);
 
-						float radius = _transforms->get_scale(trf).length();
+						glDisable(GL_SCISSOR_TEST);
 
-						if (cam_dir.length() < radius)
-							draw_directional();
-						else
-							draw_pointlight(model);
+						if (depth_bounds_)
+							glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
 
 						break;
 					}
@@ -337,15 +667,23 @@ namespace efiilj
 						fprintf(stderr, "ERROR: Light type not implemented!\n");
 				}	
 			}
+
+			glDisable(GL_STENCIL_TEST);
+
+			if (clustered_ && !clustered_lights_.empty())
+				draw_clustered(cam_pos);
 		}
 
 		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
 		glDepthMask(GL_TRUE);
 
 	}	
 
 	void deferred_renderer::on_end_frame()
 	{
+		GPU_PROFILE_SCOPE(_gpu, "blit");
+
 		// Reset GL state for forward pass
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);	
@@ -6,6 +6,8 @@
 #include "lght_mgr.h"
 #include "cam_mgr.h"
 #include "shdr_mgr.h"
+#include "light_cluster.h"
+#include "light_volume.h"
 
 #include <vector>
 #include <string>
@@ -40,14 +42,34 @@ namespace efiilj
 
 		void set_light_uniforms(light_id idx) const;
 		void draw_directional() const;
-		void draw_pointlight(const matrix4& model) const;
+		void draw_volume(mesh_id volume, const matrix4& model, const light_rect& rect) const;
+		void draw_light(light_id idx);
+
+		void setup_clusters();
+		void build_clusters(camera_id cam);
+		void draw_clustered(const vector3& cam_pos);
 
 		unsigned rbo_, depth_texture_, target_texture_, ubo_, quad_vao_, quad_vbo_, frame_index_;
 
 		shader_id _fallback_secondary;
+		shader_id _clustered_secondary;
+		shader_id _stencil_volume;
+
+		light_clusters clusters_;
+		std::vector<light_id> clustered_lights_;
+		std::vector<light_sphere> light_spheres_;
+		std::vector<vector4> light_texels_;
+
+		unsigned light_tbo_, light_tex_, grid_tbo_, grid_tex_, index_tbo_, index_tex_;
+		float cluster_ms_;
+		bool clustered_;
 
 		mesh_id v_pointlight_;
 		mesh_id v_spotlight_;
+		unsigned spotlight_segments_;
+
+		bool stencil_volumes_, depth_bounds_;
+		size_t lights_drawn_, lights_skipped_, lights_fullscreen_;
 
 		std::vector<unsigned> textures_;
 
@@ -55,7 +77,7 @@ namespace efiilj
 
 		deferred_renderer(const renderer_settings& settings);
 
-		~deferred_renderer() = default;
+		~deferred_renderer();
 
 		void on_editor_gui() override;
 		void on_editor_gui(render_id idx) override;
@@ -1,13 +1,25 @@
 #include "fwd_rend.h"
 #include "mgr_host.h"
+#include "core/hash.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
 
 #include <GL/glew.h>
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
 namespace efiilj
 {
 	forward_renderer::forward_renderer(const renderer_settings& set)
 		: 
-			settings_(set), _fallback_primary(-1)
+			settings_(set), _fallback_primary(-1), _fallback_indirect(-1), 
+			_num_visible(0), _num_culled(0), _num_occluded(0), 
+			_culling(true), _occlusion_culling(true), 
+			_lod(set.use_lod), _camera_valid(false), _camera_fov(0.0f), _lod_draws(), _lod_tris_saved(0),
+			_cluster_culling(set.use_meshlet_culling), _clusters_total(0), _clusters_visible(0),
+			_indirect(false)
 	{
 		printf("Init forward renderer...\n");
 		_name = "Forward renderer";
@@ -24,6 +36,30 @@ namespace efiilj
 		ImGui::BulletText("Nodes: %lu", get_instances().size());
 		ImGui::BulletText("Width: %u, Height: %u", settings_.width, settings_.height);
 
+		ImGui::Checkbox("Frustum culling", &_culling);
+		ImGui::Checkbox("Occlusion culling", &_occlusion_culling);
+		ImGui::BulletText("Visible: %lu, Culled: %lu, Occluded: %lu", _num_visible, _num_culled, _num_occluded);
+		ImGui::BulletText("Occluder triangles: %lu", _occlusion.get_occluder_tris());
+
+		ImGui::Checkbox("LOD", &_lod);
+		ImGui::BulletText("LOD draws: %lu / %lu / %lu / %lu, %lu triangles saved", 
+				_lod_draws[0], _lod_draws[1], _lod_draws[2], _lod_draws[3], _lod_tris_saved);
+
+		ImGui::Checkbox("Meshlet culling", &_cluster_culling);
+		ImGui::BulletText("Meshlets: %lu / %lu visible", _clusters_visible, _clusters_total);
+
+		bool occ = _data.occluder[idx];
+		if (ImGui::Checkbox("Occluder", &occ))
+			_data.occluder[idx] = occ;
+
+		if (_indirect)
+		{
+			ImGui::BulletText("Indirect: %lu draws, %lu commands, %lu batches", 
+					_draws.size(), _commands.size(), _batches.size());
+		}
+
+		draw_gpu_times();
+
 		bool err = _data.error[idx];
 		bool vis = _data.visible[idx];
 
@@ -54,7 +90,12 @@ namespace efiilj
 
 		add_data({
 				&_data.error,
-				&_data.visible
+				&_data.visible,
+				&_data.occluder,
+				&_data.world_bounds,
+				&_data.bounds_version,
+				&_data.bounds_meshes,
+				&_data.bounds_generation
 				});
 	}
 
@@ -63,13 +104,47 @@ namespace efiilj
 		_fallback_primary = _shaders->create();
 		_shaders->set_uri(_fallback_primary, settings_.default_fallback_path);
 		_shaders->compile(_fallback_primary);
+
+		if (settings_.use_indirect)
+			setup_indirect();
+
+		_gpu.setup("GPU: " + _name);
+	}
+
+	void forward_renderer::draw_gpu_times() const
+	{
+		if (!_gpu.is_supported())
+		{
+			ImGui::BulletText("GPU timing: not supported");
+			return;
+		}
+
+		for (const auto& pass : _gpu.get_results())
+			ImGui::BulletText("%*sGPU %s: %.3f ms", pass.depth * 2, "", pass.name, pass.ms);
+	}
+
+	void forward_renderer::setup_indirect()
+	{
+		if (!_meshes->enable_pool(settings_.pool_vertex_capacity, settings_.pool_index_capacity))
+			return;
+
+		_fallback_indirect = _shaders->create();
+		_shaders->set_uri(_fallback_indirect, _shaders->get_uri(_fallback_primary));
+		_shaders->set_features(_fallback_indirect, feature_instanced);
+		_indirect = _shaders->compile(_fallback_indirect);
+
+		if (!_indirect)
+			fprintf(stderr, "Failed to compile indirect shader, using direct rendering\n");
 	}
 
 	void forward_renderer::on_begin_frame()
-	{}
+	{
+		_gpu.begin_frame();
+	}
 
 	void forward_renderer::on_frame()
 	{
+		GPU_PROFILE_SCOPE(_gpu, "forward");
 		render_all();
 	}
 
@@ -99,6 +174,7 @@ namespace efiilj
 
 		const matrix4& model = _transforms->get_model(trf_id);
 		const auto& meshes = _mesh_instances->get_components(eid);
+		const float screen_size = get_screen_size(idx);
 		
 		for (auto miid : meshes)
 		{
@@ -110,7 +186,7 @@ namespace efiilj
 			if (_materials->apply(mat_id, _fallback_primary))
 			{
 				_shaders->set_uniform(settings_.u_model, model);
-				_meshes->draw_elements(mid);
+				draw_direct(miid, mid, mat_id, trf_id, screen_size);
 			}
 			else set_error(idx, true);
 
@@ -122,9 +198,372 @@ namespace efiilj
 
 	void forward_renderer::render_all()
 	{
-		for (auto idx : get_instances())
+		PROFILE_SCOPE("render_all");
+
+		std::fill(std::begin(_lod_draws), std::end(_lod_draws), 0);
+		_lod_tris_saved = 0;
+		_clusters_total = 0;
+		_clusters_visible = 0;
+
+		cull();
+
+		if (_indirect)
+		{
+			render_indirect();
+			return;
+		}
+
+		for (auto idx : _visible_list)
 		{
 			render(idx);
 		}
 	}
+
+	void forward_renderer::update_bounds(render_id idx, transform_id trf_id)
+	{
+		entity_id eid = get_entity(idx);
+
+		const auto& meshes = _mesh_instances->get_components(eid);
+
+		// Fetching the model first flushes any pending transform change into the version
+		const matrix4& model = _transforms->get_model(trf_id);
+		unsigned version = _transforms->get_version(trf_id);
+
+		// Swapped or recycled meshes change the handles, and reloaded or rebounded meshes bump the server generation
+		uint64_t mesh_key = core::fnv1a_basis;
+
+		for (auto miid : meshes)
+		{
+			const mesh_id mesh = _mesh_instances->get_mesh(miid);
+			mesh_key = core::fnv1a(&mesh, sizeof(mesh), mesh_key);
+		}
+
+		if (_data.bounds_version[idx] == version && _data.bounds_meshes[idx] == mesh_key
+				&& _data.bounds_generation[idx] == _meshes->get_generation())
+			return;
+
+		bool first = true;
+		bounds world;
+
+		for (auto miid : meshes)
+		{
+			bounds b = _meshes->get_bounds(_mesh_instances->get_mesh(miid)).get_transformed_bounds(model);
+
+			world.min = first ? b.min : vector3::min(world.min, b.min);
+			world.max = first ? b.max : vector3::max(world.max, b.max);
+			first = false;
+		}
+
+		_data.world_bounds[idx] = world;
+		_data.bounds_version[idx] = version;
+		_data.bounds_meshes[idx] = mesh_key;
+		_data.bounds_generation[idx] = _meshes->get_generation();
+	}
+
+	void forward_renderer::cull()
+	{
+		PROFILE_SCOPE("cull");
+
+		_cull_ids.clear();
+
+		for (auto idx : get_instances())
+		{
+			if (!get_visible(idx) || get_error(idx))
+				continue;
+
+			transform_id trf_id = _transforms->get_component(get_entity(idx));
+
+			if (!_transforms->is_valid(trf_id))
+			{
+				set_error(idx, true);
+				continue;
+			}
+
+			update_bounds(idx, trf_id);
+			_cull_ids.push_back(idx);
+		}
+
+		_visible_list.clear();
+		_num_occluded = 0;
+
+		camera_id cam = _cameras->get_camera();
+
+		_camera_valid = _cameras->is_valid(cam);
+
+		if (_camera_valid)
+		{
+			_camera_pos = _cameras->get_position(cam);
+			_camera_fov = _cameras->get_fov(cam);
+			_view_projection = _cameras->get_perspective(cam) * _cameras->get_view(cam);
+		}
+
+		if (!_culling || !_cameras->is_valid(cam))
+		{
+			_visible_list = _cull_ids;
+			_num_visible = _visible_list.size();
+			_num_culled = 0;
+			return;
+		}
+
+		_cull_bounds.resize(_cull_ids.size());
+
+		for (size_t i = 0; i < _cull_ids.size(); i++)
+			_cull_bounds.set(i, _data.world_bounds[_cull_ids[i]]);
+
+		frustum view_frustum(_view_projection);
+
+		_cull_hits.clear();
+		view_frustum.cull(_cull_bounds, _cull_ids.size(), _cull_hits);
+
+		for (unsigned hit : _cull_hits)
+			_visible_list.push_back(_cull_ids[hit]);
+
+		_num_culled = _cull_ids.size() - _visible_list.size();
+
+		if (_occlusion_culling)
+			cull_occluded(_view_projection);
+
+		_num_visible = _visible_list.size();
+	}
+
+	float forward_renderer::get_screen_size(render_id idx) const
+	{
+		if (!_camera_valid)
+			return std::numeric_limits<float>::max();
+
+		return efiilj::get_screen_size(_data.world_bounds[idx], _camera_pos, _camera_fov);
+	}
+
+	unsigned forward_renderer::pick_lod(mesh_instance_id miid, mesh_id mid, float screen_size)
+	{
+		unsigned lod = 0;
+
+		if (_lod)
+		{
+			lod = select_lod(screen_size, _mesh_instances->get_lod(miid), _meshes->get_lod_count(mid), 
+					settings_.lod_threshold, settings_.lod_hysteresis);
+		}
+
+		_mesh_instances->set_lod(miid, lod);
+
+		_lod_draws[std::min<unsigned>(lod, MESH_LOD_LEVELS)]++;
+		_lod_tris_saved += (_meshes->get_index_count(mid) - _meshes->get_lod_index_count(mid, lod)) / 3;
+
+		return lod;
+	}
+
+	bool forward_renderer::cull_clusters(mesh_id mid, material_id mat_id, transform_id trf_id, std::vector<meshlet_range>& ranges)
+	{
+		const auto& meshlets = _meshes->get_meshlets(mid);
+
+		if (!_cluster_culling || !_camera_valid || meshlets.empty())
+			return false;
+
+		// Fetching the model first flushes any pending transform change, which the inverse depends on
+		const matrix4& model = _transforms->get_model(trf_id);
+		const vector3 camera = _transforms->get_model_inv(trf_id) * _camera_pos;
+
+		const meshlet_view view(_view_projection, model, camera, !_materials->get_double_sided(mat_id));
+
+		_clusters_total += meshlets.size();
+		_clusters_visible += cull_meshlets(meshlets, view, _cluster_visible, ranges);
+
+		return true;
+	}
+
+	void forward_renderer::draw_direct(mesh_instance_id miid, mesh_id mid, material_id mat_id, transform_id trf_id, float screen_size)
+	{
+		const unsigned lod = pick_lod(miid, mid, screen_size);
+
+		_direct_ranges.clear();
+
+		if (lod == 0 && cull_clusters(mid, mat_id, trf_id, _direct_ranges))
+			_meshes->draw_ranges(mid, _direct_ranges);
+		else
+			_meshes->draw_elements(mid, lod);
+	}
+
+	void forward_renderer::cull_occluded(const matrix4& view_projection)
+	{
+		_occlusion.begin(view_projection);
+
+		for (auto idx : _visible_list)
+		{
+			if (!get_occluder(idx))
+				continue;
+
+			entity_id eid = get_entity(idx);
+			const matrix4& model = _transforms->get_model(_transforms->get_component(eid));
+
+			for (auto miid : _mesh_instances->get_components(eid))
+			{
+				mesh_id mid = _mesh_instances->get_mesh(miid);
+
+				if (!_meshes->retain_data(mid))
+					continue;
+
+				_occlusion.add_occluder(_meshes->get_positions(mid), _meshes->get_indices(mid), model);
+			}
+		}
+
+		if (_occlusion.get_occluder_tris() == 0)
+			return;
+
+		_occlusion.rasterize();
+
+		_occlusion_results.resize(_visible_list.size());
+
+		core::job_system::get().parallel_for(_visible_list.size(), 64, [this](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; i++)
+					{
+						render_id idx = _visible_list[i];
+						_occlusion_results[i] = get_occluder(idx) || _occlusion.test(_data.world_bounds[idx]);
+					}
+				});
+
+		size_t kept = 0;
+		for (size_t i = 0; i < _visible_list.size(); i++)
+		{
+			if (_occlusion_results[i])
+				_visible_list[kept++] = _visible_list[i];
+		}
+
+		_num_occluded = _visible_list.size() - kept;
+		_visible_list.resize(kept);
+	}
+
+	void forward_renderer::render_indirect()
+	{
+		PROFILE_SCOPE("render_indirect");
+
+		_items.clear();
+		_ranges.clear();
+
+		// Hidden and culled instances were already left out of the visible list by cull
+		for (auto idx : _visible_list)
+		{
+			if (get_error(idx))
+				continue;
+
+			entity_id eid = get_entity(idx);
+			transform_id trf_id = _transforms->get_component(eid);
+
+			if (!_transforms->is_valid(trf_id))
+			{
+				set_error(idx, true);
+				continue;
+			}
+
+			const matrix4& model = _transforms->get_model(trf_id);
+			const float screen_size = get_screen_size(idx);
+
+			for (auto miid : _mesh_instances->get_components(eid))
+			{
+				mesh_id mid = _mesh_instances->get_mesh(miid);
+				material_id mat_id = _mesh_instances->get_material(miid);
+
+				if (!_materials->is_valid(mat_id))
+				{
+					set_error(idx, true);
+					continue;
+				}
+
+				// Meshes outside the pool, or with custom programs, are drawn directly
+				if (!_meshes->is_pooled(mid) || _shaders->is_valid(_materials->get_program(mat_id)))
+				{
+					_meshes->bind(mid);
+
+					if (_materials->apply(mat_id, _fallback_primary))
+					{
+						_shaders->set_uniform(settings_.u_model, model);
+						draw_direct(miid, mid, mat_id, trf_id, screen_size);
+					}
+
+					continue;
+				}
+
+				const unsigned lod = pick_lod(miid, mid, screen_size);
+
+				// Clustered draws cull the full level here, before its ranges are split into commands below
+				const size_t first_range = _ranges.size();
+				const bool clustered = lod == 0 && cull_clusters(mid, mat_id, trf_id, _ranges);
+
+				_items.push_back({ mat_id, mid, &model, lod, clustered, first_range, _ranges.size() - first_range });
+			}
+		}
+
+		// Group by material, then by mesh and level so that repeated meshes merge into instanced commands
+		std::sort(_items.begin(), _items.end(), [](const draw_item& a, const draw_item& b)
+				{
+					if (a.material != b.material)
+						return a.material < b.material;
+
+					return a.mesh != b.mesh ? a.mesh < b.mesh : a.lod < b.lod;
+				});
+
+		_draws.clear();
+		_draw_models.clear();
+		_draw_meshes.clear();
+		_commands.clear();
+		_batches.clear();
+
+		size_t start = 0;
+		while (start < _items.size())
+		{
+			const size_t first_draw = _draws.size();
+
+			size_t end = start;
+			for (; end < _items.size() && _items[end].material == _items[start].material; end++)
+			{
+				const draw_item& item = _items[end];
+				const unsigned slot = static_cast<unsigned>(end);
+				const pool_entry entry = _meshes->get_pool_entry(item.mesh, item.lod);
+
+				_draw_models.push_back(*item.model);
+				_draw_meshes.push_back(item.mesh);
+
+				if (!item.clustered)
+				{
+					_draws.push_back({ entry, slot, true });
+					continue;
+				}
+
+				// Each visible range of meshlets draws with the model slot of its instance
+				for (size_t r = item.first_range; r < item.first_range + item.range_count; r++)
+				{
+					pool_entry range = entry;
+					range.first_index += _ranges[r].first_index;
+					range.index_count = _ranges[r].index_count;
+
+					_draws.push_back({ range, slot, true });
+				}
+			}
+
+			size_t first = _commands.size();
+			build_indirect_commands(_draws.data() + first_draw, _draws.size() - first_draw, _commands);
+
+			if (_commands.size() > first)
+				_batches.push_back({ _items[start].material, first, _commands.size() - first });
+
+			start = end;
+		}
+
+		if (_batches.empty())
+		{
+			_meshes->unbind();
+			return;
+		}
+
+		_meshes->set_draw_models(_draw_models, _draw_meshes);
+		_meshes->set_draw_commands(_commands);
+
+		for (const draw_batch& batch : _batches)
+		{
+			if (_materials->apply(batch.material, _fallback_indirect))
+				_meshes->draw_indirect(batch.first, batch.count);
+		}
+
+		_meshes->unbind();
+	}
 }
@@ -9,7 +9,11 @@
 
 #include "lght_mgr.h"
 #include "cam_mgr.h"
+#include "frustum.h"
+#include "occl_rast.h"
+#include "gpu_prof.h"
 
+#include <cstdint>
 #include <memory>
 #include <chrono>
 
@@ -24,13 +28,117 @@ namespace efiilj
 		const renderer_settings& settings_;
 
 		shader_id _fallback_primary;
+		shader_id _fallback_indirect;
 
 		struct RenderData
 		{
 			ComponentData<bool> visible { true };
 			ComponentData<bool> error	{ false };
+			ComponentData<bool> occluder { false };
+			ComponentData<bounds> world_bounds;
+			ComponentData<unsigned> bounds_version { 0 };
+			ComponentData<uint64_t> bounds_meshes { 0 };
+			ComponentData<unsigned> bounds_generation { 0 };
 		} _data;
 
+		bounds_soa _cull_bounds;
+		std::vector<render_id> _cull_ids;
+		std::vector<unsigned> _cull_hits;
+		std::vector<render_id> _visible_list;
+
+		occlusion_rasterizer _occlusion;
+		std::vector<unsigned char> _occlusion_results;
+
+		size_t _num_visible;
+		size_t _num_culled;
+		size_t _num_occluded;
+
+		bool _culling;
+		bool _occlusion_culling;
+
+		bool _lod;
+		bool _camera_valid;
+		vector3 _camera_pos;
+		float _camera_fov;
+
+		size_t _lod_draws[MESH_LOD_LEVELS + 1];
+		size_t _lod_tris_saved;
+
+		bool _cluster_culling;
+		matrix4 _view_projection;
+
+		std::vector<unsigned char> _cluster_visible;
+		std::vector<meshlet_range> _ranges;
+		std::vector<meshlet_range> _direct_ranges;
+
+		size_t _clusters_total;
+		size_t _clusters_visible;
+
+		void update_bounds(render_id idx, transform_id trf_id);
+		void cull_occluded(const matrix4& view_projection);
+
+		/**
+		 * \brief Projected size of an instance from its world bounds, as a fraction of the screen height.
+		 */
+		float get_screen_size(render_id idx) const;
+
+		/**
+		 * \brief Selects the level of a mesh instance for this frame, and records it for the next.
+		 */
+		unsigned pick_lod(mesh_instance_id miid, mesh_id mid, float screen_size);
+
+		/**
+		 * \brief Culls the meshlets of the full level of a mesh instance, and appends the visible index ranges.
+		 * \return False if the mesh is drawn whole, as it has no meshlets or there is no camera to cull against
+		 */
+		bool cull_clusters(mesh_id mid, material_id mat_id, transform_id trf_id, std::vector<meshlet_range>& ranges);
+
+		/**
+		 * \brief Draws one mesh instance directly, at its selected level or as its visible meshlets.
+		 */
+		void draw_direct(mesh_instance_id miid, mesh_id mid, material_id mat_id, transform_id trf_id, float screen_size);
+
+		struct draw_item
+		{
+			material_id material;
+			mesh_id mesh;
+			const matrix4* model;
+			unsigned lod;
+
+			// Visible meshlets in _ranges, drawn in place of the whole mesh when clustered
+			bool clustered;
+			size_t first_range;
+			size_t range_count;
+		};
+
+		struct draw_batch
+		{
+			material_id material;
+			size_t first;
+			size_t count;
+		};
+
+		std::vector<draw_item> _items;
+		std::vector<pool_draw> _draws;
+		std::vector<matrix4> _draw_models;
+		std::vector<mesh_id> _draw_meshes;
+		std::vector<DrawElementsIndirectCommand> _commands;
+		std::vector<draw_batch> _batches;
+
+		bool _indirect;
+
+		gpu_profiler _gpu;
+
+		/**
+		 * \brief Lists the GPU time of each pass, as last read back.
+		 */
+		void draw_gpu_times() const;
+
+		/**
+		 * \brief Enables the mesh pool, and builds the indirect fallback as the instanced permutation of the primary one.
+		 */
+		void setup_indirect();
+
 		std::shared_ptr<camera_manager> _cameras;
 		std::shared_ptr<transform_manager> _transforms;
 		std::shared_ptr<light_manager> _lights;
@@ -58,6 +166,21 @@ namespace efiilj
 		void render(render_id idx);
 		void render_all();
 
+		/**
+		 * \brief Tests the world bounds of all instances against the camera frustum,
+		 * and rebuilds the visible list consumed by render_all.
+		 */
+		void cull();
+
+		const std::vector<render_id>& get_visible_list() const
+		{ return _visible_list; }
+
+		/**
+		 * \brief Draws all pooled meshes with one multi-draw-indirect call per material,
+		 * and any remaining meshes one by one.
+		 */
+		void render_indirect();
+
 		shader_id get_fallback_shader()
 		{ return _fallback_primary; }
 
@@ -75,5 +198,15 @@ namespace efiilj
 
 		void set_visible(render_id idx, bool state)
 		{ _data.visible[idx] = state; }
+
+		bool get_occluder(render_id idx) const
+		{ return _data.occluder[idx]; }
+
+		/**
+		 * \brief Marks an instance as an occluder -- its meshes are rasterized into 
+		 * the software depth buffer and hide other instances behind them.
+		 */
+		void set_occluder(render_id idx, bool state)
+		{ _data.occluder[idx] = state; }
 	};
 }
@@ -0,0 +1,121 @@
+#include "gpu_prof.h"
+
+#include <GL/glew.h>
+
+#include <cstdio>
+
+namespace efiilj
+{
+	gpu_profiler::gpu_profiler()
+		: _current(0), _track(0), _supported(false), _recording(false)
+	{ }
+
+	void gpu_profiler::setup(const std::string& name)
+	{
+		// Timestamp queries are core since 3.3
+		_supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+
+		if (!_supported)
+		{
+			printf("Timer queries not supported, GPU passes will not be timed\n");
+			return;
+		}
+
+		_track = core::add_profile_track(name.c_str());
+	}
+
+	unsigned gpu_profiler::query()
+	{
+		frame_queries& frame = _frames[_current];
+
+		if (frame.used == frame.queries.size())
+		{
+			const size_t grow = 16;
+
+			frame.queries.resize(frame.used + grow);
+			glGenQueries(grow, &frame.queries[frame.used]);
+		}
+
+		const unsigned idx = frame.used++;
+		glQueryCounter(frame.queries[idx], GL_TIMESTAMP);
+
+		return idx;
+	}
+
+	void gpu_profiler::resolve(frame_queries& frame)
+	{
+		// Queries complete in order, so the last one being done means they all are.
+		// A frame the GPU is still behind on is dropped instead of waited for.
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+			return;
+
+		_results.clear();
+
+		for (const zone& z : frame.zones)
+		{
+			// Left open when the frame ended
+			if (z.end == static_cast<unsigned>(-1))
+				continue;
+
+			GLuint64 start, end;
+			glGetQueryObjectui64v(frame.queries[z.begin], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(frame.queries[z.end], GL_QUERY_RESULT, &end);
+
+			_results.push_back({ z.name, z.depth, (end - start) / 1e6f });
+
+			core::record_profile_zone(_track, z.name, start + frame.offset, end + frame.offset, z.depth);
+		}
+	}
+
+	void gpu_profiler::begin_frame()
+	{
+		if (!_supported)
+			return;
+
+		_current = (_current + 1) % latency;
+		frame_queries& frame = _frames[_current];
+
+		if (!frame.zones.empty())
+			resolve(frame);
+
+		frame.zones.clear();
+		frame.used = 0;
+		_open.clear();
+
+		// Decided once per frame, so that a frame is never half recorded
+		_recording = core::is_profiling();
+
+		if (_recording)
+		{
+			GLint64 now;
+			glGetInteger64v(GL_TIMESTAMP, &now);
+			frame.offset = static_cast<int64_t>(core::profile_now()) - now;
+		}
+	}
+
+	void gpu_profiler::begin(const char* name)
+	{
+		if (!_recording)
+			return;
+
+		frame_queries& frame = _frames[_current];
+
+		const unsigned depth = static_cast<unsigned>(_open.size());
+		const unsigned start = query();
+
+		frame.zones.push_back({ name, depth, start, static_cast<unsigned>(-1) });
+		_open.push_back(frame.zones.size() - 1);
+	}
+
+	void gpu_profiler::end()
+	{
+		if (!_recording || _open.empty())
+			return;
+
+		_frames[_current].zones[_open.back()].end = query();
+		_open.pop_back();
+	}
+}
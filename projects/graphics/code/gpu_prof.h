@@ -0,0 +1,126 @@
+#pragma once
+
+#include "core/profiler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace efiilj
+{
+	/**
+	 * \brief Times render passes on the GPU with timestamp queries. Each frame gets its own set of queries,
+	 * which are read back a few frames later so that the CPU never waits on the GPU.
+	 * Passes are only timed while the CPU profiler records, and every call does nothing without timer query support.
+	 */
+	class gpu_profiler
+	{
+		public:
+
+			// Frames in flight -- the results of a frame are read when its queries come around again
+			static const unsigned latency = 3;
+
+			struct pass_time
+			{
+				const char* name;
+				unsigned depth;
+				float ms;
+			};
+
+		private:
+
+			struct zone
+			{
+				const char* name;
+				unsigned depth;
+				unsigned begin;
+				unsigned end;
+			};
+
+			struct frame_queries
+			{
+				std::vector<unsigned> queries;
+				std::vector<zone> zones;
+				unsigned used = 0;
+
+				// Added to GPU timestamps to put them on the clock of the CPU profiler
+				int64_t offset = 0;
+			};
+
+			frame_queries _frames[latency];
+			std::vector<size_t> _open;
+			std::vector<pass_time> _results;
+
+			unsigned _current;
+			uint32_t _track;
+			bool _supported;
+			bool _recording;
+
+			/**
+			 * \brief Writes a timestamp into the next free query of the current frame.
+			 * \return Index of the query in the frame
+			 */
+			unsigned query();
+
+			void resolve(frame_queries& frame);
+
+		public:
+
+			gpu_profiler();
+
+			/**
+			 * \brief Checks for timer queries, once there is a GL context.
+			 * \param name Row of the GPU zones in the CPU profiler
+			 */
+			void setup(const std::string& name);
+
+			/**
+			 * \brief Reads back the oldest frame if the GPU is done with it, and starts a new one.
+			 */
+			void begin_frame();
+
+			void begin(const char* name);
+			void end();
+
+			bool is_supported() const
+			{ return _supported; }
+
+			/**
+			 * \brief GPU time of each pass in the last frame that was read back, in the order they began.
+			 */
+			const std::vector<pass_time>& get_results() const
+			{ return _results; }
+	};
+
+	/**
+	 * \brief Times the commands issued between construction and destruction.
+	 */
+	class gpu_scope
+	{
+		private:
+
+			gpu_profiler& _profiler;
+
+		public:
+
+			gpu_scope(gpu_profiler& profiler, const char* name)
+				: _profiler(profiler)
+			{
+				_profiler.begin(name);
+			}
+
+			~gpu_scope()
+			{
+				_profiler.end();
+			}
+
+			gpu_scope(const gpu_scope&) = delete;
+			gpu_scope& operator=(const gpu_scope&) = delete;
+	};
+}
+
+#ifdef GOBLIN_NO_PROFILER
+#define GPU_PROFILE_SCOPE(profiler, name)
+#else
+#define GPU_PROFILE_SCOPE(profiler, name) efiilj::gpu_scope PROFILE_CONCAT(gpu_scope_, __LINE__)(profiler, name)
+#endif
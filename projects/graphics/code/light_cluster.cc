@@ -0,0 +1,205 @@
+#include "light_cluster.h"
+#include "core/jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace efiilj
+{
+	light_clusters::light_clusters(unsigned size_x, unsigned size_y, unsigned size_z, unsigned max_per_cluster)
+		: _size_x(size_x), _size_y(size_y), _size_z(size_z), _max_per_cluster(max_per_cluster),
+		_near(0.1f), _far(100.0f), _scale_x(1.0f), _scale_y(1.0f), _overflow(0)
+	{
+		_cluster_lights.resize(get_cluster_count());
+		_slice_overflow.resize(size_z, 0);
+		_grid.resize(get_cluster_count() * 2, 0);
+	}
+
+	float light_clusters::get_slice_depth(unsigned slice) const
+	{
+		return _near * std::pow(_far / _near, static_cast<float>(slice) / _size_z);
+	}
+
+	int light_clusters::get_slice(float depth) const
+	{
+		if (depth <= _near)
+			return 0;
+
+		int slice = static_cast<int>(std::floor(std::log(depth / _near) / std::log(_far / _near) * _size_z));
+		return std::clamp(slice, 0, static_cast<int>(_size_z) - 1);
+	}
+
+	void light_clusters::compute_range(const light_sphere& light, const matrix4& view, light_range& range) const
+	{
+		const vector4 vs = view * vector4(light.position, 1.0f);
+
+		// Work with positive depth along the view direction
+		range.center = vector3(vs.x, vs.y, -vs.z);
+		range.radius = light.radius;
+
+		const float near_depth = range.center.z - light.radius;
+		const float far_depth = range.center.z + light.radius;
+
+		if (far_depth < _near || near_depth > _far)
+		{
+			range.x0 = range.y0 = range.z0 = 1;
+			range.x1 = range.y1 = range.z1 = 0;
+			return;
+		}
+
+		range.z0 = get_slice(near_depth);
+		range.z1 = get_slice(far_depth);
+
+		// Sphere reaches behind the near plane, so it may cover the whole screen
+		if (near_depth <= _near)
+		{
+			range.x0 = range.y0 = 0;
+			range.x1 = _size_x - 1;
+			range.y1 = _size_y - 1;
+			return;
+		}
+
+		// Project the corners of the sphere's view-space box, which bounds its screen footprint
+		float min_x = 1.0f, max_x = -1.0f, min_y = 1.0f, max_y = -1.0f;
+
+		for (float depth : { near_depth, far_depth })
+		{
+			for (float sign : { -1.0f, 1.0f })
+			{
+				float x = _scale_x * (range.center.x + sign * light.radius) / depth;
+				float y = _scale_y * (range.center.y + sign * light.radius) / depth;
+
+				min_x = std::min(min_x, x);
+				max_x = std::max(max_x, x);
+				min_y = std::min(min_y, y);
+				max_y = std::max(max_y, y);
+			}
+		}
+
+		auto to_tile = [](float ndc, unsigned size)
+		{
+			int tile = static_cast<int>(std::floor((ndc + 1.0f) * 0.5f * size));
+			return std::clamp(tile, 0, static_cast<int>(size) - 1);
+		};
+
+		range.x0 = to_tile(min_x, _size_x);
+		range.x1 = to_tile(max_x, _size_x);
+		range.y0 = to_tile(min_y, _size_y);
+		range.y1 = to_tile(max_y, _size_y);
+
+		if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+			range.x0 = range.x1 + 1;
+	}
+
+	void light_clusters::assign_slice(unsigned z)
+	{
+		const float zn = get_slice_depth(z);
+		const float zf = get_slice_depth(z + 1);
+
+		const unsigned first = z * _size_x * _size_y;
+
+		for (unsigned c = first; c < first + _size_x * _size_y; c++)
+			_cluster_lights[c].clear();
+
+		size_t overflow = 0;
+
+		for (unsigned i = 0; i < _ranges.size(); i++)
+		{
+			const light_range& r = _ranges[i];
+
+			if (static_cast<int>(z) < r.z0 || static_cast<int>(z) > r.z1)
+				continue;
+
+			const float r2 = r.radius * r.radius;
+
+			for (int y = r.y0; y <= r.y1; y++)
+			{
+				const float ny0 = static_cast<float>(y) / _size_y * 2.0f - 1.0f;
+				const float ny1 = static_cast<float>(y + 1) / _size_y * 2.0f - 1.0f;
+
+				const float min_y = std::min(ny0 * zn, ny0 * zf) / _scale_y;
+				const float max_y = std::max(ny1 * zn, ny1 * zf) / _scale_y;
+
+				const float dy = std::max({ min_y - r.center.y, 0.0f, r.center.y - max_y });
+				const float dz = std::max({ zn - r.center.z, 0.0f, r.center.z - zf });
+
+				for (int x = r.x0; x <= r.x1; x++)
+				{
+					const float nx0 = static_cast<float>(x) / _size_x * 2.0f - 1.0f;
+					const float nx1 = static_cast<float>(x + 1) / _size_x * 2.0f - 1.0f;
+
+					const float min_x = std::min(nx0 * zn, nx0 * zf) / _scale_x;
+					const float max_x = std::max(nx1 * zn, nx1 * zf) / _scale_x;
+
+					const float dx = std::max({ min_x - r.center.x, 0.0f, r.center.x - max_x });
+
+					if (dx * dx + dy * dy + dz * dz > r2)
+						continue;
+
+					auto& list = _cluster_lights[first + y * _size_x + x];
+
+					if (list.size() < _max_per_cluster)
+						list.push_back(i);
+					else
+						overflow++;
+				}
+			}
+		}
+
+		_slice_overflow[z] = overflow;
+	}
+
+	void light_clusters::build(const std::vector<light_sphere>& lights, const matrix4& view, const matrix4& projection, float near, float far)
+	{
+		_near = near;
+		_far = far;
+		_scale_x = projection.col(0).x;
+		_scale_y = projection.col(1).y;
+
+		core::job_system& jobs = core::job_system::get();
+
+		_ranges.resize(lights.size());
+
+		jobs.parallel_for(lights.size(), 256, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; i++)
+						compute_range(lights[i], view, _ranges[i]);
+				});
+
+		// Each slice owns its own clusters, so slices can be filled without locking
+		jobs.parallel_for(_size_z, 1, [this](size_t begin, size_t end)
+				{
+					for (size_t z = begin; z < end; z++)
+						assign_slice(static_cast<unsigned>(z));
+				});
+
+		const size_t last_overflow = _overflow;
+
+		_overflow = 0;
+		for (size_t overflow : _slice_overflow)
+			_overflow += overflow;
+
+		// Warn when clusters start overflowing, rather than every frame they stay full
+		if (_overflow > 0 && last_overflow == 0)
+			fprintf(stderr, "Light clusters: %zu light references dropped, clusters are capped at %u lights\n",
+					_overflow, _max_per_cluster);
+
+		unsigned offset = 0;
+		for (unsigned c = 0; c < get_cluster_count(); c++)
+		{
+			unsigned count = static_cast<unsigned>(_cluster_lights[c].size());
+			_grid[c * 2] = offset;
+			_grid[c * 2 + 1] = count;
+			offset += count;
+		}
+
+		_indices.resize(offset);
+
+		jobs.parallel_for(get_cluster_count(), 512, [this](size_t begin, size_t end)
+				{
+					for (size_t c = begin; c < end; c++)
+						std::copy(_cluster_lights[c].begin(), _cluster_lights[c].end(), _indices.begin() + _grid[c * 2]);
+				});
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "matrix4.h"
+#include "vector4.h"
+
+#include <vector>
+
+namespace efiilj
+{
+	/**
+	 * \brief Bounding sphere of a light in world space.
+	 */
+	struct light_sphere
+	{
+		vector3 position;
+		float radius;
+	};
+
+	/**
+	 * \brief Builds a 3D grid of view-space froxels, each holding a list of the lights touching it.
+	 * Slices are distributed exponentially in depth, and tiles evenly in screen space.
+	 * Does not depend on GL -- the output is two flat arrays ready for upload.
+	 * Clusters hold at most max_per_cluster lights, and the references past that are counted in get_overflow().
+	 */
+	class light_clusters
+	{
+		private:
+
+			struct light_range
+			{
+				vector3 center;
+				float radius;
+				int x0, x1, y0, y1, z0, z1;
+			};
+
+			unsigned _size_x, _size_y, _size_z;
+			unsigned _max_per_cluster;
+
+			float _near, _far;
+			float _scale_x, _scale_y;
+
+			std::vector<light_range> _ranges;
+			std::vector<std::vector<unsigned>> _cluster_lights;
+			std::vector<size_t> _slice_overflow;
+			size_t _overflow;
+
+			std::vector<unsigned> _grid;
+			std::vector<unsigned> _indices;
+
+			float get_slice_depth(unsigned slice) const;
+			int get_slice(float depth) const;
+
+			void compute_range(const light_sphere& light, const matrix4& view, light_range& range) const;
+			void assign_slice(unsigned z);
+
+		public:
+
+			light_clusters(unsigned size_x = 16, unsigned size_y = 9, unsigned size_z = 24, unsigned max_per_cluster = 128);
+
+			/**
+			 * \brief Rebuilds the cluster grid, in parallel over lights and depth slices.
+			 * \param lights Bounding spheres of all lights, index order is preserved in the output
+			 * \param view Camera view matrix
+			 * \param projection Camera (symmetric) perspective matrix
+			 * \param near Camera near plane distance
+			 * \param far Camera far plane distance
+			 */
+			void build(const std::vector<light_sphere>& lights, const matrix4& view, const matrix4& projection, float near, float far);
+
+			/**
+			 * \brief Returns the grid as (offset, count) pairs into the index list,
+			 * laid out x-major, then y, then z.
+			 */
+			const std::vector<unsigned>& get_grid() const { return _grid; }
+			const std::vector<unsigned>& get_indices() const { return _indices; }
+
+			unsigned get_size_x() const { return _size_x; }
+			unsigned get_size_y() const { return _size_y; }
+			unsigned get_size_z() const { return _size_z; }
+			unsigned get_cluster_count() const { return _size_x * _size_y * _size_z; }
+			unsigned get_max_per_cluster() const { return _max_per_cluster; }
+
+			/**
+			 * \brief Returns how many light references the last build dropped from clusters that were full.
+			 * Non-zero means some clusters are lit by fewer lights than touch them.
+			 */
+			size_t get_overflow() const { return _overflow; }
+	};
+}
@@ -0,0 +1,119 @@
+#include "light_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace efiilj
+{
+	bool get_light_rect(const light_sphere& sphere, const matrix4& view, const matrix4& projection,
+			unsigned width, unsigned height, light_rect& rect)
+	{
+		rect = { 0, 0, static_cast<int>(width), static_cast<int>(height), 0.0f, 1.0f };
+
+		const vector4 vs = view * vector4(sphere.position, 1.0f);
+
+		// Near plane distance, recovered from the depth terms of the projection
+		const float near = projection.col(3).z / (projection.col(2).z - 1.0f);
+
+		// View space looks down -z, so positive depth is -vs.z
+		const float near_depth = -vs.z - sphere.radius;
+		const float far_depth = -vs.z + sphere.radius;
+
+		if (far_depth < near)
+			return false;
+
+		// Sphere reaches behind the near plane, so corners can't be projected reliably
+		if (near_depth <= near)
+			return true;
+
+		float min_x = 1.0f, max_x = -1.0f, min_y = 1.0f, max_y = -1.0f;
+		float min_z = 1.0f, max_z = -1.0f;
+
+		// Project the corners of the sphere's view-space box, which bounds its screen footprint
+		for (int i = 0; i < 8; i++)
+		{
+			const vector4 corner(
+					vs.x + ((i & 1) ? sphere.radius : -sphere.radius),
+					vs.y + ((i & 2) ? sphere.radius : -sphere.radius),
+					vs.z + ((i & 4) ? sphere.radius : -sphere.radius),
+					1.0f);
+
+			const vector4 clip = projection * corner;
+			const float inv_w = 1.0f / clip.w;
+
+			min_x = std::min(min_x, clip.x * inv_w);
+			max_x = std::max(max_x, clip.x * inv_w);
+			min_y = std::min(min_y, clip.y * inv_w);
+			max_y = std::max(max_y, clip.y * inv_w);
+			min_z = std::min(min_z, clip.z * inv_w);
+			max_z = std::max(max_z, clip.z * inv_w);
+		}
+
+		if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+			return false;
+
+		auto to_pixel = [](float ndc, unsigned size, bool upper)
+		{
+			float px = (std::clamp(ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * size;
+			return static_cast<int>(upper ? std::ceil(px) : std::floor(px));
+		};
+
+		const int x0 = to_pixel(min_x, width, false);
+		const int x1 = to_pixel(max_x, width, true);
+		const int y0 = to_pixel(min_y, height, false);
+		const int y1 = to_pixel(max_y, height, true);
+
+		if (x1 <= x0 || y1 <= y0)
+			return false;
+
+		rect.x = x0;
+		rect.y = y0;
+		rect.width = x1 - x0;
+		rect.height = y1 - y0;
+
+		// Window depth with the default [0, 1] depth range
+		rect.min_depth = std::clamp(min_z * 0.5f + 0.5f, 0.0f, 1.0f);
+		rect.max_depth = std::clamp(max_z * 0.5f + 0.5f, 0.0f, 1.0f);
+
+		return true;
+	}
+
+	light_sphere get_cone_bounds(const vector3& position, const vector3& direction, float range, float cos_outer)
+	{
+		if (cos_outer <= LIGHT_MIN_CONE_COS)
+			return { position, range };
+
+		const float cos_sq = cos_outer * cos_outer;
+
+		// Wide cones are bounded by their base disc, which also contains the apex
+		if (cos_sq <= 0.5f)
+		{
+			const float tan_outer = std::sqrt(1.0f - cos_sq) / cos_outer;
+			return { position + direction * range, range * tan_outer };
+		}
+
+		// Narrow cones are bounded by the sphere through the apex and the base rim
+		const float radius = range / (2.0f * cos_sq);
+		return { position + direction * radius, radius };
+	}
+
+	matrix4 get_cone_model(const vector3& position, const vector3& direction, float range, float cos_outer, unsigned segments)
+	{
+		const float cos_clamped = std::clamp(cos_outer, LIGHT_MIN_CONE_COS, 1.0f);
+		const float tan_outer = std::sqrt(1.0f - cos_clamped * cos_clamped) / cos_clamped;
+
+		// The mesh base is a polygon inscribed in the unit circle, scale it up to circumscribe it instead
+		const float inset = segments >= 3 ? std::cos(3.14159265f / segments) : 1.0f;
+		const float radial = range * tan_outer / inset;
+
+		const vector3 ref = std::fabs(direction.y) < 0.99f ? vector3(0, 1, 0) : vector3(1, 0, 0);
+		const vector3 right = vector3::cross(ref, direction).norm();
+		const vector3 up = vector3::cross(direction, right);
+
+		return matrix4(
+				vector4(right * radial, 0.0f),
+				vector4(up * radial, 0.0f),
+				vector4(direction * range, 0.0f),
+				vector4(position, 1.0f));
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "matrix4.h"
+#include "vector4.h"
+#include "light_cluster.h"
+
+// Spotlights wider than this are drawn with the point light volume
+#define LIGHT_MIN_CONE_COS 0.1f
+
+namespace efiilj
+{
+	/**
+	 * \brief Screen-space pixel rectangle and window depth range covered by a light volume.
+	 */
+	struct light_rect
+	{
+		int x, y, width, height;
+		float min_depth, max_depth;
+	};
+
+	/**
+	 * \brief Computes the scissor rectangle and depth bounds of a light's bounding sphere.
+	 * Spheres reaching behind the near plane get the full screen and depth range.
+	 * \param sphere World-space bounding sphere of the light
+	 * \param view Camera view matrix
+	 * \param projection Camera (symmetric) perspective matrix
+	 * \param width Viewport width in pixels
+	 * \param height Viewport height in pixels
+	 * \param rect Output rectangle, in pixels from the lower left corner
+	 * \return False if the sphere is entirely off-screen, true otherwise
+	 */
+	bool get_light_rect(const light_sphere& sphere, const matrix4& view, const matrix4& projection,
+			unsigned width, unsigned height, light_rect& rect);
+
+	/**
+	 * \brief Returns the smallest sphere enclosing a spotlight cone.
+	 * \param position Cone apex
+	 * \param direction Normalized direction the cone opens towards
+	 * \param range Cone length
+	 * \param cos_outer Cosine of the cone half-angle
+	 */
+	light_sphere get_cone_bounds(const vector3& position, const vector3& direction, float range, float cos_outer);
+
+	/**
+	 * \brief Builds the model matrix placing a unit cone volume (apex at origin, base of radius 1 at z = 1)
+	 * over a spotlight.
+	 * \param position Cone apex
+	 * \param direction Normalized direction the cone opens towards
+	 * \param range Cone length
+	 * \param cos_outer Cosine of the cone half-angle
+	 * \param segments Number of sides of the volume mesh, used to push the polygon out to enclose the true cone
+	 */
+	matrix4 get_cone_model(const vector3& position, const vector3& direction, float range, float cos_outer, unsigned segments);
+}
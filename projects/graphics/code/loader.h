@@ -1,6 +1,5 @@
 #pragma once
 
-#include "vertex.h"
 #include "mesh_srv.h"
 
 #include <vector>
@@ -19,13 +18,20 @@ namespace efiilj
 		bool _is_valid;
 
 		bool load_from_file(const std::filesystem::path& uri);
-		bool find_indices(std::vector<vertex>& in_vertices);
+		bool load_from_cache(const std::filesystem::path& uri, uint64_t hash);
 
 		std::shared_ptr<mesh_server> _meshes;
 
 	public:
 
-		object_loader(const std::filesystem::path& uri, std::shared_ptr<mesh_server> meshes);
+		/**
+		 * \brief Loads an OBJ file into a new mesh.
+		 * \param use_cache If true, the mesh is read from a cooked cache next to the file when it is
+		 * up to date, and the cache is (re)written after parsing otherwise. A file with the same contents
+		 * as one loaded before shares its mesh instead.
+		 * Either way the mesh comes with one reference for the caller, dropped with mesh_server::remove_ref.
+		 */
+		object_loader(const std::filesystem::path& uri, std::shared_ptr<mesh_server> meshes, bool use_cache = true);
 		~object_loader();
 
 		bool is_valid() const { return _is_valid; }
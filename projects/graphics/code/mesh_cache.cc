@@ -0,0 +1,750 @@
+#include "mesh_cache.h"
+#include "core/hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+// Relative to the size of the point set, points closer than this to a hull face count as on it
+#define MESH_CACHE_HULL_EPSILON 1e-5f
+
+namespace efiilj
+{
+	static uint64_t align_offset(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGN - 1) & ~static_cast<uint64_t>(MESH_CACHE_ALIGN - 1);
+	}
+
+	/**
+	 * \brief Whether count elements fit in the file at an offset. Divides rather than multiplies,
+	 * so that counts and offsets from a corrupt file can't wrap around the check.
+	 */
+	static bool fits(uint64_t offset, uint64_t count, size_t element, size_t size)
+	{
+		if (offset > size || offset % MESH_CACHE_ALIGN != 0)
+			return false;
+
+		return element == 0 || count <= (size - offset) / element;
+	}
+
+	std::filesystem::path mesh_cache::get_cache_path(const std::filesystem::path& source)
+	{
+		std::filesystem::path cache = source;
+		cache += MESH_CACHE_EXTENSION;
+		return cache;
+	}
+
+	uint64_t mesh_cache::hash_file(const std::filesystem::path& path)
+	{
+		core::mapped_file file(path);
+
+		if (!file.is_open())
+			return 0;
+
+		return core::fnv1a(file.data(), file.size());
+	}
+
+	uint32_t mesh_cache::get_layout_id(const mesh_server& meshes)
+	{
+		return meshes.get_vertex_layout().flags | (meshes.is_pooled() ? MESH_CACHE_LAYOUT_POOLED : 0u);
+	}
+
+	vertex_layout mesh_cache::get_packing(uint32_t layout, unsigned attribs, unsigned& packed_attribs)
+	{
+		vertex_layout packing;
+
+		// Follows mesh_server::build -- pooled meshes are interleaved and zero-fill the streams they lack
+		if (layout & MESH_CACHE_LAYOUT_POOLED)
+		{
+			packing.flags = (layout & ~MESH_CACHE_LAYOUT_POOLED) | layout_interleaved;
+			packed_attribs = attrib_mask_all;
+		}
+		else
+		{
+			packing.flags = layout;
+			packed_attribs = attribs;
+		}
+
+		return packing;
+	}
+
+	bool mesh_cache::open(const std::filesystem::path& cache_path, uint64_t source_hash, uint32_t layout)
+	{
+		close();
+
+		if (!_file.open(cache_path))
+			return false;
+
+		const unsigned char* base = _file.data();
+		const size_t size = _file.size();
+
+		if (size < sizeof(mesh_cache_header))
+			return false;
+
+		const auto* header = reinterpret_cast<const mesh_cache_header*>(base);
+
+		if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION)
+		{
+			printf("Mesh cache %s: version mismatch, recooking\n", cache_path.c_str());
+			close();
+			return false;
+		}
+
+		if (header->source_hash != source_hash)
+		{
+			printf("Mesh cache %s: source changed, recooking\n", cache_path.c_str());
+			close();
+			return false;
+		}
+
+		if (header->layout != layout)
+		{
+			printf("Mesh cache %s: vertex layout changed, recooking\n", cache_path.c_str());
+			close();
+			return false;
+		}
+
+		if (header->mesh_count > (size - sizeof(mesh_cache_header)) / sizeof(mesh_cache_entry))
+		{
+			close();
+			return false;
+		}
+
+		const auto* entries = reinterpret_cast<const mesh_cache_entry*>(base + sizeof(mesh_cache_header));
+
+		_meshes.resize(header->mesh_count);
+
+		for (uint32_t i = 0; i < header->mesh_count; i++)
+		{
+			const mesh_cache_entry& entry = entries[i];
+			cooked_mesh& mesh = _meshes[i];
+
+			unsigned packed_attribs;
+			const vertex_layout packing = get_packing(layout, entry.streams & attrib_mask_all, packed_attribs);
+
+			mesh.vertex_count = entry.vertex_count;
+			mesh.vertex_bytes = static_cast<size_t>(entry.vertex_count) * packing.get_vertex_size(packed_attribs);
+			mesh.index_count = entry.index_count;
+			mesh.hull_count = entry.hull_count;
+			mesh.attribs = entry.streams & attrib_mask_all;
+
+			mesh.min = vector3(entry.min[0], entry.min[1], entry.min[2]);
+			mesh.max = vector3(entry.max[0], entry.max[1], entry.max[2]);
+			mesh.center = vector3(entry.center[0], entry.center[1], entry.center[2]);
+			mesh.quant.offset = vector3(entry.quant_offset[0], entry.quant_offset[1], entry.quant_offset[2]);
+			mesh.quant.scale = vector3(entry.quant_scale[0], entry.quant_scale[1], entry.quant_scale[2]);
+			mesh.optimized = (entry.streams & stream_optimized) != 0;
+			mesh.lod_count = std::min<size_t>(entry.lod_count, MESH_LOD_LEVELS);
+
+			size_t lod_total = 0;
+
+			for (size_t l = 0; l < mesh.lod_count; l++)
+			{
+				mesh.lod_index_count[l] = entry.lod_index_count[l];
+				mesh.lod_error[l] = entry.lod_error[l];
+				lod_total += entry.lod_index_count[l];
+			}
+
+			if (!fits(entry.vertex_offset, entry.vertex_count, packing.get_vertex_size(packed_attribs), size)
+					|| !fits(entry.position_offset, entry.vertex_count, sizeof(vector3), size)
+					|| !fits(entry.index_offset, entry.index_count, sizeof(unsigned), size)
+					|| !fits(entry.hull_offset, entry.hull_count, sizeof(vector3), size)
+					|| !fits(entry.lod_offset, lod_total, sizeof(unsigned), size))
+			{
+				fprintf(stderr, "Mesh cache %s: entry %u out of bounds\n", cache_path.c_str(), i);
+				close();
+				return false;
+			}
+
+			mesh.vertices = base + entry.vertex_offset;
+			mesh.positions = reinterpret_cast<const vector3*>(base + entry.position_offset);
+			mesh.indices = reinterpret_cast<const unsigned*>(base + entry.index_offset);
+			mesh.hull = reinterpret_cast<const vector3*>(base + entry.hull_offset);
+			mesh.lod_indices = reinterpret_cast<const unsigned*>(base + entry.lod_offset);
+		}
+
+		return true;
+	}
+
+	void mesh_cache::close()
+	{
+		_meshes.clear();
+		_file.close();
+	}
+
+	bool mesh_cache::instantiate(mesh_server& meshes, std::vector<mesh_id>& out) const
+	{
+		for (const auto& mesh : _meshes)
+		{
+			mesh_id mid = meshes.create();
+
+			// The server keeps its own vectors, so data is copied straight out of the mapping
+			std::vector<vector3> positions(mesh.positions, mesh.positions + mesh.vertex_count);
+			std::vector<unsigned> indices(mesh.indices, mesh.indices + mesh.index_count);
+			std::vector<vector3> hull(mesh.hull, mesh.hull + mesh.hull_count);
+
+			std::vector<lod_level> lods(mesh.lod_count);
+			const unsigned* lod_indices = mesh.lod_indices;
+
+			for (size_t l = 0; l < mesh.lod_count; l++)
+			{
+				lods[l].indices.assign(lod_indices, lod_indices + mesh.lod_index_count[l]);
+				lods[l].error = mesh.lod_error[l];
+				lod_indices += mesh.lod_index_count[l];
+			}
+
+			// Uploaded as they are, the float streams other than positions are not needed
+			meshes.set_packed(mid, mesh.vertices, mesh.vertex_bytes, mesh.attribs, mesh.quant);
+			meshes.set_positions(mid, positions);
+			meshes.set_indices(mid, indices);
+			meshes.set_hull(mid, hull);
+
+			meshes.set_bounds(mid, mesh.min, mesh.max);
+			meshes.set_center(mid, mesh.center);
+			meshes.set_optimized(mid, mesh.optimized);
+
+			// An empty chain is still set, so meshes too small for LODs aren't simplified again on every load
+			meshes.set_lods(mid, lods);
+
+			if (!meshes.build(mid))
+				return false;
+
+			out.push_back(mid);
+		}
+
+		return true;
+	}
+
+	bool mesh_cache::write(const std::filesystem::path& cache_path, uint64_t source_hash,
+			mesh_server& meshes, const std::vector<mesh_id>& ids)
+	{
+		std::vector<mesh_cache_source> sources(ids.size());
+
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			mesh_id mid = ids[i];
+			mesh_cache_source& source = sources[i];
+
+			source.positions = &meshes.get_positions(mid);
+			source.normals = &meshes.get_normals(mid);
+			source.uvs = &meshes.get_uvs(mid);
+			source.tangents = &meshes.get_tangents(mid);
+			source.indices = &meshes.get_indices(mid);
+			source.lods = &meshes.get_lods(mid);
+			source.box = meshes.get_bounds(mid);
+			source.center = meshes.get_center(mid);
+			source.optimized = meshes.is_optimized(mid);
+		}
+
+		const bool written = write(cache_path, source_hash, get_layout_id(meshes), sources);
+
+		for (size_t i = 0; i < ids.size(); i++)
+			meshes.set_hull(ids[i], sources[i].hull);
+
+		return written;
+	}
+
+	bool mesh_cache::write(const std::filesystem::path& cache_path, uint64_t source_hash, uint32_t layout,
+			std::vector<mesh_cache_source>& sources)
+	{
+		std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			fprintf(stderr, "Mesh cache: failed to open %s for writing\n", cache_path.c_str());
+			return false;
+		}
+
+		mesh_cache_header header = { MESH_CACHE_MAGIC, MESH_CACHE_VERSION, source_hash,
+			static_cast<uint32_t>(sources.size()), layout };
+
+		std::vector<mesh_cache_entry> entries(sources.size());
+		std::vector<std::vector<unsigned char>> packed(sources.size());
+
+		// Lay out the blobs after the entry table
+		uint64_t offset = sizeof(mesh_cache_header) + sources.size() * sizeof(mesh_cache_entry);
+
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			mesh_cache_source& source = sources[i];
+			mesh_cache_entry& entry = entries[i];
+
+			memset(&entry, 0, sizeof(entry));
+
+			const size_t count = source.positions->size();
+
+			entry.vertex_count = static_cast<uint32_t>(count);
+			entry.index_count = static_cast<uint32_t>(source.indices->size());
+
+			entry.streams |= !source.positions->empty() ? static_cast<uint32_t>(stream_position) : 0u;
+			entry.streams |= !source.normals->empty() ? static_cast<uint32_t>(stream_normal) : 0u;
+			entry.streams |= !source.uvs->empty() ? static_cast<uint32_t>(stream_uv) : 0u;
+			entry.streams |= !source.tangents->empty() ? static_cast<uint32_t>(stream_tangent) : 0u;
+			entry.streams |= source.optimized ? static_cast<uint32_t>(stream_optimized) : 0u;
+
+			// Packed the same way the server packs them on build, so loading only copies them into the buffer
+			unsigned packed_attribs;
+			const vertex_layout packing = get_packing(layout, entry.streams & attrib_mask_all, packed_attribs);
+
+			vertex_quantization quant;
+
+			if (packing.flags & layout_quantized_positions)
+				quant = get_quantization(*source.positions);
+
+			pack_vertices(packing, packed_attribs, quant, *source.positions, *source.normals, *source.uvs, *source.tangents, packed[i]);
+
+			source.hull = compute_hull(*source.positions);
+			entry.hull_count = static_cast<uint32_t>(source.hull.size());
+
+			const float min[3] = { source.box.min.x, source.box.min.y, source.box.min.z };
+			const float max[3] = { source.box.max.x, source.box.max.y, source.box.max.z };
+			const float mid_point[3] = { source.center.x, source.center.y, source.center.z };
+			const float quant_offset[3] = { quant.offset.x, quant.offset.y, quant.offset.z };
+			const float quant_scale[3] = { quant.scale.x, quant.scale.y, quant.scale.z };
+
+			memcpy(entry.min, min, sizeof(min));
+			memcpy(entry.max, max, sizeof(max));
+			memcpy(entry.center, mid_point, sizeof(mid_point));
+			memcpy(entry.quant_offset, quant_offset, sizeof(quant_offset));
+			memcpy(entry.quant_scale, quant_scale, sizeof(quant_scale));
+
+			entry.vertex_offset = offset = align_offset(offset);
+			offset += packed[i].size();
+
+			entry.position_offset = offset = align_offset(offset);
+			offset += count * sizeof(vector3);
+
+			entry.index_offset = offset = align_offset(offset);
+			offset += entry.index_count * sizeof(unsigned);
+
+			entry.hull_offset = offset = align_offset(offset);
+			offset += entry.hull_count * sizeof(vector3);
+
+			const auto& lods = *source.lods;
+
+			entry.lod_count = static_cast<uint32_t>(std::min<size_t>(lods.size(), MESH_LOD_LEVELS));
+			entry.lod_offset = offset = align_offset(offset);
+
+			for (uint32_t l = 0; l < entry.lod_count; l++)
+			{
+				entry.lod_index_count[l] = static_cast<uint32_t>(lods[l].indices.size());
+				entry.lod_error[l] = lods[l].error;
+				offset += lods[l].indices.size() * sizeof(unsigned);
+			}
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(mesh_cache_entry));
+
+		auto write_at = [&file](uint64_t at, const void* data, size_t size)
+		{
+			static const char zeros[MESH_CACHE_ALIGN] = {};
+
+			uint64_t pos = static_cast<uint64_t>(file.tellp());
+			file.write(zeros, static_cast<std::streamsize>(at - pos));
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		};
+
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const mesh_cache_source& source = sources[i];
+			const mesh_cache_entry& entry = entries[i];
+
+			write_at(entry.vertex_offset, packed[i].data(), packed[i].size());
+			write_at(entry.position_offset, source.positions->data(), entry.vertex_count * sizeof(vector3));
+			write_at(entry.index_offset, source.indices->data(), entry.index_count * sizeof(unsigned));
+			write_at(entry.hull_offset, source.hull.data(), source.hull.size() * sizeof(vector3));
+
+			uint64_t at = entry.lod_offset;
+
+			for (uint32_t l = 0; l < entry.lod_count; l++)
+			{
+				write_at(at, (*source.lods)[l].indices.data(), entry.lod_index_count[l] * sizeof(unsigned));
+				at += entry.lod_index_count[l] * sizeof(unsigned);
+			}
+		}
+
+		// Pads out to the end, where an empty LOD block of the last mesh may be aligned past the last write
+		write_at(offset, nullptr, 0);
+
+		return file.good();
+	}
+
+	namespace
+	{
+		/**
+		 * \brief Planes of the hull are kept in double precision, where the tests against float points are close to exact.
+		 */
+		struct hull_face
+		{
+			unsigned v[3];
+			double normal[3];
+			double offset;
+			std::vector<unsigned> outside;
+			size_t visited;
+			bool alive;
+		};
+
+		double distance(const hull_face& face, const vector3& point)
+		{
+			return face.normal[0] * point.x + face.normal[1] * point.y + face.normal[2] * point.z - face.offset;
+		}
+
+		uint64_t edge_key(unsigned from, unsigned to)
+		{
+			return (static_cast<uint64_t>(from) << 32) | to;
+		}
+
+		/**
+		 * \brief Cross product of b - a and c - a in double precision.
+		 */
+		void cross(const vector3& a, const vector3& b, const vector3& c, double out[3])
+		{
+			const double u[3] = { double(b.x) - a.x, double(b.y) - a.y, double(b.z) - a.z };
+			const double w[3] = { double(c.x) - a.x, double(c.y) - a.y, double(c.z) - a.z };
+
+			out[0] = u[1] * w[2] - u[2] * w[1];
+			out[1] = u[2] * w[0] - u[0] * w[2];
+			out[2] = u[0] * w[1] - u[1] * w[0];
+		}
+
+		/**
+		 * \brief Checks if a triangle is closer to a line than the tolerance, measured across its longest side.
+		 */
+		bool is_thin(const std::vector<vector3>& points, unsigned a, unsigned b, unsigned c, float epsilon)
+		{
+			double n[3];
+			cross(points[a], points[b], points[c], n);
+
+			const float longest = std::max((points[b] - points[a]).length(),
+					std::max((points[c] - points[a]).length(), (points[c] - points[b]).length()));
+
+			return std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) < double(epsilon) * longest;
+		}
+
+		/**
+		 * \brief Sets up a face, with its normal following the winding of a, b and c.
+		 * \return False if the face is too thin to have a reliable normal
+		 */
+		bool make_face(hull_face& face, const std::vector<vector3>& points, unsigned a, unsigned b, unsigned c, float epsilon)
+		{
+			face.v[0] = a;
+			face.v[1] = b;
+			face.v[2] = c;
+			face.visited = 0;
+			face.alive = true;
+
+			if (is_thin(points, a, b, c, epsilon))
+				return false;
+
+			cross(points[a], points[b], points[c], face.normal);
+
+			const double length = std::sqrt(face.normal[0] * face.normal[0] + face.normal[1] * face.normal[1] + face.normal[2] * face.normal[2]);
+
+			for (double& n : face.normal)
+				n /= length;
+
+			face.offset = face.normal[0] * points[a].x + face.normal[1] * points[a].y + face.normal[2] * points[a].z;
+
+			return true;
+		}
+	}
+
+	std::vector<vector3> mesh_cache::compute_hull(const std::vector<vector3>& points)
+	{
+		// Duplicates are dropped first, they are common where vertices are split for normals or UVs
+		std::vector<vector3> unique = points;
+
+		std::sort(unique.begin(), unique.end(), [](const vector3& a, const vector3& b)
+				{
+					if (a.x != b.x) return a.x < b.x;
+					if (a.y != b.y) return a.y < b.y;
+					return a.z < b.z;
+				});
+
+		unique.erase(std::unique(unique.begin(), unique.end(), [](const vector3& a, const vector3& b)
+				{
+					return a.x == b.x && a.y == b.y && a.z == b.z;
+				}), unique.end());
+
+		if (unique.size() <= 4)
+			return unique;
+
+		// Initial tetrahedron, from the extreme points along the axes
+		unsigned extremes[6] = {};
+
+		for (unsigned i = 0; i < unique.size(); i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (unique[i][axis] < unique[extremes[axis * 2]][axis])
+					extremes[axis * 2] = i;
+
+				if (unique[i][axis] > unique[extremes[axis * 2 + 1]][axis])
+					extremes[axis * 2 + 1] = i;
+			}
+		}
+
+		unsigned a = extremes[0], b = extremes[1];
+		float widest = 0.0f;
+
+		for (int i = 0; i < 6; i++)
+		{
+			for (int j = i + 1; j < 6; j++)
+			{
+				const float d = (unique[extremes[i]] - unique[extremes[j]]).length();
+
+				if (d > widest)
+				{
+					widest = d;
+					a = extremes[i];
+					b = extremes[j];
+				}
+			}
+		}
+
+		const float epsilon = widest * MESH_CACHE_HULL_EPSILON;
+
+		unsigned c = a;
+		float best = 0.0f;
+
+		for (unsigned i = 0; i < unique.size(); i++)
+		{
+			const float d = vector3::cross(unique[b] - unique[a], unique[i] - unique[a]).length() / widest;
+
+			if (d > best)
+			{
+				best = d;
+				c = i;
+			}
+		}
+
+		// A flat or straight point set has no volume, and every one of its points may be a support point
+		if (best < epsilon)
+			return unique;
+
+		const vector3 plane = vector3::cross(unique[b] - unique[a], unique[c] - unique[a]).norm();
+
+		unsigned d = a;
+		best = 0.0f;
+
+		for (unsigned i = 0; i < unique.size(); i++)
+		{
+			const float dist = std::fabs(vector3::dot(plane, unique[i] - unique[a]));
+
+			if (dist > best)
+			{
+				best = dist;
+				d = i;
+			}
+		}
+
+		if (best < epsilon)
+			return unique;
+
+		// Wound so that every face of the tetrahedron points out, new faces keep the winding of the ones they replace
+		if (vector3::dot(plane, unique[d] - unique[a]) > 0.0f)
+			std::swap(b, c);
+
+		std::vector<hull_face> faces(4);
+
+		make_face(faces[0], unique, a, b, c, epsilon);
+		make_face(faces[1], unique, a, c, d, epsilon);
+		make_face(faces[2], unique, a, d, b, epsilon);
+		make_face(faces[3], unique, b, d, c, epsilon);
+
+		// Owner of each directed edge, the twin of an edge leads to the neighbouring face
+		std::unordered_map<uint64_t, unsigned> edges;
+		edges.reserve(unique.size() * 6);
+
+		for (unsigned f = 0; f < 4; f++)
+		{
+			for (int e = 0; e < 3; e++)
+				edges[edge_key(faces[f].v[e], faces[f].v[(e + 1) % 3])] = f;
+		}
+
+		// Faces with points in front of them, checked lazily as faces die while they wait
+		std::vector<unsigned> pending;
+
+		auto assign = [&](unsigned point, size_t first_face)
+		{
+			for (size_t f = first_face; f < faces.size(); f++)
+			{
+				if (faces[f].alive && distance(faces[f], unique[point]) > epsilon)
+				{
+					if (faces[f].outside.empty())
+						pending.push_back(static_cast<unsigned>(f));
+
+					faces[f].outside.push_back(point);
+					return;
+				}
+			}
+		};
+
+		for (unsigned i = 0; i < unique.size(); i++)
+		{
+			if (i != a && i != b && i != c && i != d)
+				assign(i, 0);
+		}
+
+		std::vector<unsigned> visible;
+		std::vector<unsigned> stack;
+		std::vector<unsigned> orphans;
+		std::vector<std::pair<unsigned, unsigned>> horizon;
+		std::vector<size_t> on_horizon(unique.size(), 0);
+		std::vector<unsigned> kept;
+
+		// Every step adds a point to the hull, so anything more means the hull has gone wrong
+		for (size_t step = 1; step <= unique.size(); step++)
+		{
+			while (!pending.empty() && (!faces[pending.back()].alive || faces[pending.back()].outside.empty()))
+				pending.pop_back();
+
+			if (pending.empty())
+				break;
+
+			const unsigned current = pending.back();
+
+			// Farthest point in front of the face is always on the hull
+			unsigned eye = faces[current].outside.front();
+
+			for (unsigned point : faces[current].outside)
+			{
+				if (distance(faces[current], unique[point]) > distance(faces[current], unique[eye]))
+					eye = point;
+			}
+
+			visible.clear();
+			orphans.clear();
+			horizon.clear();
+
+			// Faces seen from the eye are connected, so they are found by walking out from the first one.
+			// Edges that lead to a face the eye does not see make up the horizon, and faces seen are marked with the step.
+			faces[current].visited = step;
+			stack.assign(1, current);
+
+			bool is_valid = true;
+
+			while (!stack.empty() && is_valid)
+			{
+				const unsigned f = stack.back();
+				stack.pop_back();
+				visible.push_back(f);
+
+				for (int e = 0; e < 3; e++)
+				{
+					const unsigned from = faces[f].v[e];
+					const unsigned to = faces[f].v[(e + 1) % 3];
+
+					auto twin = edges.find(edge_key(to, from));
+
+					if (twin == edges.end())
+					{
+						is_valid = false;
+						break;
+					}
+
+					hull_face& next = faces[twin->second];
+
+					if (next.visited == step)
+						continue;
+
+					// A face the eye lies on the plane of is taken along when the new face on the edge would be a sliver
+					if (distance(next, unique[eye]) > epsilon || is_thin(unique, from, to, eye, epsilon))
+					{
+						next.visited = step;
+						stack.push_back(twin->second);
+					}
+					else
+						horizon.emplace_back(from, to);
+				}
+			}
+
+			// Rounding on near-flat patches can leave a horizon that touches itself or a new face with no area.
+			// The hull is left as it is then, and the eye is kept aside as it may still be on the real hull.
+			for (const auto& edge : horizon)
+			{
+				if (on_horizon[edge.first] == step || is_thin(unique, edge.first, edge.second, eye, epsilon))
+					is_valid = false;
+
+				on_horizon[edge.first] = step;
+			}
+
+			if (!is_valid)
+			{
+				std::vector<unsigned>& outside = faces[current].outside;
+
+				outside.erase(std::find(outside.begin(), outside.end(), eye));
+				kept.push_back(eye);
+
+				continue;
+			}
+
+			for (unsigned f : visible)
+			{
+				for (unsigned point : faces[f].outside)
+				{
+					if (point != eye)
+						orphans.push_back(point);
+				}
+
+				for (int e = 0; e < 3; e++)
+					edges.erase(edge_key(faces[f].v[e], faces[f].v[(e + 1) % 3]));
+
+				faces[f].alive = false;
+				std::vector<unsigned>().swap(faces[f].outside);
+			}
+
+			const size_t first_new = faces.size();
+
+			for (const auto& edge : horizon)
+			{
+				const unsigned f = static_cast<unsigned>(faces.size());
+
+				faces.emplace_back();
+				make_face(faces.back(), unique, edge.first, edge.second, eye, epsilon);
+
+				edges[edge_key(edge.first, edge.second)] = f;
+				edges[edge_key(edge.second, eye)] = f;
+				edges[edge_key(eye, edge.first)] = f;
+			}
+
+			// Points not in front of any new face are inside the hull now
+			for (unsigned point : orphans)
+				assign(point, first_new);
+		}
+
+		std::vector<unsigned char> used(unique.size(), 0);
+		std::vector<vector3> hull;
+
+		auto keep = [&](unsigned point)
+		{
+			if (!used[point])
+			{
+				used[point] = 1;
+				hull.push_back(unique[point]);
+			}
+		};
+
+		for (const hull_face& face : faces)
+		{
+			if (!face.alive)
+				continue;
+
+			for (unsigned v : face.v)
+				keep(v);
+
+			// Only left when the steps ran out
+			for (unsigned point : face.outside)
+				keep(point);
+		}
+
+		for (unsigned point : kept)
+			keep(point);
+
+		return hull;
+	}
+}
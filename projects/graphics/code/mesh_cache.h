@@ -0,0 +1,188 @@
+#pragma once
+
+#include "mesh_srv.h"
+#include "core/mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#define MESH_CACHE_MAGIC 0x434d4247 // "GBMC"
+#define MESH_CACHE_VERSION 4
+#define MESH_CACHE_ALIGN 16
+#define MESH_CACHE_EXTENSION ".gbmc"
+
+// Set in the layout id of caches cooked for the mesh pool, where every vertex is interleaved with all attributes
+#define MESH_CACHE_LAYOUT_POOLED (1u << 31)
+
+namespace efiilj
+{
+	// Stream bits follow vertex_attribute, so that they double as the attribute mask of the mesh
+	enum mesh_cache_stream : uint32_t
+	{
+		stream_position = 1 << attrib_position,
+		stream_normal = 1 << attrib_normal,
+		stream_uv = 1 << attrib_uv,
+		stream_tangent = 1 << attrib_tangent,
+
+		// Not a stream, marks meshes already run through optimize_mesh
+		stream_optimized = 1 << 4
+	};
+
+	struct mesh_cache_header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t source_hash;
+		uint32_t mesh_count;
+
+		// Vertex layout flags the vertices are packed with, and MESH_CACHE_LAYOUT_POOLED
+		uint32_t layout;
+	};
+
+	/**
+	 * \brief Per-mesh table entry. Offsets are in bytes from the start of the file.
+	 * Vertices are stored packed, exactly as mesh_server::build uploads them, followed by
+	 * the float positions that the CPU keeps for culling and physics.
+	 */
+	struct mesh_cache_entry
+	{
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t hull_count;
+		uint32_t streams;
+
+		uint64_t vertex_offset;
+		uint64_t position_offset;
+		uint64_t index_offset;
+		uint64_t hull_offset;
+
+		float min[3];
+		float max[3];
+		float center[3];
+
+		// Dequantisation of the packed positions
+		float quant_offset[3];
+		float quant_scale[3];
+
+		// LOD levels, stored back to back at lod_offset
+		uint32_t lod_count;
+		uint32_t lod_index_count[MESH_LOD_LEVELS];
+		float lod_error[MESH_LOD_LEVELS];
+		uint64_t lod_offset;
+	};
+
+	/**
+	 * \brief Pointers into a mapped cache file for a single mesh.
+	 */
+	struct cooked_mesh
+	{
+		const unsigned char* vertices = nullptr;
+		const vector3* positions = nullptr;
+		const unsigned* indices = nullptr;
+		const vector3* hull = nullptr;
+		const unsigned* lod_indices = nullptr;
+
+		size_t vertex_count = 0, vertex_bytes = 0, index_count = 0, hull_count = 0;
+		size_t lod_count = 0;
+		size_t lod_index_count[MESH_LOD_LEVELS] = {};
+		float lod_error[MESH_LOD_LEVELS] = {};
+
+		vector3 min, max, center;
+		vertex_quantization quant;
+		unsigned attribs = 0;
+		bool optimized = false;
+	};
+
+	/**
+	 * \brief CPU data of one mesh to write to a cache. Streams are owned elsewhere, and every one
+	 * must be set, to an empty vector for streams the mesh does not have.
+	 */
+	struct mesh_cache_source
+	{
+		const std::vector<vector3>* positions = nullptr;
+		const std::vector<vector3>* normals = nullptr;
+		const std::vector<vector2>* uvs = nullptr;
+		const std::vector<vector4>* tangents = nullptr;
+		const std::vector<unsigned>* indices = nullptr;
+		const std::vector<lod_level>* lods = nullptr;
+
+		bounds box;
+		vector3 center;
+		bool optimized = false;
+
+		// Collision hull, filled in by the write
+		std::vector<vector3> hull;
+	};
+
+	/**
+	 * \brief Engine-native binary cache of mesh_server data, stored next to the source asset.
+	 * Opening a cache maps the file and fixes up the entry offsets into pointers; nothing is parsed.
+	 */
+	class mesh_cache
+	{
+		private:
+
+			core::mapped_file _file;
+			std::vector<cooked_mesh> _meshes;
+
+		public:
+
+			/**
+			 * \brief Maps a cache file and validates its header against the source content hash and vertex layout.
+			 * \param layout Layout id the vertices must be packed with, from get_layout_id
+			 * \return False if the cache is missing, from another version or layout, or stale
+			 */
+			bool open(const std::filesystem::path& cache_path, uint64_t source_hash, uint32_t layout);
+			void close();
+
+			size_t get_mesh_count() const { return _meshes.size(); }
+			const cooked_mesh& get_mesh(size_t index) const { return _meshes[index]; }
+
+			/**
+			 * \brief Creates and builds one mesh per cached entry.
+			 */
+			bool instantiate(mesh_server& meshes, std::vector<mesh_id>& out) const;
+
+			/**
+			 * \brief Writes built meshes to a cache file, computing collision hulls where missing.
+			 * Must run in the frame the meshes are built, while their CPU streams and LOD chains are still held.
+			 */
+			static bool write(const std::filesystem::path& cache_path, uint64_t source_hash,
+					mesh_server& meshes, const std::vector<mesh_id>& ids);
+
+			/**
+			 * \brief Writes meshes to a cache file from their CPU data, packing the vertices for a layout id.
+			 * Does not touch the GPU, and computes the hull of every source.
+			 */
+			static bool write(const std::filesystem::path& cache_path, uint64_t source_hash, uint32_t layout,
+					std::vector<mesh_cache_source>& sources);
+
+			/**
+			 * \brief Layout id of the vertices a mesh server builds, which caches are cooked for.
+			 */
+			static uint32_t get_layout_id(const mesh_server& meshes);
+
+			/**
+			 * \brief Vertex layout and attribute mask that vertices are packed with under a layout id.
+			 * \param attribs Mask of the streams the mesh has
+			 */
+			static vertex_layout get_packing(uint32_t layout, unsigned attribs, unsigned& packed_attribs);
+
+			/**
+			 * \brief Returns the cache path used for a source asset.
+			 */
+			static std::filesystem::path get_cache_path(const std::filesystem::path& source);
+
+			/**
+			 * \brief Content hash of a source file, 0 if it can't be read.
+			 */
+			static uint64_t hash_file(const std::filesystem::path& path);
+
+			/**
+			 * \brief Vertices of the convex hull of a point set, by quickhull. Points within a small tolerance of the hull
+			 * may be left out, and flat or straight point sets are returned whole after dropping duplicates.
+			 */
+			static std::vector<vector3> compute_hull(const std::vector<vector3>& points);
+	};
+}
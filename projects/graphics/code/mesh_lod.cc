@@ -0,0 +1,432 @@
+#include "mesh_lod.h"
+#include "mesh_opt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace efiilj
+{
+	/**
+	 * \brief Symmetric 4x4 error quadric, accumulated from area-weighted planes.
+	 */
+	struct quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0;
+		double weight = 0;
+	};
+
+	static void add_plane(quadric& q, const vector3& n, float d, double weight)
+	{
+		q.a00 += weight * n.x * n.x;
+		q.a01 += weight * n.x * n.y;
+		q.a02 += weight * n.x * n.z;
+		q.a11 += weight * n.y * n.y;
+		q.a12 += weight * n.y * n.z;
+		q.a22 += weight * n.z * n.z;
+		q.b0 += weight * n.x * d;
+		q.b1 += weight * n.y * d;
+		q.b2 += weight * n.z * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	static void add_quadric(quadric& q, const quadric& r)
+	{
+		q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+		q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+		q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+		q.c += r.c;
+		q.weight += r.weight;
+	}
+
+	/**
+	 * \brief Mean squared distance of a point to the planes of a quadric.
+	 */
+	static double evaluate(const quadric& q, const vector3& p)
+	{
+		const double x = p.x, y = p.y, z = p.z;
+
+		const double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+			+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+			+ 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+			+ q.c;
+
+		return q.weight > 0.0 ? std::fabs(r) / q.weight : 0.0;
+	}
+
+	struct edge_collapse
+	{
+		unsigned from;
+		unsigned to;
+		double error;
+	};
+
+	std::vector<unsigned> simplify_mesh(const std::vector<vector3>& positions, const std::vector<unsigned>& indices,
+			size_t target_index_count, float max_error, float& result_error)
+	{
+		std::vector<unsigned> result = indices;
+		result_error = 0.0f;
+
+		const size_t vertex_count = positions.size();
+
+		if (vertex_count == 0 || indices.size() % 3 != 0 || result.size() <= target_index_count)
+			return result;
+
+		vector3 min = positions[0], max = positions[0];
+
+		for (const auto& pos : positions)
+		{
+			min = vector3::min(min, pos);
+			max = vector3::max(max, pos);
+		}
+
+		const double extent = (max - min).length();
+
+		if (extent <= 0.0)
+			return result;
+
+		const double max_sq = static_cast<double>(max_error) * max_error * extent * extent;
+
+		// Weld vertices by position, so attribute seams share one position in the topology
+		std::vector<unsigned> weld(vertex_count);
+		std::vector<unsigned> sibling(vertex_count);
+		{
+			std::vector<unsigned> order(vertex_count);
+			std::iota(order.begin(), order.end(), 0);
+
+			std::sort(order.begin(), order.end(), [&positions](unsigned a, unsigned b)
+					{
+						const vector3& pa = positions[a];
+						const vector3& pb = positions[b];
+
+						if (pa.x != pb.x) return pa.x < pb.x;
+						if (pa.y != pb.y) return pa.y < pb.y;
+						return pa.z < pb.z;
+					});
+
+			size_t group = 0;
+
+			for (size_t i = 0; i <= vertex_count; i++)
+			{
+				if (i < vertex_count && positions[order[i]] == positions[order[group]])
+					continue;
+
+				// Siblings form a ring through every vertex at the same position
+				for (size_t j = group; j < i; j++)
+				{
+					weld[order[j]] = order[group];
+					sibling[order[j]] = order[j + 1 < i ? j + 1 : group];
+				}
+
+				group = i;
+			}
+		}
+
+		std::vector<quadric> quadrics(vertex_count);
+
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const vector3& p0 = positions[result[i]];
+			const vector3& p1 = positions[result[i + 1]];
+			const vector3& p2 = positions[result[i + 2]];
+
+			vector3 n = vector3::cross(p1 - p0, p2 - p0);
+			const float area = n.length();
+
+			if (area <= 0.0f)
+				continue;
+
+			n = n / area;
+			const float d = -vector3::dot(n, p0);
+
+			for (int k = 0; k < 3; k++)
+				add_plane(quadrics[weld[result[i + k]]], n, d, area * 0.5);
+		}
+
+		// Border and non-manifold edges of the welded topology stay in place
+		std::vector<unsigned char> locked(vertex_count, 0);
+		{
+			std::unordered_map<uint64_t, unsigned> edges;
+			edges.reserve(result.size());
+
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					const unsigned a = weld[result[i + k]];
+					const unsigned b = weld[result[i + (k + 1) % 3]];
+
+					if (a != b)
+						edges[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+				}
+			}
+
+			for (const auto& edge : edges)
+			{
+				if (edge.second == 2)
+					continue;
+
+				locked[edge.first >> 32] = 1;
+				locked[edge.first & 0xffffffff] = 1;
+			}
+		}
+
+		std::vector<unsigned> remap(vertex_count);
+		std::vector<unsigned> tri_offset(vertex_count + 1);
+		std::vector<unsigned> tri_list;
+		std::vector<unsigned char> touched(vertex_count);
+		std::vector<edge_collapse> candidates;
+		std::vector<std::pair<unsigned, unsigned>> moves;
+
+		auto corner_at = [&](unsigned tri, unsigned pos, unsigned& out) -> bool
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (weld[result[tri * 3 + k]] == pos)
+				{
+					out = result[tri * 3 + k];
+					return true;
+				}
+			}
+
+			return false;
+		};
+
+		while (result.size() > target_index_count)
+		{
+			const size_t tri_count = result.size() / 3;
+
+			// Triangles around each vertex
+			std::fill(tri_offset.begin(), tri_offset.end(), 0);
+
+			for (unsigned index : result)
+				tri_offset[index + 1]++;
+
+			for (size_t v = 0; v < vertex_count; v++)
+				tri_offset[v + 1] += tri_offset[v];
+
+			tri_list.resize(result.size());
+			std::vector<unsigned> fill(tri_offset.begin(), tri_offset.end() - 1);
+
+			for (size_t i = 0; i < result.size(); i++)
+				tri_list[fill[result[i]]++] = static_cast<unsigned>(i / 3);
+
+			candidates.clear();
+
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					const unsigned a = weld[result[i + k]];
+					const unsigned b = weld[result[i + (k + 1) % 3]];
+
+					if (a == b)
+						continue;
+
+					if (!locked[a])
+						candidates.push_back({ a, b, evaluate(quadrics[a], positions[b]) });
+
+					if (!locked[b])
+						candidates.push_back({ b, a, evaluate(quadrics[b], positions[a]) });
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(),
+					[](const edge_collapse& a, const edge_collapse& b) { return a.error < b.error; });
+
+			// Each collapse removes about two triangles
+			const size_t limit = std::max<size_t>((tri_count - target_index_count / 3) / 2, 1);
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+
+			size_t collapses = 0;
+
+			for (const auto& collapse : candidates)
+			{
+				if (collapse.error > max_sq || collapses >= limit)
+					break;
+
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+
+				moves.clear();
+				bool valid = true;
+
+				// Every vertex at the collapsed position merges into a neighbour at the target,
+				// keeping its side of any attribute seam
+				unsigned v = collapse.from;
+				do
+				{
+					unsigned target = ~0u;
+
+					for (unsigned t = tri_offset[v]; t < tri_offset[v + 1] && target == ~0u; t++)
+						corner_at(tri_list[t], collapse.to, target);
+
+					if (tri_offset[v] != tri_offset[v + 1])
+					{
+						if (target == ~0u)
+						{
+							valid = false;
+							break;
+						}
+
+						moves.emplace_back(v, target);
+					}
+
+					v = sibling[v];
+				}
+				while (v != collapse.from);
+
+				if (!valid || moves.empty())
+					continue;
+
+				// Reject collapses that flip a remaining triangle
+				const vector3& target_pos = positions[collapse.to];
+
+				for (const auto& move : moves)
+				{
+					for (unsigned t = tri_offset[move.first]; t < tri_offset[move.first + 1] && valid; t++)
+					{
+						const unsigned tri = tri_list[t];
+						unsigned corner;
+
+						if (corner_at(tri, collapse.to, corner))
+							continue;
+
+						vector3 p[3], q[3];
+
+						for (int k = 0; k < 3; k++)
+						{
+							p[k] = positions[result[tri * 3 + k]];
+							q[k] = weld[result[tri * 3 + k]] == collapse.from ? target_pos : p[k];
+						}
+
+						const vector3 before = vector3::cross(p[1] - p[0], p[2] - p[0]);
+						const vector3 after = vector3::cross(q[1] - q[0], q[2] - q[0]);
+
+						valid = vector3::dot(before, after) > 0.0f;
+					}
+				}
+
+				if (!valid)
+					continue;
+
+				for (const auto& move : moves)
+				{
+					remap[move.first] = move.second;
+
+					// Neighbours are frozen for the pass, as their flip checks assumed this position
+					for (unsigned t = tri_offset[move.first]; t < tri_offset[move.first + 1]; t++)
+					{
+						for (int k = 0; k < 3; k++)
+							touched[weld[result[tri_list[t] * 3 + k]]] = 1;
+					}
+				}
+
+				add_quadric(quadrics[collapse.to], quadrics[collapse.from]);
+				result_error = std::max(result_error, static_cast<float>(std::sqrt(collapse.error) / extent));
+
+				collapses++;
+			}
+
+			if (collapses == 0)
+				break;
+
+			size_t write = 0;
+
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				const unsigned a = remap[result[i]];
+				const unsigned b = remap[result[i + 1]];
+				const unsigned c = remap[result[i + 2]];
+
+				if (a == b || b == c || a == c)
+					continue;
+
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+
+			result.resize(write);
+		}
+
+		return result;
+	}
+
+	std::vector<lod_level> generate_lod_chain(const std::vector<vector3>& positions, const std::vector<unsigned>& indices,
+			float max_error)
+	{
+		std::vector<lod_level> chain;
+
+		const size_t tri_count = indices.size() / 3;
+
+		if (tri_count < MESH_LOD_MIN_TRIANGLES)
+			return chain;
+
+		chain.reserve(MESH_LOD_LEVELS);
+
+		const std::vector<unsigned>* source = &indices;
+		float error = 0.0f;
+
+		for (unsigned level = 1; level <= MESH_LOD_LEVELS; level++)
+		{
+			lod_level lod;
+
+			// Each level starts from the last, and the errors add up to a bound on the distance to the full mesh
+			float level_error;
+			lod.indices = simplify_mesh(positions, *source, (tri_count >> level) * 3, max_error - error, level_error);
+
+			// Levels that barely shrink aren't worth their index memory
+			if (lod.indices.empty() || lod.indices.size() > source->size() * 3 / 4)
+				break;
+
+			error += level_error;
+			lod.error = error;
+
+			optimize_vertex_cache(lod.indices, positions.size());
+
+			chain.push_back(std::move(lod));
+			source = &chain.back().indices;
+		}
+
+		return chain;
+	}
+
+	float get_screen_size(const bounds& world, const vector3& camera, float fov)
+	{
+		const vector3 center = (world.min + world.max) * 0.5f;
+		const float radius = (world.max - world.min).length() * 0.5f;
+		const float distance = (center - camera).length();
+
+		if (distance <= radius)
+			return std::numeric_limits<float>::max();
+
+		return radius / (distance * tanf(fov * 0.5f));
+	}
+
+	unsigned select_lod(float screen_size, unsigned current, unsigned lod_count, float threshold, float hysteresis)
+	{
+		if (lod_count <= 1)
+			return 0;
+
+		unsigned lod = std::min(current, lod_count - 1);
+
+		// Size at which level i takes over from level i - 1
+		auto switch_size = [threshold](unsigned i) { return threshold / static_cast<float>(1u << (i - 1)); };
+
+		while (lod + 1 < lod_count && screen_size < switch_size(lod + 1) * (1.0f - hysteresis))
+			lod++;
+
+		while (lod > 0 && screen_size > switch_size(lod) * (1.0f + hysteresis))
+			lod--;
+
+		return lod;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vector3.h"
+#include "bounds.h"
+
+#include <cstddef>
+#include <vector>
+
+#define MESH_LOD_LEVELS 3 // Simplified levels generated below the full mesh, each at half the triangles of the last
+#define MESH_LOD_MAX_ERROR 0.02f // Largest simplification error, relative to the mesh extent
+#define MESH_LOD_MIN_TRIANGLES 128 // Meshes smaller than this get no LOD chain
+
+namespace efiilj
+{
+	/**
+	 * \brief Index buffer of one simplified level. Levels share the vertices of the full mesh.
+	 */
+	struct lod_level
+	{
+		std::vector<unsigned> indices;
+
+		// Simplification error relative to the mesh extent
+		float error = 0.0f;
+	};
+
+	/**
+	 * \brief Simplifies a triangle list by quadric error edge collapse (Garland and Heckbert),
+	 * moving vertices onto their neighbours so the vertex buffer is left as it is.
+	 * Mesh borders and attribute seams are preserved.
+	 * \param target_index_count Index count to stop at
+	 * \param max_error Stops before collapses whose error exceeds this, relative to the mesh extent
+	 * \param result_error Receives the largest error of the collapses made, relative to the mesh extent
+	 * \return Simplified indices, which may stay above the target when the error bound is reached first
+	 */
+	std::vector<unsigned> simplify_mesh(const std::vector<vector3>& positions, const std::vector<unsigned>& indices,
+			size_t target_index_count, float max_error, float& result_error);
+
+	/**
+	 * \brief Generates up to MESH_LOD_LEVELS levels at 1/2, 1/4 and 1/8 of the triangles, each simplified from the last
+	 * and ordered for the vertex cache. Stops early when a level can no longer be reduced within the error bound.
+	 */
+	std::vector<lod_level> generate_lod_chain(const std::vector<vector3>& positions, const std::vector<unsigned>& indices,
+			float max_error = MESH_LOD_MAX_ERROR);
+
+	/**
+	 * \brief Projected size of the bounding sphere of world bounds, as a fraction of the screen height.
+	 * \param fov Vertical field of view in radians
+	 */
+	float get_screen_size(const bounds& world, const vector3& camera, float fov);
+
+	/**
+	 * \brief Selects a level from screen size, where level i is used below threshold / 2^(i - 1).
+	 * A level is only left once the size is past the switch point by a fraction of hysteresis,
+	 * so objects hovering around a switch point don't flicker between levels.
+	 */
+	unsigned select_lod(float screen_size, unsigned current, unsigned lod_count, float threshold, float hysteresis);
+}
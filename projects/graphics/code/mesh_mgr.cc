@@ -1,5 +1,6 @@
 #include "mesh_mgr.h"
 #include "imgui.h"
+#include <GL/glew.h>
 
 namespace efiilj
 {
@@ -48,6 +49,44 @@ namespace efiilj
 					_meshes->get_vao(mid),
 					_meshes->get_vbo(mid),
 					_meshes->get_ibo(mid));
+			ImGui::BulletText("Index type: %s", 
+					_meshes->get_index_type(mid) == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit");
+
+			if (_meshes->is_pooled(mid))
+			{
+				const pool_entry& entry = _meshes->get_pool_entry(mid);
+				ImGui::BulletText("Pooled: base vertex %lu, first index %lu", 
+						entry.first_vertex, entry.first_index);
+			}
+
+			const size_t gpu_bytes = _meshes->get_gpu_bytes(mid);
+			const size_t float_bytes = _meshes->get_float_bytes(mid);
+			const size_t vertices = _meshes->get_vertex_count(mid);
+
+			ImGui::BulletText("GPU memory: %.1f KB, %.1f bytes/vertex", 
+					gpu_bytes / 1024.0f, vertices ? static_cast<float>(gpu_bytes) / vertices : 0.0f);
+
+			if (float_bytes > gpu_bytes)
+				ImGui::BulletText("Saved: %.1f KB (%.0f%%) over 32-bit floats", 
+						(float_bytes - gpu_bytes) / 1024.0f, 100.0f * (float_bytes - gpu_bytes) / float_bytes);
+
+			ImGui::BulletText("CPU copy: %s", _meshes->is_resident(mid) ? "kept" : "dropped");
+
+			if (!_meshes->get_meshlets(mid).empty())
+				ImGui::BulletText("Meshlets: %lu", _meshes->get_meshlets(mid).size());
+
+			const unsigned lod_count = _meshes->get_lod_count(mid);
+
+			if (lod_count > 1 && ImGui::TreeNode("LOD", "LOD %u of %u", _data.lod[idx], lod_count))
+			{
+				for (unsigned lod = 0; lod < lod_count; lod++)
+				{
+					ImGui::BulletText("%u: %lu triangles, error %.2f%%", 
+							lod, _meshes->get_lod_index_count(mid, lod) / 3, _meshes->get_lod_error(mid, lod) * 100.0f);
+				}
+
+				ImGui::TreePop();
+			}
 
 			ImGui::TreePop();
 		}
@@ -60,6 +99,7 @@ namespace efiilj
 
 		add_data({
 				&_data.material,
-				&_data.mesh});
+				&_data.mesh,
+				&_data.lod});
 	}
 }
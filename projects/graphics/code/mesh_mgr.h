@@ -18,6 +18,7 @@ namespace efiilj
 			{
 				ComponentData<mesh_id> mesh;
 				ComponentData<material_id> material;
+				ComponentData<unsigned> lod { 0 };
 			} _data;
 
 			std::shared_ptr<mesh_server> _meshes;
@@ -52,5 +53,18 @@ namespace efiilj
 			{
 				_data.material[idx] = material;
 			}
+
+			/**
+			 * \brief Level drawn last frame, kept so that LOD selection can apply hysteresis.
+			 */
+			unsigned get_lod(mesh_instance_id idx)
+			{
+				return _data.lod[idx];
+			}
+
+			void set_lod(mesh_instance_id idx, unsigned lod)
+			{
+				_data.lod[idx] = lod;
+			}
 	};
 }
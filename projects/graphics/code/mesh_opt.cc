@@ -0,0 +1,450 @@
+#include "mesh_opt.h"
+#include "core/hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace efiilj
+{
+	static const unsigned no_vertex = ~0u;
+
+	template<typename T>
+	static void remap_stream(std::vector<T>& stream, const std::vector<unsigned>& remap, size_t count)
+	{
+		if (stream.empty())
+			return;
+
+		std::vector<T> out(count);
+
+		for (size_t v = 0; v < remap.size(); v++)
+		{
+			if (remap[v] != no_vertex)
+				out[remap[v]] = stream[v];
+		}
+
+		stream.swap(out);
+	}
+
+	static void remap_streams(mesh_streams& mesh, const std::vector<unsigned>& remap, size_t count)
+	{
+		remap_stream(mesh.positions, remap, count);
+		remap_stream(mesh.normals, remap, count);
+		remap_stream(mesh.colors, remap, count);
+		remap_stream(mesh.uvs, remap, count);
+		remap_stream(mesh.tangents, remap, count);
+
+		for (auto& index : mesh.indices)
+			index = remap[index];
+	}
+
+	vertex_cache_stats analyze_vertex_cache(const std::vector<unsigned>& indices, size_t vertex_count, unsigned cache_size)
+	{
+		vertex_cache_stats stats;
+
+		// A vertex is cached if fewer than cache_size vertices were transformed since its own transform
+		std::vector<size_t> stamp(vertex_count, 0);
+
+		for (unsigned index : indices)
+		{
+			if (stamp[index] == 0)
+				stats.vertices++;
+
+			if (stamp[index] == 0 || stats.transforms + 1 - stamp[index] > cache_size)
+				stamp[index] = ++stats.transforms;
+		}
+
+		stats.triangles = indices.size() / 3;
+
+		return stats;
+	}
+
+	size_t deduplicate_vertices(mesh_streams& mesh)
+	{
+		const size_t vertex_count = mesh.positions.size();
+
+		auto hash_vertex = [&mesh](size_t v)
+		{
+			uint64_t hash = core::fnv1a(&mesh.positions[v], sizeof(vector3));
+
+			if (!mesh.normals.empty())
+				hash = core::fnv1a(&mesh.normals[v], sizeof(vector3), hash);
+			if (!mesh.colors.empty())
+				hash = core::fnv1a(&mesh.colors[v], sizeof(vector3), hash);
+			if (!mesh.uvs.empty())
+				hash = core::fnv1a(&mesh.uvs[v], sizeof(vector2), hash);
+			if (!mesh.tangents.empty())
+				hash = core::fnv1a(&mesh.tangents[v], sizeof(vector4), hash);
+
+			return hash;
+		};
+
+		auto equal = [&mesh](size_t a, size_t b)
+		{
+			return memcmp(&mesh.positions[a], &mesh.positions[b], sizeof(vector3)) == 0
+				&& (mesh.normals.empty() || memcmp(&mesh.normals[a], &mesh.normals[b], sizeof(vector3)) == 0)
+				&& (mesh.colors.empty() || memcmp(&mesh.colors[a], &mesh.colors[b], sizeof(vector3)) == 0)
+				&& (mesh.uvs.empty() || memcmp(&mesh.uvs[a], &mesh.uvs[b], sizeof(vector2)) == 0)
+				&& (mesh.tangents.empty() || memcmp(&mesh.tangents[a], &mesh.tangents[b], sizeof(vector4)) == 0);
+		};
+
+		// Open addressing over vertex indices, at most half full
+		size_t table_size = 1;
+
+		while (table_size < vertex_count * 2)
+			table_size <<= 1;
+
+		std::vector<unsigned> table(table_size, no_vertex);
+		std::vector<unsigned> remap(vertex_count);
+		size_t unique = 0;
+
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			size_t slot = hash_vertex(v) & (table_size - 1);
+
+			while (table[slot] != no_vertex && !equal(table[slot], v))
+				slot = (slot + 1) & (table_size - 1);
+
+			if (table[slot] == no_vertex)
+			{
+				table[slot] = static_cast<unsigned>(v);
+				remap[v] = static_cast<unsigned>(unique++);
+			}
+			else
+				remap[v] = remap[table[slot]];
+		}
+
+		if (unique == vertex_count)
+			return 0;
+
+		remap_streams(mesh, remap, unique);
+
+		return vertex_count - unique;
+	}
+
+	static float get_vertex_score(int cache_position, unsigned valence)
+	{
+		// No triangles left to draw, so the vertex is worthless
+		if (valence == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+
+		if (cache_position >= 0)
+		{
+			// The last triangle is scored flat, so its vertices are not favoured in any order
+			if (cache_position < 3)
+				score = 0.75f;
+			else
+				score = powf(1.0f - static_cast<float>(cache_position - 3) / (MESH_OPT_CACHE_SIZE - 3), 1.5f);
+		}
+
+		// Vertices with few triangles left are finished off first, to not leave lone triangles behind
+		return score + 2.0f / sqrtf(static_cast<float>(valence));
+	}
+
+	void optimize_vertex_cache(std::vector<unsigned>& indices, size_t vertex_count)
+	{
+		const size_t triangle_count = indices.size() / 3;
+
+		if (triangle_count == 0)
+			return;
+
+		// Triangles adjacent to each vertex, the first valence[v] of which are not yet emitted
+		std::vector<unsigned> valence(vertex_count, 0);
+		std::vector<unsigned> offset(vertex_count + 1, 0);
+		std::vector<unsigned> adjacency(indices.size());
+
+		for (unsigned index : indices)
+			valence[index]++;
+
+		for (size_t v = 0; v < vertex_count; v++)
+			offset[v + 1] = offset[v] + valence[v];
+
+		std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned>(i / 3);
+
+		std::vector<int> cache_position(vertex_count, -1);
+		std::vector<float> vertex_score(vertex_count);
+		std::vector<float> triangle_score(triangle_count, 0.0f);
+		std::vector<bool> emitted(triangle_count, false);
+
+		for (size_t v = 0; v < vertex_count; v++)
+			vertex_score[v] = get_vertex_score(-1, valence[v]);
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			triangle_score[t] = vertex_score[indices[t * 3]]
+				+ vertex_score[indices[t * 3 + 1]]
+				+ vertex_score[indices[t * 3 + 2]];
+		}
+
+		std::vector<unsigned> out;
+		out.reserve(indices.size());
+
+		unsigned cache[MESH_OPT_CACHE_SIZE + 3];
+		unsigned next_cache[MESH_OPT_CACHE_SIZE + 3];
+		size_t cache_count = 0;
+
+		int best = static_cast<int>(std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin());
+		size_t cursor = 0;
+
+		while (out.size() < indices.size())
+		{
+			// Nothing in the cache has triangles left, so continue with the next triangle in input order
+			if (best < 0)
+			{
+				while (emitted[cursor])
+					cursor++;
+
+				best = static_cast<int>(cursor);
+			}
+
+			const unsigned* tri = &indices[best * 3];
+
+			emitted[best] = true;
+			out.insert(out.end(), tri, tri + 3);
+
+			size_t next_count = 0;
+
+			for (int k = 0; k < 3; k++)
+			{
+				const unsigned v = tri[k];
+
+				unsigned* begin = &adjacency[offset[v]];
+				unsigned* end = begin + valence[v];
+
+				*std::find(begin, end, static_cast<unsigned>(best)) = *(end - 1);
+				valence[v]--;
+
+				next_cache[next_count++] = v;
+			}
+
+			// The emitted vertices move to the front; the rest keep their order behind them
+			for (size_t i = 0; i < cache_count; i++)
+			{
+				const unsigned v = cache[i];
+
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					next_cache[next_count++] = v;
+			}
+
+			best = -1;
+			float best_score = -1.0f;
+
+			for (size_t i = 0; i < next_count; i++)
+			{
+				const unsigned v = next_cache[i];
+
+				cache_position[v] = (i < MESH_OPT_CACHE_SIZE) ? static_cast<int>(i) : -1;
+				vertex_score[v] = get_vertex_score(cache_position[v], valence[v]);
+			}
+
+			for (size_t i = 0; i < next_count; i++)
+			{
+				const unsigned v = next_cache[i];
+
+				for (unsigned j = offset[v]; j < offset[v] + valence[v]; j++)
+				{
+					const unsigned t = adjacency[j];
+
+					triangle_score[t] = vertex_score[indices[t * 3]]
+						+ vertex_score[indices[t * 3 + 1]]
+						+ vertex_score[indices[t * 3 + 2]];
+
+					if (triangle_score[t] > best_score)
+					{
+						best_score = triangle_score[t];
+						best = static_cast<int>(t);
+					}
+				}
+			}
+
+			// Vertices pushed past the end of the cache were rescored above, and are dropped here
+			cache_count = std::min(next_count, static_cast<size_t>(MESH_OPT_CACHE_SIZE));
+			std::copy(next_cache, next_cache + cache_count, cache);
+		}
+
+		indices.swap(out);
+	}
+
+	struct triangle_cluster
+	{
+		size_t first, count;
+		float sort_key;
+	};
+
+	void optimize_overdraw(std::vector<unsigned>& indices, const std::vector<vector3>& positions, float threshold)
+	{
+		const size_t triangle_count = indices.size() / 3;
+
+		if (triangle_count == 0)
+			return;
+
+		const float mesh_acmr = analyze_vertex_cache(indices, positions.size()).acmr();
+
+		// Clusters restart the simulated cache, as they will not follow the same triangles once sorted
+		std::vector<size_t> stamp(positions.size(), 0);
+		std::vector<triangle_cluster> clusters;
+
+		size_t transforms = 0, cluster_base = 0, cluster_transforms = 0, cluster_first = 0;
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			size_t misses = 0;
+
+			for (int k = 0; k < 3; k++)
+			{
+				const unsigned v = indices[t * 3 + k];
+
+				if (stamp[v] <= cluster_base || transforms + 1 - stamp[v] > MESH_OPT_FIFO_SIZE)
+				{
+					stamp[v] = ++transforms;
+					misses++;
+				}
+			}
+
+			cluster_transforms += misses;
+
+			const size_t cluster_triangles = t + 1 - cluster_first;
+
+			// Split once the cluster has paid off its cold start, staying close to the ACMR of the whole mesh
+			if (cluster_transforms <= threshold * mesh_acmr * cluster_triangles)
+			{
+				clusters.push_back({ cluster_first, cluster_triangles, 0.0f });
+
+				cluster_first = t + 1;
+				cluster_base = transforms;
+				cluster_transforms = 0;
+			}
+		}
+
+		if (cluster_first < triangle_count)
+			clusters.push_back({ cluster_first, triangle_count - cluster_first, 0.0f });
+
+		if (clusters.size() < 2)
+			return;
+
+		auto get_triangle = [&](size_t t, vector3& centroid, vector3& normal)
+		{
+			const vector3& a = positions[indices[t * 3]];
+			const vector3& b = positions[indices[t * 3 + 1]];
+			const vector3& c = positions[indices[t * 3 + 2]];
+
+			// Length of the cross product is twice the area, which weights both sums
+			normal = vector3::cross(b - a, c - a);
+			centroid = (a + b + c) / 3.0f;
+		};
+
+		vector3 mesh_centroid;
+		float mesh_area = 0.0f;
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			vector3 centroid, normal;
+			get_triangle(t, centroid, normal);
+
+			const float area = normal.length();
+
+			mesh_centroid += centroid * area;
+			mesh_area += area;
+		}
+
+		if (mesh_area > 0.0f)
+			mesh_centroid /= mesh_area;
+
+		for (auto& cluster : clusters)
+		{
+			vector3 cluster_centroid, cluster_normal;
+			float cluster_area = 0.0f;
+
+			for (size_t t = cluster.first; t < cluster.first + cluster.count; t++)
+			{
+				vector3 centroid, normal;
+				get_triangle(t, centroid, normal);
+
+				const float area = normal.length();
+
+				cluster_centroid += centroid * area;
+				cluster_normal += normal;
+				cluster_area += area;
+			}
+
+			if (cluster_area > 0.0f)
+				cluster_centroid /= cluster_area;
+
+			const float normal_length = cluster_normal.length();
+
+			// Clusters far out along their own facing are likely to occlude the rest, so go first
+			cluster.sort_key = normal_length > 0.0f
+				? vector3::dot(cluster_centroid - mesh_centroid, cluster_normal / normal_length)
+				: 0.0f;
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const triangle_cluster& a, const triangle_cluster& b)
+				{
+					return a.sort_key > b.sort_key;
+				});
+
+		std::vector<unsigned> out;
+		out.reserve(indices.size());
+
+		for (const auto& cluster : clusters)
+			out.insert(out.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+
+		indices.swap(out);
+	}
+
+	void optimize_vertex_fetch(mesh_streams& mesh)
+	{
+		std::vector<unsigned> remap(mesh.positions.size(), no_vertex);
+		unsigned next = 0;
+
+		for (unsigned index : mesh.indices)
+		{
+			if (remap[index] == no_vertex)
+				remap[index] = next++;
+		}
+
+		remap_streams(mesh, remap, next);
+	}
+
+	mesh_opt_report optimize_mesh(mesh_streams& mesh)
+	{
+		mesh_opt_report report;
+
+		const size_t vertex_count = mesh.positions.size();
+
+		auto matches = [vertex_count](size_t size) { return size == 0 || size == vertex_count; };
+
+		bool valid = vertex_count > 0 && !mesh.indices.empty() && mesh.indices.size() % 3 == 0
+			&& matches(mesh.normals.size()) && matches(mesh.colors.size())
+			&& matches(mesh.uvs.size()) && matches(mesh.tangents.size());
+
+		for (size_t i = 0; valid && i < mesh.indices.size(); i++)
+			valid = mesh.indices[i] < vertex_count;
+
+		report.vertices_before = vertex_count;
+
+		if (!valid)
+		{
+			report.vertices_after = vertex_count;
+			return report;
+		}
+
+		report.before = analyze_vertex_cache(mesh.indices, vertex_count);
+
+		deduplicate_vertices(mesh);
+		optimize_vertex_cache(mesh.indices, mesh.positions.size());
+		optimize_overdraw(mesh.indices, mesh.positions);
+		optimize_vertex_fetch(mesh);
+
+		report.after = analyze_vertex_cache(mesh.indices, mesh.positions.size());
+		report.vertices_after = mesh.positions.size();
+
+		return report;
+	}
+}
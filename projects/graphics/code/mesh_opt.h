@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vector2.h"
+#include "vector3.h"
+#include "vector4.h"
+
+#include <cstddef>
+#include <vector>
+
+#define MESH_OPT_CACHE_SIZE 32 // Cache modelled by the vertex cache optimiser
+#define MESH_OPT_FIFO_SIZE 16 // FIFO cache simulated for ACMR/ATVR statistics
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+namespace efiilj
+{
+	/**
+	 * \brief References to the streams of one triangle mesh. Streams may be empty, but those that are not
+	 * must hold one element per position.
+	 */
+	struct mesh_streams
+	{
+		std::vector<vector3>& positions;
+		std::vector<vector3>& normals;
+		std::vector<vector3>& colors;
+		std::vector<vector2>& uvs;
+		std::vector<vector4>& tangents;
+		std::vector<unsigned>& indices;
+	};
+
+	/**
+	 * \brief Post-transform cache behaviour of an index buffer, from a simulated FIFO cache.
+	 */
+	struct vertex_cache_stats
+	{
+		size_t triangles = 0;
+		size_t vertices = 0;
+		size_t transforms = 0;
+
+		// Average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst)
+		float acmr() const { return triangles ? static_cast<float>(transforms) / triangles : 0.0f; }
+
+		// Average transform to vertex ratio (1 at best)
+		float atvr() const { return vertices ? static_cast<float>(transforms) / vertices : 0.0f; }
+
+		void add(const vertex_cache_stats& other)
+		{
+			triangles += other.triangles;
+			vertices += other.vertices;
+			transforms += other.transforms;
+		}
+	};
+
+	struct mesh_opt_report
+	{
+		vertex_cache_stats before, after;
+		size_t vertices_before = 0, vertices_after = 0;
+
+		void add(const mesh_opt_report& other)
+		{
+			before.add(other.before);
+			after.add(other.after);
+			vertices_before += other.vertices_before;
+			vertices_after += other.vertices_after;
+		}
+	};
+
+	/**
+	 * \brief Simulates a FIFO post-transform cache over an index buffer.
+	 */
+	vertex_cache_stats analyze_vertex_cache(const std::vector<unsigned>& indices, size_t vertex_count,
+			unsigned cache_size = MESH_OPT_FIFO_SIZE);
+
+	/**
+	 * \brief Merges vertices that are bitwise identical across every stream, and rewrites the indices.
+	 * \return Number of vertices removed
+	 */
+	size_t deduplicate_vertices(mesh_streams& mesh);
+
+	/**
+	 * \brief Reorders triangles for the post-transform cache with Tom Forsyth's linear-speed algorithm.
+	 */
+	void optimize_vertex_cache(std::vector<unsigned>& indices, size_t vertex_count);
+
+	/**
+	 * \brief Splits cache-ordered triangles into clusters and sorts them outside-in, so that the outer surfaces
+	 * of a mesh tend to be drawn before what they occlude (Sander et al., Tipsify).
+	 * \param threshold How much the cluster ACMR may exceed that of the whole mesh, trading cache
+	 * efficiency for smaller clusters and finer ordering
+	 */
+	void optimize_overdraw(std::vector<unsigned>& indices, const std::vector<vector3>& positions,
+			float threshold = MESH_OPT_OVERDRAW_THRESHOLD);
+
+	/**
+	 * \brief Renumbers vertices in order of first use by the indices, so vertex fetch walks memory forwards.
+	 * Unreferenced vertices are dropped.
+	 */
+	void optimize_vertex_fetch(mesh_streams& mesh);
+
+	/**
+	 * \brief Runs deduplication, cache ordering, overdraw ordering and fetch remapping in turn.
+	 * Meshes that are not indexed triangle lists are left as they are.
+	 */
+	mesh_opt_report optimize_mesh(mesh_streams& mesh);
+}
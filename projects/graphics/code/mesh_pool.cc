@@ -0,0 +1,138 @@
+#include "mesh_pool.h"
+
+#include <algorithm>
+
+namespace efiilj
+{
+	range_allocator::range_allocator(size_t capacity)
+		: _capacity(0), _used(0)
+	{
+		grow(capacity);
+	}
+
+	bool range_allocator::allocate(size_t count, size_t& offset)
+	{
+		if (count == 0)
+		{
+			offset = 0;
+			return true;
+		}
+
+		for (size_t i = 0; i < _free.size(); i++)
+		{
+			range& r = _free[i];
+
+			if (r.count < count)
+				continue;
+
+			offset = r.offset;
+			r.offset += count;
+			r.count -= count;
+
+			if (r.count == 0)
+				_free.erase(_free.begin() + i);
+
+			_used += count;
+			return true;
+		}
+
+		return false;
+	}
+
+	void range_allocator::free(size_t offset, size_t count)
+	{
+		if (count == 0)
+			return;
+
+		// Free list is kept sorted by offset, so neighbours can be merged in place
+		auto it = std::lower_bound(_free.begin(), _free.end(), offset,
+				[](const range& r, size_t off) { return r.offset < off; });
+
+		it = _free.insert(it, { offset, count });
+		_used -= count;
+
+		auto next = it + 1;
+		if (next != _free.end() && it->offset + it->count == next->offset)
+		{
+			it->count += next->count;
+			_free.erase(next);
+		}
+
+		if (it != _free.begin())
+		{
+			auto prev = it - 1;
+			if (prev->offset + prev->count == it->offset)
+			{
+				prev->count += it->count;
+				_free.erase(it);
+			}
+		}
+	}
+
+	void range_allocator::grow(size_t capacity)
+	{
+		if (capacity <= _capacity)
+			return;
+
+		size_t added = capacity - _capacity;
+
+		if (!_free.empty() && _free.back().offset + _free.back().count == _capacity)
+			_free.back().count += added;
+		else
+			_free.push_back({ _capacity, added });
+
+		_capacity = capacity;
+	}
+
+	void range_allocator::clear()
+	{
+		_free.clear();
+		_used = 0;
+
+		if (_capacity > 0)
+			_free.push_back({ 0, _capacity });
+	}
+
+	size_t build_indirect_commands(const pool_draw* draws, size_t count, std::vector<DrawElementsIndirectCommand>& commands)
+	{
+		// Only merge with commands generated by this call
+		size_t first = commands.size();
+		size_t visible = 0;
+
+		commands.reserve(first + count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const pool_draw& draw = draws[i];
+
+			if (!draw.visible || draw.entry.index_count == 0)
+				continue;
+
+			visible++;
+
+			if (commands.size() > first)
+			{
+				DrawElementsIndirectCommand& last = commands.back();
+
+				if (last.first_index == draw.entry.first_index
+						&& last.count == draw.entry.index_count
+						&& last.base_vertex == static_cast<int>(draw.entry.first_vertex)
+						&& last.base_instance + last.instance_count == draw.slot)
+				{
+					last.instance_count++;
+					continue;
+				}
+			}
+
+			commands.push_back({
+					static_cast<unsigned>(draw.entry.index_count),
+					1,
+					static_cast<unsigned>(draw.entry.first_index),
+					static_cast<int>(draw.entry.first_vertex),
+					draw.slot
+			});
+		}
+
+		return visible;
+	}
+}
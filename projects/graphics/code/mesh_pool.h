@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace efiilj
+{
+	/**
+	 * \brief Layout of a single indirect draw record, as consumed by glMultiDrawElementsIndirect.
+	 */
+	struct DrawElementsIndirectCommand
+	{
+		unsigned count;
+		unsigned instance_count;
+		unsigned first_index;
+		int base_vertex;
+		unsigned base_instance;
+	};
+
+	/**
+	 * \brief Location of a mesh inside the shared vertex and index buffers.
+	 */
+	struct pool_entry
+	{
+		size_t first_vertex = 0;
+		size_t vertex_count = 0;
+		size_t first_index = 0;
+		size_t index_count = 0;
+	};
+
+	/**
+	 * \brief A single candidate draw, referring to a pooled mesh and a per-draw data slot.
+	 */
+	struct pool_draw
+	{
+		pool_entry entry;
+		unsigned slot;
+		bool visible;
+	};
+
+	/**
+	 * \brief First-fit free-list allocator over a linear range of elements.
+	 * Does not own any memory -- only hands out offsets, so it can be used for GPU buffers.
+	 */
+	class range_allocator
+	{
+		private:
+
+			struct range
+			{
+				size_t offset;
+				size_t count;
+			};
+
+			std::vector<range> _free;
+
+			size_t _capacity;
+			size_t _used;
+
+		public:
+
+			range_allocator(size_t capacity = 0);
+
+			/**
+			 * \brief Reserves a contiguous range of elements.
+			 * \param count Number of elements to reserve
+			 * \param offset Receives the first element of the range
+			 * \return True if a range was found, false if the allocator needs to grow
+			 */
+			bool allocate(size_t count, size_t& offset);
+
+			/**
+			 * \brief Returns a range to the allocator, merging it with adjacent free ranges.
+			 */
+			void free(size_t offset, size_t count);
+
+			/**
+			 * \brief Extends the managed range -- the new tail is appended as free space.
+			 */
+			void grow(size_t capacity);
+
+			void clear();
+
+			size_t get_capacity() const { return _capacity; }
+			size_t get_used() const { return _used; }
+			size_t get_fragments() const { return _free.size(); }
+	};
+
+	/**
+	 * \brief Generates indirect draw commands from a list of candidate draws.
+	 * Invisible draws are compacted away, and consecutive draws of the same mesh
+	 * with consecutive slots are merged into a single instanced command.
+	 * \param draws Candidate draws, in submission order
+	 * \param count Number of candidate draws
+	 * \param commands Generated commands are appended to this vector
+	 * \return Number of visible draws represented by the new commands
+	 */
+	size_t build_indirect_commands(const pool_draw* draws, size_t count, std::vector<DrawElementsIndirectCommand>& commands);
+}
@@ -2,12 +2,64 @@
 
 #include <GL/glew.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace efiilj
 {
+	static unsigned grow_buffer(unsigned old, size_t old_size, size_t new_size)
+	{
+		unsigned buf;
+
+		glGenBuffers(1, &buf);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+		glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, GL_STATIC_DRAW);
+
+		if (old != 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, old);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+			glDeleteBuffers(1, &old);
+		}
+
+		return buf;
+	}
+
+	static unsigned get_gl_type(vertex_component type)
+	{
+		switch (type)
+		{
+			case vertex_component::float16: return GL_HALF_FLOAT;
+			case vertex_component::snorm16: return GL_SHORT;
+			case vertex_component::unorm16: return GL_UNSIGNED_SHORT;
+			default: return GL_FLOAT;
+		}
+	}
 	
+	template<typename T>
+	static void write_levels(T* out, const std::vector<unsigned>& indices, const std::vector<lod_level>& lods)
+	{
+		auto narrow = [](unsigned i) { return static_cast<T>(i); };
+
+		out = std::transform(indices.begin(), indices.end(), out, narrow);
+
+		for (const auto& lod : lods)
+			out = std::transform(lod.indices.begin(), lod.indices.end(), out, narrow);
+	}
+
 	mesh_server::mesh_server()
-		: _current_vao(0)
+		: _current_vao(0), _generation(0), _dropped_bytes(0), _optimize(true), _generate_lods(true), _build_meshlets(true)
 	{
+		add_columns({
+			&_data.positions, &_data.normals, &_data.colors, &_data.uvs, &_data.tangents,
+			&_data.indices, &_data.hull, &_data.lods, &_data.lod_ranges, &_data.meshlets,
+			&_data.bbox, &_data.center, &_data.material, &_data.usage, &_data.mode, &_data.vao,
+			&_data.vbo, &_data.ibo, &_data.index_type, &_data.vertex_count, &_data.index_count,
+			&_data.attribs, &_data.quant, &_data.packed, &_data.packed_attribs, &_data.gpu_bytes, &_data.entry, &_data.pooled,
+			&_data.optimized, &_data.lod_ready, &_data.keep_data, &_data.resident, &_data.state,
+			&_data.uri
+		});
+
 		printf("Init mesh...\n");
 	}
 
@@ -24,6 +76,10 @@ namespace efiilj
 		_data.uvs.emplace_back();
 		_data.tangents.emplace_back();
 		_data.indices.emplace_back();
+		_data.hull.emplace_back();
+		_data.lods.emplace_back();
+		_data.lod_ranges.emplace_back();
+		_data.meshlets.emplace_back();
 		_data.bbox.emplace_back();
 		_data.center.emplace_back();
 		_data.material.emplace_back(-1);
@@ -32,7 +88,174 @@ namespace efiilj
 		_data.vao.emplace_back(0);
 		_data.vbo.emplace_back(0);
 		_data.ibo.emplace_back(0);
+		_data.index_type.emplace_back(GL_UNSIGNED_INT);
+		_data.vertex_count.emplace_back(0);
+		_data.index_count.emplace_back(0);
+		_data.attribs.emplace_back(0);
+		_data.quant.emplace_back();
+		_data.packed.emplace_back();
+		_data.packed_attribs.emplace_back(0);
+		_data.gpu_bytes.emplace_back(0);
+		_data.entry.emplace_back();
+		_data.pooled.emplace_back(false);
+		_data.optimized.emplace_back(false);
+		_data.lod_ready.emplace_back(false);
+		_data.keep_data.emplace_back(false);
+		_data.resident.emplace_back(true);
 		_data.state.emplace_back(false);
+		_data.uri.emplace_back();
+	}
+
+	void mesh_server::on_end_frame()
+	{
+		for (mesh_id idx : _uploaded)
+			drop_data(idx);
+
+		_uploaded.clear();
+	}
+
+	bool mesh_server::destroy(mesh_id idx)
+	{
+		// A stale handle would release whatever now lives in its slot
+		if (!is_valid(idx))
+			return false;
+
+		release(idx);
+		return server::destroy(idx);
+	}
+
+	void mesh_server::release(mesh_id idx)
+	{
+		// The data is about to change, so later lookups must not find it under the old content
+		unshare(idx);
+
+		if (_data.pooled[idx])
+		{
+			const pool_entry& entry = _data.entry[idx];
+
+			_mega.vertices.free(entry.first_vertex, entry.vertex_count);
+			_mega.indices.free(entry.first_index, entry.index_count);
+
+			for (const lod_range& range : _data.lod_ranges[idx])
+				_mega.indices.free(range.first_index, range.index_count);
+
+			_data.entry[idx] = pool_entry();
+			_data.pooled[idx] = false;
+		}
+		else if (_data.vao[idx] != 0)
+		{
+			glDeleteVertexArrays(1, &_data.vao[idx]);
+			glDeleteBuffers(1, &_data.vbo[idx]);
+			glDeleteBuffers(1, &_data.ibo[idx]);
+		}
+
+		if (_current_vao == _data.vao[idx])
+			_current_vao = 0;
+
+		_data.vao[idx] = 0;
+		_data.vbo[idx] = 0;
+		_data.ibo[idx] = 0;
+		_data.gpu_bytes[idx] = 0;
+		_data.state[idx] = false;
+		_data.optimized[idx] = false;
+		_data.lod_ready[idx] = false;
+		_data.lods[idx].clear();
+		_data.lod_ranges[idx].clear();
+		_data.meshlets[idx].clear();
+
+		_generation++;
+	}
+
+	mesh_opt_report mesh_server::optimize(mesh_id idx)
+	{
+		// Renumbered vertices would invalidate the indices of any existing chain
+		_data.lods[idx].clear();
+		_data.lod_ready[idx] = false;
+		_data.meshlets[idx].clear();
+
+		mesh_streams streams = { 
+			_data.positions[idx], 
+			_data.normals[idx], 
+			_data.colors[idx], 
+			_data.uvs[idx], 
+			_data.tangents[idx], 
+			_data.indices[idx] 
+		};
+
+		auto start = std::chrono::steady_clock::now();
+
+		mesh_opt_report report = optimize_mesh(streams);
+
+		const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		_data.optimized[idx] = true;
+		_opt_report.add(report);
+
+		// Built-in primitives are too small to be worth a line each
+		if (!_data.uri[idx].empty())
+		{
+			printf("Mesh %d optimised in %.2f ms: %lu -> %lu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", 
+					idx, ms, report.vertices_before, report.vertices_after,
+					report.before.acmr(), report.after.acmr(), report.before.atvr(), report.after.atvr());
+		}
+
+		return report;
+	}
+
+	void mesh_server::generate_lods(mesh_id idx)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		_data.lods[idx] = generate_lod_chain(_data.positions[idx], _data.indices[idx]);
+		_data.lod_ready[idx] = true;
+
+		const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (_data.uri[idx].empty() || _data.lods[idx].empty())
+			return;
+
+		printf("Mesh %d: %lu LODs generated in %.2f ms:", idx, _data.lods[idx].size(), ms);
+
+		for (const auto& lod : _data.lods[idx])
+			printf(" %lu tris (%.2f%%)", lod.indices.size() / 3, lod.error * 100.0f);
+
+		printf("\n");
+	}
+
+	void mesh_server::generate_meshlets(mesh_id idx)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		build_meshlets(_data.positions[idx], _data.indices[idx], _data.meshlets[idx]);
+
+		const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (_data.uri[idx].empty() || _data.meshlets[idx].empty())
+			return;
+
+		printf("Mesh %d: %lu meshlets built in %.2f ms, %.1f tris each\n", idx, _data.meshlets[idx].size(), ms,
+				_data.indices[idx].size() / 3.0f / _data.meshlets[idx].size());
+	}
+
+	void mesh_server::set_lods(mesh_id idx, std::vector<lod_level>& lods)
+	{
+		_data.lods[idx] = std::move(lods);
+		_data.lod_ready[idx] = true;
+	}
+
+	pool_entry mesh_server::get_pool_entry(mesh_id idx, unsigned lod) const
+	{
+		pool_entry entry = _data.entry[idx];
+
+		if (lod > 0 && lod <= _data.lod_ranges[idx].size())
+		{
+			const lod_range& range = _data.lod_ranges[idx][lod - 1];
+
+			entry.first_index = range.first_index;
+			entry.index_count = range.index_count;
+		}
+
+		return entry;
 	}
 
 	bool mesh_server::bind(mesh_id idx)
@@ -58,8 +281,37 @@ namespace efiilj
 		if (_data.vao[idx] != 0)
 			return false;
 
+		if (!_data.resident[idx])
+		{
+			fprintf(stderr, "Err: Mesh %d - CPU data was dropped after upload, set new data before building\n", idx);
+			return false;
+		}
+
 		_data.usage[idx] = usage;
 
+		// Dynamic meshes are rewritten in place, so their vertex order must stay as given
+		if (_optimize && usage == GL_STATIC_DRAW && _data.mode[idx] == GL_TRIANGLES && !_data.optimized[idx]
+				&& _data.packed[idx].empty())
+			optimize(idx);
+
+		if (_generate_lods && usage == GL_STATIC_DRAW && _data.mode[idx] == GL_TRIANGLES && !_data.lod_ready[idx])
+			generate_lods(idx);
+
+		// Meshlets reorder the triangles of the full level, so they are built after optimisation
+		if (_build_meshlets && usage == GL_STATIC_DRAW && _data.mode[idx] == GL_TRIANGLES && _data.meshlets[idx].empty()
+				&& _data.indices[idx].size() / 3 >= MESHLET_MIN_TRIANGLES)
+			generate_meshlets(idx);
+
+		_data.vertex_count[idx] = _data.positions[idx].size();
+		_data.index_count[idx] = _data.indices[idx].size();
+		_data.attribs[idx] = get_attribs(idx);
+
+		if (usage == GL_STATIC_DRAW)
+			_uploaded.push_back(idx);
+
+		if (_mega.enabled && usage == GL_STATIC_DRAW && _data.mode[idx] == GL_TRIANGLES)
+			return build_pooled(idx);
+
 		glGenVertexArrays(1, &_data.vao[idx]);
 		glBindVertexArray(_data.vao[idx]);
 
@@ -69,67 +321,400 @@ namespace efiilj
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _data.ibo[idx]);
 		glBindBuffer(GL_ARRAY_BUFFER, _data.vbo[idx]);
 
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
-				get_index_count(idx) * sizeof(unsigned int), _data.indices[idx].data(), GL_STATIC_DRAW);
+		// LOD levels follow the full mesh in the same index buffer
+		auto& ranges = _data.lod_ranges[idx];
+		size_t total = _data.indices[idx].size();
+
+		ranges.clear();
+
+		for (const auto& lod : _data.lods[idx])
+		{
+			ranges.push_back({ total, lod.indices.size(), lod.error });
+			total += lod.indices.size();
+		}
+
+		// Small meshes keep 16-bit indices on the GPU, halving index memory
+		const bool narrow = _data.vertex_count[idx] <= 0x10000;
+		const size_t size = total * (narrow ? sizeof(unsigned short) : sizeof(unsigned));
 
-		size_t stride = 0;
+		_data.index_type[idx] = narrow ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-		stride += has_position_data(idx) * sizeof(vector3);
-		stride += has_normal_data(idx)  * sizeof(vector3);
-		stride += has_uv_data(idx) * sizeof(vector2);
-		stride += has_tangent_data(idx) * sizeof(vector4);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
 
-		glBufferData(GL_ARRAY_BUFFER, get_vertex_count(idx) * stride, NULL, usage);
+		// Levels are written (and narrowed) straight into the mapped buffer, without staging a combined copy
+		if (size > 0)
+		{
+			void* mapped = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+			if (mapped == nullptr)
+			{
+				fprintf(stderr, "Err: Mesh %d - failed to map index buffer\n", idx);
+				return false;
+			}
+
+			if (narrow)
+				write_levels(static_cast<unsigned short*>(mapped), _data.indices[idx], _data.lods[idx]);
+			else
+				write_levels(static_cast<unsigned*>(mapped), _data.indices[idx], _data.lods[idx]);
 
-		buffer(idx);
+			if (glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_FALSE)
+			{
+				fprintf(stderr, "Err: Mesh %d - index buffer was lost while mapped\n", idx);
+				return false;
+			}
+		}
+
+		if (!buffer(idx))
+			return false;
 
 		_data.state[idx] = true;
 
 		return true;
 	}
 
-	bool mesh_server::buffer(mesh_id idx)
+	bool mesh_server::build_pooled(mesh_id idx)
 	{
+		size_t vertex_count = _data.vertex_count[idx];
+		size_t index_count = _data.index_count[idx];
 
-		bind(idx);
+		// Every pooled mesh shares one vertex format, so missing streams are zero-filled
+		std::vector<unsigned char> vertices;
+
+		if (!get_upload_vertices(idx, _pool_layout, attrib_mask_all, vertices))
+			return false;
+
+		pool_entry& entry = _data.entry[idx];
+
+		while (!_mega.vertices.allocate(vertex_count, entry.first_vertex))
+			grow_pool(vertex_count, 0);
+
+		while (!_mega.indices.allocate(index_count, entry.first_index))
+			grow_pool(0, index_count);
+
+		entry.vertex_count = vertex_count;
+		entry.index_count = index_count;
+
+		const unsigned stride = _pool_layout.get_vertex_size(attrib_mask_all);
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _mega.vbo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 
+				entry.first_vertex * stride, vertices.size(), vertices.data());
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _mega.ibo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 
+				entry.first_index * sizeof(unsigned), index_count * sizeof(unsigned), _data.indices[idx].data());
+
+		auto& ranges = _data.lod_ranges[idx];
+		size_t lod_indices = 0;
+
+		ranges.clear();
+
+		for (const auto& lod : _data.lods[idx])
+		{
+			lod_range range = { 0, lod.indices.size(), lod.error };
+
+			while (!_mega.indices.allocate(range.index_count, range.first_index))
+				grow_pool(0, range.index_count);
+
+			// Growing reallocates the index buffer
+			glBindBuffer(GL_COPY_WRITE_BUFFER, _mega.ibo);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 
+					range.first_index * sizeof(unsigned), range.index_count * sizeof(unsigned), lod.indices.data());
+
+			ranges.push_back(range);
+			lod_indices += range.index_count;
+		}
+
+		_data.vao[idx] = _mega.vao;
+		_data.vbo[idx] = _mega.vbo;
+		_data.ibo[idx] = _mega.ibo;
+		_data.gpu_bytes[idx] = vertices.size() + (index_count + lod_indices) * sizeof(unsigned);
+		_data.pooled[idx] = true;
+		_data.state[idx] = true;
+
+		return true;
+	}
+
+	bool mesh_server::enable_pool(size_t vertex_capacity, size_t index_capacity)
+	{
+		if (_mega.enabled)
+			return true;
 
-		size_t offset = 0;
-		if (has_position_data(idx))
+		if (!GLEW_ARB_multi_draw_indirect || !GLEW_ARB_base_instance)
 		{
-			size_t size = _data.positions[idx].size() * sizeof(vector3);
-			glBufferSubData(GL_ARRAY_BUFFER, offset, size, _data.positions[idx].data());
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-			offset += size;
+			fprintf(stderr, "Err: Multi-draw-indirect unsupported, mesh pool disabled\n");
+			return false;
 		}
 
-		if (has_normal_data(idx))
+		_pool_layout.flags = _layout.flags | layout_interleaved;
+
+		glGenVertexArrays(1, &_mega.vao);
+		glGenBuffers(1, &_mega.mbo);
+		glGenBuffers(1, &_mega.qbo);
+		glGenBuffers(1, &_mega.dibo);
+
+		_mega.model_capacity = 256;
+
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.mbo);
+		glBufferData(GL_ARRAY_BUFFER, _mega.model_capacity * sizeof(matrix4), nullptr, GL_STREAM_DRAW);
+
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.qbo);
+		glBufferData(GL_ARRAY_BUFFER, _mega.model_capacity * 2 * sizeof(vector4), nullptr, GL_STREAM_DRAW);
+
+		grow_pool(vertex_capacity, index_capacity);
+
+		_mega.enabled = true;
+
+		printf("Mesh pool enabled: %lu vertices of %u bytes, %lu indices\n", 
+				_mega.vertices.get_capacity(), _pool_layout.get_vertex_size(attrib_mask_all), _mega.indices.get_capacity());
+
+		return true;
+	}
+
+	void mesh_server::grow_pool(size_t vertex_count, size_t index_count)
+	{
+		size_t v_cap = _mega.vertices.get_capacity();
+		size_t i_cap = _mega.indices.get_capacity();
+
+		const unsigned stride = _pool_layout.get_vertex_size(attrib_mask_all);
+
+		if (vertex_count > 0 || _mega.vbo == 0)
 		{
-			size_t size = _data.normals[idx].size() * sizeof(vector3);
-			glBufferSubData(GL_ARRAY_BUFFER, offset, size, _data.normals[idx].data());
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-			offset += size;
+			size_t new_cap = std::max(v_cap * 2, v_cap + vertex_count);
+			_mega.vbo = grow_buffer(_mega.vbo, v_cap * stride, new_cap * stride);
+			_mega.vertices.grow(new_cap);
 		}
 
-		if (has_uv_data(idx))
+		if (index_count > 0 || _mega.ibo == 0)
 		{
-			size_t size = _data.uvs[idx].size() * sizeof(vector2);
-			glBufferSubData(GL_ARRAY_BUFFER, offset, size, _data.uvs[idx].data());
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-			offset += size;
+			size_t new_cap = std::max(i_cap * 2, i_cap + index_count);
+			_mega.ibo = grow_buffer(_mega.ibo, i_cap * sizeof(unsigned), new_cap * sizeof(unsigned));
+			_mega.indices.grow(new_cap);
 		}
 
-		if (has_tangent_data(idx))
+		for (mesh_id idx : _pool)
 		{
-			size_t size = _data.tangents[idx].size() * sizeof(vector4);
-			glBufferSubData(GL_ARRAY_BUFFER, offset, size, _data.tangents[idx].data());
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-			offset += size;
+			if (!_data.pooled[idx])
+				continue;
+
+			_data.vbo[idx] = _mega.vbo;
+			_data.ibo[idx] = _mega.ibo;
 		}
 
+		setup_pool_layout();
+	}
+
+	void mesh_server::setup_pool_layout()
+	{
+		_current_vao = _mega.vao;
+		glBindVertexArray(_mega.vao);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _mega.ibo);
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.vbo);
+
+		set_attributes(_pool_layout, attrib_mask_all, 0);
+
+		// Per-draw model matrix occupies four consecutive attribute slots
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.mbo);
+
+		for (unsigned i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(VERTEX_ATTRIB_MODEL + i);
+			glVertexAttribPointer(VERTEX_ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(matrix4), (void*)(i * sizeof(vector4)));
+			glVertexAttribDivisor(VERTEX_ATTRIB_MODEL + i, 1);
+		}
+
+		if (!(_pool_layout.flags & layout_quantized_positions))
+			return;
+
+		// Per-draw position offset and scale, following the model matrices
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.qbo);
+
+		glEnableVertexAttribArray(VERTEX_ATTRIB_QUANT_OFFSET);
+		glVertexAttribPointer(VERTEX_ATTRIB_QUANT_OFFSET, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(vector4), nullptr);
+		glVertexAttribDivisor(VERTEX_ATTRIB_QUANT_OFFSET, 1);
+
+		glEnableVertexAttribArray(VERTEX_ATTRIB_QUANT_SCALE);
+		glVertexAttribPointer(VERTEX_ATTRIB_QUANT_SCALE, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(vector4), (void*)sizeof(vector4));
+		glVertexAttribDivisor(VERTEX_ATTRIB_QUANT_SCALE, 1);
+	}
+
+	void mesh_server::set_attributes(const vertex_layout& layout, unsigned attribs, size_t vertex_count)
+	{
+		// Attribute locations follow the order of vertex_attribute
+		for (unsigned i = 0; i < attrib_count; i++)
+		{
+			if (!(attribs & (1u << i)))
+			{
+				glDisableVertexAttribArray(i);
+				continue;
+			}
+
+			const vertex_attribute attrib = static_cast<vertex_attribute>(i);
+			const vertex_element element = layout.get_element(attrib);
+
+			size_t offset;
+			unsigned stride;
+
+			layout.get_placement(attrib, attribs, vertex_count, offset, stride);
+
+			const bool normalized = element.type == vertex_component::snorm16 || element.type == vertex_component::unorm16;
+
+			glEnableVertexAttribArray(i);
+			glVertexAttribPointer(i, element.components, get_gl_type(element.type), 
+					normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+		}
+	}
+
+	unsigned mesh_server::get_attribs(mesh_id idx) const
+	{
+		if (!_data.packed[idx].empty())
+			return _data.packed_attribs[idx];
+
+		unsigned attribs = 0;
+
+		attribs |= has_position_data(idx) ? 1u << attrib_position : 0;
+		attribs |= has_normal_data(idx) ? 1u << attrib_normal : 0;
+		attribs |= has_uv_data(idx) ? 1u << attrib_uv : 0;
+		attribs |= has_tangent_data(idx) ? 1u << attrib_tangent : 0;
+
+		return attribs;
+	}
+
+	bool mesh_server::get_upload_vertices(mesh_id idx, const vertex_layout& layout, unsigned attribs, std::vector<unsigned char>& out)
+	{
+		auto& packed = _data.packed[idx];
+
+		if (packed.empty())
+		{
+			if (layout.flags & layout_quantized_positions)
+				_data.quant[idx] = get_quantization(_data.positions[idx]);
+
+			pack_vertices(layout, attribs, _data.quant[idx],
+					_data.positions[idx], 
+					_data.normals[idx], 
+					_data.uvs[idx], 
+					_data.tangents[idx], 
+					out);
+
+			return true;
+		}
+
+		// Used once, the buffer is all that needs them afterwards
+		out.swap(packed);
+		std::vector<unsigned char>().swap(packed);
+
+		if (out.size() != _data.positions[idx].size() * layout.get_vertex_size(attribs))
+		{
+			fprintf(stderr, "Err: Mesh %d - packed vertices do not match the vertex layout\n", idx);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool mesh_server::bind_pool()
+	{
+		if (!_mega.enabled)
+			return false;
+
+		if (_current_vao == _mega.vao)
+			return true;
+
+		_current_vao = _mega.vao;
+		glBindVertexArray(_current_vao);
+		return true;
+	}
+
+	void mesh_server::set_draw_models(const std::vector<matrix4>& models, const std::vector<mesh_id>& meshes)
+	{
+		if (!_mega.enabled)
+			return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.mbo);
+
+		if (models.size() > _mega.model_capacity)
+			_mega.model_capacity = std::max(_mega.model_capacity * 2, models.size());
+
+		// Orphan the previous frame's storage rather than waiting on it
+		glBufferData(GL_ARRAY_BUFFER, _mega.model_capacity * sizeof(matrix4), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, models.size() * sizeof(matrix4), models.data());
+
+		if (!(_pool_layout.flags & layout_quantized_positions))
+			return;
+
+		_draw_quant.resize(meshes.size() * 2);
+
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const vertex_quantization& quant = _data.quant[meshes[i]];
+
+			_draw_quant[i * 2] = vector4(quant.offset, 0.0f);
+			_draw_quant[i * 2 + 1] = vector4(quant.scale, 0.0f);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, _mega.qbo);
+		glBufferData(GL_ARRAY_BUFFER, _mega.model_capacity * 2 * sizeof(vector4), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, _draw_quant.size() * sizeof(vector4), _draw_quant.data());
+	}
+
+	void mesh_server::set_draw_commands(const std::vector<DrawElementsIndirectCommand>& commands)
+	{
+		if (!_mega.enabled)
+			return;
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _mega.dibo);
+
+		if (commands.size() > _mega.command_capacity)
+			_mega.command_capacity = std::max(_mega.command_capacity * 2, commands.size());
+
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, 
+				_mega.command_capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 
+				0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	}
+
+	void mesh_server::draw_indirect(size_t first, size_t count)
+	{
+		if (count == 0 || !bind_pool())
+			return;
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _mega.dibo);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 
+				(void*)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+	}
+
+	bool mesh_server::buffer(mesh_id idx)
+	{
+		if (_data.pooled[idx])
+			return false;
+
+		bind(idx);
+
+		const unsigned attribs = get_attribs(idx);
+		const size_t vertex_count = _data.positions[idx].size();
+
+		std::vector<unsigned char> vertices;
+
+		if (!get_upload_vertices(idx, _layout, attribs, vertices))
+			return false;
+
+		glBindBuffer(GL_ARRAY_BUFFER, _data.vbo[idx]);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), _data.usage[idx]);
+
+		set_attributes(_layout, attribs, vertex_count);
+
+		const size_t index_size = _data.index_type[idx] == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+
+		size_t index_count = _data.index_count[idx];
+
+		for (const lod_range& range : _data.lod_ranges[idx])
+			index_count += range.index_count;
+
+		_data.vertex_count[idx] = vertex_count;
+		_data.attribs[idx] = attribs;
+		_data.gpu_bytes[idx] = vertices.size() + index_count * index_size;
+
 		return true;
 	}
 
@@ -147,9 +732,221 @@ namespace efiilj
 			fprintf(stderr, "Err: Mesh %d - Tried to update static buffer\n", idx);
 	}
 
-	void mesh_server::draw_elements(mesh_id idx)
+	void mesh_server::begin_direct(mesh_id idx)
 	{
-		glDrawElements(_data.mode[idx], get_index_count(idx), GL_UNSIGNED_INT, nullptr);
+		if (!(_layout.flags & layout_quantized_positions))
+			return;
+
+		const vertex_quantization& quant = _data.quant[idx];
+
+		glVertexAttrib4f(VERTEX_ATTRIB_QUANT_OFFSET, quant.offset.x, quant.offset.y, quant.offset.z, 0.0f);
+		glVertexAttrib4f(VERTEX_ATTRIB_QUANT_SCALE, quant.scale.x, quant.scale.y, quant.scale.z, 0.0f);
+
+		// The pool streams quantisation per draw, so direct draws switch over to the constants above
+		if (_data.pooled[idx])
+		{
+			glDisableVertexAttribArray(VERTEX_ATTRIB_QUANT_OFFSET);
+			glDisableVertexAttribArray(VERTEX_ATTRIB_QUANT_SCALE);
+		}
+	}
+
+	void mesh_server::end_direct(mesh_id idx)
+	{
+		if ((_layout.flags & layout_quantized_positions) && _data.pooled[idx])
+		{
+			glEnableVertexAttribArray(VERTEX_ATTRIB_QUANT_OFFSET);
+			glEnableVertexAttribArray(VERTEX_ATTRIB_QUANT_SCALE);
+		}
+	}
+
+	void mesh_server::draw_elements(mesh_id idx, unsigned lod)
+	{
+		begin_direct(idx);
+
+		if (_data.pooled[idx])
+		{
+			const pool_entry entry = get_pool_entry(idx, lod);
+
+			glDrawElementsBaseVertex(_data.mode[idx], entry.index_count, GL_UNSIGNED_INT, 
+					(void*)(entry.first_index * sizeof(unsigned)), entry.first_vertex);
+		}
+		else if (lod > 0 && lod <= _data.lod_ranges[idx].size())
+		{
+			const lod_range& range = _data.lod_ranges[idx][lod - 1];
+			const size_t index_size = _data.index_type[idx] == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+
+			glDrawElements(_data.mode[idx], range.index_count, _data.index_type[idx], (void*)(range.first_index * index_size));
+		}
+		else
+			glDrawElements(_data.mode[idx], _data.index_count[idx], _data.index_type[idx], nullptr);
+
+		end_direct(idx);
+	}
+
+	void mesh_server::draw_ranges(mesh_id idx, const std::vector<meshlet_range>& ranges)
+	{
+		if (ranges.empty())
+			return;
+
+		const bool pooled = _data.pooled[idx];
+		const unsigned type = pooled ? GL_UNSIGNED_INT : _data.index_type[idx];
+		const size_t index_size = type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned);
+		const size_t first = pooled ? _data.entry[idx].first_index : 0;
+
+		std::vector<GLsizei> counts(ranges.size());
+		std::vector<void*> offsets(ranges.size());
+
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			counts[i] = static_cast<GLsizei>(ranges[i].index_count);
+			offsets[i] = (void*)((first + ranges[i].first_index) * index_size);
+		}
+
+		begin_direct(idx);
+
+		if (pooled)
+		{
+			std::vector<GLint> base_vertices(ranges.size(), static_cast<GLint>(_data.entry[idx].first_vertex));
+
+			glMultiDrawElementsBaseVertex(_data.mode[idx], counts.data(), type, offsets.data(), 
+					static_cast<GLsizei>(ranges.size()), base_vertices.data());
+		}
+		else
+		{
+			glMultiDrawElements(_data.mode[idx], counts.data(), type, offsets.data(), static_cast<GLsizei>(ranges.size()));
+		}
+
+		end_direct(idx);
+	}
+
+	bool mesh_server::set_vertex_layout(unsigned flags)
+	{
+		bool built = _mega.enabled;
+
+		for (mesh_id idx : _pool)
+			built = built || _data.state[idx];
+
+		if (built)
+		{
+			fprintf(stderr, "Err: Vertex layout must be set before any mesh is built\n");
+			return false;
+		}
+
+		_layout.flags = flags;
+
+		printf("Mesh vertex layout: %u bytes per vertex (%u as float)\n", 
+				_layout.get_vertex_size(attrib_mask_all), vertex_layout().get_vertex_size(attrib_mask_all));
+
+		return true;
+	}
+
+	void mesh_server::set_packed(mesh_id idx, const unsigned char* vertices, size_t size, unsigned attribs, 
+			const vertex_quantization& quant)
+	{
+		_data.packed[idx].assign(vertices, vertices + size);
+		_data.packed_attribs[idx] = attribs;
+		_data.quant[idx] = quant;
+	}
+
+	size_t mesh_server::get_float_bytes(mesh_id idx) const
+	{
+		const vertex_layout planar;
+
+		size_t index_count = _data.index_count[idx];
+
+		for (const lod_range& range : _data.lod_ranges[idx])
+			index_count += range.index_count;
+
+		return _data.vertex_count[idx] * planar.get_vertex_size(_data.attribs[idx]) + index_count * sizeof(unsigned);
+	}
+
+	void mesh_server::drop_data(mesh_id idx)
+	{
+		// Dynamic meshes are repacked from their streams on every update
+		if (!is_valid(idx) || !_data.state[idx] || _data.usage[idx] != GL_STATIC_DRAW)
+			return;
+
+		const size_t before = get_data_bytes(idx);
+
+		std::vector<vector3>().swap(_data.normals[idx]);
+		std::vector<vector3>().swap(_data.colors[idx]);
+		std::vector<vector2>().swap(_data.uvs[idx]);
+		std::vector<vector4>().swap(_data.tangents[idx]);
+		std::vector<lod_level>().swap(_data.lods[idx]);
+
+		if (!_data.keep_data[idx])
+		{
+			std::vector<vector3>().swap(_data.positions[idx]);
+			std::vector<unsigned>().swap(_data.indices[idx]);
+
+			_data.resident[idx] = false;
+		}
+
+		_dropped_bytes += before - get_data_bytes(idx);
+	}
+
+	bool mesh_server::retain_data(mesh_id idx)
+	{
+		if (!is_valid(idx))
+			return false;
+
+		_data.keep_data[idx] = true;
+
+		return _data.resident[idx] || read_back(idx);
+	}
+
+	bool mesh_server::read_back(mesh_id idx)
+	{
+		if (!_data.state[idx])
+			return false;
+
+		const bool pooled = _data.pooled[idx];
+		const vertex_layout& layout = pooled ? _pool_layout : _layout;
+		const unsigned attribs = pooled ? attrib_mask_all : _data.attribs[idx];
+		const size_t vertex_count = _data.vertex_count[idx];
+		const size_t index_count = _data.index_count[idx];
+
+		size_t offset;
+		unsigned stride;
+
+		layout.get_placement(attrib_position, attribs, vertex_count, offset, stride);
+
+		if (pooled)
+			offset += _data.entry[idx].first_vertex * stride;
+
+		std::vector<unsigned char> vertices(vertex_count * stride);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, _data.vbo[idx]);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, offset, vertices.size(), vertices.data());
+
+		auto& positions = _data.positions[idx];
+		positions.resize(vertex_count);
+
+		for (size_t i = 0; i < vertex_count; i++)
+			positions[i] = unpack_position(layout, vertices.data() + i * stride, _data.quant[idx]);
+
+		auto& indices = _data.indices[idx];
+		indices.resize(index_count);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, _data.ibo[idx]);
+
+		if (!pooled && _data.index_type[idx] == GL_UNSIGNED_SHORT)
+		{
+			std::vector<unsigned short> narrow(index_count);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, index_count * sizeof(unsigned short), narrow.data());
+			std::copy(narrow.begin(), narrow.end(), indices.begin());
+		}
+		else
+		{
+			const size_t first = pooled ? _data.entry[idx].first_index : 0;
+			glGetBufferSubData(GL_COPY_READ_BUFFER, first * sizeof(unsigned), index_count * sizeof(unsigned), indices.data());
+		}
+
+		_data.resident[idx] = true;
+
+		printf("Mesh %d: read back %lu vertices and %lu indices for CPU access\n", idx, vertex_count, index_count);
+
+		return true;
 	}
 	
 	void mesh_server::calculate_center(mesh_id idx)
@@ -158,18 +955,20 @@ namespace efiilj
 		for (const auto& v : _data.positions[idx])
 			sum += v;
 
-		_data.center[idx] = sum / static_cast<float>(get_vertex_count(idx));
+		_data.center[idx] = sum / static_cast<float>(_data.positions[idx].size());
 	}
 
 	void mesh_server::set_positions(mesh_id idx, std::vector<vector3>& positions)
 	{
 		_data.positions[idx] = std::move(positions);
+		_data.resident[idx] = true;
 		calculate_center(idx);
 	}
 
 	void mesh_server::set_positions(mesh_id idx, const std::vector<vector3>& positions)
 	{
 		_data.positions[idx] = positions;
+		_data.resident[idx] = true;
 		calculate_center(idx);
 	}
 
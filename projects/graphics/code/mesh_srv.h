@@ -4,7 +4,13 @@
 #include "mgr_host.h"
 
 #include "mtrl_srv.h"
+#include "mesh_pool.h"
+#include "mesh_opt.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "vertex_layout.h"
 #include "vector4.h"
+#include "matrix4.h"
 #include "bounds.h"
 
 #include <filesystem>
@@ -20,30 +26,109 @@ namespace efiilj
 		bbox
 	};
 
+	/**
+	 * \brief Uploaded index range of one simplified level.
+	 */
+	struct lod_range
+	{
+		size_t first_index = 0;
+		size_t index_count = 0;
+		float error = 0.0f;
+	};
+
 	class mesh_server : public server<mesh_id>
 	{
 		private:
 
 			struct MeshData 
 			{
-				std::vector<std::vector<vector3>> positions;
-				std::vector<std::vector<vector3>> normals;
-				std::vector<std::vector<vector3>> colors;
-				std::vector<std::vector<vector2>> uvs;
-				std::vector<std::vector<vector4>> tangents;
-				std::vector<std::vector<unsigned>> indices;
-				std::vector<bounds> bbox;
-				std::vector<vector3> center;
-				std::vector<material_id> material;
-				std::vector<unsigned> usage;
-				std::vector<unsigned> mode;
-				std::vector<unsigned> vao;
-				std::vector<unsigned> vbo;
-				std::vector<unsigned> ibo;
-				std::vector<bool> state;
+				slot_vector<std::vector<vector3>> positions;
+				slot_vector<std::vector<vector3>> normals;
+				slot_vector<std::vector<vector3>> colors;
+				slot_vector<std::vector<vector2>> uvs;
+				slot_vector<std::vector<vector4>> tangents;
+				slot_vector<std::vector<unsigned>> indices;
+				slot_vector<std::vector<vector3>> hull;
+				slot_vector<std::vector<lod_level>> lods;
+				slot_vector<std::vector<lod_range>> lod_ranges;
+				slot_vector<std::vector<meshlet>> meshlets;
+				slot_vector<bounds> bbox;
+				slot_vector<vector3> center;
+				slot_vector<material_id> material;
+				slot_vector<unsigned> usage;
+				slot_vector<unsigned> mode;
+				slot_vector<unsigned> vao;
+				slot_vector<unsigned> vbo;
+				slot_vector<unsigned> ibo;
+				slot_vector<unsigned> index_type;
+				slot_vector<size_t> vertex_count;
+				slot_vector<size_t> index_count;
+				slot_vector<unsigned> attribs;
+				slot_vector<vertex_quantization> quant;
+				slot_vector<std::vector<unsigned char>> packed;
+				slot_vector<unsigned> packed_attribs;
+				slot_vector<size_t> gpu_bytes;
+				slot_vector<pool_entry> entry;
+				slot_vector<bool> pooled;
+				slot_vector<bool> optimized;
+				slot_vector<bool> lod_ready;
+				slot_vector<bool> keep_data;
+				slot_vector<bool> resident;
+				slot_vector<bool> state;
+				slot_vector<std::filesystem::path> uri;
 			} _data;
 
+			struct MegaBuffer
+			{
+				unsigned vao = 0;
+				unsigned vbo = 0;
+				unsigned ibo = 0;
+				unsigned mbo = 0;
+				unsigned qbo = 0;
+				unsigned dibo = 0;
+				size_t model_capacity = 0;
+				size_t command_capacity = 0;
+				range_allocator vertices;
+				range_allocator indices;
+				bool enabled = false;
+			} _mega;
+
 			unsigned int _current_vao;
+			unsigned _generation;
+
+			vertex_layout _layout;
+			vertex_layout _pool_layout;
+
+			// Static meshes built this frame, whose CPU streams are dropped at the end of it
+			std::vector<mesh_id> _uploaded;
+			size_t _dropped_bytes;
+
+			std::vector<vector4> _draw_quant;
+
+			bool _optimize;
+			mesh_opt_report _opt_report;
+
+			bool _generate_lods;
+			bool _build_meshlets;
+
+			bool build_pooled(mesh_id idx);
+			void grow_pool(size_t vertex_count, size_t index_count);
+			void setup_pool_layout();
+
+			void begin_direct(mesh_id idx);
+			void end_direct(mesh_id idx);
+
+			void set_attributes(const vertex_layout& layout, unsigned attribs, size_t vertex_count);
+			unsigned get_attribs(mesh_id idx) const;
+
+			/**
+			 * \brief Vertices to upload, packed in the given layout -- the ones set by set_packed, or else packed here from the streams.
+			 * \return False if vertices set by set_packed do not have the size the layout gives them
+			 */
+			bool get_upload_vertices(mesh_id idx, const vertex_layout& layout, unsigned attribs, std::vector<unsigned char>& out);
+
+			void drop_data(mesh_id idx);
+			bool read_back(mesh_id idx);
 
 			void create_line(mesh_id idx);
 			void create_cube(mesh_id idx);
@@ -55,9 +140,76 @@ namespace efiilj
 			~mesh_server();
 
 			void append_defaults(mesh_id idx) override;
+			void on_end_frame() override;
+
+			bool destroy(mesh_id idx) override;
+
+			/**
+			 * \brief Frees the GPU storage of a mesh, so that it can be built again with new data.
+			 */
+			void release(mesh_id idx);
 
 			mesh_id create_primitive(primitive type);
 
+			/**
+			 * \brief Deduplicates and reorders the vertices and indices of a triangle mesh for the vertex cache,
+			 * overdraw and vertex fetch. Static triangle meshes are optimised when first built, unless already marked.
+			 */
+			mesh_opt_report optimize(mesh_id idx);
+
+			/**
+			 * \brief Generates the LOD chain of a triangle mesh from its CPU streams. Static triangle meshes
+			 * get one when first built, unless a chain was set from elsewhere, such as a staging thread or a cache.
+			 */
+			void generate_lods(mesh_id idx);
+
+			/**
+			 * \brief Sets a LOD chain generated elsewhere, uploaded on the next build. Levels index the mesh vertices,
+			 * so the chain must be generated after the vertices are optimised.
+			 */
+			void set_lods(mesh_id idx, std::vector<lod_level>& lods);
+
+			/**
+			 * \brief CPU copy of the LOD chain, available until the end of the frame the mesh is built in.
+			 */
+			const std::vector<lod_level>& get_lods(mesh_id idx) const
+			{ return _data.lods[idx]; }
+
+			/**
+			 * \brief Number of uploaded levels, including the full mesh as level 0.
+			 */
+			unsigned get_lod_count(mesh_id idx) const
+			{ return 1 + static_cast<unsigned>(_data.lod_ranges[idx].size()); }
+
+			size_t get_lod_index_count(mesh_id idx, unsigned lod) const
+			{ return lod == 0 ? get_index_count(idx) : _data.lod_ranges[idx][lod - 1].index_count; }
+
+			float get_lod_error(mesh_id idx, unsigned lod) const
+			{ return lod == 0 ? 0.0f : _data.lod_ranges[idx][lod - 1].error; }
+
+			void set_lods_on_build(bool enabled)
+			{
+				_generate_lods = enabled;
+			}
+
+			/**
+			 * \brief Splits the full level of a triangle mesh into meshlets for cluster culling, reordering its triangles
+			 * so that each meshlet is a range of the index buffer. Static triangle meshes of at least MESHLET_MIN_TRIANGLES 
+			 * get them when first built.
+			 */
+			void generate_meshlets(mesh_id idx);
+
+			/**
+			 * \brief Meshlets of the full level, as ranges of its indices. Kept after the CPU streams are dropped.
+			 */
+			const std::vector<meshlet>& get_meshlets(mesh_id idx) const
+			{ return _data.meshlets[idx]; }
+
+			void set_meshlets_on_build(bool enabled)
+			{
+				_build_meshlets = enabled;
+			}
+
 			bool bind(mesh_id idx);
 			bool build(mesh_id idx);
 			bool build(mesh_id idx, unsigned usage);
@@ -65,10 +217,101 @@ namespace efiilj
 
 			void unbind();
 			void update(mesh_id idx);
-			void draw_elements(mesh_id idx);
-
-			size_t get_vertex_count(mesh_id idx) const { return _data.positions[idx].size(); }
-			size_t get_index_count(mesh_id idx) const { return _data.indices[idx].size(); }
+			void draw_elements(mesh_id idx, unsigned lod = 0);
+
+			/**
+			 * \brief Draws ranges of the full level of a mesh in one call, such as the visible meshlets.
+			 */
+			void draw_ranges(mesh_id idx, const std::vector<meshlet_range>& ranges);
+
+			/**
+			 * \brief Enables the shared vertex/index mega-buffer. 
+			 * Static triangle meshes built after this call are suballocated into it.
+			 * \param vertex_capacity Initial number of vertices (grows on demand)
+			 * \param index_capacity Initial number of indices (grows on demand)
+			 * \return True if the pool is enabled, false if multi-draw-indirect is unsupported
+			 */
+			bool enable_pool(size_t vertex_capacity, size_t index_capacity);
+			bool bind_pool();
+
+			/**
+			 * \brief Uploads per-draw model matrices, and the position quantisation of each drawn mesh,
+			 * fetched in the shader through base instance.
+			 */
+			void set_draw_models(const std::vector<matrix4>& models, const std::vector<mesh_id>& meshes);
+
+			/**
+			 * \brief Uploads indirect draw commands to the draw indirect buffer.
+			 */
+			void set_draw_commands(const std::vector<DrawElementsIndirectCommand>& commands);
+
+			/**
+			 * \brief Submits a range of the uploaded draw commands with glMultiDrawElementsIndirect.
+			 */
+			void draw_indirect(size_t first, size_t count);
+
+			bool is_pooled() const { return _mega.enabled; }
+			bool is_pooled(mesh_id idx) const { return _data.pooled[idx]; }
+
+			const pool_entry& get_pool_entry(mesh_id idx) const 
+			{ return _data.entry[idx]; }
+
+			/**
+			 * \brief Pool location of one level, which shares the vertices of the full mesh.
+			 */
+			pool_entry get_pool_entry(mesh_id idx, unsigned lod) const;
+
+			size_t get_vertex_count(mesh_id idx) const 
+			{ return _data.state[idx] ? _data.vertex_count[idx] : _data.positions[idx].size(); }
+
+			size_t get_index_count(mesh_id idx) const 
+			{ return _data.state[idx] ? _data.index_count[idx] : _data.indices[idx].size(); }
+
+			/**
+			 * \brief Selects how vertices are packed on the GPU. Shaders must be compiled with the defines
+			 * from get_layout_defines(), so the layout can only be changed before any mesh is built.
+			 * \return False if meshes have already been built with the current layout
+			 */
+			bool set_vertex_layout(unsigned flags);
+
+			const vertex_layout& get_vertex_layout() const { return _layout; }
+
+			/**
+			 * \brief Sets vertices already packed in the layout the next build uploads with, such as from a cache.
+			 * The positions must still be set, as the CPU copy for culling and physics, and the other streams can be left out.
+			 * Meshes with packed vertices are not optimised on build, as that would reorder the positions alone.
+			 * \param attribs Mask of the vertex_attribute streams the mesh has
+			 * \param quant Quantisation the positions were packed with
+			 */
+			void set_packed(mesh_id idx, const unsigned char* vertices, size_t size, unsigned attribs, const vertex_quantization& quant);
+			std::vector<std::string> get_layout_defines() const { return _layout.get_defines(); }
+
+			/**
+			 * \brief Keeps the CPU copy of the positions and indices of a mesh, for physics or picking.
+			 * Static meshes otherwise drop their CPU streams at the end of the frame they are built in.
+			 * A copy that was already dropped is read back from the GPU, with the precision of the vertex layout.
+			 */
+			bool retain_data(mesh_id idx);
+
+			/**
+			 * \brief True while the CPU positions and indices of the mesh are available.
+			 */
+			bool is_resident(mesh_id idx) const { return _data.resident[idx]; }
+
+			/**
+			 * \brief Bytes of vertex and index data uploaded to the GPU.
+			 */
+			size_t get_gpu_bytes(mesh_id idx) const { return _data.gpu_bytes[idx]; }
+
+			/**
+			 * \brief Bytes the same mesh takes with planar 32-bit float vertices and 32-bit indices.
+			 */
+			size_t get_float_bytes(mesh_id idx) const;
+
+			/**
+			 * \brief Bytes of CPU streams dropped after upload, over every mesh.
+			 */
+			size_t get_dropped_bytes() const { return _dropped_bytes; }
 
 			bool has_position_data(mesh_id idx) const { return _data.positions[idx].size() > 0; }
 			bool has_normal_data(mesh_id idx) const { return _data.normals[idx].size() > 0; }
@@ -76,6 +319,19 @@ namespace efiilj
 			bool has_uv_data(mesh_id idx) const { return _data.uvs[idx].size() > 0; }
 			bool has_tangent_data(mesh_id idx) const { return _data.tangents[idx].size() > 0; }
 
+			/**
+			 * \brief Size of the vertex and index streams held by the mesh.
+			 */
+			size_t get_data_bytes(mesh_id idx) const
+			{
+				return _data.positions[idx].size() * sizeof(vector3)
+					+ _data.normals[idx].size() * sizeof(vector3)
+					+ _data.colors[idx].size() * sizeof(vector3)
+					+ _data.uvs[idx].size() * sizeof(vector2)
+					+ _data.tangents[idx].size() * sizeof(vector4)
+					+ _data.indices[idx].size() * sizeof(unsigned);
+			}
+
 			void calculate_center(mesh_id idx);
 
 			const vector3& get_center(mesh_id idx) const
@@ -83,12 +339,38 @@ namespace efiilj
 				return _data.center[idx];
 			}
 
+			void set_center(mesh_id idx, const vector3& center)
+			{
+				_data.center[idx] = center;
+			}
+
 			const vector3& get_position(mesh_id idx, size_t index) const 
 			{ return _data.positions[idx][index]; }
 
 			const std::vector<vector3>& get_positions(mesh_id idx) const
 			{ return _data.positions[idx]; }
 
+			const std::vector<unsigned>& get_indices(mesh_id idx) const
+			{ return _data.indices[idx]; }
+
+			const std::vector<vector3>& get_normals(mesh_id idx) const
+			{ return _data.normals[idx]; }
+
+			const std::vector<vector2>& get_uvs(mesh_id idx) const
+			{ return _data.uvs[idx]; }
+
+			const std::vector<vector4>& get_tangents(mesh_id idx) const
+			{ return _data.tangents[idx]; }
+
+			/**
+			 * \brief Returns the collision hull points, or all positions if no hull has been set.
+			 */
+			const std::vector<vector3>& get_hull(mesh_id idx) const
+			{ return _data.hull[idx].empty() ? _data.positions[idx] : _data.hull[idx]; }
+
+			void set_hull(mesh_id idx, std::vector<vector3>& hull)
+			{ _data.hull[idx] = std::move(hull); }
+
 			const vector3& get_indexed_position(mesh_id idx, size_t index) const 
 			{ return get_position(idx, _data.indices[idx][index]); }
 
@@ -142,11 +424,13 @@ namespace efiilj
 			void set_bounds(mesh_id idx, const bounds& bounds)
 			{
 				_data.bbox[idx] = bounds;
+				_generation++;
 			}
 
 			void set_bounds(mesh_id idx, const vector3& min, const vector3& max)
 			{
 				_data.bbox[idx] = bounds(min, max);
+				_generation++;
 			}
 
 			const vector3& get_min(mesh_id idx) const
@@ -157,6 +441,7 @@ namespace efiilj
 			void set_min(mesh_id idx, const vector3& min)
 			{
 				_data.bbox[idx].min = min;
+				_generation++;
 			}
 
 			const vector3& get_max(mesh_id idx) const
@@ -167,6 +452,33 @@ namespace efiilj
 			void set_max(mesh_id idx, const vector3& max)
 			{
 				_data.bbox[idx].max = max;
+				_generation++;
+			}
+
+			bool is_optimized(mesh_id idx) const
+			{
+				return _data.optimized[idx];
+			}
+
+			/**
+			 * \brief Marks a mesh as optimised, for data optimised elsewhere, such as on a staging thread or in a cache.
+			 */
+			void set_optimized(mesh_id idx, bool optimized)
+			{
+				_data.optimized[idx] = optimized;
+			}
+
+			void set_optimize_on_build(bool enabled)
+			{
+				_optimize = enabled;
+			}
+
+			/**
+			 * \brief Totals over every mesh optimised by the server.
+			 */
+			const mesh_opt_report& get_optimize_report() const
+			{
+				return _opt_report;
 			}
 
 			void set_triangle_mode(mesh_id idx, unsigned mode)
@@ -184,6 +496,27 @@ namespace efiilj
 				return _data.state[idx];
 			}
 
+			/**
+			 * \brief Source file of the mesh, if it was loaded from one.
+			 */
+			const std::filesystem::path& get_uri(mesh_id idx) const
+			{
+				return _data.uri[idx];
+			}
+
+			void set_uri(mesh_id idx, const std::filesystem::path& uri)
+			{
+				_data.uri[idx] = uri;
+			}
+
+			/**
+			 * \brief Counter bumped whenever mesh data is released or its bounds are set, for caches derived from mesh data.
+			 */
+			unsigned get_generation() const
+			{
+				return _generation;
+			}
+
 			unsigned int get_vao(mesh_id idx) const
 			{
 				return _data.vao[idx];
@@ -198,5 +531,13 @@ namespace efiilj
 			{
 				return _data.ibo[idx];
 			}
+
+			/**
+			 * \brief GL type of the uploaded index buffer, GL_UNSIGNED_SHORT when every index fits in 16 bits.
+			 */
+			unsigned get_index_type(mesh_id idx) const
+			{
+				return _data.index_type[idx];
+			}
 	};
 }
@@ -0,0 +1,278 @@
+#include "meshlet.h"
+#include "mesh_opt.h"
+#include "core/jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define MESHLET_CULL_GRAIN 256
+
+namespace efiilj
+{
+	static void finish_meshlet(const std::vector<vector3>& positions, const std::vector<unsigned>& indices, meshlet& m)
+	{
+		const unsigned end = m.first_index + m.index_count;
+
+		vector3 min = positions[indices[m.first_index]];
+		vector3 max = min;
+
+		for (unsigned i = m.first_index; i < end; i++)
+		{
+			min = vector3::min(min, positions[indices[i]]);
+			max = vector3::max(max, positions[indices[i]]);
+		}
+
+		m.center = (min + max) * 0.5f;
+		m.radius = 0.0f;
+
+		for (unsigned i = m.first_index; i < end; i++)
+			m.radius = std::max(m.radius, (positions[indices[i]] - m.center).length());
+
+		vector3 axis;
+		std::vector<vector3> normals;
+		normals.reserve(m.index_count / 3);
+
+		for (unsigned i = m.first_index; i < end; i += 3)
+		{
+			const vector3& p0 = positions[indices[i]];
+			const vector3& p1 = positions[indices[i + 1]];
+			const vector3& p2 = positions[indices[i + 2]];
+
+			vector3 n = vector3::cross(p1 - p0, p2 - p0);
+			const float length = n.length();
+
+			// Degenerate triangles are never drawn, so they don't widen the cone
+			if (length <= 0.0f)
+				continue;
+
+			n = n / length;
+			normals.push_back(n);
+			axis += n;
+		}
+
+		const float axis_length = axis.length();
+
+		m.cone_axis = axis_length > 0.0f ? axis / axis_length : vector3(0, 0, 1);
+		m.cone_cutoff = 1.0f;
+
+		if (axis_length <= 0.0f || normals.empty())
+			return;
+
+		float min_dot = 1.0f;
+
+		for (const auto& n : normals)
+			min_dot = std::min(min_dot, vector3::dot(n, m.cone_axis));
+
+		if (min_dot > 0.0f)
+			m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+	}
+
+	void build_meshlets(const std::vector<vector3>& positions, std::vector<unsigned>& indices,
+			std::vector<meshlet>& meshlets, size_t max_vertices, size_t max_triangles)
+	{
+		meshlets.clear();
+
+		const size_t triangle_count = indices.size() / 3;
+		const size_t vertex_count = positions.size();
+
+		if (triangle_count == 0)
+			return;
+
+		// Triangles around each vertex, packed one vertex after another
+		std::vector<unsigned> adjacency_offset(vertex_count + 1, 0);
+		std::vector<unsigned> adjacency(triangle_count * 3);
+
+		for (unsigned index : indices)
+			adjacency_offset[index + 1]++;
+
+		for (size_t v = 0; v < vertex_count; v++)
+			adjacency_offset[v + 1] += adjacency_offset[v];
+
+		std::vector<unsigned> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+
+		for (size_t i = 0; i < triangle_count * 3; i++)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned>(i / 3);
+
+		std::vector<vector3> normals(triangle_count);
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			const vector3& p0 = positions[indices[t * 3]];
+			const vector3 n = vector3::cross(positions[indices[t * 3 + 1]] - p0, positions[indices[t * 3 + 2]] - p0);
+			const float length = n.length();
+
+			normals[t] = length > 0.0f ? n / length : vector3();
+		}
+
+		std::vector<unsigned> reordered;
+		reordered.reserve(indices.size());
+
+		std::vector<bool> emitted(triangle_count, false);
+
+		// Stamped with the meshlet a vertex was last added to, so each is counted once per meshlet
+		std::vector<unsigned> stamp(vertex_count, ~0u);
+		std::vector<unsigned> vertices;
+
+		size_t seed = 0;
+		vector3 axis;
+
+		auto new_vertices = [&](size_t t, unsigned id)
+		{
+			const unsigned a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+			return (stamp[a] != id) + (stamp[b] != id && b != a) + (stamp[c] != id && c != a && c != b);
+		};
+
+		while (reordered.size() < indices.size())
+		{
+			const unsigned id = static_cast<unsigned>(meshlets.size());
+
+			meshlet current = {};
+			current.first_index = static_cast<unsigned>(reordered.size());
+			vertices.clear();
+			axis = vector3();
+
+			while (seed < triangle_count && emitted[seed])
+				seed++;
+
+			size_t next = seed;
+
+			// Grows over triangles sharing the most vertices with the meshlet, then facing its way, for tight bounds and cones
+			while (next < triangle_count)
+			{
+				emitted[next] = true;
+
+				for (int k = 0; k < 3; k++)
+				{
+					const unsigned v = indices[next * 3 + k];
+					reordered.push_back(v);
+
+					if (stamp[v] != id)
+					{
+						stamp[v] = id;
+						vertices.push_back(v);
+					}
+				}
+
+				current.index_count += 3;
+				axis += normals[next];
+
+				if (current.index_count / 3 >= max_triangles)
+					break;
+
+				const vector3 direction = axis.length() > 0.0f ? axis / axis.length() : vector3();
+
+				next = triangle_count;
+				float best_score = std::numeric_limits<float>::max();
+
+				for (unsigned v : vertices)
+				{
+					for (unsigned i = adjacency_offset[v]; i < adjacency_offset[v + 1]; i++)
+					{
+						const unsigned t = adjacency[i];
+
+						if (emitted[t])
+							continue;
+
+						const int added = new_vertices(t, id);
+
+						if (vertices.size() + added > max_vertices)
+							continue;
+
+						// Each new vertex counts as much as a quarter turn away from the cone
+						const float score = added + (1.0f - vector3::dot(normals[t], direction));
+
+						if (score < best_score)
+						{
+							next = t;
+							best_score = score;
+						}
+					}
+				}
+			}
+
+			meshlets.push_back(current);
+		}
+
+		indices.swap(reordered);
+
+		// Growing by shape scatters the cache order within a meshlet, so each is reordered again on its own vertices
+		std::vector<unsigned> local;
+		std::fill(stamp.begin(), stamp.end(), ~0u);
+
+		for (auto& m : meshlets)
+		{
+			local.assign(indices.begin() + m.first_index, indices.begin() + m.first_index + m.index_count);
+			vertices.clear();
+
+			for (unsigned& index : local)
+			{
+				if (stamp[index] == ~0u)
+				{
+					stamp[index] = static_cast<unsigned>(vertices.size());
+					vertices.push_back(index);
+				}
+
+				index = stamp[index];
+			}
+
+			optimize_vertex_cache(local, vertices.size());
+
+			for (size_t i = 0; i < local.size(); i++)
+				indices[m.first_index + i] = vertices[local[i]];
+
+			for (unsigned v : vertices)
+				stamp[v] = ~0u;
+
+			finish_meshlet(positions, indices, m);
+		}
+	}
+
+	bool is_meshlet_visible(const meshlet& m, const meshlet_view& view)
+	{
+		if (!view.planes.test(m.center, m.radius))
+			return false;
+
+		if (!view.backfaces)
+			return true;
+
+		// Back-facing when every triangle normal in the cone points away from the camera, from anywhere in the sphere
+		const vector3 to_center = m.center - view.camera;
+		const float distance = to_center.length();
+
+		return vector3::dot(to_center, m.cone_axis) < m.cone_cutoff * distance + m.radius;
+	}
+
+	size_t cull_meshlets(const std::vector<meshlet>& meshlets, const meshlet_view& view,
+			std::vector<unsigned char>& visible, std::vector<meshlet_range>& ranges)
+	{
+		const size_t count = meshlets.size();
+
+		visible.resize(count);
+
+		core::job_system::get().parallel_for(count, MESHLET_CULL_GRAIN, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; i++)
+						visible[i] = is_meshlet_visible(meshlets[i], view);
+				});
+
+		size_t drawn = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!visible[i])
+				continue;
+
+			const meshlet& m = meshlets[i];
+			drawn++;
+
+			// Meshlets are consecutive in the index buffer, so runs of visible ones draw as one range
+			if (i > 0 && visible[i - 1] && !ranges.empty())
+				ranges.back().index_count += m.index_count;
+			else
+				ranges.push_back({ m.first_index, m.index_count });
+		}
+
+		return drawn;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "vector3.h"
+#include "frustum.h"
+
+#include <cstddef>
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MIN_TRIANGLES 4096 // Meshes smaller than this are only culled as a whole
+
+namespace efiilj
+{
+	/**
+	 * \brief A cluster of consecutive triangles in a mesh index buffer, with bounds for culling.
+	 */
+	struct meshlet
+	{
+		unsigned first_index;
+		unsigned index_count;
+
+		// Bounding sphere
+		vector3 center;
+		float radius;
+
+		// Normal cone, as the average normal and the sine of its widest angle to a triangle normal.
+		// A cutoff of 1 means the triangles face too many ways for the cluster to ever be back-facing.
+		vector3 cone_axis;
+		float cone_cutoff;
+	};
+
+	/**
+	 * \brief Contiguous index range of visible meshlets, merged where neighbours are both visible.
+	 */
+	struct meshlet_range
+	{
+		unsigned first_index;
+		unsigned index_count;
+	};
+
+	/**
+	 * \brief Viewer in the local space of a mesh instance, so meshlet bounds can be tested untransformed.
+	 */
+	struct meshlet_view
+	{
+		frustum planes;
+		vector3 camera;
+
+		// Off for double-sided materials, whose back faces are drawn
+		bool backfaces = true;
+
+		/**
+		 * \param view_projection Camera projection * view
+		 * \param model Instance model matrix
+		 * \param camera_local Camera position transformed by the inverse model matrix
+		 * \param cull_backfaces Whether clusters facing away from the camera are culled
+		 */
+		meshlet_view(const matrix4& view_projection, const matrix4& model, const vector3& camera_local, bool cull_backfaces = true)
+			: planes(view_projection * model), camera(camera_local), backfaces(cull_backfaces)
+		{}
+	};
+
+	/**
+	 * \brief Splits a triangle list into meshlets, reordering the triangles so that each meshlet is a consecutive range.
+	 * Meshlets are grown from the first remaining triangle over neighbours that add the fewest vertices and face the same way,
+	 * which keeps their bounds and normal cones tight, and their triangles in roughly the cache order they started in.
+	 */
+	void build_meshlets(const std::vector<vector3>& positions, std::vector<unsigned>& indices,
+			std::vector<meshlet>& meshlets,
+			size_t max_vertices = MESHLET_MAX_VERTICES, size_t max_triangles = MESHLET_MAX_TRIANGLES);
+
+	/**
+	 * \brief Tests a meshlet against the view frustum, and for facing away from the camera.
+	 */
+	bool is_meshlet_visible(const meshlet& m, const meshlet_view& view);
+
+	/**
+	 * \brief Culls meshlets, spreading the tests over the job system, and appends the visible index ranges.
+	 * \param visible Scratch space for one flag per meshlet, kept by the caller between frames
+	 * \return Number of visible meshlets
+	 */
+	size_t cull_meshlets(const std::vector<meshlet>& meshlets, const meshlet_view& view,
+			std::vector<unsigned char>& visible, std::vector<meshlet_range>& ranges);
+}
@@ -1,4 +1,5 @@
 #include "mtrl_srv.h"
+#include "core/hash.h"
 #include "imgui.h"
 
 #include <GL/glew.h>
@@ -7,6 +8,12 @@ namespace efiilj
 {
 	material_server::material_server()
 	{
+		add_columns({
+			&_data.shader, &_data.textures, &_data.base_color, &_data.emissive_factor,
+			&_data.metallic_factor, &_data.roughness_factor, &_data.alpha_cutoff,
+			&_data.double_sided, &_data.features, &_data.permutation, &_data.permutation_base
+		});
+
 		printf("Init materials...\n");
 	}
 
@@ -44,6 +51,9 @@ namespace efiilj
 		_data.roughness_factor.emplace_back(0.5f);
 		_data.alpha_cutoff.emplace_back(0.1f);
 		_data.double_sided.emplace_back(false);
+		_data.features.emplace_back(feature_alpha_cutoff);
+		_data.permutation.emplace_back(-1);
+		_data.permutation_base.emplace_back(-1);
 	}
 
 	void material_server::on_register(std::shared_ptr<manager_host> host)
@@ -58,6 +68,12 @@ namespace efiilj
 
 		ImGui::Text("Material %d", idx);
 
+		if (_refs[idx] > 1)
+		{
+			ImGui::SameLine();
+			ImGui::Text("-- shared by %u", _refs[idx]);
+		}
+
 		if (_shaders->is_valid(sid))
 		{
 			ImGui::TextColored(ImVec4(0, 1, 0, 1), 
@@ -67,6 +83,20 @@ namespace efiilj
 		else
 			ImGui::TextColored(ImVec4(1,0,0,1), "Shader unlinked");
 
+		shader_id perm = _data.permutation[idx];
+
+		ImGui::Text("Features %#x", _data.features[idx]);
+
+		if (perm >= 0 && perm != _data.permutation_base[idx])
+		{
+			ImGui::SameLine();
+
+			if (_shaders->is_valid(perm))
+				ImGui::Text("-- permutation %d", perm);
+			else
+				ImGui::TextColored(ImVec4(1, 1, 0, 1), "-- permutation %d (building)", perm);
+		}
+
 		if (ImGui::TreeNode("Textures"))
 		{
 			for (const auto& img : _data.textures[idx])
@@ -81,6 +111,7 @@ namespace efiilj
 						tex_id,
 						_textures->get_width(img), 
 						_textures->get_height(img));
+				_textures->on_editor_gui(img);
 				ImGui::EndGroup();
 			}
 			ImGui::TreePop();
@@ -88,21 +119,32 @@ namespace efiilj
 
 		if (ImGui::TreeNode("Properies"))
 		{
+			// Edits apply to every user of a shared material, but withdraw it from further sharing
+			bool edited = false;
+
 			if (ImGui::TreeNode("Base color"))
 			{
-				ImGui::ColorPicker4("Base color", &_data.base_color[idx].x);
+				edited |= ImGui::ColorPicker4("Base color", &_data.base_color[idx].x);
 				ImGui::TreePop();
 			}
 
 			if (ImGui::TreeNode("Emissive"))
 			{
-				ImGui::ColorPicker4("Emissive factor", &_data.emissive_factor[idx].x);
+				edited |= ImGui::ColorPicker4("Emissive factor", &_data.emissive_factor[idx].x);
 				ImGui::TreePop();
 			}
 
-			ImGui::DragFloat("Metallic factor", &_data.metallic_factor[idx], 0.05f);
-			ImGui::DragFloat("Roughness", &_data.roughness_factor[idx], 0.05f);
-			ImGui::DragFloat("Alpha cutoff", &_data.alpha_cutoff[idx], 0.05f);
+			edited |= ImGui::DragFloat("Metallic factor", &_data.metallic_factor[idx], 0.05f);
+			edited |= ImGui::DragFloat("Roughness", &_data.roughness_factor[idx], 0.05f);
+
+			if (ImGui::DragFloat("Alpha cutoff", &_data.alpha_cutoff[idx], 0.05f))
+			{
+				update_features(idx);
+				edited = true;
+			}
+
+			if (edited)
+				unshare(idx);
 
 			ImGui::TreePop();
 		}
@@ -113,7 +155,7 @@ namespace efiilj
 		if (!is_valid(idx))
 			return false;
 
-		if (!_shaders->use(_data.shader[idx]) && !_shaders->use(fallback))
+		if (!_shaders->use(_data.shader[idx]) && !_shaders->use(get_permutation(idx, fallback)) && !_shaders->use(fallback))
 			return false;
 
 		_shaders->set_uniform("base_color_factor", _data.base_color[idx]);
@@ -138,38 +180,139 @@ namespace efiilj
 		return true;
 	}
 
+	shader_id material_server::get_permutation(material_id idx, shader_id base)
+	{
+		if (base < 0)
+			return -1;
+
+		if (_data.permutation_base[idx] != base)
+		{
+			_data.permutation[idx] = _shaders->get_permutation(base, _data.features[idx]);
+			_data.permutation_base[idx] = base;
+		}
+
+		return _data.permutation[idx];
+	}
+
+	void material_server::update_features(material_id idx)
+	{
+		unsigned features = feature_none;
+
+		for (const auto& tex : _data.textures[idx])
+		{
+			switch (_textures->get_type(tex))
+			{
+				case texture_type::tex_base:
+					features |= feature_base_map;
+					break;
+				case texture_type::tex_normal:
+					features |= feature_normal_map;
+					break;
+				case texture_type::tex_orm:
+					features |= feature_orm_map;
+					break;
+				case texture_type::tex_emissive:
+					features |= feature_emissive_map;
+					break;
+				default:
+					break;
+			}
+		}
+
+		if (_data.alpha_cutoff[idx] > 0.0f)
+			features |= feature_alpha_cutoff;
+
+		if (features != _data.features[idx])
+		{
+			_data.features[idx] = features;
+			_data.permutation_base[idx] = -1;
+		}
+	}
+
+	uint64_t material_server::hash(material_id idx) const
+	{
+		const unsigned char double_sided = _data.double_sided[idx];
+		const auto& textures = _data.textures[idx];
+
+		uint64_t hash = core::fnv1a(&_data.shader[idx], sizeof(shader_id));
+
+		// Texture ids are compared rather than texels, as identical images already share an id
+		hash = core::fnv1a(textures.data(), textures.size() * sizeof(texture_id), hash);
+		hash = core::fnv1a(&_data.base_color[idx], sizeof(vector4), hash);
+		hash = core::fnv1a(&_data.emissive_factor[idx], sizeof(vector4), hash);
+		hash = core::fnv1a(&_data.metallic_factor[idx], sizeof(float), hash);
+		hash = core::fnv1a(&_data.roughness_factor[idx], sizeof(float), hash);
+		hash = core::fnv1a(&_data.alpha_cutoff[idx], sizeof(float), hash);
+		hash = core::fnv1a(&double_sided, sizeof(double_sided), hash);
+
+		return hash;
+	}
+
+	material_id material_server::deduplicate(material_id idx)
+	{
+		const uint64_t key = hash(idx);
+
+		if (_hash[idx] == key)
+			return idx;
+
+		const material_id shared = find_shared(key);
+
+		if (shared >= 0)
+		{
+			destroy(idx);
+			return shared;
+		}
+
+		// Not a texture or program size, just the columns the material itself takes up
+		const size_t bytes = sizeof(shader_id) * 3 + sizeof(vector4) * 2 + sizeof(float) * 3 + sizeof(unsigned)
+			+ _data.textures[idx].size() * sizeof(texture_id);
+
+		set_shared(idx, key, bytes);
+
+		return idx;
+	}
+
 	void material_server::add_texture(material_id idx, texture_id tex_id)
 	{
+		unshare(idx);
 		_data.textures[idx].emplace_back(tex_id);
+		update_features(idx);
 	}
 
 	void material_server::set_base_color(material_id idx, const vector4& base)
 	{
+		unshare(idx);
 		_data.base_color[idx] = base;
 	}
 
 	void material_server::set_emissive_factor(material_id idx, const vector3& emit)
 	{
+		unshare(idx);
 		_data.emissive_factor[idx] = vector4(emit, 1.0f);
 	}
 
 	void material_server::set_metallic_factor(material_id idx, const float& factor)
 	{
+		unshare(idx);
 		_data.metallic_factor[idx] = factor;
 	}
 
 	void material_server::set_roughness_factor(material_id idx, const float& factor)
 	{
+		unshare(idx);
 		_data.roughness_factor[idx] = factor;
 	}
 
 	void material_server::set_alpha_cutoff(material_id idx, const float& cutoff)
 	{
+		unshare(idx);
 		_data.alpha_cutoff[idx] = cutoff;
+		update_features(idx);
 	}
 
 	void material_server::set_double_sided(material_id idx, bool double_sided)
 	{
+		unshare(idx);
 		_data.double_sided[idx] = double_sided;
 	}
 }
@@ -17,18 +17,24 @@ namespace efiilj
 
 			struct MaterialData
 			{
-				std::vector<shader_id> shader;
-				std::vector<std::vector<texture_id>> textures;
+				slot_vector<shader_id> shader;
+				slot_vector<std::vector<texture_id>> textures;
 
-				std::vector<vector4> base_color;
-				std::vector<vector4> emissive_factor;
-				std::vector<float> metallic_factor;
-				std::vector<float> roughness_factor;
-				std::vector<float> alpha_cutoff;
+				slot_vector<vector4> base_color;
+				slot_vector<vector4> emissive_factor;
+				slot_vector<float> metallic_factor;
+				slot_vector<float> roughness_factor;
+				slot_vector<float> alpha_cutoff;
 
-				std::vector<bool> double_sided;
+				slot_vector<bool> double_sided;
+
+				slot_vector<unsigned> features;
+				slot_vector<shader_id> permutation;
+				slot_vector<shader_id> permutation_base;
 			} _data;
 
+			void update_features(material_id idx);
+
 			std::shared_ptr<shader_server> _shaders;
 			std::shared_ptr<texture_server> _textures;
 			
@@ -43,7 +49,37 @@ namespace efiilj
 
 			void on_editor_gui(material_id) override;
 
+			/**
+			 * \brief Binds the material program, textures and uniforms. Materials without a program of their own use
+			 * the permutation of the fallback shader matching their features, or the fallback itself while that builds.
+			 */
 			bool apply(material_id idx, shader_id fallback = -1);
+
+			/**
+			 * \brief Returns the smallest permutation of a base shader covering the material, queueing it if needed.
+			 */
+			shader_id get_permutation(material_id idx, shader_id base);
+
+			/**
+			 * \brief Shader feature bits needed by the textures and properties of the material.
+			 */
+			unsigned get_features(material_id idx) const
+			{
+				return _data.features[idx];
+			}
+
+			/**
+			 * \brief Hash of the program, textures and factors of the material.
+			 */
+			uint64_t hash(material_id idx) const;
+
+			/**
+			 * \brief Replaces a fully set up material with an identical one, if there is one, and destroys it.
+			 * Otherwise the material is published for later calls to find. Changing a material withdraws it again.
+			 * \return Id to use in place of idx
+			 */
+			material_id deduplicate(material_id idx);
+
 			void add_texture(material_id idx, texture_id tex_id);
 
 			const std::vector<texture_id>& get_textures(material_id idx)
@@ -58,6 +94,7 @@ namespace efiilj
 
 			void set_program(material_id idx, shader_id prog)
 			{
+				unshare(idx);
 				_data.shader[idx] = prog;
 			}
 
@@ -68,5 +105,8 @@ namespace efiilj
 			void set_alpha_cutoff(material_id idx, const float& cutoff);
 			void set_double_sided(material_id idx, bool double_sided);
 
+			bool get_double_sided(material_id idx) const
+			{ return _data.double_sided[idx]; }
+
 	};
 }
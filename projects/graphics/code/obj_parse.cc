@@ -0,0 +1,409 @@
+#include "obj_parse.h"
+#include "core/jobs.h"
+
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+
+#define OBJ_PARSE_CHUNK_SIZE (1 << 20)
+
+namespace efiilj
+{
+	/**
+	 * \brief Face corner as read from the file, 1-based with 0 marking a missing attribute.
+	 * Negative indices are resolved against the chunk's own element count and flagged,
+	 * so the chunk base offset can be added once all chunks have been counted.
+	 */
+	struct obj_corner
+	{
+		int v, vt, vn;
+		unsigned char relative;
+	};
+
+	enum obj_relative : unsigned char
+	{
+		relative_v = 1 << 0,
+		relative_vt = 1 << 1,
+		relative_vn = 1 << 2
+	};
+
+	struct obj_chunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<vector3> positions;
+		std::vector<vector3> normals;
+		std::vector<vector2> uvs;
+		std::vector<obj_corner> corners;
+
+		size_t base_v = 0, base_vt = 0, base_vn = 0;
+		std::string error;
+	};
+
+	struct obj_key
+	{
+		int v, vt, vn;
+
+		bool operator == (const obj_key& other) const
+		{
+			return v == other.v && vt == other.vt && vn == other.vn;
+		}
+	};
+
+	struct obj_key_hash
+	{
+		size_t operator () (const obj_key& key) const
+		{
+			size_t hash = static_cast<size_t>(key.v) * 73856093u;
+			hash ^= static_cast<size_t>(key.vt) * 19349663u;
+			hash ^= static_cast<size_t>(key.vn) * 83492791u;
+			return hash;
+		}
+	};
+
+	static const char* skip_space(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+
+		return p;
+	}
+
+	static bool parse_floats(const char* p, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			p = skip_space(p, end);
+
+			auto result = std::from_chars(p, end, out[i]);
+
+			if (result.ec != std::errc())
+				return false;
+
+			p = result.ptr;
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief Reads one index of a face corner, resolving negative indices against the local count.
+	 */
+	static bool parse_index(const char*& p, const char* end, size_t local_count, int& out, bool& relative)
+	{
+		int value = 0;
+		auto result = std::from_chars(p, end, value);
+
+		if (result.ec != std::errc() || value == 0)
+			return false;
+
+		p = result.ptr;
+		relative = value < 0;
+		out = relative ? static_cast<int>(local_count) + value + 1 : value;
+
+		return true;
+	}
+
+	static bool parse_face(const char* p, const char* end, obj_chunk& chunk, std::vector<obj_corner>& face)
+	{
+		face.clear();
+
+		while ((p = skip_space(p, end)) < end)
+		{
+			obj_corner corner = { 0, 0, 0, 0 };
+			bool relative = false;
+
+			if (!parse_index(p, end, chunk.positions.size(), corner.v, relative))
+				return false;
+
+			corner.relative |= relative ? relative_v : 0;
+
+			if (p < end && *p == '/')
+			{
+				p++;
+
+				// v//vn leaves the uv out
+				if (p < end && *p != '/')
+				{
+					if (!parse_index(p, end, chunk.uvs.size(), corner.vt, relative))
+						return false;
+
+					corner.relative |= relative ? relative_vt : 0;
+				}
+
+				if (p < end && *p == '/')
+				{
+					p++;
+
+					if (!parse_index(p, end, chunk.normals.size(), corner.vn, relative))
+						return false;
+
+					corner.relative |= relative ? relative_vn : 0;
+				}
+			}
+
+			if (p < end && *p != ' ' && *p != '\t')
+				return false;
+
+			face.push_back(corner);
+		}
+
+		if (face.size() < 3)
+			return false;
+
+		// Fan triangulation, matching the winding of the source polygon
+		for (size_t i = 1; i + 1 < face.size(); i++)
+		{
+			chunk.corners.push_back(face[0]);
+			chunk.corners.push_back(face[i]);
+			chunk.corners.push_back(face[i + 1]);
+		}
+
+		return true;
+	}
+
+	static void parse_chunk(obj_chunk& chunk)
+	{
+		std::vector<obj_corner> face;
+
+		const char* p = chunk.begin;
+
+		while (p < chunk.end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+			const char* next = line_end ? line_end + 1 : chunk.end;
+
+			if (!line_end)
+				line_end = chunk.end;
+
+			if (line_end > p && line_end[-1] == '\r')
+				line_end--;
+
+			const char* cs = skip_space(p, line_end);
+			bool ok = true;
+
+			if (line_end - cs >= 2 && cs[0] == 'v' && (cs[1] == ' ' || cs[1] == '\t'))
+			{
+				vector3 vert;
+				ok = parse_floats(cs + 2, line_end, &vert[0], 3);
+
+				if (ok)
+					chunk.positions.push_back(vert);
+			}
+			else if (line_end - cs >= 3 && cs[0] == 'v' && cs[1] == 'n')
+			{
+				vector3 norm;
+				ok = parse_floats(cs + 2, line_end, &norm[0], 3);
+
+				if (ok)
+					chunk.normals.push_back(norm);
+			}
+			else if (line_end - cs >= 3 && cs[0] == 'v' && cs[1] == 't')
+			{
+				// The optional third texture coordinate is ignored
+				vector2 uv;
+				ok = parse_floats(cs + 2, line_end, &uv[0], 2);
+
+				if (ok)
+					chunk.uvs.push_back(uv);
+			}
+			else if (line_end - cs >= 2 && cs[0] == 'f' && (cs[1] == ' ' || cs[1] == '\t'))
+			{
+				ok = parse_face(cs + 2, line_end, chunk, face);
+			}
+
+			if (!ok)
+			{
+				chunk.error.assign(cs, line_end);
+				return;
+			}
+
+			p = next;
+		}
+	}
+
+	static bool resolve_index(int& index, bool relative, size_t base, size_t total)
+	{
+		// A relative index may resolve to zero locally, so only absolute zeroes mark a missing attribute
+		if (index == 0 && !relative)
+		{
+			index = -1;
+			return true;
+		}
+
+		long long global = relative ? static_cast<long long>(base) + index : index;
+
+		if (global < 1 || global > static_cast<long long>(total))
+			return false;
+
+		index = static_cast<int>(global - 1);
+		return true;
+	}
+
+	bool parse_obj(const char* data, size_t size, obj_mesh& out)
+	{
+		std::vector<obj_chunk> chunks;
+
+		// Split on line boundaries so no line straddles two chunks
+		const char* end = data + size;
+		const char* begin = data;
+
+		while (begin < end)
+		{
+			const char* split = begin + OBJ_PARSE_CHUNK_SIZE;
+
+			if (split >= end)
+				split = end;
+			else
+			{
+				const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+				split = newline ? newline + 1 : end;
+			}
+
+			obj_chunk& chunk = chunks.emplace_back();
+			chunk.begin = begin;
+			chunk.end = split;
+
+			begin = split;
+		}
+
+		core::job_system::get().parallel_for(chunks.size(), 1, [&chunks](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				parse_chunk(chunks[i]);
+		});
+
+		// Prefix sums give each chunk the global index of its first element
+		size_t total_v = 0, total_vt = 0, total_vn = 0, total_corners = 0;
+
+		for (auto& chunk : chunks)
+		{
+			if (!chunk.error.empty())
+			{
+				fprintf(stderr, "OBJ: Failed to parse line (%s)\n", chunk.error.c_str());
+				return false;
+			}
+
+			chunk.base_v = total_v;
+			chunk.base_vt = total_vt;
+			chunk.base_vn = total_vn;
+
+			total_v += chunk.positions.size();
+			total_vt += chunk.uvs.size();
+			total_vn += chunk.normals.size();
+			total_corners += chunk.corners.size();
+		}
+
+		if (total_corners < 3)
+		{
+			fprintf(stderr, "OBJ: No faces found\n");
+			return false;
+		}
+
+		std::vector<vector3> positions, normals;
+		std::vector<vector2> uvs;
+
+		positions.reserve(total_v);
+		normals.reserve(total_vn);
+		uvs.reserve(total_vt);
+
+		for (const auto& chunk : chunks)
+		{
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+			uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		}
+
+		// Resolve corners into global zero-based indices, -1 marking a missing attribute
+		std::atomic<bool> valid = true;
+
+		core::job_system::get().parallel_for(chunks.size(), 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				obj_chunk& chunk = chunks[i];
+
+				for (auto& c : chunk.corners)
+				{
+					if (!resolve_index(c.v, c.relative & relative_v, chunk.base_v, total_v)
+							|| !resolve_index(c.vt, c.relative & relative_vt, chunk.base_vt, total_vt)
+							|| !resolve_index(c.vn, c.relative & relative_vn, chunk.base_vn, total_vn)
+							|| c.v < 0)
+					{
+						valid = false;
+						return;
+					}
+				}
+			}
+		});
+
+		if (!valid)
+		{
+			fprintf(stderr, "OBJ: Face references a missing vertex\n");
+			return false;
+		}
+
+		const bool has_uvs = total_vt > 0;
+		const bool has_normals = total_vn > 0;
+
+		std::unordered_map<obj_key, unsigned, obj_key_hash> unique;
+		unique.reserve(total_corners / 2);
+
+		out.positions.clear();
+		out.normals.clear();
+		out.uvs.clear();
+		out.indices.clear();
+
+		out.positions.reserve(total_v);
+		out.indices.reserve(total_corners);
+
+		if (has_normals)
+			out.normals.reserve(total_v);
+
+		if (has_uvs)
+			out.uvs.reserve(total_v);
+
+		out.min = vector3(
+				std::numeric_limits<float>::max(),
+				std::numeric_limits<float>::max(),
+				std::numeric_limits<float>::max());
+
+		out.max = vector3(
+				-std::numeric_limits<float>::max(),
+				-std::numeric_limits<float>::max(),
+				-std::numeric_limits<float>::max());
+
+		for (const auto& chunk : chunks)
+		{
+			for (const auto& c : chunk.corners)
+			{
+				obj_key key = { c.v, c.vt, c.vn };
+				auto [it, inserted] = unique.try_emplace(key, static_cast<unsigned>(out.positions.size()));
+
+				if (inserted)
+				{
+					const vector3& pos = positions[c.v];
+
+					out.positions.push_back(pos);
+					out.min = vector3::min(out.min, pos);
+					out.max = vector3::max(out.max, pos);
+
+					if (has_normals)
+						out.normals.push_back(c.vn >= 0 ? normals[c.vn] : vector3());
+
+					if (has_uvs)
+						out.uvs.push_back(c.vt >= 0 ? uvs[c.vt] : vector2());
+				}
+
+				out.indices.push_back(it->second);
+			}
+		}
+
+		return true;
+	}
+}
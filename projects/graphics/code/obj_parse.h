@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vector2.h"
+#include "vector3.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace efiilj
+{
+	/**
+	 * \brief Indexed mesh produced by parse_obj, with one vertex per unique (v, vt, vn) triplet.
+	 * Streams missing from the file are left empty.
+	 */
+	struct obj_mesh
+	{
+		std::vector<vector3> positions;
+		std::vector<vector3> normals;
+		std::vector<vector2> uvs;
+		std::vector<unsigned> indices;
+
+		vector3 min, max;
+	};
+
+	/**
+	 * \brief Parses Wavefront OBJ geometry from memory.
+	 * The buffer is split at line boundaries into chunks parsed in parallel on the job system.
+	 * Supports v, v/vt, v//vn and v/vt/vn corners, negative (relative) indices and n-gons, which are fan triangulated.
+	 * Materials, groups and smoothing groups are ignored.
+	 * \return False if the data contains no triangles or a face references a missing vertex
+	 */
+	bool parse_obj(const char* data, size_t size, obj_mesh& out);
+}
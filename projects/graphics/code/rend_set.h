@@ -12,6 +12,26 @@ namespace efiilj
 		unsigned width = 1024;
 		unsigned height = 1024;
 
+		// Mesh pool -- static meshes share buffers and are drawn with multi-draw-indirect
+		bool use_indirect = false;
+		size_t pool_vertex_capacity = 1 << 18;
+		size_t pool_index_capacity = 1 << 20;
+
+		// LOD -- mesh level i is drawn below lod_threshold / 2^(i - 1) of the screen height,
+		// and only left once the size is past the switch point by the hysteresis fraction
+		bool use_lod = true;
+		float lod_threshold = 0.4f;
+		float lod_hysteresis = 0.15f;
+
+		// Meshlet culling -- dense meshes drop their back-facing and off-screen clusters when drawn at full detail
+		bool use_meshlet_culling = true;
+
+		// Clustered lighting -- point and spot lights are shaded in a single pass
+		bool use_clustered = false;
+
+		// Light volumes -- stencil-marked in a depth-only pass, then shaded inside a scissor rect
+		bool use_stencil_volumes = true;
+
 		// Uniform names
 		std::string ubo_camera = "Matrices";
 		std::string u_camera = "cam_pos";
@@ -24,5 +44,7 @@ namespace efiilj
 		std::string default_fallback_path = "../res/shaders/default_color.sdr";
 		std::string default_fallback_path_primary = "../res/shaders/default_primary.sdr";
 		std::string default_fallback_path_secondary = "../res/shaders/default_secondary.sdr";
+		std::string clustered_lighting_path = "../res/shaders/default_clustered.sdr";
+		std::string stencil_volume_path = "../res/shaders/default_stencil.sdr";
 	};
 }
@@ -1,38 +1,46 @@
 #include "sdr_loader.h"
-#include "regex_exts.h"
+#include "core/hash.h"
+#include "core/mapped_file.h"
 
-#include <iostream>
+#include <cstring>
 #include <fstream>
 #include <string>
-#include <regex>
 
 #include <GL/glew.h>
 
-#define RECURSION_DEPTH 50
-
 namespace efiilj
 {
-
-	std::string shader_processor::load_source(const fs::path& path)
+	struct shader_binary_header
 	{
-		printf("Loading shader from %s\n", path.string().c_str());
-
-		std::ifstream t(path);
-		std::stringstream buffer;
+		uint32_t magic;
+		uint32_t version;
+		uint64_t source_hash;
+		uint64_t driver_hash;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	fs::path shader_processor::get_binary_path(const fs::path& path, const std::vector<std::string>& defines)
+	{
+		fs::path binary = path;
 
-		if (!t.is_open())
+		if (!defines.empty())
 		{
-			fprintf(stderr, "I/O error - shader not loaded\n");
-			return buffer.str();
+			uint64_t hash = core::fnv1a_basis;
+
+			for (const auto& define : defines)
+				hash = core::fnv1a(define.data(), define.size() + 1, hash);
+
+			char suffix[20];
+			snprintf(suffix, sizeof(suffix), ".%08x", static_cast<unsigned>(hash ^ (hash >> 32)));
+			binary += suffix;
 		}
-		
-		buffer << t.rdbuf();
-		std::string s = buffer.str();
 
-		return s;
+		binary += SHADER_BINARY_EXTENSION;
+		return binary;
 	}
 
-	bool shader_processor::debug_shader(unsigned id, unsigned status, unsigned type, char* msg)
+	bool shader_processor::debug_shader(unsigned id, unsigned status, unsigned type, char*& msg)
 	{
 		int result = 0;
 		int log_size = 0;
@@ -45,7 +53,8 @@ namespace efiilj
 				if (result == GL_FALSE)
 				{
 					glGetShaderiv(id, GL_INFO_LOG_LENGTH, &log_size);
-					msg = static_cast<char*>(malloc(log_size * sizeof(char)));
+					msg = static_cast<char*>(malloc(log_size * sizeof(char) + 1));
+					msg[0] = '\0';
 					glGetShaderInfoLog(id, log_size, nullptr, msg);
 				}
 				break;
@@ -57,7 +66,8 @@ namespace efiilj
 				if (result == GL_FALSE)
 				{
 					glGetProgramiv(id, GL_INFO_LOG_LENGTH, &log_size);
-					msg = static_cast<char*>(malloc(log_size * sizeof(char)));
+					msg = static_cast<char*>(malloc(log_size * sizeof(char) + 1));
+					msg[0] = '\0';
 					glGetProgramInfoLog(id, log_size, nullptr, msg);
 				}
 				break;
@@ -80,89 +90,231 @@ namespace efiilj
 		return 0;
 	}
 
-	void shader_processor::parse_include(const fs::path& path, std::string& str)
+	bool shader_processor::parse_source(unsigned int pid, const shader_source& source)
 	{
-		std::regex includes("Include\\((.*)\\)");
-		std::smatch matches;
+		printf("Found %lu sources in shader amalgam\n", source.stages.size());
+
+		bool attached = false;
 
-		int i = 0;
-		while (std::regex_search(str, matches, includes))
+		for (const auto& stage : source.stages)
 		{
-			str = exts::regex_replace(str, includes, 
-					[&path](const std::smatch& s) 
-					{ 
-						return load_source(path / s[1].str()); 
-					});
+			unsigned int type = parse_shader_type(stage.type);
 
-			if (i++ > RECURSION_DEPTH)
+			if (type == 0)
 			{
-				fprintf(stderr, "Error: Reached recursion depth (%d)\n", RECURSION_DEPTH);
-				break;
+				fprintf(stderr, "Invalid shader type %s\n", stage.type.c_str());
+				continue;
 			}
+
+			unsigned int sid = glCreateShader(type);
+			const char* src = stage.source.c_str();
+
+			glShaderSource(sid, 1, &src, nullptr);
+			glCompileShader(sid);
+
+			// Compile status is not queried here, as that would stall on the driver -- 
+			// errors are reported from end_program if linking fails
+			glAttachShader(pid, sid);
+
+			// Flagged for deletion, the shader lives until the program is deleted
+			glDeleteShader(sid);
+
+			attached = true;
 		}
+
+		return attached;
 	}
 
-	void shader_processor::parse_source(unsigned int pid, const std::string& amal)
+	uint64_t shader_processor::get_driver_hash()
 	{
-		std::regex source("Begin\\((\\w*)\\)((?:.|\\n)*?)End\\(\\)",
-				std::regex_constants::ECMAScript);
-
-    	auto source_begin = std::sregex_iterator(amal.begin(), amal.end(), source);
-    	auto source_end = std::sregex_iterator();
+		uint64_t hash = core::fnv1a_basis;
 
-		printf("Found %ld sources in shader amalgam\n", std::distance(source_begin, source_end));
-		
-		for (std::sregex_iterator i = source_begin; i != source_end; ++i) 
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
 		{
-			std::smatch match = *i;
-			std::string type_str = match[1].str();
-			std::string src_str = match[2].str();
+			const char* str = reinterpret_cast<const char*>(glGetString(name));
 
-			char* msg = nullptr;
-			unsigned int type = parse_shader_type(type_str);
+			if (str != nullptr)
+				hash = core::fnv1a(str, strlen(str), hash);
+		}
 
-			if (type == 0)
-			{
-				fprintf(stderr, "Invalid shader type %s\n", type_str.c_str());
-				continue;
-			}
+		return hash;
+	}
 
-			unsigned int sid = glCreateShader(type);
-			const char* src = src_str.c_str();
+	bool shader_processor::load_binary(unsigned int pid, const fs::path& path, uint64_t source_hash)
+	{
+		core::mapped_file file(path);
 
-			glShaderSource(sid, 1, &src, nullptr);
-			glCompileShader(sid);
+		if (!file.is_open() || file.size() < sizeof(shader_binary_header))
+			return false;
 
-			if (debug_shader(sid, GL_COMPILE_STATUS, GL_SHADER, msg))
-			{
-				fprintf(stderr, "Shader compilation error: \n%s\nSource: \n%s\n", msg, src);
-				free(msg);
-				continue;
-			}
+		const auto* header = reinterpret_cast<const shader_binary_header*>(file.data());
 
-			glAttachShader(pid, sid);
-    	}
+		if (header->magic != SHADER_BINARY_MAGIC || header->version != SHADER_BINARY_VERSION
+				|| header->source_hash != source_hash || header->driver_hash != get_driver_hash()
+				|| file.size() < sizeof(shader_binary_header) + header->length)
+			return false;
+
+		glProgramBinary(pid, header->format, file.data() + sizeof(shader_binary_header), header->length);
+
+		// Drivers may reject a binary at any time, so link status decides
+		int status = GL_FALSE;
+		glGetProgramiv(pid, GL_LINK_STATUS, &status);
+
+		return status == GL_TRUE;
+	}
+
+	void shader_processor::save_binary(unsigned int pid, const fs::path& path, uint64_t source_hash)
+	{
+		int length = 0;
+		glGetProgramiv(pid, GL_PROGRAM_BINARY_LENGTH, &length);
+
+		if (length <= 0)
+			return;
+
+		std::vector<char> blob(length);
+		GLenum format = 0;
+
+		glGetProgramBinary(pid, length, &length, &format, blob.data());
+
+		shader_binary_header header = { SHADER_BINARY_MAGIC, SHADER_BINARY_VERSION, source_hash,
+			get_driver_hash(), format, static_cast<uint32_t>(length) };
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+			return;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(blob.data(), length);
+	}
+
+	bool shader_processor::has_program_binary()
+	{
+		int formats = 0;
+
+		if (GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+		return formats > 0;
+	}
+
+	bool shader_processor::has_parallel_compile()
+	{
+		return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
 	}
 
-	unsigned int shader_processor::compile(const fs::path& path)
+	unsigned int shader_processor::begin_program(const shader_source& source, const fs::path& binary_path)
 	{
 		unsigned int pid = glCreateProgram();
 
-		std::string s = load_source(path);
-		parse_include(path.parent_path(), s);
-		parse_source(pid, s);
+		if (!binary_path.empty())
+		{
+			if (load_binary(pid, binary_path, source.hash))
+			{
+				printf("Loaded program binary %s\n", binary_path.string().c_str());
+				return pid;
+			}
+
+			// A program which failed to load a binary is recreated, rather than reused
+			glDeleteProgram(pid);
+			pid = glCreateProgram();
+
+			glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		if (!parse_source(pid, source))
+		{
+			glDeleteProgram(pid);
+			return 0;
+		}
 
 		glLinkProgram(pid);
 
+		return pid;
+	}
+
+	bool shader_processor::is_program_complete(unsigned int pid)
+	{
+		if (!has_parallel_compile())
+			return true;
+
+		int status = GL_FALSE;
+		glGetProgramiv(pid, GL_COMPLETION_STATUS_KHR, &status);
+
+		return status == GL_TRUE;
+	}
+
+	bool shader_processor::end_program(unsigned int pid, const fs::path& binary_path, uint64_t source_hash)
+	{
 		char* msg = nullptr;
 
 		if (debug_shader(pid, GL_LINK_STATUS, GL_PROGRAM, msg))
 		{
+			unsigned int shaders[8];
+			int count = 0;
+
+			glGetAttachedShaders(pid, 8, &count, shaders);
+
+			for (int i = 0; i < count; i++)
+			{
+				char* log = nullptr;
+
+				if (debug_shader(shaders[i], GL_COMPILE_STATUS, GL_SHADER, log))
+				{
+					fprintf(stderr, "Shader compilation error: \n%s\n", log);
+					free(log);
+				}
+			}
+
 			fprintf(stderr, "Shader link error: \n%s\n", msg);
 			free(msg);
+			glDeleteProgram(pid);
+			return false;
+		}
+
+		// Only programs built from source set the retrievable hint, loaded binaries are not written back
+		if (!binary_path.empty())
+		{
+			int retrievable = GL_FALSE;
+			glGetProgramiv(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, &retrievable);
+
+			if (retrievable == GL_TRUE)
+				save_binary(pid, binary_path, source_hash);
+		}
+
+		return true;
+	}
+
+	unsigned int shader_processor::compile(const fs::path& path, std::vector<fs::path>* dependencies, bool use_cache,
+			const std::vector<std::string>& defines)
+	{
+		printf("Loading shader from %s\n", path.string().c_str());
+
+		shader_source source;
+
+		if (!shader_preprocessor::load(path, source, use_cache))
+		{
+			fprintf(stderr, "I/O error - shader not loaded\n");
 			return 0;
 		}
 
+		shader_preprocessor::add_defines(source, defines);
+
+		if (dependencies != nullptr)
+		{
+			dependencies->clear();
+
+			for (const auto& dep : source.dependencies)
+				dependencies->push_back(dep.path);
+		}
+
+		const fs::path binary_path = (use_cache && has_program_binary()) ? get_binary_path(path, defines) : fs::path();
+
+		unsigned int pid = begin_program(source, binary_path);
+
+		if (pid == 0 || !end_program(pid, binary_path, source.hash))
+			return 0;
+
 		return pid;
 	}
 }
@@ -1,6 +1,14 @@
 #pragma once
 
+#include "sdr_preproc.h"
+
 #include <filesystem>
+#include <string>
+#include <vector>
+
+#define SHADER_BINARY_MAGIC 0x42534247 // "GBSB"
+#define SHADER_BINARY_VERSION 1
+#define SHADER_BINARY_EXTENSION ".sdrb"
 
 namespace fs = std::filesystem;
 
@@ -10,15 +18,61 @@ namespace efiilj
 	{
 		private:
 
-			static std::string load_source(const fs::path& path);
-			static bool debug_shader(unsigned id, unsigned status, unsigned type, char* msg);
+			static bool debug_shader(unsigned id, unsigned status, unsigned type, char*& msg);
 			static unsigned int parse_shader_type(const std::string& str);
-			static void parse_include(const fs::path& path, std::string& amal);
-			static void parse_source(unsigned int pid, const std::string& amal);
+			static bool parse_source(unsigned int pid, const shader_source& source);
+
+			static uint64_t get_driver_hash();
+			static bool load_binary(unsigned int pid, const fs::path& path, uint64_t source_hash);
+			static void save_binary(unsigned int pid, const fs::path& path, uint64_t source_hash);
 
 		public:
 
-			static unsigned int compile(const fs::path& path);
+			/**
+			 * \brief Returns the program binary path of a shader, with a suffix per set of defines.
+			 */
+			static fs::path get_binary_path(const fs::path& path, const std::vector<std::string>& defines = {});
+
+			/**
+			 * \brief True if the driver can retrieve and load program binaries.
+			 */
+			static bool has_program_binary();
+
+			/**
+			 * \brief True if the driver compiles and links on its own threads (KHR/ARB_parallel_shader_compile).
+			 */
+			static bool has_parallel_compile();
+
+			/**
+			 * \brief Creates a program from preprocessed sources, loading the binary at binary_path if it is valid.
+			 * Otherwise compiles and starts linking without querying any status, so drivers with parallel compilation
+			 * can finish the work in the background. Empty binary_path disables the binary cache.
+			 * \return Program id, 0 on failure
+			 */
+			static unsigned int begin_program(const shader_source& source, const fs::path& binary_path);
+
+			/**
+			 * \brief True once the driver has finished linking, always true without parallel compilation.
+			 */
+			static bool is_program_complete(unsigned int pid);
+
+			/**
+			 * \brief Checks the link status of a program started with begin_program, printing compile and link logs on failure,
+			 * and stores the program binary if binary_path is set.
+			 * \return False if the program failed to link, in which case it is deleted
+			 */
+			static bool end_program(unsigned int pid, const fs::path& binary_path, uint64_t source_hash);
+
+			/**
+			 * \brief Preprocesses, compiles and links a shader amalgam.
+			 * With the cache enabled the preprocessed sources are kept next to the shader, and where the driver
+			 * supports it so is the linked program binary, keyed by source hash and driver string.
+			 * \param dependencies If set, receives every file the shader was built from
+			 * \param defines Names defined at the top of every stage
+			 * \return Program id, 0 on failure
+			 */
+			static unsigned int compile(const fs::path& path, std::vector<fs::path>* dependencies = nullptr, bool use_cache = true,
+					const std::vector<std::string>& defines = {});
 
 	};
 }
@@ -0,0 +1,405 @@
+#include "sdr_preproc.h"
+#include "core/hash.h"
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace efiilj
+{
+	/**
+	 * \brief State shared by the recursive expansion of one amalgam.
+	 */
+	struct preprocess_state
+	{
+		const shader_preprocessor::file_reader& reader;
+		std::filesystem::path include_dir;
+		std::vector<std::filesystem::path> stack;
+		shader_source& out;
+		int stage = -1;
+	};
+
+	/**
+	 * \brief Size and modification time of a file, left at 0 for paths that are not on disk.
+	 */
+	static void get_stamp(const std::filesystem::path& path, uint64_t& size, int64_t& mtime)
+	{
+		std::error_code ec;
+
+		const auto file_size = std::filesystem::file_size(path, ec);
+		size = ec ? 0 : static_cast<uint64_t>(file_size);
+
+		const auto write_time = std::filesystem::last_write_time(path, ec);
+		mtime = ec ? 0 : static_cast<int64_t>(write_time.time_since_epoch().count());
+	}
+
+	static bool is_identifier(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	static bool match_directive(const std::string& text, size_t pos, const char* directive)
+	{
+		return text.compare(pos, strlen(directive), directive) == 0 && (pos == 0 || !is_identifier(text[pos - 1]));
+	}
+
+	/**
+	 * \brief Reads the argument of a directive up to the closing parenthesis on the same line.
+	 * \return Position after the parenthesis, or npos if it is missing
+	 */
+	static size_t read_argument(const std::string& text, size_t begin, std::string& arg)
+	{
+		size_t end = text.find_first_of(")\n", begin);
+
+		if (end == std::string::npos || text[end] != ')')
+			return std::string::npos;
+
+		size_t first = text.find_first_not_of(" \t", begin);
+		size_t last = text.find_last_not_of(" \t", end - 1);
+
+		arg = (first < end && last != std::string::npos && last >= first) ? text.substr(first, last - first + 1) : std::string();
+
+		return end + 1;
+	}
+
+	static void append_text(preprocess_state& state, const std::string& text, size_t begin, size_t end)
+	{
+		// Text outside Begin/End is ignored, as it always was
+		if (state.stage >= 0 && end > begin)
+			state.out.stages[state.stage].source.append(text, begin, end - begin);
+	}
+
+	static bool expand(const std::filesystem::path& path, int depth, preprocess_state& state)
+	{
+		if (depth > SHADER_RECURSION_DEPTH)
+		{
+			fprintf(stderr, "Error: Reached recursion depth (%d) at %s\n", SHADER_RECURSION_DEPTH, path.c_str());
+			return false;
+		}
+
+		if (std::find(state.stack.begin(), state.stack.end(), path) != state.stack.end())
+		{
+			fprintf(stderr, "Error: Cyclic shader include of %s\n", path.c_str());
+			return false;
+		}
+
+		auto& deps = state.out.dependencies;
+
+		const bool first = std::none_of(deps.begin(), deps.end(), [&path](const shader_dependency& dep) { return dep.path == path; });
+
+		// Stamped before reading, so a write in between shows up as a changed stamp rather than a stale hash
+		shader_dependency dep { path };
+
+		if (first)
+			get_stamp(path, dep.size, dep.mtime);
+
+		std::string text;
+
+		if (!state.reader(path, text))
+		{
+			fprintf(stderr, "I/O error - shader source %s not loaded\n", path.c_str());
+			return false;
+		}
+
+		if (first)
+		{
+			dep.hash = core::fnv1a(text.data(), text.size());
+			deps.push_back(std::move(dep));
+		}
+
+		state.stack.push_back(path);
+
+		size_t copied = 0;
+
+		for (size_t pos = 0; pos < text.size(); pos++)
+		{
+			const char c = text[pos];
+
+			if (c != 'I' && c != 'B' && c != 'E')
+				continue;
+
+			std::string arg;
+			size_t next;
+
+			if (match_directive(text, pos, "Include("))
+			{
+				if ((next = read_argument(text, pos + 8, arg)) == std::string::npos)
+				{
+					fprintf(stderr, "Error: Unterminated Include in %s\n", path.c_str());
+					return false;
+				}
+
+				append_text(state, text, copied, pos);
+
+				if (!expand((state.include_dir / arg).lexically_normal(), depth + 1, state))
+					return false;
+			}
+			else if (match_directive(text, pos, "Begin("))
+			{
+				if ((next = read_argument(text, pos + 6, arg)) == std::string::npos || state.stage >= 0)
+				{
+					fprintf(stderr, "Error: Malformed or nested Begin in %s\n", path.c_str());
+					return false;
+				}
+
+				append_text(state, text, copied, pos);
+
+				state.out.stages.push_back({ arg, std::string() });
+				state.stage = static_cast<int>(state.out.stages.size()) - 1;
+			}
+			else if (match_directive(text, pos, "End()"))
+			{
+				if (state.stage < 0)
+				{
+					fprintf(stderr, "Error: End without Begin in %s\n", path.c_str());
+					return false;
+				}
+
+				append_text(state, text, copied, pos);
+
+				next = pos + 5;
+				state.stage = -1;
+			}
+			else
+				continue;
+
+			copied = next;
+			pos = next - 1;
+		}
+
+		append_text(state, text, copied, text.size());
+		state.stack.pop_back();
+
+		return true;
+	}
+
+	bool shader_preprocessor::read_file(const std::filesystem::path& path, std::string& out)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+		if (!file.is_open())
+			return false;
+
+		out.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(&out[0], static_cast<std::streamsize>(out.size()));
+
+		return file.good();
+	}
+
+	static uint64_t hash_stages(const std::vector<shader_stage>& stages)
+	{
+		uint64_t hash = core::fnv1a_basis;
+
+		for (const auto& stage : stages)
+		{
+			hash = core::fnv1a(stage.type.data(), stage.type.size(), hash);
+			hash = core::fnv1a(stage.source.data(), stage.source.size(), hash);
+		}
+
+		return hash;
+	}
+
+	bool shader_preprocessor::process(const std::filesystem::path& path, shader_source& out, const file_reader& reader)
+	{
+		out = shader_source();
+
+		preprocess_state state = { reader, path.parent_path(), {}, out };
+
+		if (!expand(path.lexically_normal(), 0, state))
+			return false;
+
+		if (state.stage >= 0)
+		{
+			fprintf(stderr, "Error: Missing End() in %s\n", path.c_str());
+			return false;
+		}
+
+		out.hash = hash_stages(out.stages);
+
+		return true;
+	}
+
+	bool shader_preprocessor::load(const std::filesystem::path& path, shader_source& out, bool use_cache)
+	{
+		if (use_cache && read_cache(path, out))
+			return true;
+
+		if (!process(path, out))
+			return false;
+
+		if (use_cache)
+			write_cache(path, out);
+
+		return true;
+	}
+
+	void shader_preprocessor::add_defines(shader_source& source, const std::vector<std::string>& defines)
+	{
+		if (defines.empty())
+			return;
+
+		std::string block;
+
+		for (const auto& define : defines)
+			block += "#define " + define + "\n";
+
+		for (auto& stage : source.stages)
+		{
+			// GLSL requires #version to come first, so the defines go on the line after it
+			size_t version = stage.source.find("#version");
+			size_t pos = 0;
+
+			if (version != std::string::npos)
+			{
+				pos = stage.source.find('\n', version);
+				pos = (pos == std::string::npos) ? stage.source.size() : pos + 1;
+			}
+
+			stage.source.insert(pos, block);
+		}
+
+		source.hash = hash_stages(source.stages);
+	}
+
+	std::filesystem::path shader_preprocessor::get_cache_path(const std::filesystem::path& path)
+	{
+		std::filesystem::path cache = path;
+		cache += SHADER_CACHE_EXTENSION;
+		return cache;
+	}
+
+	bool shader_preprocessor::write_cache(const std::filesystem::path& path, const shader_source& source)
+	{
+		std::ofstream file(get_cache_path(path), std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+			return false;
+
+		auto write_u32 = [&file](uint32_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+		auto write_u64 = [&file](uint64_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+		auto write_str = [&](const std::string& str)
+		{
+			write_u32(static_cast<uint32_t>(str.size()));
+			file.write(str.data(), static_cast<std::streamsize>(str.size()));
+		};
+
+		write_u32(SHADER_CACHE_MAGIC);
+		write_u32(SHADER_CACHE_VERSION);
+		write_u64(source.hash);
+		write_u32(static_cast<uint32_t>(source.dependencies.size()));
+		write_u32(static_cast<uint32_t>(source.stages.size()));
+
+		for (const auto& dep : source.dependencies)
+		{
+			write_str(dep.path.string());
+			write_u64(dep.hash);
+			write_u64(dep.size);
+			write_u64(static_cast<uint64_t>(dep.mtime));
+		}
+
+		for (const auto& stage : source.stages)
+		{
+			write_str(stage.type);
+			write_str(stage.source);
+		}
+
+		return file.good();
+	}
+
+	bool shader_preprocessor::read_cache(const std::filesystem::path& path, shader_source& out)
+	{
+		core::mapped_file file(get_cache_path(path));
+
+		if (!file.is_open())
+			return false;
+
+		const unsigned char* cursor = file.data();
+		const unsigned char* end = file.data() + file.size();
+
+		auto read = [&cursor, end](void* dst, size_t size)
+		{
+			if (static_cast<size_t>(end - cursor) < size)
+				return false;
+
+			memcpy(dst, cursor, size);
+			cursor += size;
+			return true;
+		};
+
+		auto read_str = [&](std::string& str)
+		{
+			uint32_t size = 0;
+
+			if (!read(&size, sizeof(size)) || static_cast<size_t>(end - cursor) < size)
+				return false;
+
+			str.assign(reinterpret_cast<const char*>(cursor), size);
+			cursor += size;
+			return true;
+		};
+
+		uint32_t magic = 0, version = 0, dep_count = 0, stage_count = 0;
+
+		out = shader_source();
+
+		if (!read(&magic, 4) || !read(&version, 4) || magic != SHADER_CACHE_MAGIC || version != SHADER_CACHE_VERSION)
+			return false;
+
+		if (!read(&out.hash, 8) || !read(&dep_count, 4) || !read(&stage_count, 4))
+			return false;
+
+		// Every dependency and stage takes at least its fixed fields, so larger counts mean a damaged file
+		const size_t dep_size = 4 + 8 + 8 + 8, stage_size = 4 + 4;
+
+		if (dep_count > static_cast<size_t>(end - cursor) / dep_size)
+			return false;
+
+		// Files written within the cache's own timestamp tick may have changed unseen, so only older ones are trusted
+		std::error_code ec;
+		const int64_t cache_mtime = static_cast<int64_t>(
+				std::filesystem::last_write_time(get_cache_path(path), ec).time_since_epoch().count());
+
+		for (uint32_t i = 0; i < dep_count; i++)
+		{
+			std::string dep_path;
+			shader_dependency dep;
+
+			if (!read_str(dep_path) || !read(&dep.hash, 8) || !read(&dep.size, 8) || !read(&dep.mtime, 8))
+				return false;
+
+			dep.path = dep_path;
+
+			uint64_t size = 0;
+			int64_t mtime = 0;
+			get_stamp(dep.path, size, mtime);
+
+			const bool stamped = !ec && mtime != 0 && size == dep.size && mtime == dep.mtime && mtime < cache_mtime;
+
+			// Otherwise the contents decide, and any changed, missing or unreadable dependency invalidates the amalgam
+			if (!stamped)
+			{
+				std::string text;
+
+				if (!read_file(dep.path, text) || core::fnv1a(text.data(), text.size()) != dep.hash)
+					return false;
+			}
+
+			out.dependencies.push_back(std::move(dep));
+		}
+
+		if (stage_count > static_cast<size_t>(end - cursor) / stage_size)
+			return false;
+
+		out.stages.resize(stage_count);
+
+		for (auto& stage : out.stages)
+		{
+			if (!read_str(stage.type) || !read_str(stage.source))
+				return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define SHADER_CACHE_MAGIC 0x43534247 // "GBSC"
+#define SHADER_CACHE_VERSION 2
+#define SHADER_CACHE_EXTENSION ".sdrc"
+#define SHADER_RECURSION_DEPTH 50
+
+namespace efiilj
+{
+	/**
+	 * \brief Source of one shader stage, with type as written in Begin(...).
+	 */
+	struct shader_stage
+	{
+		std::string type;
+		std::string source;
+	};
+
+	/**
+	 * \brief File read into an amalgam. Size and modification time are taken before reading,
+	 * so that the cache can skip rehashing files that have not been touched since.
+	 */
+	struct shader_dependency
+	{
+		std::filesystem::path path;
+		uint64_t hash = 0;
+		uint64_t size = 0;
+		int64_t mtime = 0;
+	};
+
+	/**
+	 * \brief Fully expanded shader amalgam.
+	 * Dependencies hold the root file followed by every included file, each listed once.
+	 */
+	struct shader_source
+	{
+		std::vector<shader_stage> stages;
+		std::vector<shader_dependency> dependencies;
+
+		// Hash of the expanded stage sources
+		uint64_t hash = 0;
+	};
+
+	/**
+	 * \brief Expands Include(...) directives and splits Begin(TYPE) ... End() blocks in a single pass,
+	 * without touching GL. Includes are resolved relative to the directory of the root file.
+	 */
+	class shader_preprocessor
+	{
+		public:
+
+			typedef std::function<bool(const std::filesystem::path&, std::string&)> file_reader;
+
+			/**
+			 * \brief Reads a whole file into a string.
+			 */
+			static bool read_file(const std::filesystem::path& path, std::string& out);
+
+			/**
+			 * \brief Preprocesses a shader amalgam.
+			 * \param reader Source of file contents, replaceable to run on in-memory files
+			 * \return False on a missing or cyclic include, or unbalanced Begin/End
+			 */
+			static bool process(const std::filesystem::path& path, shader_source& out, const file_reader& reader = read_file);
+
+			/**
+			 * \brief Loads preprocessed sources from the cache next to the shader if every dependency is unchanged,
+			 * otherwise preprocesses and rewrites the cache. Dependencies are only rehashed when their size or
+			 * modification time differs from the cache, or is too close to the cache's own to be trusted.
+			 */
+			static bool load(const std::filesystem::path& path, shader_source& out, bool use_cache = true);
+
+			/**
+			 * \brief Inserts a #define for each name after the #version line of every stage, and rehashes the sources.
+			 */
+			static void add_defines(shader_source& source, const std::vector<std::string>& defines);
+
+			static std::filesystem::path get_cache_path(const std::filesystem::path& path);
+			static bool read_cache(const std::filesystem::path& path, shader_source& out);
+			static bool write_cache(const std::filesystem::path& path, const shader_source& source);
+	};
+}
@@ -1,13 +1,19 @@
 #include "shdr_mgr.h"
 #include "sdr_loader.h"
+#include "core/jobs.h"
 
 #include <GL/glew.h>
 
 namespace efiilj
 {
 	shader_server::shader_server()
-		: _current(0)
+		: _current(0), _pending(0)
 	{
+		add_columns({
+			&_data.uri, &_data.dependencies, &_data.program_id, &_data.type, &_data.state,
+			&_data.features, &_data.base, &_data.status, &_data.build
+		});
+
 		printf("Init shaders...\n");
 	}
 
@@ -22,6 +28,11 @@ namespace efiilj
 		_data.state.emplace_back(false);
 		_data.type.emplace_back(0);
 		_data.uri.emplace_back();
+		_data.dependencies.emplace_back();
+		_data.features.emplace_back(feature_none);
+		_data.base.emplace_back(-1);
+		_data.status.emplace_back(shader_status::idle);
+		_data.build.emplace_back();
 	}
 
 	void shader_server::on_register(std::shared_ptr<manager_host> host) //NOLINT
@@ -29,9 +40,313 @@ namespace efiilj
 		
 	}
 
+	void shader_server::on_setup()
+	{
+		// Let the driver use as many compiler threads as it likes
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else if (GLEW_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+		printf("Shader compilation: %s\n", shader_processor::has_parallel_compile() ? "parallel" : "serial");
+	}
+
+	void shader_server::on_begin_frame()
+	{
+		_pending = 0;
+
+		int started = 0;
+
+		for (shader_id idx : _pool)
+		{
+			if (!_alive[idx])
+				continue;
+
+			switch (_data.status[idx])
+			{
+				case shader_status::preprocessing:
+				{
+					// Without parallel compilation begin_link stalls, so only a few are started per frame
+					if (!_data.build[idx]->done.load(std::memory_order_acquire) 
+							|| (!shader_processor::has_parallel_compile() && started >= SHADER_COMPILE_BUDGET))
+					{
+						_pending++;
+						break;
+					}
+
+					begin_link(idx);
+					started++;
+
+					if (_data.status[idx] == shader_status::linking)
+						_pending++;
+
+					break;
+				}
+
+				case shader_status::linking:
+				{
+					if (shader_processor::is_program_complete(_data.build[idx]->program))
+						end_link(idx);
+					else
+						_pending++;
+
+					break;
+				}
+
+				default:
+					break;
+			}
+		}
+	}
+
+	std::vector<std::string> shader_server::get_feature_defines(unsigned features)
+	{
+		static const char* names[feature_count] = 
+		{
+			"HAS_BASE_MAP",
+			"HAS_NORMAL_MAP",
+			"HAS_ORM_MAP",
+			"HAS_EMISSIVE_MAP",
+			"ALPHA_CUTOFF",
+			"INSTANCED",
+			"SKINNED"
+		};
+
+		std::vector<std::string> defines;
+
+		for (unsigned i = 0; i < feature_count; i++)
+		{
+			if (features & (1u << i))
+				defines.emplace_back(names[i]);
+		}
+
+		return defines;
+	}
+
+	std::vector<std::string> shader_server::get_defines(shader_id idx) const
+	{
+		std::vector<std::string> defines = _global_defines;
+		std::vector<std::string> features = get_feature_defines(_data.features[idx]);
+
+		defines.insert(defines.end(), features.begin(), features.end());
+
+		return defines;
+	}
+
+	static uint64_t get_permutation_key(shader_id base, unsigned features)
+	{
+		return (static_cast<uint64_t>(base) << 32) | features;
+	}
+
+	shader_id shader_server::get_permutation(shader_id base, unsigned features)
+	{
+		if (!server::is_valid(base))
+			return base;
+
+		// Permutations of permutations are flattened onto the root shader
+		if (_data.base[base] >= 0)
+		{
+			features |= _data.features[base];
+			base = _data.base[base];
+		}
+
+		features |= _data.features[base];
+
+		if (features == _data.features[base])
+			return base;
+
+		const uint64_t key = get_permutation_key(base, features);
+		auto it = _permutations.find(key);
+
+		if (it != _permutations.end())
+			return it->second;
+
+		shader_id idx = create();
+
+		_data.uri[idx] = _data.uri[base];
+		_data.base[idx] = base;
+		_data.features[idx] = features;
+
+		_permutations[key] = idx;
+
+		queue(idx);
+
+		return idx;
+	}
+
+	void shader_server::queue(shader_id idx)
+	{
+		auto build = std::make_shared<shader_build>();
+		build->start = std::chrono::steady_clock::now();
+
+		_data.build[idx] = build;
+		_data.status[idx] = shader_status::preprocessing;
+
+		const std::filesystem::path uri = _data.uri[idx];
+		const std::vector<std::string> defines = get_defines(idx);
+
+		core::job_system::get().submit([build, uri, defines]()
+				{
+					build->ok = shader_preprocessor::load(uri, build->source);
+					shader_preprocessor::add_defines(build->source, defines);
+					build->done.store(true, std::memory_order_release);
+				}, nullptr, core::job_queue::background);
+	}
+
+	bool shader_server::reload(shader_id idx)
+	{
+		if (_data.status[idx] == shader_status::preprocessing || _data.status[idx] == shader_status::linking)
+			return false;
+
+		printf("Reloading shader %d (%s)\n", idx, _data.uri[idx].c_str());
+		queue(idx);
+
+		return true;
+	}
+
+	void shader_server::fail_build(shader_id idx)
+	{
+		// A failed reload keeps running the previous program
+		_data.status[idx] = _data.state[idx] ? shader_status::ready : shader_status::failed;
+		_data.build[idx].reset();
+	}
+
+	void shader_server::begin_link(shader_id idx)
+	{
+		shader_build& build = *_data.build[idx];
+
+		if (!build.ok)
+		{
+			fprintf(stderr, "Shader %d: failed to preprocess %s\n", idx, _data.uri[idx].c_str());
+			fail_build(idx);
+			return;
+		}
+
+		_data.dependencies[idx].clear();
+
+		for (const auto& dep : build.source.dependencies)
+			_data.dependencies[idx].push_back(dep.path);
+
+		const std::filesystem::path binary_path = shader_processor::has_program_binary() 
+			? shader_processor::get_binary_path(_data.uri[idx], get_defines(idx))
+			: std::filesystem::path();
+
+		build.program = shader_processor::begin_program(build.source, binary_path);
+
+		if (build.program == 0)
+		{
+			fail_build(idx);
+			return;
+		}
+
+		_data.status[idx] = shader_status::linking;
+	}
+
+	void shader_server::end_link(shader_id idx)
+	{
+		shader_build& build = *_data.build[idx];
+
+		const std::filesystem::path binary_path = shader_processor::has_program_binary() 
+			? shader_processor::get_binary_path(_data.uri[idx], get_defines(idx))
+			: std::filesystem::path();
+
+		if (!shader_processor::end_program(build.program, binary_path, build.source.hash))
+		{
+			fprintf(stderr, "Shader %d: failed to link %s\n", idx, _data.uri[idx].c_str());
+			fail_build(idx);
+			return;
+		}
+
+		const unsigned old = _data.program_id[idx];
+
+		// Reloads keep the bindings set on the program they replace, permutations take those of their base
+		if (old != 0)
+			copy_block_bindings(old, build.program);
+		else if (is_valid(_data.base[idx]))
+			copy_block_bindings(_data.program_id[_data.base[idx]], build.program);
+
+		if (old != 0)
+			glDeleteProgram(old);
+
+		if (_current == idx)
+			_current = -1;
+
+		_data.program_id[idx] = build.program;
+		_data.state[idx] = true;
+		_data.status[idx] = shader_status::ready;
+
+		printf("Shader %d of %s (features %#x) ready in %.1f ms\n", 
+				idx, _data.uri[idx].filename().c_str(), _data.features[idx],
+				std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - build.start).count());
+
+		_data.build[idx].reset();
+	}
+
+	void shader_server::copy_block_bindings(unsigned src, unsigned dst)
+	{
+		int count = 0;
+		glGetProgramiv(src, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+
+		for (int i = 0; i < count; i++)
+		{
+			char name[128];
+			int binding = 0;
+
+			glGetActiveUniformBlockName(src, i, sizeof(name), nullptr, name);
+			glGetActiveUniformBlockiv(src, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+
+			unsigned block = glGetUniformBlockIndex(dst, name);
+
+			if (block != GL_INVALID_INDEX)
+				glUniformBlockBinding(dst, block, binding);
+		}
+	}
+
 	bool shader_server::is_valid(shader_id idx) const
 	{
-		return (idx > -1 && idx < static_cast<int>(_pool.size()) && _data.state[idx]);
+		return (server::is_valid(idx) && _data.state[idx]);
+	}
+
+	bool shader_server::destroy(shader_id idx)
+	{
+		// Shaders that never linked are not valid for use, but still hold a slot
+		if (!server::is_valid(idx))
+			return false;
+
+		// A permutation leaves the lookup, and a base takes its permutations with it
+		if (_data.base[idx] >= 0)
+		{
+			_permutations.erase(get_permutation_key(_data.base[idx], _data.features[idx]));
+		}
+		else
+		{
+			std::vector<shader_id> permutations;
+
+			for (const auto& [key, perm] : _permutations)
+			{
+				if (static_cast<shader_id>(key >> 32) == idx)
+					permutations.push_back(perm);
+			}
+
+			for (shader_id perm : permutations)
+				destroy(perm);
+		}
+
+		if (_data.build[idx] && _data.build[idx]->program != 0)
+			glDeleteProgram(_data.build[idx]->program);
+
+		if (_data.program_id[idx] != 0)
+			glDeleteProgram(_data.program_id[idx]);
+
+		if (_current == idx)
+			_current = -1;
+
+		_data.program_id[idx] = 0;
+		_data.state[idx] = false;
+		_data.status[idx] = shader_status::idle;
+		_data.build[idx].reset();
+
+		return server::destroy(idx);
 	}
 
 	bool shader_server::use(shader_id idx) const
@@ -51,17 +366,20 @@ namespace efiilj
 
 	bool shader_server::compile(shader_id idx)
 	{
-		unsigned int pid = shader_processor::compile(_data.uri[idx]);
+		unsigned int pid = shader_processor::compile(_data.uri[idx], &_data.dependencies[idx], true, 
+				get_defines(idx));
 
 		if (pid > 0)
 		{
 			_data.program_id[idx] = pid;
 			_data.state[idx] = true;
+			_data.status[idx] = shader_status::ready;
 			printf("Shader %d compiled successfully\n", pid);
 			return true;
 		}
 
 		fprintf(stderr, "Compilation failed\n");
+		_data.status[idx] = shader_status::failed;
 		return false;
 	}
 
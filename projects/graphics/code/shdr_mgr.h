@@ -3,14 +3,62 @@
 #include "manager.h"
 #include "mgr_host.h"
 #include "matrix4.h"
+#include "sdr_preproc.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <filesystem>
+#include <unordered_map>
+
+#define SHADER_COMPILE_BUDGET 4
 
 namespace efiilj
 {
 	typedef int shader_id;
 
+	/**
+	 * \brief Feature bits of a shader permutation, each adding a #define to the shader sources.
+	 */
+	enum shader_feature : unsigned
+	{
+		feature_none = 0,
+		feature_base_map = 1 << 0,		// HAS_BASE_MAP
+		feature_normal_map = 1 << 1,	// HAS_NORMAL_MAP
+		feature_orm_map = 1 << 2,		// HAS_ORM_MAP
+		feature_emissive_map = 1 << 3,	// HAS_EMISSIVE_MAP
+		feature_alpha_cutoff = 1 << 4,	// ALPHA_CUTOFF
+		feature_instanced = 1 << 5,		// INSTANCED
+		feature_skinned = 1 << 6,		// SKINNED
+		feature_count = 7
+	};
+
+	enum class shader_status
+	{
+		idle,
+		preprocessing,
+		linking,
+		ready,
+		failed
+	};
+
+	/**
+	 * \brief Preprocessed sources handed from a worker thread to the main thread for compilation.
+	 */
+	struct shader_build
+	{
+		std::atomic<bool> done { false };
+		bool ok = false;
+
+		shader_source source;
+		std::chrono::steady_clock::time_point start;
+
+		// Program being linked, swapped in for the current one once complete
+		unsigned program = 0;
+	};
+
 	class shader_server : public server<shader_id>
 	{
 		private:
@@ -19,12 +67,30 @@ namespace efiilj
 
 			struct ShaderData
 			{
-				std::vector<std::filesystem::path> uri;
-				std::vector<unsigned int> program_id;
-				std::vector<unsigned int> type;
-				std::vector<bool> state;
+				slot_vector<std::filesystem::path> uri;
+				slot_vector<std::vector<std::filesystem::path>> dependencies;
+				slot_vector<unsigned int> program_id;
+				slot_vector<unsigned int> type;
+				slot_vector<bool> state;
+				slot_vector<unsigned> features;
+				slot_vector<shader_id> base;
+				slot_vector<shader_status> status;
+				slot_vector<std::shared_ptr<shader_build>> build;
 			} _data;
 
+			// Permutations keyed by base shader in the high and feature bits in the low word
+			std::unordered_map<uint64_t, shader_id> _permutations;
+
+			size_t _pending;
+
+			std::vector<std::string> _global_defines;
+
+			void queue(shader_id idx);
+			void begin_link(shader_id idx);
+			void end_link(shader_id idx);
+			void fail_build(shader_id idx);
+			void copy_block_bindings(unsigned src, unsigned dst);
+
 		public:
 
 			shader_server();
@@ -33,9 +99,53 @@ namespace efiilj
 			void append_defaults(shader_id idx) override;
 			bool is_valid(shader_id idx) const override;
 
+			/**
+			 * \brief Deletes the program, and any still linking, before the slot is freed for reuse.
+			 * A permutation is dropped from the permutation lookup, and a base shader destroys its permutations.
+			 */
+			bool destroy(shader_id idx) override;
+
 			void on_register(std::shared_ptr<manager_host> host) override;
+			void on_setup() override;
+			void on_begin_frame() override;
 
+			/**
+			 * \brief Compiles and links a shader immediately, with the defines of its feature bits.
+			 */
 			bool compile(shader_id idx);
+
+			/**
+			 * \brief Returns the permutation of a base shader with the given feature bits added to its own, 
+			 * creating it and queueing a background build on first request. The permutation is not valid 
+			 * until its program has linked, so callers should fall back to the base shader until then.
+			 */
+			shader_id get_permutation(shader_id base, unsigned features);
+
+			/**
+			 * \brief Rebuilds a shader in the background, keeping the current program in use until the new one has linked.
+			 * \return False if a build is already in flight
+			 */
+			bool reload(shader_id idx);
+
+			/**
+			 * \brief Returns the #define names of a feature mask.
+			 */
+			static std::vector<std::string> get_feature_defines(unsigned features);
+
+			/**
+			 * \brief Returns the global defines followed by those of the feature bits of a shader.
+			 */
+			std::vector<std::string> get_defines(shader_id idx) const;
+
+			/**
+			 * \brief Sets defines added to every shader, such as those of the mesh vertex layout.
+			 * Only affects shaders built afterwards, so should be set before any are loaded.
+			 */
+			void set_global_defines(const std::vector<std::string>& defines)
+			{
+				_global_defines = defines;
+			}
+
 			bool use(shader_id idx) const;
 
 			int find_uniform_location(shader_id idx, const std::string& name, bool is_block = false);
@@ -58,8 +168,43 @@ namespace efiilj
 			bool set_uniform(const std::string& name, const matrix3& mat);
 
 			const std::filesystem::path& get_uri(shader_id idx) const;
+
+			/**
+			 * \brief Files the shader was built from in its last compile, including the root amalgam.
+			 */
+			const std::vector<std::filesystem::path>& get_dependencies(shader_id idx) const
+			{
+				return _data.dependencies[idx];
+			}
+
 			void set_uri(shader_id idx, const std::filesystem::path& uri);
 
+			unsigned get_features(shader_id idx) const
+			{
+				return _data.features[idx];
+			}
+
+			/**
+			 * \brief Sets the feature bits used by the next compile.
+			 */
+			void set_features(shader_id idx, unsigned features)
+			{
+				_data.features[idx] = features;
+			}
+
+			shader_status get_status(shader_id idx) const
+			{
+				return _data.status[idx];
+			}
+
+			/**
+			 * \brief Number of permutations and reloads still preprocessing or linking.
+			 */
+			size_t get_pending_count() const
+			{
+				return _pending;
+			}
+
 			const unsigned int& get_program_id(shader_id idx) const
 			{
 				return _data.program_id[idx];
@@ -0,0 +1,857 @@
+#include "tex_cook.h"
+#include "core/jobs.h"
+#include "core/mapped_file.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace efiilj
+{
+	// BC7 4-bit index interpolation weights, out of 64
+	static const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/**
+	 * \brief A 4x4 block of texels, one plane per channel.
+	 */
+	struct texel_block
+	{
+		alignas(16) float c[4][16];
+	};
+
+	static float srgb_to_linear(float v)
+	{
+		return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float linear_to_srgb(float v)
+	{
+		return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static unsigned char to_unorm8(float v)
+	{
+		return static_cast<unsigned char>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+	size_t get_codec_level_size(texture_codec codec, unsigned width, unsigned height)
+	{
+		const size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+
+		switch (codec)
+		{
+			case texture_codec::bc1:
+			case texture_codec::bc4:
+				return blocks * 8;
+			case texture_codec::bc3:
+			case texture_codec::bc5:
+			case texture_codec::bc7:
+				return blocks * 16;
+			default:
+				return static_cast<size_t>(width) * height * 4;
+		}
+	}
+
+	int get_codec_channels(texture_codec codec)
+	{
+		switch (codec)
+		{
+			case texture_codec::bc1: return 3;
+			case texture_codec::bc4: return 1;
+			case texture_codec::bc5: return 2;
+			default: return 4;
+		}
+	}
+
+	const char* get_codec_name(texture_codec codec)
+	{
+		static const char* names[] = { "RGBA8", "BC1", "BC3", "BC4", "BC5", "BC7" };
+		return names[static_cast<int>(codec)];
+	}
+
+	double cooked_texture::get_psnr() const
+	{
+		if (texels == 0)
+			return 0.0;
+
+		const double mse = sq_error / (static_cast<double>(texels) * get_codec_channels(codec));
+		return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+	}
+
+	/**
+	 * \brief Halves one axis of a float RGBA image with the [1 3 3 1] / 8 kernel, clamping at the edges.
+	 * \param horizontal True to filter along rows, false along columns
+	 */
+	static void downsample_axis(const std::vector<float>& src, std::vector<float>& dst,
+			unsigned length, unsigned lines, unsigned out_length, bool horizontal)
+	{
+		const int last = static_cast<int>(length) - 1;
+
+		core::job_system::get().parallel_for(lines, 64, [&](size_t begin, size_t end)
+		{
+			for (size_t line = begin; line < end; line++)
+			{
+				for (unsigned i = 0; i < out_length; i++)
+				{
+					const int taps[4] = {
+						std::clamp(static_cast<int>(i * 2) - 1, 0, last),
+						std::clamp(static_cast<int>(i * 2), 0, last),
+						std::clamp(static_cast<int>(i * 2) + 1, 0, last),
+						std::clamp(static_cast<int>(i * 2) + 2, 0, last)
+					};
+
+					const float weights[4] = { 0.125f, 0.375f, 0.375f, 0.125f };
+
+					for (int c = 0; c < 4; c++)
+					{
+						float sum = 0.0f;
+
+						for (int t = 0; t < 4; t++)
+						{
+							size_t at = horizontal ? line * length + taps[t] : taps[t] * lines + line;
+							sum += src[at * 4 + c] * weights[t];
+						}
+
+						size_t to = horizontal ? line * out_length + i : i * lines + line;
+						dst[to * 4 + c] = sum;
+					}
+				}
+			}
+		});
+	}
+
+	void cook_mips(std::vector<std::vector<unsigned char>>& levels, unsigned width, unsigned height, texture_content content)
+	{
+		levels.resize(1);
+
+		std::vector<float> current(static_cast<size_t>(width) * height * 4);
+		std::vector<float> temp;
+
+		float to_linear[256];
+
+		for (int i = 0; i < 256; i++)
+			to_linear[i] = content == texture_content::color ? srgb_to_linear(i / 255.0f) : i / 255.0f;
+
+		for (size_t i = 0; i < current.size(); i++)
+			current[i] = (i % 4 == 3) ? levels[0][i] / 255.0f : to_linear[levels[0][i]];
+
+		unsigned w = width, h = height;
+
+		// Filtering continues from the float result of the previous level, not the quantized one
+		while (w > 1 || h > 1)
+		{
+			const unsigned dw = std::max(1u, w / 2);
+			const unsigned dh = std::max(1u, h / 2);
+
+			temp.assign(static_cast<size_t>(dw) * h * 4, 0.0f);
+			downsample_axis(current, temp, w, h, dw, true);
+
+			current.assign(static_cast<size_t>(dw) * dh * 4, 0.0f);
+			downsample_axis(temp, current, h, dw, dh, false);
+
+			std::vector<unsigned char> level(current.size());
+
+			for (size_t t = 0; t < current.size(); t += 4)
+			{
+				float r = current[t], g = current[t + 1], b = current[t + 2];
+
+				if (content == texture_content::color)
+				{
+					r = linear_to_srgb(r);
+					g = linear_to_srgb(g);
+					b = linear_to_srgb(b);
+				}
+				else if (content == texture_content::normal)
+				{
+					float x = r * 2.0f - 1.0f, y = g * 2.0f - 1.0f, z = b * 2.0f - 1.0f;
+					float len = std::sqrt(x * x + y * y + z * z);
+
+					if (len > 0.0f)
+					{
+						r = x / len * 0.5f + 0.5f;
+						g = y / len * 0.5f + 0.5f;
+						b = z / len * 0.5f + 0.5f;
+					}
+				}
+
+				level[t] = to_unorm8(r);
+				level[t + 1] = to_unorm8(g);
+				level[t + 2] = to_unorm8(b);
+				level[t + 3] = to_unorm8(current[t + 3]);
+			}
+
+			levels.push_back(std::move(level));
+
+			w = dw;
+			h = dh;
+		}
+	}
+
+	static void load_block(const unsigned char* rgba, unsigned width, unsigned height, unsigned bx, unsigned by, texel_block& block)
+	{
+		for (unsigned y = 0; y < 4; y++)
+		{
+			const unsigned sy = std::min(by * 4 + y, height - 1);
+
+			for (unsigned x = 0; x < 4; x++)
+			{
+				const unsigned sx = std::min(bx * 4 + x, width - 1);
+				const unsigned char* texel = rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+
+				for (int c = 0; c < 4; c++)
+					block.c[c][y * 4 + x] = texel[c];
+			}
+		}
+	}
+
+	/**
+	 * \brief Picks the closest palette entry for every texel over the first channels,
+	 * four texels at a time.
+	 * \return Summed squared error
+	 */
+	static float select_indices(const texel_block& block, int channels, const float (*palette)[4], int count, uint8_t* indices)
+	{
+#ifdef __SSE2__
+		__m128 total = _mm_setzero_ps();
+
+		for (int t = 0; t < 16; t += 4)
+		{
+			__m128 texel[4];
+
+			for (int c = 0; c < channels; c++)
+				texel[c] = _mm_load_ps(&block.c[c][t]);
+
+			__m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+			__m128i best_index = _mm_setzero_si128();
+
+			for (int p = 0; p < count; p++)
+			{
+				__m128 dist = _mm_setzero_ps();
+
+				for (int c = 0; c < channels; c++)
+				{
+					__m128 d = _mm_sub_ps(texel[c], _mm_set1_ps(palette[p][c]));
+					dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+				}
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+
+				best = _mm_min_ps(best, dist);
+				best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, best_index));
+			}
+
+			alignas(16) int lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), best_index);
+
+			for (int i = 0; i < 4; i++)
+				indices[t + i] = static_cast<uint8_t>(lanes[i]);
+
+			total = _mm_add_ps(total, best);
+		}
+
+		alignas(16) float sums[4];
+		_mm_store_ps(sums, total);
+
+		return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+		float total = 0.0f;
+
+		for (int t = 0; t < 16; t++)
+		{
+			float best = std::numeric_limits<float>::max();
+
+			for (int p = 0; p < count; p++)
+			{
+				float dist = 0.0f;
+
+				for (int c = 0; c < channels; c++)
+				{
+					float d = block.c[c][t] - palette[p][c];
+					dist += d * d;
+				}
+
+				if (dist < best)
+				{
+					best = dist;
+					indices[t] = static_cast<uint8_t>(p);
+				}
+			}
+
+			total += best;
+		}
+
+		return total;
+#endif
+	}
+
+	/**
+	 * \brief Fits a line through the block colors and returns its extremes as endpoints.
+	 */
+	static void fit_principal_axis(const texel_block& block, int channels, float* e0, float* e1)
+	{
+		float mean[4] = {};
+
+		for (int c = 0; c < channels; c++)
+		{
+			for (int t = 0; t < 16; t++)
+				mean[c] += block.c[c][t];
+
+			mean[c] /= 16.0f;
+		}
+
+		float cov[4][4] = {};
+
+		for (int t = 0; t < 16; t++)
+		{
+			for (int i = 0; i < channels; i++)
+			{
+				for (int j = 0; j < channels; j++)
+					cov[i][j] += (block.c[i][t] - mean[i]) * (block.c[j][t] - mean[j]);
+			}
+		}
+
+		// Power iteration for the dominant eigenvector
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+		for (int iter = 0; iter < 8; iter++)
+		{
+			float next[4] = {};
+			float len = 0.0f;
+
+			for (int i = 0; i < channels; i++)
+			{
+				for (int j = 0; j < channels; j++)
+					next[i] += cov[i][j] * axis[j];
+
+				len = std::max(len, std::fabs(next[i]));
+			}
+
+			if (len <= 0.0f)
+				break;
+
+			for (int i = 0; i < channels; i++)
+				axis[i] = next[i] / len;
+		}
+
+		float norm = 0.0f;
+
+		for (int i = 0; i < channels; i++)
+			norm += axis[i] * axis[i];
+
+		norm = norm > 0.0f ? 1.0f / std::sqrt(norm) : 0.0f;
+
+		float lo = std::numeric_limits<float>::max(), hi = -std::numeric_limits<float>::max();
+
+		for (int t = 0; t < 16; t++)
+		{
+			float d = 0.0f;
+
+			for (int i = 0; i < channels; i++)
+				d += (block.c[i][t] - mean[i]) * axis[i] * norm;
+
+			lo = std::min(lo, d);
+			hi = std::max(hi, d);
+		}
+
+		for (int i = 0; i < channels; i++)
+		{
+			e0[i] = std::clamp(mean[i] + axis[i] * norm * hi, 0.0f, 255.0f);
+			e1[i] = std::clamp(mean[i] + axis[i] * norm * lo, 0.0f, 255.0f);
+		}
+	}
+
+	/**
+	 * \brief Least squares endpoints for fixed indices, where weights[i] is the contribution of e0 to palette entry i.
+	 * \return False if the system is degenerate
+	 */
+	static bool refit_endpoints(const texel_block& block, int channels, const uint8_t* indices, const float* weights, float* e0, float* e1)
+	{
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+
+		for (int t = 0; t < 16; t++)
+		{
+			const float w = weights[indices[t]];
+
+			aa += w * w;
+			bb += (1.0f - w) * (1.0f - w);
+			ab += w * (1.0f - w);
+
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += w * block.c[c][t];
+				bx[c] += (1.0f - w) * block.c[c][t];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+
+		if (std::fabs(det) < 1e-6f)
+			return false;
+
+		for (int c = 0; c < channels; c++)
+		{
+			e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+			e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+		}
+
+		return true;
+	}
+
+	static uint16_t pack_565(const float* color)
+	{
+		const unsigned r = static_cast<unsigned>(std::lround(color[0] * 31.0f / 255.0f));
+		const unsigned g = static_cast<unsigned>(std::lround(color[1] * 63.0f / 255.0f));
+		const unsigned b = static_cast<unsigned>(std::lround(color[2] * 31.0f / 255.0f));
+
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	static void unpack_565(uint16_t packed, float* color)
+	{
+		const unsigned r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+		color[0] = static_cast<float>((r << 3) | (r >> 2));
+		color[1] = static_cast<float>((g << 2) | (g >> 4));
+		color[2] = static_cast<float>((b << 3) | (b >> 2));
+		color[3] = 0.0f;
+	}
+
+	/**
+	 * \brief Quantizes endpoints to 565 and selects four-color mode indices.
+	 */
+	static float try_bc1(const texel_block& block, const float* e0, const float* e1, uint16_t& c0, uint16_t& c1, uint8_t* indices)
+	{
+		c0 = pack_565(e0);
+		c1 = pack_565(e1);
+
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		float palette[4][4];
+
+		unpack_565(c0, palette[0]);
+		unpack_565(c1, palette[1]);
+
+		if (c0 == c1)
+		{
+			memset(indices, 0, 16);
+			return select_indices(block, 3, palette, 1, indices);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+
+		return select_indices(block, 3, palette, 4, indices);
+	}
+
+	static float encode_bc1(const texel_block& block, unsigned char* out)
+	{
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+		float e0[4], e1[4];
+		fit_principal_axis(block, 3, e0, e1);
+
+		uint16_t c0, c1;
+		uint8_t indices[16];
+		float error = try_bc1(block, e0, e1, c0, c1, indices);
+
+		if (c0 != c1 && refit_endpoints(block, 3, indices, weights, e0, e1))
+		{
+			uint16_t r0, r1;
+			uint8_t refit[16];
+			float refit_error = try_bc1(block, e0, e1, r0, r1, refit);
+
+			if (refit_error < error)
+			{
+				error = refit_error;
+				c0 = r0;
+				c1 = r1;
+				memcpy(indices, refit, 16);
+			}
+		}
+
+		uint32_t bits = 0;
+
+		for (int t = 0; t < 16; t++)
+			bits |= static_cast<uint32_t>(indices[t]) << (t * 2);
+
+		out[0] = c0 & 0xff;
+		out[1] = c0 >> 8;
+		out[2] = c1 & 0xff;
+		out[3] = c1 >> 8;
+
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (bits >> (i * 8)) & 0xff;
+
+		return error;
+	}
+
+	/**
+	 * \brief Encodes one channel of the block in the eight value mode.
+	 */
+	static float encode_bc4(const texel_block& block, int channel, unsigned char* out)
+	{
+		// select_indices reads the first channel, so the source plane is copied to the front
+		texel_block plane;
+		memcpy(plane.c[0], block.c[channel], sizeof(plane.c[0]));
+
+		float lo = 255.0f, hi = 0.0f;
+
+		for (int t = 0; t < 16; t++)
+		{
+			lo = std::min(lo, plane.c[0][t]);
+			hi = std::max(hi, plane.c[0][t]);
+		}
+
+		const int a0 = static_cast<int>(std::lround(hi));
+		const int a1 = static_cast<int>(std::lround(lo));
+
+		float palette[8][4] = {};
+		uint8_t indices[16] = {};
+		float error;
+
+		if (a0 == a1)
+		{
+			palette[0][0] = static_cast<float>(a0);
+			error = select_indices(plane, 1, palette, 1, indices);
+		}
+		else
+		{
+			palette[0][0] = static_cast<float>(a0);
+			palette[1][0] = static_cast<float>(a1);
+
+			for (int i = 2; i < 8; i++)
+				palette[i][0] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+
+			error = select_indices(plane, 1, palette, 8, indices);
+		}
+
+		uint64_t bits = 0;
+
+		for (int t = 0; t < 16; t++)
+			bits |= static_cast<uint64_t>(indices[t]) << (t * 3);
+
+		out[0] = static_cast<unsigned char>(a0);
+		out[1] = static_cast<unsigned char>(a1);
+
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (bits >> (i * 8)) & 0xff;
+
+		return error;
+	}
+
+	/**
+	 * \brief Quantizes an RGBA endpoint to 7 bits per channel plus the p-bit that fits it best.
+	 */
+	static void quantize_bc7(const float* endpoint, int* q, int& pbit)
+	{
+		float best = std::numeric_limits<float>::max();
+
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - p) / 2.0f)), 0, 127);
+
+				float d = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+				error += d * d;
+			}
+
+			if (error < best)
+			{
+				best = error;
+				pbit = p;
+				memcpy(q, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	static float try_bc7(const texel_block& block, const float* e0, const float* e1,
+			int* q0, int* q1, int& p0, int& p1, uint8_t* indices)
+	{
+		quantize_bc7(e0, q0, p0);
+		quantize_bc7(e1, q1, p1);
+
+		float palette[16][4];
+
+		for (int c = 0; c < 4; c++)
+		{
+			const int a = (q0[c] << 1) | p0;
+			const int b = (q1[c] << 1) | p1;
+
+			for (int i = 0; i < 16; i++)
+				palette[i][c] = static_cast<float>(((64 - bc7_weights[i]) * a + bc7_weights[i] * b + 32) >> 6);
+		}
+
+		return select_indices(block, 4, palette, 16, indices);
+	}
+
+	/**
+	 * \brief Writes bits LSB first into a 16 byte block.
+	 */
+	struct bit_writer
+	{
+		unsigned char* out;
+		int pos = 0;
+
+		void write(unsigned value, int count)
+		{
+			for (int i = 0; i < count; i++, pos++)
+				out[pos >> 3] |= ((value >> i) & 1) << (pos & 7);
+		}
+	};
+
+	/**
+	 * \brief Encodes the block in BC7 mode 6 -- one subset, RGBA 7.7.7.7 endpoints with unique p-bits, 4-bit indices.
+	 */
+	static float encode_bc7(const texel_block& block, unsigned char* out)
+	{
+		float weights[16];
+
+		for (int i = 0; i < 16; i++)
+			weights[i] = (64 - bc7_weights[i]) / 64.0f;
+
+		float e0[4], e1[4];
+		fit_principal_axis(block, 4, e0, e1);
+
+		int q0[4], q1[4], p0, p1;
+		uint8_t indices[16];
+		float error = try_bc7(block, e0, e1, q0, q1, p0, p1, indices);
+
+		if (refit_endpoints(block, 4, indices, weights, e0, e1))
+		{
+			int r0[4], r1[4], rp0, rp1;
+			uint8_t refit[16];
+			float refit_error = try_bc7(block, e0, e1, r0, r1, rp0, rp1, refit);
+
+			if (refit_error < error)
+			{
+				error = refit_error;
+				memcpy(q0, r0, sizeof(r0));
+				memcpy(q1, r1, sizeof(r1));
+				p0 = rp0;
+				p1 = rp1;
+				memcpy(indices, refit, 16);
+			}
+		}
+
+		// The anchor index drops its top bit, so the endpoints are swapped if it is set
+		if (indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+
+			for (int t = 0; t < 16; t++)
+				indices[t] = 15 - indices[t];
+		}
+
+		memset(out, 0, 16);
+		bit_writer bits = { out };
+
+		bits.write(1 << 6, 7);
+
+		for (int c = 0; c < 4; c++)
+		{
+			bits.write(q0[c], 7);
+			bits.write(q1[c], 7);
+		}
+
+		bits.write(p0, 1);
+		bits.write(p1, 1);
+		bits.write(indices[0], 3);
+
+		for (int t = 1; t < 16; t++)
+			bits.write(indices[t], 4);
+
+		return error;
+	}
+
+	double encode_level(const unsigned char* rgba, unsigned width, unsigned height, texture_codec codec, std::vector<unsigned char>& out)
+	{
+		const unsigned blocks_x = (width + 3) / 4;
+		const unsigned blocks_y = (height + 3) / 4;
+		const size_t block_size = get_codec_level_size(codec, 4, 4);
+
+		out.assign(get_codec_level_size(codec, width, height), 0);
+
+		std::vector<double> row_error(blocks_y, 0.0);
+
+		core::job_system::get().parallel_for(blocks_y, 4, [&](size_t begin, size_t end)
+		{
+			texel_block block;
+
+			for (size_t by = begin; by < end; by++)
+			{
+				double error = 0.0;
+
+				for (unsigned bx = 0; bx < blocks_x; bx++)
+				{
+					unsigned char* dst = &out[(by * blocks_x + bx) * block_size];
+
+					load_block(rgba, width, height, bx, static_cast<unsigned>(by), block);
+
+					switch (codec)
+					{
+						case texture_codec::bc1:
+							error += encode_bc1(block, dst);
+							break;
+						case texture_codec::bc3:
+							error += encode_bc4(block, 3, dst);
+							error += encode_bc1(block, dst + 8);
+							break;
+						case texture_codec::bc4:
+							error += encode_bc4(block, 0, dst);
+							break;
+						case texture_codec::bc5:
+							error += encode_bc4(block, 0, dst);
+							error += encode_bc4(block, 1, dst + 8);
+							break;
+						case texture_codec::bc7:
+							error += encode_bc7(block, dst);
+							break;
+						default:
+							break;
+					}
+				}
+
+				row_error[by] = error;
+			}
+		});
+
+		double total = 0.0;
+
+		for (double e : row_error)
+			total += e;
+
+		return total;
+	}
+
+	void cook_texture(std::vector<unsigned char>&& rgba, unsigned width, unsigned height,
+			texture_codec codec, texture_content content, cooked_texture& out)
+	{
+		out.codec = codec;
+		out.width = width;
+		out.height = height;
+		out.sq_error = 0.0;
+		out.texels = 0;
+
+		out.levels.clear();
+		out.levels.push_back(std::move(rgba));
+
+		cook_mips(out.levels, width, height, content);
+
+		if (codec == texture_codec::rgba8)
+			return;
+
+		for (size_t level = 0; level < out.levels.size(); level++)
+		{
+			const unsigned w = std::max(1u, width >> level);
+			const unsigned h = std::max(1u, height >> level);
+
+			std::vector<unsigned char> encoded;
+			out.sq_error += encode_level(out.levels[level].data(), w, h, codec, encoded);
+			out.texels += static_cast<size_t>(w) * h;
+
+			out.levels[level] = std::move(encoded);
+		}
+	}
+
+	std::filesystem::path get_texture_cache_path(const std::filesystem::path& source)
+	{
+		std::filesystem::path cache = source;
+		cache += TEXTURE_CACHE_EXTENSION;
+		return cache;
+	}
+
+	bool write_texture_cache(const std::filesystem::path& path, uint64_t source_hash, const cooked_texture& texture)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			fprintf(stderr, "Texture cache: failed to open %s for writing\n", path.c_str());
+			return false;
+		}
+
+		const uint32_t count = static_cast<uint32_t>(texture.levels.size());
+
+		texture_cache_header header = { TEXTURE_CACHE_MAGIC, TEXTURE_CACHE_VERSION, source_hash,
+			static_cast<uint32_t>(texture.codec), texture.width, texture.height, count };
+
+		std::vector<texture_cache_level> index(count);
+
+		// Smallest level first after the index
+		uint64_t offset = sizeof(header) + count * sizeof(texture_cache_level);
+
+		for (uint32_t i = count; i-- > 0;)
+		{
+			index[i].offset = offset;
+			index[i].size = texture.levels[i].size();
+			offset += index[i].size;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(index.data()), count * sizeof(texture_cache_level));
+
+		for (uint32_t i = count; i-- > 0;)
+			file.write(reinterpret_cast<const char*>(texture.levels[i].data()), static_cast<std::streamsize>(texture.levels[i].size()));
+
+		return file.good();
+	}
+
+	bool read_texture_cache(const std::filesystem::path& path, uint64_t source_hash, texture_codec codec, cooked_texture& out)
+	{
+		core::mapped_file file(path);
+
+		if (!file.is_open() || file.size() < sizeof(texture_cache_header))
+			return false;
+
+		const auto* header = reinterpret_cast<const texture_cache_header*>(file.data());
+
+		if (header->magic != TEXTURE_CACHE_MAGIC || header->version != TEXTURE_CACHE_VERSION
+				|| header->source_hash != source_hash || header->codec != static_cast<uint32_t>(codec))
+			return false;
+
+		const size_t table_end = sizeof(texture_cache_header) + header->level_count * sizeof(texture_cache_level);
+
+		if (file.size() < table_end)
+			return false;
+
+		const auto* index = reinterpret_cast<const texture_cache_level*>(file.data() + sizeof(texture_cache_header));
+
+		out.codec = codec;
+		out.width = header->width;
+		out.height = header->height;
+		out.levels.resize(header->level_count);
+
+		for (uint32_t i = 0; i < header->level_count; i++)
+		{
+			const unsigned w = std::max(1u, out.width >> i);
+			const unsigned h = std::max(1u, out.height >> i);
+
+			if (index[i].offset + index[i].size > file.size() || index[i].size != get_codec_level_size(codec, w, h))
+			{
+				fprintf(stderr, "Texture cache %s: level %u out of bounds\n", path.c_str(), i);
+				return false;
+			}
+
+			const unsigned char* data = file.data() + index[i].offset;
+			out.levels[i].assign(data, data + index[i].size);
+		}
+
+		return true;
+	}
+}
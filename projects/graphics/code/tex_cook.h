@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#define TEXTURE_CACHE_MAGIC 0x58544247 // "GBTX"
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_EXTENSION ".gbtx"
+
+namespace efiilj
+{
+	/**
+	 * \brief Storage format of a cooked texture. Block formats encode 4x4 texel blocks.
+	 */
+	enum class texture_codec : uint32_t
+	{
+		rgba8 = 0,
+		bc1 = 1,	// RGB, 8 bytes per block
+		bc3 = 2,	// RGBA, BC1 color plus BC4 alpha
+		bc4 = 3,	// R, 8 bytes per block
+		bc5 = 4,	// RG, two BC4 blocks
+		bc7 = 5		// RGBA, mode 6 only
+	};
+
+	/**
+	 * \brief How texel values are treated when filtering mips.
+	 */
+	enum class texture_content
+	{
+		color,	// sRGB encoded, filtered in linear light
+		normal,	// tangent space normal, renormalized per mip
+		data	// filtered as is
+	};
+
+	/**
+	 * \brief Header of a cooked texture file. Like KTX2, the level index is ordered from level 0,
+	 * while the level data itself is stored smallest first so the mip tail is read before the large levels.
+	 */
+	struct texture_cache_header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t source_hash;
+		uint32_t codec;
+		uint32_t width;
+		uint32_t height;
+		uint32_t level_count;
+	};
+
+	struct texture_cache_level
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	/**
+	 * \brief A cooked mip chain, level 0 first.
+	 */
+	struct cooked_texture
+	{
+		texture_codec codec = texture_codec::rgba8;
+		unsigned width = 0, height = 0;
+		std::vector<std::vector<unsigned char>> levels;
+
+		// Encoding statistics over all levels, for block codecs
+		double sq_error = 0.0;
+		size_t texels = 0;
+
+		/**
+		 * \brief Peak signal to noise ratio in dB over the encoded channels, 0 if nothing was encoded.
+		 */
+		double get_psnr() const;
+	};
+
+	int get_codec_channels(texture_codec codec);
+	const char* get_codec_name(texture_codec codec);
+
+	/**
+	 * \brief Size in bytes of a single mip level stored in the given codec.
+	 */
+	size_t get_codec_level_size(texture_codec codec, unsigned width, unsigned height);
+
+	/**
+	 * \brief Builds the mip chain of an RGBA8 image with a separable [1 3 3 1] filter.
+	 * \param levels Level 0 on input, the full chain on output
+	 */
+	void cook_mips(std::vector<std::vector<unsigned char>>& levels, unsigned width, unsigned height, texture_content content);
+
+	/**
+	 * \brief Encodes one RGBA8 level into a block codec, in parallel over block rows on the job system.
+	 * \return Sum of squared per-channel errors over the level
+	 */
+	double encode_level(const unsigned char* rgba, unsigned width, unsigned height, texture_codec codec, std::vector<unsigned char>& out);
+
+	/**
+	 * \brief Builds mips from an RGBA8 image and encodes every level.
+	 */
+	void cook_texture(std::vector<unsigned char>&& rgba, unsigned width, unsigned height,
+			texture_codec codec, texture_content content, cooked_texture& out);
+
+	/**
+	 * \brief Returns the cache path used for a source image.
+	 */
+	std::filesystem::path get_texture_cache_path(const std::filesystem::path& source);
+
+	/**
+	 * \brief Writes a cooked texture to disk.
+	 */
+	bool write_texture_cache(const std::filesystem::path& path, uint64_t source_hash, const cooked_texture& texture);
+
+	/**
+	 * \brief Reads a cooked texture, if it exists and was cooked from the same source content in the requested codec.
+	 */
+	bool read_texture_cache(const std::filesystem::path& path, uint64_t source_hash, texture_codec codec, cooked_texture& out);
+}
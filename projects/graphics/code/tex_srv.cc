@@ -1,13 +1,103 @@
 #include "tex_srv.h"
 #include "stb_image.h"
+#include "core/hash.h"
+#include "core/jobs.h"
+#include "core/mapped_file.h"
+#include "imgui.h"
 
 #include "GL/glew.h"
 #include "iostream"
 
+#include <algorithm>
+#include <cstring>
+
 namespace efiilj
 {
+	static int get_components(unsigned format)
+	{
+		switch (format)
+		{
+			case GL_RED: return 1;
+			case GL_RG: return 2;
+			case GL_RGB: return 3;
+			default: return 4;
+		}
+	}
+
+	static int get_mip_count(int width, int height)
+	{
+		int count = 1;
+
+		while (width > 1 || height > 1)
+		{
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+			count++;
+		}
+
+		return count;
+	}
+
+	static unsigned get_gl_format(texture_codec codec)
+	{
+		switch (codec)
+		{
+			case texture_codec::bc1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case texture_codec::bc3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case texture_codec::bc4: return GL_COMPRESSED_RED_RGTC1;
+			case texture_codec::bc5: return GL_COMPRESSED_RG_RGTC2;
+			case texture_codec::bc7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+			default: return GL_RGBA;
+		}
+	}
+
+	static texture_content get_content(texture_type usage)
+	{
+		switch (usage)
+		{
+			case texture_type::tex_normal: return texture_content::normal;
+			case texture_type::tex_orm: return texture_content::data;
+			default: return texture_content::color;
+		}
+	}
+
+	/**
+	 * \brief Keys the cooked cache of a source. Content changes how the mips are filtered,
+	 * so an image used as both color and data is not read back cooked for the other.
+	 */
+	static uint64_t hash_source(const std::filesystem::path& path, texture_content content)
+	{
+		core::mapped_file file(path);
+		return file.is_open() ? core::fnv1a(&content, sizeof(content), core::fnv1a(file.data(), file.size())) : 0;
+	}
+
+	/**
+	 * \brief Builds and encodes the mip chain on the calling worker, writing the cooked cache if a source hash is given.
+	 */
+	static void cook_source(texture_stream& stream, std::vector<unsigned char>&& rgba, unsigned width, unsigned height,
+			texture_codec codec, texture_content content, const std::filesystem::path& source, uint64_t hash)
+	{
+		cook_texture(std::move(rgba), width, height, codec, content, stream.texture);
+
+		if (codec == texture_codec::rgba8)
+			return;
+
+		if (hash != 0)
+			write_texture_cache(get_texture_cache_path(source), hash, stream.texture);
+	}
+
 	texture_server::texture_server()
+		: _placeholder{}, _compress(true), _bptc(false), _s3tc(false), _frame(0), _upload_budget(TEXTURE_UPLOAD_BUDGET), _memory_cap(TEXTURE_MEMORY_CAP),
+		_resident_total(0), _uploaded_bytes(0), _evicted_bytes(0), _pending(0)
 	{
+		add_columns({
+			&_data.tex_id, &_data.uri, &_data.name, &_data.usage, &_data.tex_wrap_s,
+			&_data.tex_wrap_t, &_data.tex_min_filter, &_data.tex_mag_filter, &_data.tex_format,
+			&_data.tex_type, &_data.width, &_data.height, &_data.bits, &_data.state,
+			&_data.residency, &_data.codec, &_data.stream, &_data.mip_count, &_data.resident_mip,
+			&_data.target_mip, &_data.resident_bytes, &_data.last_used, &_data.reloading
+		});
+
 		printf("Init textures...\n");
 	}
 
@@ -32,40 +122,533 @@ namespace efiilj
 		_data.width.emplace_back(0);
 		_data.height.emplace_back(0);
 		_data.bits.emplace_back(0);
+		_data.residency.emplace_back(texture_residency::unloaded);
+		_data.codec.emplace_back(texture_codec::rgba8);
+		_data.stream.emplace_back();
+		_data.mip_count.emplace_back(0);
+		_data.resident_mip.emplace_back(0);
+		_data.target_mip.emplace_back(0);
+		_data.resident_bytes.emplace_back(0);
+		_data.last_used.emplace_back(0);
+		_data.reloading.emplace_back(false);
+	}
+
+	void texture_server::on_setup()
+	{
+		// 1x1 stand-ins bound while a texture has no resident levels -- neutral values per usage
+		const unsigned char colors[4][4] = {
+			{ 192, 192, 192, 255 },	// base
+			{ 128, 128, 255, 255 },	// normal
+			{ 255, 255, 0, 255 },	// orm
+			{ 0, 0, 0, 255 }		// emissive
+		};
+
+		_bptc = GLEW_ARB_texture_compression_bptc;
+		_s3tc = GLEW_EXT_texture_compression_s3tc;
+
+		glGenTextures(4, _placeholder);
+
+		for (int i = 0; i < 4; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, _placeholder[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors[i]);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void texture_server::on_begin_frame()
+	{
+		_frame++;
+		_uploaded_bytes = 0;
+		_pending = 0;
+
+		std::vector<texture_id> streaming;
+
+		for (texture_id idx : _pool)
+		{
+			if (!_alive[idx])
+				continue;
+
+			if (_data.residency[idx] == texture_residency::decoding)
+			{
+				texture_stream& stream = *_data.stream[idx];
+
+				if (!stream.done.load(std::memory_order_acquire))
+				{
+					_pending++;
+					continue;
+				}
+
+				if (!stream.ok)
+				{
+					fprintf(stderr, "Texture %s: failed to decode\n", _data.uri[idx].c_str());
+
+					// A failed reload, such as of a file caught mid-write, leaves the old texture in place
+					_data.residency[idx] = _data.reloading[idx] ? texture_residency::resident : texture_residency::failed;
+					_data.reloading[idx] = false;
+					_data.stream[idx].reset();
+					continue;
+				}
+
+				if (_data.reloading[idx])
+				{
+					release(idx);
+					_data.reloading[idx] = false;
+				}
+
+				// Re-requests after eviction keep their resident levels and just continue upwards
+				if (_data.mip_count[idx] == 0)
+					allocate(idx);
+
+				_data.residency[idx] = texture_residency::streaming;
+			}
+
+			if (_data.residency[idx] == texture_residency::streaming)
+			{
+				streaming.push_back(idx);
+				_pending++;
+			}
+		}
+
+		// Most recently used textures get their high mips first
+		std::sort(streaming.begin(), streaming.end(), [this](texture_id a, texture_id b)
+		{
+			return _data.last_used[a] > _data.last_used[b];
+		});
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		bool progress = true;
+
+		while (progress)
+		{
+			progress = false;
+
+			for (texture_id idx : streaming)
+			{
+				if (_data.resident_mip[idx] <= _data.target_mip[idx])
+					continue;
+
+				const int level = _data.resident_mip[idx] - 1;
+				const size_t bytes = get_level_bytes(idx, level);
+
+				// Always let one level through, so a level larger than the budget still streams in
+				if (_uploaded_bytes > 0 && _uploaded_bytes + bytes > _upload_budget)
+					continue;
+
+				upload_level(idx, level);
+				progress = true;
+			}
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		for (texture_id idx : streaming)
+		{
+			if (_data.resident_mip[idx] > _data.target_mip[idx])
+				continue;
+
+			// Fully streamed -- the CPU copy is dropped and decoded again if evicted levels are needed
+			_data.residency[idx] = texture_residency::resident;
+			_data.stream[idx].reset();
+			_pending--;
+		}
+
+		if (_resident_total > _memory_cap)
+			evict();
+
+		unbind();
+	}
+
+	void texture_server::on_editor_gui(texture_id idx)
+	{
+		static const char* states[] = { "unloaded", "decoding", "streaming", "resident", "failed" };
+
+		ImGui::Text("Mips %d-%d of %d, %s, %s, %.2f MB", 
+				_data.resident_mip[idx], _data.mip_count[idx] - 1, _data.mip_count[idx],
+				get_codec_name(_data.codec[idx]),
+				states[static_cast<int>(_data.residency[idx])],
+				_data.resident_bytes[idx] / (1024.0f * 1024.0f));
+
+		ImGui::Text("Sharing: %u refs", _refs[idx]);
+	}
+
+	void texture_server::on_editor_gui()
+	{
+		ImGui::Text("Streaming: %.1f / %.1f MB resident, %lu pending",
+				_resident_total / (1024.0f * 1024.0f), _memory_cap / (1024.0f * 1024.0f), _pending);
+
+		ImGui::Text("Sharing: %lu shared textures, %.2f MB saved",
+				_shared.size(), _saved_bytes / (1024.0f * 1024.0f));
+
+		ImGui::Checkbox("Compress new textures", &_compress);
 	}
 
 	bool texture_server::load(texture_id idx)
 	{
-		if (_data.state[idx])
+		if (_data.residency[idx] != texture_residency::unloaded && _data.residency[idx] != texture_residency::failed)
 			return true;
 
+		if (_data.uri[idx].empty())
+			return false;
+
+		if (_data.tex_id[idx] == 0)
+			generate(idx);
+
+		_data.mip_count[idx] = 0;
+		_data.resident_mip[idx] = 0;
+		_data.target_mip[idx] = 0;
+		_data.codec[idx] = select_codec(idx);
+
+		request(idx);
+
+		return true;
+	}
+
+	bool texture_server::reload(texture_id idx)
+	{
+		if (_data.uri[idx].empty() || _data.residency[idx] == texture_residency::decoding 
+				|| _data.residency[idx] == texture_residency::streaming)
+			return false;
+
+		printf("Reloading texture %d (%s)\n", idx, _data.uri[idx].c_str());
+
+		if (_data.tex_id[idx] == 0)
+			generate(idx);
+
+		_data.reloading[idx] = _data.mip_count[idx] > 0;
+		_data.target_mip[idx] = 0;
+
+		request(idx);
+
+		return true;
+	}
+
+	bool texture_server::destroy(texture_id idx)
+	{
+		// A stale handle would delete whatever now lives in its slot
+		if (!is_valid(idx))
+			return false;
+
+		glDeleteTextures(1, &_data.tex_id[idx]);
+
+		// A cook still running holds its own share of the stream, and is dropped once done
+		_resident_total -= _data.resident_bytes[idx];
+		_data.tex_id[idx] = 0;
+		_data.resident_bytes[idx] = 0;
+		_data.mip_count[idx] = 0;
+		_data.state[idx] = false;
+		_data.residency[idx] = texture_residency::unloaded;
+		_data.stream[idx].reset();
+
+		return server::destroy(idx);
+	}
+
+	void texture_server::release(texture_id idx)
+	{
+		unshare(idx);
+
+		// A new texture object, rather than respecified levels, as the size or codec may have changed
+		glDeleteTextures(1, &_data.tex_id[idx]);
 		generate(idx);
-		bind(idx);
 
+		_resident_total -= _data.resident_bytes[idx];
+		_data.resident_bytes[idx] = 0;
+		_data.mip_count[idx] = 0;
+		_data.resident_mip[idx] = 0;
+		_data.target_mip[idx] = 0;
+	}
+
+	void texture_server::stream(texture_id idx, unsigned width, unsigned height, std::vector<unsigned char>&& pixels,
+			const std::filesystem::path& source)
+	{
+		if (_data.tex_id[idx] == 0)
+			generate(idx);
+
+		// With a source the texture can be restored after eviction, and reloaded when the file changes
+		if (!source.empty())
+			_data.uri[idx] = source;
+
+		auto stream = std::make_shared<texture_stream>();
+
+		const int components = get_components(_data.tex_format[idx]);
+		texture_codec codec = select_codec(idx);
+
+		// Single channel data fits BC4 better than any of the color codecs
+		if (components == 1 && codec != texture_codec::rgba8 && _data.usage[idx] != texture_type::tex_normal)
+			codec = texture_codec::bc4;
+
+		const texture_content content = get_content(_data.usage[idx]);
+
+		// The cooker works on RGBA, so the pixels are expanded on the worker
+		_data.tex_format[idx] = GL_RGBA;
+		_data.tex_type[idx] = GL_UNSIGNED_BYTE;
+
+		_data.codec[idx] = codec;
+		_data.stream[idx] = stream;
+		_data.residency[idx] = texture_residency::decoding;
+		_data.mip_count[idx] = 0;
+		_data.resident_mip[idx] = 0;
+		_data.target_mip[idx] = 0;
+		_data.last_used[idx] = _frame;
+
+		auto source_pixels = std::make_shared<std::vector<unsigned char>>(std::move(pixels));
+
+		core::job_system::get().submit([stream, source_pixels, width, height, components, codec, content, source]()
+		{
+			const uint64_t hash = (!source.empty() && codec != texture_codec::rgba8) ? hash_source(source, content) : 0;
+
+			if (hash != 0 && read_texture_cache(get_texture_cache_path(source), hash, codec, stream->texture))
+			{
+				stream->ok = true;
+				stream->done.store(true, std::memory_order_release);
+				return;
+			}
+
+			std::vector<unsigned char> rgba;
+
+			if (components == 4)
+				rgba = std::move(*source_pixels);
+			else
+			{
+				const size_t count = static_cast<size_t>(width) * height;
+				rgba.resize(count * 4);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					const unsigned char* texel = &(*source_pixels)[i * components];
+
+					rgba[i * 4 + 0] = texel[0];
+					rgba[i * 4 + 1] = components > 1 ? texel[1] : 0;
+					rgba[i * 4 + 2] = components > 2 ? texel[2] : 0;
+					rgba[i * 4 + 3] = 255;
+				}
+			}
+
+			source_pixels->clear();
+
+			cook_source(*stream, std::move(rgba), width, height, codec, content, source, hash);
+
+			stream->ok = true;
+			stream->done.store(true, std::memory_order_release);
+		}, nullptr, core::job_queue::background);
+	}
+
+	void texture_server::request(texture_id idx)
+	{
+		auto stream = std::make_shared<texture_stream>();
+		std::filesystem::path uri = _data.uri[idx];
+
+		const texture_codec codec = _data.codec[idx];
+		const texture_content content = get_content(_data.usage[idx]);
+
+		// Files are always expanded to RGBA
+		_data.tex_format[idx] = GL_RGBA;
+		_data.tex_type[idx] = GL_UNSIGNED_BYTE;
+
+		_data.stream[idx] = stream;
+		_data.residency[idx] = texture_residency::decoding;
+		_data.last_used[idx] = _frame;
+
+		core::job_system::get().submit([stream, uri, codec, content]()
+		{
+			const uint64_t hash = codec != texture_codec::rgba8 ? hash_source(uri, content) : 0;
+
+			// An up to date cooked file skips decoding entirely
+			if (hash != 0 && read_texture_cache(get_texture_cache_path(uri), hash, codec, stream->texture))
+			{
+				stream->ok = true;
+				stream->done.store(true, std::memory_order_release);
+				return;
+			}
+
+			int width = 0, height = 0, bits = 0;
+			unsigned char* buf = stbi_load(uri.c_str(), &width, &height, &bits, 4);
+
+			if (buf != nullptr)
+			{
+				const size_t row = static_cast<size_t>(width) * 4;
+				std::vector<unsigned char> pixels(row * height);
+
+				// The global stbi flip flag isn't thread safe in this version, so rows are flipped here
+				for (int y = 0; y < height; y++)
+					memcpy(&pixels[y * row], buf + (height - 1 - y) * row, row);
+
+				stbi_image_free(buf);
+
+				cook_source(*stream, std::move(pixels), width, height, codec, content, uri, hash);
+				stream->ok = true;
+			}
+
+			stream->done.store(true, std::memory_order_release);
+		}, nullptr, core::job_queue::background);
+	}
+
+	void texture_server::allocate(texture_id idx)
+	{
+		const cooked_texture& texture = _data.stream[idx]->texture;
+
+		_data.codec[idx] = texture.codec;
+		_data.width[idx] = texture.width;
+		_data.height[idx] = texture.height;
+		_data.mip_count[idx] = static_cast<int>(texture.levels.size());
+		_data.resident_mip[idx] = _data.mip_count[idx];
+
+		glBindTexture(GL_TEXTURE_2D, _data.tex_id[idx]);
 		set_params(idx);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _data.mip_count[idx] - 1);
 
-		stbi_set_flip_vertically_on_load(true);
+		// The mip tail is tiny, so it goes up at once outside the budget
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-		unsigned char* buf = stbi_load(
-				_data.uri[idx].c_str(), &_data.width[idx], &_data.height[idx], &_data.bits[idx], 4);
+		const int tail = get_tail_level(idx);
 
-		stbi_set_flip_vertically_on_load(false);
+		for (int level = _data.mip_count[idx] - 1; level >= tail; level--)
+			upload_level(idx, level);
 
-		if (buf == nullptr)
-			return false;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		_data.state[idx] = true;
+	}
 
-		buffer(idx, _data.width[idx], _data.height[idx], buf);
+	void texture_server::upload_level(texture_id idx, int level)
+	{
+		const std::vector<unsigned char>& data = _data.stream[idx]->texture.levels[level];
+		const size_t bytes = get_level_bytes(idx, level);
 
-		stbi_image_free(buf);
+		const int width = std::max(1, _data.width[idx] >> level);
+		const int height = std::max(1, _data.height[idx] >> level);
 
-		unbind();
-		
-		return true;	
+		glBindTexture(GL_TEXTURE_2D, _data.tex_id[idx]);
+
+		if (_data.codec[idx] == texture_codec::rgba8)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, 
+					_data.tex_format[idx], _data.tex_type[idx], data.data());
+		}
+		else
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, get_gl_format(_data.codec[idx]), width, height, 0,
+					static_cast<GLsizei>(data.size()), data.data());
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+		_data.resident_mip[idx] = level;
+		_data.resident_bytes[idx] += bytes;
+		_resident_total += bytes;
+		_uploaded_bytes += bytes;
 	}
 
-	void texture_server::bind(texture_id idx) const
+	void texture_server::drop_level(texture_id idx)
 	{
+		const int level = _data.resident_mip[idx];
+		const size_t bytes = get_level_bytes(idx, level);
+
 		glBindTexture(GL_TEXTURE_2D, _data.tex_id[idx]);
+
+		// A zero-size image releases the level; GL 3.3 has no way to shrink a texture in place
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+
+		if (_data.codec[idx] == texture_codec::rgba8)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, _data.tex_format[idx], _data.tex_type[idx], nullptr);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, get_gl_format(_data.codec[idx]), 0, 0, 0, 0, nullptr);
+
+		_data.resident_mip[idx] = level + 1;
+		_data.target_mip[idx] = level + 1;
+		_data.resident_bytes[idx] -= bytes;
+		_resident_total -= bytes;
+		_evicted_bytes += bytes;
+	}
+
+	void texture_server::evict()
+	{
+		std::vector<texture_id> victims;
+
+		// Only streamed textures can be restored, and anything used recently is left alone
+		for (texture_id idx : _pool)
+		{
+			if (_alive[idx] && _data.residency[idx] == texture_residency::resident && !_data.uri[idx].empty()
+					&& _data.last_used[idx] + TEXTURE_EVICT_FRAMES < _frame
+					&& _data.resident_mip[idx] < get_tail_level(idx))
+				victims.push_back(idx);
+		}
+
+		std::sort(victims.begin(), victims.end(), [this](texture_id a, texture_id b)
+		{
+			return _data.last_used[a] < _data.last_used[b];
+		});
+
+		for (texture_id idx : victims)
+		{
+			while (_resident_total > _memory_cap && _data.resident_mip[idx] < get_tail_level(idx))
+				drop_level(idx);
+
+			if (_resident_total <= _memory_cap)
+				break;
+		}
+	}
+
+	int texture_server::get_tail_level(texture_id idx) const
+	{
+		int level = 0;
+
+		while (level < _data.mip_count[idx] - 1 
+				&& std::max(_data.width[idx] >> level, _data.height[idx] >> level) > TEXTURE_MIP_TAIL_SIZE)
+			level++;
+
+		return level;
+	}
+
+	size_t texture_server::get_level_bytes(texture_id idx, int level) const
+	{
+		return get_codec_level_size(_data.codec[idx], 
+				std::max(1, _data.width[idx] >> level), std::max(1, _data.height[idx] >> level));
+	}
+
+	texture_codec texture_server::select_codec(texture_id idx) const
+	{
+		if (!_compress)
+			return texture_codec::rgba8;
+
+		// BC7 for color, falling back to BC3 where BPTC is missing; BC5 for normals; BC1 for ORM and emissive
+		switch (_data.usage[idx])
+		{
+			case texture_type::tex_base:
+			case texture_type::tex_default:
+				return _bptc ? texture_codec::bc7 : (_s3tc ? texture_codec::bc3 : texture_codec::rgba8);
+			case texture_type::tex_normal:
+				return texture_codec::bc5;
+			case texture_type::tex_orm:
+			case texture_type::tex_emissive:
+				return _s3tc ? texture_codec::bc1 : texture_codec::rgba8;
+			default:
+				return texture_codec::rgba8;
+		}
+	}
+
+	unsigned texture_server::get_placeholder(texture_id idx) const
+	{
+		const int usage = static_cast<int>(_data.usage[idx]);
+		return _placeholder[usage < 4 ? usage : 0];
+	}
+
+	void texture_server::bind(texture_id idx)
+	{
+		_data.last_used[idx] = _frame;
+
+		// Evicted levels are requested again as soon as the texture is used
+		if (_data.target_mip[idx] > 0 && _data.residency[idx] == texture_residency::resident)
+		{
+			_data.target_mip[idx] = 0;
+			request(idx);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, get_tex_id(idx));
 	}
 	
 	void texture_server::unbind() const
@@ -73,7 +656,7 @@ namespace efiilj
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
-	void texture_server::set_active(texture_id idx, unsigned int slot) const
+	void texture_server::set_active(texture_id idx, unsigned int slot)
 	{
 		glActiveTexture(GL_TEXTURE0 + slot);
 		bind(idx);
@@ -91,9 +674,24 @@ namespace efiilj
 
 		glGenerateMipmap(GL_TEXTURE_2D);
 
+		// Buffered textures have no source to stream from, so they stay fully resident
+		size_t bytes = 0;
+		const int mips = get_mip_count(width, height);
+
+		for (int level = 0; level < mips; level++)
+			bytes += get_codec_level_size(texture_codec::rgba8, std::max(1u, width >> level), std::max(1u, height >> level));
+
+		_resident_total += bytes - _data.resident_bytes[idx];
+
 		_data.width[idx] = width;
 		_data.height[idx] = height;
 		_data.state[idx] = true;
+		_data.residency[idx] = texture_residency::resident;
+		_data.codec[idx] = texture_codec::rgba8;
+		_data.mip_count[idx] = mips;
+		_data.resident_mip[idx] = 0;
+		_data.target_mip[idx] = 0;
+		_data.resident_bytes[idx] = bytes;
 	}
 
 	void texture_server::set_params(texture_id idx)
@@ -2,8 +2,17 @@
 
 #include "server.h"
 #include "mgr_host.h"
+#include "tex_cook.h"
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+
+#define TEXTURE_MIP_TAIL_SIZE 64
+#define TEXTURE_EVICT_FRAMES 120
+#define TEXTURE_UPLOAD_BUDGET (8u << 20)
+#define TEXTURE_MEMORY_CAP (512u << 20)
 
 namespace efiilj
 {
@@ -19,28 +28,83 @@ namespace efiilj
 		tex_default = 5,
 	};
 
+	/**
+	 * \brief Number of texture types, for tables indexed by type.
+	 */
+	constexpr size_t texture_type_count = static_cast<size_t>(texture_type::tex_default) + 1;
+
+	enum class texture_residency
+	{
+		unloaded,
+		decoding,
+		streaming,
+		resident,
+		failed
+	};
+
+	/**
+	 * \brief Cooked mip chain handed from a worker thread to the main thread for upload.
+	 */
+	struct texture_stream
+	{
+		std::atomic<bool> done { false };
+		bool ok = false;
+
+		cooked_texture texture;
+	};
+
 	class texture_server : public server<texture_id>
 	{
 		private:
 
 			struct TextureData 
 			{
-				std::vector<unsigned int> tex_id;
-				std::vector<std::filesystem::path> uri;
-				std::vector<std::string> name;
-				std::vector<texture_type> usage;
-				std::vector<unsigned int> tex_wrap_s;
-				std::vector<unsigned int> tex_wrap_t;
-				std::vector<unsigned int> tex_min_filter;
-				std::vector<unsigned int> tex_mag_filter;
-				std::vector<unsigned int> tex_format;
-				std::vector<unsigned int> tex_type;
-				std::vector<int> width;
-				std::vector<int> height;
-				std::vector<int> bits;
-				std::vector<bool> state;
+				slot_vector<unsigned int> tex_id;
+				slot_vector<std::filesystem::path> uri;
+				slot_vector<std::string> name;
+				slot_vector<texture_type> usage;
+				slot_vector<unsigned int> tex_wrap_s;
+				slot_vector<unsigned int> tex_wrap_t;
+				slot_vector<unsigned int> tex_min_filter;
+				slot_vector<unsigned int> tex_mag_filter;
+				slot_vector<unsigned int> tex_format;
+				slot_vector<unsigned int> tex_type;
+				slot_vector<int> width;
+				slot_vector<int> height;
+				slot_vector<int> bits;
+				slot_vector<bool> state;
+				slot_vector<texture_residency> residency;
+				slot_vector<texture_codec> codec;
+				slot_vector<std::shared_ptr<texture_stream>> stream;
+				slot_vector<int> mip_count;
+				slot_vector<int> resident_mip;
+				slot_vector<int> target_mip;
+				slot_vector<size_t> resident_bytes;
+				slot_vector<uint64_t> last_used;
+				slot_vector<bool> reloading;
 			} _data;
 
+			unsigned _placeholder[4];
+
+			bool _compress, _bptc, _s3tc;
+
+			uint64_t _frame;
+			size_t _upload_budget, _memory_cap;
+			size_t _resident_total, _uploaded_bytes, _evicted_bytes;
+			size_t _pending;
+
+			void request(texture_id idx);
+			void allocate(texture_id idx);
+			void upload_level(texture_id idx, int level);
+			void drop_level(texture_id idx);
+			void release(texture_id idx);
+			void evict();
+
+			int get_tail_level(texture_id idx) const;
+			size_t get_level_bytes(texture_id idx, int level) const;
+			texture_codec select_codec(texture_id idx) const;
+			unsigned get_placeholder(texture_id idx) const;
+
 		public:
 
 			texture_server();
@@ -48,11 +112,45 @@ namespace efiilj
 
 			void append_defaults(texture_id) override;
 
+			/**
+			 * \brief Deletes the texture object and its resident levels before the slot is freed for reuse.
+			 */
+			bool destroy(texture_id idx) override;
+
+			void on_setup() override;
+			void on_begin_frame() override;
+			void on_editor_gui(texture_id idx) override;
+
+			/**
+			 * \brief Draws the totals shared by every texture: streaming memory, sharing and compression.
+			 */
+			void on_editor_gui();
+
+			/**
+			 * \brief Starts streaming the texture at the current uri. The image is decoded, its mip chain
+			 * built and block compressed for its usage on a worker, or read from the cooked cache next to the
+			 * source if it is up to date. Until the first levels are uploaded a placeholder is bound in its place.
+			 * \return False if the texture has no uri
+			 */
 			bool load(texture_id idx);
 
-			void bind(texture_id idx) const;
+			/**
+			 * \brief Streams already decoded 8-bit pixels, in the current format, through the same path as load.
+			 * \param source Image file the pixels were decoded from, if any, used to key the cooked cache
+			 */
+			void stream(texture_id idx, unsigned width, unsigned height, std::vector<unsigned char>&& pixels,
+					const std::filesystem::path& source = {});
+
+			/**
+			 * \brief Decodes and cooks the file at the texture uri again. The current levels stay bound
+			 * until the new chain is ready, at which point the GL texture is replaced.
+			 * \return False if the texture has no uri or is still streaming
+			 */
+			bool reload(texture_id idx);
+
+			void bind(texture_id idx);
 			void unbind() const;
-			void set_active(texture_id idx, unsigned int slot) const;
+			void set_active(texture_id idx, unsigned int slot);
 			void generate(texture_id idx);
 			void buffer(texture_id idx, const unsigned int& width, const unsigned int& height, void* data);
 			void set_params(texture_id idx);
@@ -77,11 +175,40 @@ namespace efiilj
 				return _data.height[idx];
 			}
 
-			const unsigned int& get_tex_id(texture_id idx) const
+			unsigned int get_tex_id(texture_id idx) const
+			{
+				return _data.resident_mip[idx] < _data.mip_count[idx] || _data.residency[idx] == texture_residency::unloaded
+					? _data.tex_id[idx] : get_placeholder(idx);
+			}
+
+			const texture_residency& get_residency(texture_id idx) const
+			{
+				return _data.residency[idx];
+			}
+
+			const texture_codec& get_codec(texture_id idx) const
 			{
-				return _data.tex_id[idx];
+				return _data.codec[idx];
 			}
 
+			/**
+			 * \brief Enables block compression of textures streamed after the call.
+			 */
+			void set_compression(bool enabled) { _compress = enabled; }
+
+			/**
+			 * \brief Sets how many bytes of mip data may be uploaded per frame.
+			 */
+			void set_upload_budget(size_t bytes) { _upload_budget = bytes; }
+
+			/**
+			 * \brief Sets the resident memory above which high mips of textures not used recently are evicted.
+			 */
+			void set_memory_cap(size_t bytes) { _memory_cap = bytes; }
+
+			size_t get_resident_bytes() const { return _resident_total; }
+			size_t get_pending_count() const { return _pending; }
+
 			const texture_type& get_type(texture_id idx) const
 			{
 				return _data.usage[idx];
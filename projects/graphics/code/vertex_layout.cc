@@ -0,0 +1,344 @@
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace efiilj
+{
+	vertex_element vertex_layout::get_element(vertex_attribute attrib) const
+	{
+		switch (attrib)
+		{
+			case attrib_position:
+				// The fourth component pads to a multiple of 4 bytes, and decodes to w = 1
+				if (flags & layout_quantized_positions)
+					return { vertex_component::unorm16, 4, 8 };
+				return { vertex_component::float32, 3, 12 };
+
+			case attrib_normal:
+				if (flags & layout_oct_normals)
+					return { vertex_component::snorm16, 2, 4 };
+				return { vertex_component::float32, 3, 12 };
+
+			case attrib_uv:
+				if (flags & layout_half_uvs)
+					return { vertex_component::float16, 2, 4 };
+				if (flags & layout_unorm_uvs)
+					return { vertex_component::unorm16, 2, 4 };
+				return { vertex_component::float32, 2, 8 };
+
+			case attrib_tangent:
+				if (flags & layout_oct_normals)
+					return { vertex_component::snorm16, 2, 4 };
+				return { vertex_component::float32, 4, 16 };
+
+			default:
+				return { vertex_component::float32, 0, 0 };
+		}
+	}
+
+	unsigned vertex_layout::get_vertex_size(unsigned attribs) const
+	{
+		unsigned size = 0;
+
+		for (int i = 0; i < attrib_count; i++)
+		{
+			if (attribs & (1u << i))
+				size += get_element(static_cast<vertex_attribute>(i)).size;
+		}
+
+		return size;
+	}
+
+	void vertex_layout::get_placement(vertex_attribute attrib, unsigned attribs, size_t vertex_count,
+			size_t& offset, unsigned& stride) const
+	{
+		size_t before = 0;
+
+		for (int i = 0; i < attrib; i++)
+		{
+			if (attribs & (1u << i))
+				before += get_element(static_cast<vertex_attribute>(i)).size;
+		}
+
+		if (flags & layout_interleaved)
+		{
+			offset = before;
+			stride = get_vertex_size(attribs);
+		}
+		else
+		{
+			offset = before * vertex_count;
+			stride = get_element(attrib).size;
+		}
+	}
+
+	std::vector<std::string> vertex_layout::get_defines() const
+	{
+		std::vector<std::string> defines;
+
+		if (flags & layout_quantized_positions)
+			defines.emplace_back("QUANTIZED_POSITION");
+
+		if (flags & layout_oct_normals)
+			defines.emplace_back("OCT_NORMALS");
+
+		return defines;
+	}
+
+	vertex_quantization get_quantization(const std::vector<vector3>& positions)
+	{
+		vertex_quantization quant;
+
+		if (positions.empty())
+			return quant;
+
+		vector3 min = positions[0], max = positions[0];
+
+		for (const auto& pos : positions)
+		{
+			min = vector3::min(min, pos);
+			max = vector3::max(max, pos);
+		}
+
+		quant.offset = min;
+
+		// Flat axes keep a unit scale, so they decode to the offset rather than dividing by zero
+		for (int i = 0; i < 3; i++)
+			quant.scale[i] = max[i] > min[i] ? max[i] - min[i] : 1.0f;
+
+		return quant;
+	}
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t raw_exponent = (bits >> 23) & 0xff;
+		const int exponent = static_cast<int>(raw_exponent) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (raw_exponent == 0xff)
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+		if (exponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7c00);
+
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+				return static_cast<uint16_t>(sign);
+
+			// Denormal, with the implicit leading bit shifted in
+			mantissa |= 0x800000;
+
+			const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = mantissa >> shift;
+
+			if ((mantissa >> (shift - 1)) & 1)
+				half++;
+
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+
+		// Rounding may carry into the exponent, which is still the correctly rounded value
+		if (mantissa & 0x1000)
+			half++;
+
+		return static_cast<uint16_t>(half);
+	}
+
+	static int16_t to_snorm16(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+	}
+
+	static uint16_t to_unorm16(float value)
+	{
+		return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+	}
+
+	static float sign_not_zero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	void oct_encode(const vector3& n, int16_t out[2])
+	{
+		const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+		if (l1 == 0.0f)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+
+		float x = n.x / l1;
+		float y = n.y / l1;
+
+		// The lower hemisphere folds over the diagonals of the octahedron
+		if (n.z < 0.0f)
+		{
+			const float fx = (1.0f - fabsf(y)) * sign_not_zero(x);
+			const float fy = (1.0f - fabsf(x)) * sign_not_zero(y);
+
+			x = fx;
+			y = fy;
+		}
+
+		out[0] = to_snorm16(x);
+		out[1] = to_snorm16(y);
+	}
+
+	vector3 oct_decode(const int16_t in[2])
+	{
+		vector3 n(std::max(in[0] / 32767.0f, -1.0f), std::max(in[1] / 32767.0f, -1.0f), 0.0f);
+
+		n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+
+		const float t = std::max(-n.z, 0.0f);
+
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+
+		return n / n.length();
+	}
+
+	/**
+	 * \brief Octahedral tangent with the bitangent sign folded into the second value, which is remapped
+	 * to [0, 1] and offset by one step so that its sign survives at zero. Decoded in vertex_input.glsl.
+	 */
+	static void encode_tangent(const vector4& tangent, int16_t out[2])
+	{
+		oct_encode(vector3(tangent.x, tangent.y, tangent.z), out);
+
+		const float unit = (out[1] / 32767.0f) * 0.5f + 0.5f;
+		const int16_t magnitude = static_cast<int16_t>(1 + std::lround(unit * 32766.0f));
+
+		out[1] = tangent.w < 0.0f ? -magnitude : magnitude;
+	}
+
+	template<typename T>
+	static void write(unsigned char* dst, const T& value)
+	{
+		memcpy(dst, &value, sizeof(T));
+	}
+
+	void pack_vertices(const vertex_layout& layout, unsigned attribs, const vertex_quantization& quant,
+			const std::vector<vector3>& positions,
+			const std::vector<vector3>& normals,
+			const std::vector<vector2>& uvs,
+			const std::vector<vector4>& tangents,
+			std::vector<unsigned char>& out)
+	{
+		const size_t count = positions.size();
+
+		out.assign(count * layout.get_vertex_size(attribs), 0);
+
+		size_t offset[attrib_count] = {};
+		unsigned stride[attrib_count] = {};
+
+		for (int i = 0; i < attrib_count; i++)
+		{
+			if (attribs & (1u << i))
+				layout.get_placement(static_cast<vertex_attribute>(i), attribs, count, offset[i], stride[i]);
+		}
+
+		const bool quantized = layout.flags & layout_quantized_positions;
+		const bool oct = layout.flags & layout_oct_normals;
+		const bool half_uvs = layout.flags & layout_half_uvs;
+		const bool unorm_uvs = layout.flags & layout_unorm_uvs;
+
+		for (size_t v = 0; v < count; v++)
+		{
+			if (attribs & (1u << attrib_position))
+			{
+				unsigned char* dst = out.data() + offset[attrib_position] + v * stride[attrib_position];
+				const vector3& pos = positions[v];
+
+				if (quantized)
+				{
+					const uint16_t packed[4] = {
+						to_unorm16((pos.x - quant.offset.x) / quant.scale.x),
+						to_unorm16((pos.y - quant.offset.y) / quant.scale.y),
+						to_unorm16((pos.z - quant.offset.z) / quant.scale.z),
+						0xffff
+					};
+
+					write(dst, packed);
+				}
+				else
+					write(dst, pos);
+			}
+
+			if ((attribs & (1u << attrib_normal)) && v < normals.size())
+			{
+				unsigned char* dst = out.data() + offset[attrib_normal] + v * stride[attrib_normal];
+
+				if (oct)
+				{
+					int16_t packed[2];
+					oct_encode(normals[v], packed);
+					write(dst, packed);
+				}
+				else
+					write(dst, normals[v]);
+			}
+
+			if ((attribs & (1u << attrib_uv)) && v < uvs.size())
+			{
+				unsigned char* dst = out.data() + offset[attrib_uv] + v * stride[attrib_uv];
+
+				if (half_uvs)
+				{
+					const uint16_t packed[2] = { float_to_half(uvs[v].x), float_to_half(uvs[v].y) };
+					write(dst, packed);
+				}
+				else if (unorm_uvs)
+				{
+					const uint16_t packed[2] = { to_unorm16(uvs[v].x), to_unorm16(uvs[v].y) };
+					write(dst, packed);
+				}
+				else
+					write(dst, uvs[v]);
+			}
+
+			if ((attribs & (1u << attrib_tangent)) && v < tangents.size())
+			{
+				unsigned char* dst = out.data() + offset[attrib_tangent] + v * stride[attrib_tangent];
+
+				if (oct)
+				{
+					int16_t packed[2];
+					encode_tangent(tangents[v], packed);
+					write(dst, packed);
+				}
+				else
+					write(dst, tangents[v]);
+			}
+		}
+	}
+
+	vector3 unpack_position(const vertex_layout& layout, const unsigned char* element, const vertex_quantization& quant)
+	{
+		if (!(layout.flags & layout_quantized_positions))
+		{
+			vector3 pos;
+			memcpy(&pos.x, element, sizeof(float) * 3);
+			return pos;
+		}
+
+		uint16_t packed[3];
+		memcpy(packed, element, sizeof(packed));
+
+		return vector3(
+				packed[0] / 65535.0f * quant.scale.x + quant.offset.x,
+				packed[1] / 65535.0f * quant.scale.y + quant.offset.y,
+				packed[2] / 65535.0f * quant.scale.z + quant.offset.z);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "vector2.h"
+#include "vector3.h"
+#include "vector4.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Attribute locations shared by every mesh vertex shader, see res/shaders/vertex_input.glsl
+#define VERTEX_ATTRIB_POSITION 0
+#define VERTEX_ATTRIB_NORMAL 1
+#define VERTEX_ATTRIB_UV 2
+#define VERTEX_ATTRIB_TANGENT 3
+#define VERTEX_ATTRIB_MODEL 4
+#define VERTEX_ATTRIB_QUANT_OFFSET 8
+#define VERTEX_ATTRIB_QUANT_SCALE 9
+
+namespace efiilj
+{
+	enum vertex_layout_flags : unsigned
+	{
+		// Separate blocks of 32-bit floats, 48 bytes per vertex
+		layout_planar_float = 0,
+
+		layout_interleaved = 1 << 0,
+
+		// Normals and tangents octahedral encoded, 2x snorm16 each
+		layout_oct_normals = 1 << 1,
+
+		// UVs as 2x half float
+		layout_half_uvs = 1 << 2,
+
+		// UVs as 2x unorm16, only for UVs within [0, 1]
+		layout_unorm_uvs = 1 << 3,
+
+		// Positions as 4x unorm16 relative to the mesh bounds
+		layout_quantized_positions = 1 << 4,
+
+		layout_compact = layout_interleaved | layout_oct_normals | layout_half_uvs | layout_quantized_positions
+	};
+
+	enum vertex_attribute
+	{
+		attrib_position,
+		attrib_normal,
+		attrib_uv,
+		attrib_tangent,
+		attrib_count
+	};
+
+	const unsigned attrib_mask_all = (1u << attrib_count) - 1;
+
+	enum class vertex_component
+	{
+		float32,
+		float16,
+		snorm16,
+		unorm16
+	};
+
+	struct vertex_element
+	{
+		vertex_component type;
+		unsigned components;
+		unsigned size;
+	};
+
+	/**
+	 * \brief Describes how mesh_server packs vertex streams into a vertex buffer.
+	 * Attribute masks have one bit per vertex_attribute, for the streams a mesh actually has.
+	 */
+	struct vertex_layout
+	{
+		unsigned flags = layout_planar_float;
+
+		vertex_element get_element(vertex_attribute attrib) const;
+
+		/**
+		 * \brief Bytes per vertex of the attributes in a mask.
+		 */
+		unsigned get_vertex_size(unsigned attribs) const;
+
+		/**
+		 * \brief Byte offset of the first element of an attribute in a packed buffer, and the
+		 * distance between consecutive elements.
+		 */
+		void get_placement(vertex_attribute attrib, unsigned attribs, size_t vertex_count, size_t& offset, unsigned& stride) const;
+
+		/**
+		 * \brief Shader defines that select the matching decoding in vertex_input.glsl.
+		 */
+		std::vector<std::string> get_defines() const;
+	};
+
+	/**
+	 * \brief Dequantisation of packed positions, position = packed * scale + offset.
+	 */
+	struct vertex_quantization
+	{
+		vector3 offset;
+		vector3 scale = vector3(1, 1, 1);
+	};
+
+	/**
+	 * \brief Bounds of a position stream, as the quantisation that maps it onto [0, 1].
+	 */
+	vertex_quantization get_quantization(const std::vector<vector3>& positions);
+
+	/**
+	 * \brief Packs vertex streams according to a layout. Attributes in the mask but missing from the
+	 * streams (empty vectors) are zero-filled.
+	 */
+	void pack_vertices(const vertex_layout& layout, unsigned attribs, const vertex_quantization& quant,
+			const std::vector<vector3>& positions,
+			const std::vector<vector3>& normals,
+			const std::vector<vector2>& uvs,
+			const std::vector<vector4>& tangents,
+			std::vector<unsigned char>& out);
+
+	/**
+	 * \brief Reads back one packed position.
+	 */
+	vector3 unpack_position(const vertex_layout& layout, const unsigned char* element, const vertex_quantization& quant);
+
+	uint16_t float_to_half(float value);
+
+	/**
+	 * \brief Octahedral encoding of a unit vector into two snorm16 values.
+	 */
+	void oct_encode(const vector3& n, int16_t out[2]);
+	vector3 oct_decode(const int16_t in[2]);
+}
@@ -0,0 +1,84 @@
+#include "frustum.h"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace efiilj
+{
+	size_t frustum::cull(const bounds_soa& boxes, size_t count, std::vector<unsigned>& visible) const
+	{
+		size_t found = 0;
+
+		for (size_t i = 0; i < count; i += FRUSTUM_BATCH)
+		{
+			unsigned outside = 0;
+
+			for (const auto& p : planes)
+			{
+#ifdef __AVX__
+				const __m256 nx = _mm256_set1_ps(p.x);
+				const __m256 ny = _mm256_set1_ps(p.y);
+				const __m256 nz = _mm256_set1_ps(p.z);
+				const __m256 nw = _mm256_set1_ps(p.w);
+
+				const __m256 ax = _mm256_set1_ps(std::fabs(p.x));
+				const __m256 ay = _mm256_set1_ps(std::fabs(p.y));
+				const __m256 az = _mm256_set1_ps(std::fabs(p.z));
+
+				// Signed distance of the center plus the projected extent
+				__m256 d = _mm256_add_ps(_mm256_mul_ps(nx, _mm256_loadu_ps(&boxes.cx[i])), nw);
+				d = _mm256_add_ps(d, _mm256_mul_ps(ny, _mm256_loadu_ps(&boxes.cy[i])));
+				d = _mm256_add_ps(d, _mm256_mul_ps(nz, _mm256_loadu_ps(&boxes.cz[i])));
+				d = _mm256_add_ps(d, _mm256_mul_ps(ax, _mm256_loadu_ps(&boxes.ex[i])));
+				d = _mm256_add_ps(d, _mm256_mul_ps(ay, _mm256_loadu_ps(&boxes.ey[i])));
+				d = _mm256_add_ps(d, _mm256_mul_ps(az, _mm256_loadu_ps(&boxes.ez[i])));
+
+				outside |= _mm256_movemask_ps(_mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+#else
+				const __m128 nx = _mm_set1_ps(p.x);
+				const __m128 ny = _mm_set1_ps(p.y);
+				const __m128 nz = _mm_set1_ps(p.z);
+				const __m128 nw = _mm_set1_ps(p.w);
+
+				const __m128 ax = _mm_set1_ps(std::fabs(p.x));
+				const __m128 ay = _mm_set1_ps(std::fabs(p.y));
+				const __m128 az = _mm_set1_ps(std::fabs(p.z));
+
+				// Two halves of four lanes each make up one batch
+				for (size_t h = 0; h < FRUSTUM_BATCH; h += 4)
+				{
+					size_t j = i + h;
+
+					__m128 d = _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&boxes.cx[j])), nw);
+					d = _mm_add_ps(d, _mm_mul_ps(ny, _mm_loadu_ps(&boxes.cy[j])));
+					d = _mm_add_ps(d, _mm_mul_ps(nz, _mm_loadu_ps(&boxes.cz[j])));
+					d = _mm_add_ps(d, _mm_mul_ps(ax, _mm_loadu_ps(&boxes.ex[j])));
+					d = _mm_add_ps(d, _mm_mul_ps(ay, _mm_loadu_ps(&boxes.ey[j])));
+					d = _mm_add_ps(d, _mm_mul_ps(az, _mm_loadu_ps(&boxes.ez[j])));
+
+					outside |= static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(d, _mm_setzero_ps()))) << h;
+				}
+#endif
+			}
+
+			size_t lanes = std::min(static_cast<size_t>(FRUSTUM_BATCH), count - i);
+
+			for (size_t l = 0; l < lanes; l++)
+			{
+				if (outside & (1u << l))
+					continue;
+
+				visible.push_back(static_cast<unsigned>(i + l));
+				found++;
+			}
+		}
+
+		return found;
+	}
+}
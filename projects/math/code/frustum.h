@@ -0,0 +1,121 @@
+#pragma once
+
+#include "matrix4.h"
+#include "bounds.h"
+
+#include <vector>
+
+#define FRUSTUM_BATCH 8
+
+namespace efiilj
+{
+	/**
+	 * \brief World-space bounding boxes stored as centers and extents, one array per component.
+	 * Arrays are padded to a multiple of FRUSTUM_BATCH so that they can be tested in full batches.
+	 */
+	struct bounds_soa
+	{
+		std::vector<float> cx, cy, cz;
+		std::vector<float> ex, ey, ez;
+
+		void resize(size_t count)
+		{
+			size_t padded = (count + FRUSTUM_BATCH - 1) / FRUSTUM_BATCH * FRUSTUM_BATCH;
+
+			cx.resize(padded); cy.resize(padded); cz.resize(padded);
+			ex.resize(padded); ey.resize(padded); ez.resize(padded);
+		}
+
+		void set(size_t i, const bounds& b)
+		{
+			cx[i] = (b.min.x + b.max.x) * 0.5f;
+			cy[i] = (b.min.y + b.max.y) * 0.5f;
+			cz[i] = (b.min.z + b.max.z) * 0.5f;
+
+			ex[i] = (b.max.x - b.min.x) * 0.5f;
+			ey[i] = (b.max.y - b.min.y) * 0.5f;
+			ez[i] = (b.max.z - b.min.z) * 0.5f;
+		}
+	};
+
+	class frustum
+	{
+		private:
+
+		public:
+
+			frustum() = default;
+
+			/**
+			 * \brief Extracts the six clip planes from a combined projection * view matrix.
+			 * Planes point inwards, so a point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+			 */
+			frustum(const matrix4& view_projection)
+			{
+				const vector4 r0 = view_projection.row(0);
+				const vector4 r1 = view_projection.row(1);
+				const vector4 r2 = view_projection.row(2);
+				const vector4 r3 = view_projection.row(3);
+
+				// vector4 arithmetic leaves w untouched, so combine rows component-wise
+				auto combine = [](const vector4& a, const vector4& b, float sign)
+				{
+					return vector4(a.x + b.x * sign, a.y + b.y * sign, a.z + b.z * sign, a.w + b.w * sign);
+				};
+
+				planes[0] = combine(r3, r0, 1.0f);		// Left
+				planes[1] = combine(r3, r0, -1.0f);		// Right
+				planes[2] = combine(r3, r1, 1.0f);		// Bottom
+				planes[3] = combine(r3, r1, -1.0f);		// Top
+				planes[4] = combine(r3, r2, 1.0f);		// Near
+				planes[5] = combine(r3, r2, -1.0f);		// Far
+
+				for (auto& p : planes)
+				{
+					float len = p.xyz().length();
+
+					if (len > 0.0f)
+						p = p * (1.0f / len);
+				}
+			}
+
+			vector4 planes[6];
+
+			bool test(const bounds& box) const
+			{
+				const vector3 center = (box.min + box.max) * 0.5f;
+				const vector3 extent = (box.max - box.min) * 0.5f;
+
+				for (const auto& p : planes)
+				{
+					float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+					float r = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+
+					if (d + r < 0.0f)
+						return false;
+				}
+
+				return true;
+			}
+
+			bool test(const vector3& center, float radius) const
+			{
+				for (const auto& p : planes)
+				{
+					if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+						return false;
+				}
+
+				return true;
+			}
+
+			/**
+			 * \brief Tests boxes against the frustum in batches of FRUSTUM_BATCH.
+			 * \param boxes Boxes to test, padded as per bounds_soa::resize
+			 * \param count Number of valid boxes
+			 * \param visible Indices of boxes intersecting the frustum are appended here
+			 * \return Number of visible boxes
+			 */
+			size_t cull(const bounds_soa& boxes, size_t count, std::vector<unsigned>& visible) const;
+	};
+}
@@ -75,7 +75,8 @@ namespace efiilj
 				&_data.parent,
 				&_data.children,
 				&_data.model_updated,
-				&_data.inverse_updated});
+				&_data.inverse_updated,
+				&_data.version});
 	}
 
 	void transform_manager::update_models()
@@ -130,6 +131,9 @@ namespace efiilj
 		_data.model_updated[idx] = updated;
 		_data.inverse_updated[idx] = false;
 
+		if (updated)
+			_data.version[idx]++;
+
 		if (!updated)
 		{
 			for (const auto& child : _data.children[idx])
@@ -168,6 +172,25 @@ namespace efiilj
 		_data.model_updated[child_id] = false;
 	}
 
+	void transform_manager::reparent(entity_id child, entity_id parent)
+	{
+		transform_id child_id = get_component(child);
+
+		if (child_id == -1)
+			return;
+
+		if (parent == -1)
+		{
+			detach(child_id);
+			return;
+		}
+
+		transform_id parent_id = get_component(parent);
+
+		if (parent_id != -1)
+			set_parent(child_id, parent_id);
+	}
+
 	vector3 transform_manager::get_position(transform_id idx)
 	{
 		return _data.position[idx].xyz();
@@ -28,6 +28,8 @@ namespace efiilj
 				ComponentData<bool> model_updated;
 				ComponentData<bool> inverse_updated;
 
+				ComponentData<unsigned> version { 0 };
+
 				ComponentData<std::set<transform_id>> children;
 
 			} _data;
@@ -51,9 +53,20 @@ namespace efiilj
 
 			transform_id get_parent(transform_id) const;
 			void set_parent(transform_id child_id, transform_id parent_id);
+
+			void reparent(entity_id child, entity_id parent) override;
 			
 			void set_updated(transform_id idx, bool updated);
 
+			/**
+			 * \brief Returns a counter which is incremented every time the model matrix changes.
+			 * Useful for caching data derived from the model matrix.
+			 */
+			unsigned get_version(transform_id idx) const
+			{
+				return _data.version[idx];
+			}
+
 			const std::set<transform_id>& get_children(transform_id idx) const
 			{
 				return _data.children[idx];
@@ -1,7 +1,10 @@
 #include "phys_data.h"
 #include "imgui.h"
+#include "core/arena.h"
+#include "core/profiler.h"
 
 #include <algorithm>
+#include <charconv>
 #include <iterator>
 #include <memory>
 #include <limits>
@@ -58,20 +61,23 @@ namespace efiilj
 		if (ImGui::Button("Recalculate AABB"))
 			update_bounds(idx);
 
-		std::stringstream ss;
-
-		for (auto col : _data.broad_collisions[idx])
-			ss << col << ", ";
-
-		ImGui::Text("Broad: %s", ss.str().c_str());
+		// Built in the frame arena, since the editor redraws every frame
+		const auto list = [](const std::vector<collider_id>& cols)
+		{
+			std::pmr::string text(&core::frame_arena());
+			char num[16];
 
-		ss.clear();
-		ss.str("");
+			for (auto col : cols)
+			{
+				text.append(num, std::to_chars(num, num + sizeof(num), col).ptr);
+				text.append(", ");
+			}
 
-		for (auto col : _data.narrow_collisions[idx])
-			ss << col << ", ";
+			return text;
+		};
 
-		ImGui::Text("Narrow: %s", ss.str().c_str());
+		ImGui::Text("Broad: %s", list(_data.broad_collisions[idx]).c_str());
+		ImGui::Text("Narrow: %s", list(_data.narrow_collisions[idx]).c_str());
 
 		entity_id eid = get_entity(idx);
 		transform_id trf_id = _transforms->get_component(eid);
@@ -135,6 +141,9 @@ namespace efiilj
 			if (!_meshes->is_valid(mid))
 				continue;
 
+			// Support points and ray tests read the CPU positions
+			_meshes->retain_data(mid);
+
 			min = vector3::min(min, _meshes->get_min(mid));
 			max = vector3::max(max, _meshes->get_max(mid));
 		}
@@ -161,89 +170,50 @@ namespace efiilj
 		return b.get_transformed_bounds(model);
 	}
 	
-	void collider_manager::clear_sweep()
-	{
-		_sweep_x.clear();
-		_sweep_y.clear();
-		_sweep_z.clear();
-
-		_sweep_hits_x.clear();
-		_sweep_hits_y.clear();
-		_sweep_hits_z.clear();
-	}
-
-	void collider_manager::check_axis_sweep(const std::set<point, point_comp>& points, std::map<collider_id, std::set<collider_id>>& hits) const
-	{
-
-		std::set<collider_id> intervals;
-
-		for (const auto& point : points)
-		{
-			collider_id new_id = point.first;
-
-			// If this is the beginning of a new interval
-			if (intervals.find(new_id) == intervals.end())
-			{
-				// Add the new interval id to all existing intervals
-				for (const auto& idx : intervals)
-					hits[idx].insert(new_id);
-
-				// Add the existing intervals to the new interval
-				hits[new_id].insert(intervals.begin(), intervals.end());
-
-				// Insert the new interval
-				intervals.insert(new_id);
-			}
-			else
-			{
-				// Otherwise erase the interval
-				intervals.erase(new_id);
-			}
-		}
-	}
-
 	void collider_manager::update_broad()
 	{
+		PROFILE_SCOPE("broad_phase");
 
-		clear_sweep();
-
-		for (const auto& idx : get_instances())
+		struct sweep_box
 		{
-			const auto& bounds = get_bounds_world(idx);
-
-			_sweep_x.emplace(idx, bounds.min.x);
-			_sweep_x.emplace(idx, bounds.max.x);
+			collider_id idx;
+			bounds world;
+		};
 
-			_sweep_y.emplace(idx, bounds.min.y);
-			_sweep_y.emplace(idx, bounds.max.y);
+		core::scratch_scope scratch;
+		std::pmr::vector<sweep_box> boxes(scratch.resource());
 
-			_sweep_z.emplace(idx, bounds.min.z);
-			_sweep_z.emplace(idx, bounds.max.z);
+		const auto& instances = get_instances();
+		boxes.reserve(instances.size());
 
+		for (const auto& idx : instances)
+		{
+			boxes.push_back({ idx, get_bounds_world(idx) });
 			_data.broad_collisions[idx].clear();
 		}
 
-		check_axis_sweep(_sweep_x, _sweep_hits_x);
-		check_axis_sweep(_sweep_y, _sweep_hits_y);
-		check_axis_sweep(_sweep_z, _sweep_hits_z);
+		// Sort and sweep along x, then test the pairs overlapping on x against y and z
+		std::sort(boxes.begin(), boxes.end(), [](const sweep_box& a, const sweep_box& b) 
+				{ return a.world.min.x < b.world.min.x; });
 
-		for (const auto& idx : get_instances())
+		for (size_t i = 0; i < boxes.size(); i++)
 		{
-			std::set<collider_id> s1;
-			std::set<collider_id> s2;
+			const bounds& a = boxes[i].world;
 
-			std::set_intersection(
-					_sweep_hits_x[idx].begin(), _sweep_hits_x[idx].end(), 
-					_sweep_hits_y[idx].begin(), _sweep_hits_y[idx].end(),
-					std::inserter(s1, s1.begin()));
+			for (size_t j = i + 1; j < boxes.size() && boxes[j].world.min.x <= a.max.x; j++)
+			{
+				const bounds& b = boxes[j].world;
 
-			std::set_intersection(
-					s1.begin(), s1.end(), 
-					_sweep_hits_z[idx].begin(), _sweep_hits_z[idx].end(),
-					std::inserter(s2, s2.begin()));
+				if (a.min.y > b.max.y || b.min.y > a.max.y || a.min.z > b.max.z || b.min.z > a.max.z)
+					continue;
 
-			_data.broad_collisions[idx] = s2;
+				_data.broad_collisions[boxes[i].idx].push_back(boxes[j].idx);
+				_data.broad_collisions[boxes[j].idx].push_back(boxes[i].idx);
+			}
 		}
+
+		for (const auto& idx : instances)
+			std::sort(_data.broad_collisions[idx].begin(), _data.broad_collisions[idx].end());
 	}
 
 	SupportPoint collider_manager::support(collider_id col1, collider_id col2, const vector3& dir) const
@@ -275,7 +245,7 @@ namespace efiilj
 		{
 			mesh_id mid = _mesh_instances->get_mesh(miid);
 
-			const auto& points = _meshes->get_positions(mid);
+			const auto& points = _meshes->get_hull(mid);
 
 			for (const auto& point : points)
 			{
@@ -330,8 +300,10 @@ namespace efiilj
 		result.object1 = col1;
 		result.object2 = col2;
 
-		std::vector<SupportFace> faces;
-		std::vector<SupportEdge> edges;
+		// Called for every colliding pair, so the polytope lives in scratch memory
+		core::scratch_scope scratch;
+		std::pmr::vector<SupportFace> faces(scratch.resource());
+		std::pmr::vector<SupportEdge> edges(scratch.resource());
 
 		// Add termination simplex to face vector
 		faces.emplace_back(a, b, c);
@@ -571,6 +543,7 @@ check_face:
 		
 	void collider_manager::update_narrow()
 	{
+		PROFILE_SCOPE("narrow_phase");
 
 		for (auto idx : get_instances())
 		{
@@ -589,8 +562,8 @@ check_face:
 				Collision col1, col2;
 				if (test_collision(idx, col, col1, col2))
 				{
-					_data.narrow_collisions[idx].insert(col);
-					_data.narrow_collisions[col].insert(idx);
+					_data.narrow_collisions[idx].push_back(col);
+					_data.narrow_collisions[col].push_back(idx);
 
 					_data.collisions[idx].emplace_back(col2);
 					_data.collisions[col].emplace_back(col1);
@@ -712,7 +685,7 @@ check_face:
 			return false;
 		}
 
-		if (!_meshes->is_valid(mid))
+		if (!_meshes->is_valid(mid) || !_meshes->retain_data(mid))
 		{
 			fprintf(stderr, "Invalid mesh id %d\n", mid);
 			return false;
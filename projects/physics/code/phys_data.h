@@ -9,6 +9,7 @@
 #include "mesh_srv.h"
 #include "mesh_mgr.h"
 
+#include <algorithm>
 #include <memory>
 
 namespace efiilj
@@ -171,27 +172,13 @@ namespace efiilj
 	{
 		private:
 
-			typedef std::pair<collider_id, float> point;
-
-			struct point_comp
-			{
-			  bool operator () (const point& lhs, const point& rhs) const
-			  { return lhs.second < rhs.second; }
-			};	
-
-			std::set<point, point_comp> _sweep_x;
-			std::set<point, point_comp> _sweep_y;
-			std::set<point, point_comp> _sweep_z;
-
-			std::map<collider_id, std::set<collider_id>> _sweep_hits_x;
-			std::map<collider_id, std::set<collider_id>> _sweep_hits_y;
-			std::map<collider_id, std::set<collider_id>> _sweep_hits_z;
-
 			struct PhysicsData
 			{
 				ComponentData<bounds> mesh_bounds;
-				ComponentData<std::set<collider_id>> broad_collisions;
-				ComponentData<std::set<collider_id>> narrow_collisions;
+
+				// Short lists, cleared and refilled each update so that their storage is reused
+				ComponentData<std::vector<collider_id>> broad_collisions;
+				ComponentData<std::vector<collider_id>> narrow_collisions;
 				ComponentData<std::vector<Collision>> collisions;
 			} _data;
 
@@ -199,9 +186,6 @@ namespace efiilj
 			std::shared_ptr<mesh_manager> _mesh_instances;
 			std::shared_ptr<transform_manager> _transforms;
 
-			void clear_sweep();
-			void check_axis_sweep(const std::set<point, point_comp>& points, std::map<collider_id, std::set<collider_id>>& hits) const;
-
 			bool update_simplex(SupportPoint simplex[4], int& dim, vector3& dir) const;
 			bool gjk(collider_id col1, collider_id col2, Simplex& simplex) const;
 			bool epa(collider_id col1, collider_id col2, const Simplex& simplex, Collision& result) const;
@@ -242,7 +226,8 @@ namespace efiilj
 
 			bool test_broad(collider_id obj1, collider_id obj2) const
 			{
-				return _data.broad_collisions[obj1].find(obj2) != _data.broad_collisions[obj1].end();
+				const auto& cols = _data.broad_collisions[obj1];
+				return std::find(cols.begin(), cols.end(), obj2) != cols.end();
 			}
 
 			bool test_narrow(collider_id idx) const
@@ -252,13 +237,13 @@ namespace efiilj
 
 			bool test_narrow(collider_id obj1, collider_id obj2) const
 			{
-				return _data.narrow_collisions[obj1].find(obj2) != _data.narrow_collisions[obj1].end();
+				const auto& cols = _data.narrow_collisions[obj1];
+				return std::find(cols.begin(), cols.end(), obj2) != cols.end();
 			}
 
 			bool collides_with(collider_id idx, collider_id other)
 			{
-				return _data.narrow_collisions[idx].find(other) !=
-					_data.narrow_collisions[idx].end();
+				return test_narrow(idx, other);
 			}
 
 			const std::vector<Collision>& get_collisions(collider_id idx)
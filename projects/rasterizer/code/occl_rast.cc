@@ -0,0 +1,292 @@
+#include "occl_rast.h"
+#include "core/jobs.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define OCCL_MIN_W 0.00001f
+
+namespace efiilj
+{
+	occlusion_rasterizer::occlusion_rasterizer(int width, int height)
+		: _num_occluder_tris(0), _num_tested(0), _num_occluded(0)
+	{
+		_tiles_x = (width + OCCL_TILE_WIDTH - 1) / OCCL_TILE_WIDTH;
+		_tiles_y = (height + OCCL_TILE_HEIGHT - 1) / OCCL_TILE_HEIGHT;
+
+		_width = _tiles_x * OCCL_TILE_WIDTH;
+		_height = _tiles_y * OCCL_TILE_HEIGHT;
+
+		_depth.resize(_width * _height, 1.0f);
+		_tile_max.resize(_tiles_x * _tiles_y, 1.0f);
+		_bins.resize(_tiles_x * _tiles_y);
+	}
+
+	void occlusion_rasterizer::begin(const matrix4& view_projection)
+	{
+		_view_projection = view_projection;
+
+		_tris.clear();
+
+		for (auto& bin : _bins)
+			bin.clear();
+
+		_num_occluder_tris = 0;
+		_num_tested = 0;
+		_num_occluded = 0;
+	}
+
+	void occlusion_rasterizer::add_occluder(const std::vector<vector3>& positions, const std::vector<unsigned>& indices, const matrix4& model)
+	{
+		const matrix4 mvp = _view_projection * model;
+
+		_clip.resize(positions.size());
+
+		for (size_t i = 0; i < positions.size(); i++)
+			_clip[i] = mvp * vector4(positions[i], 1.0f);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			setup_tri(_clip[indices[i]], _clip[indices[i + 1]], _clip[indices[i + 2]]);
+	}
+
+	void occlusion_rasterizer::setup_tri(const vector4& c0, const vector4& c1, const vector4& c2)
+	{
+		if (c0.w < OCCL_MIN_W || c1.w < OCCL_MIN_W || c2.w < OCCL_MIN_W)
+			return;
+
+		float x[3], y[3], z[3];
+		const vector4* clip[3] = { &c0, &c1, &c2 };
+
+		for (int i = 0; i < 3; i++)
+		{
+			float inv_w = 1.0f / clip[i]->w;
+			x[i] = (clip[i]->x * inv_w * 0.5f + 0.5f) * _width;
+			y[i] = (clip[i]->y * inv_w * 0.5f + 0.5f) * _height;
+			z[i] = clip[i]->z * inv_w * 0.5f + 0.5f;
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+		if (std::fabs(area) < 1e-8f)
+			return;
+
+		// Occluders are double-sided, so just flip clockwise triangles
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		screen_tri tri;
+
+		tri.min_x = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+		tri.min_y = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+		tri.max_x = std::min(_width - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+		tri.max_y = std::min(_height - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+		if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+			return;
+
+		for (int i = 0; i < 3; i++)
+		{
+			int j = (i + 1) % 3;
+			tri.a[i] = y[i] - y[j];
+			tri.b[i] = x[j] - x[i];
+			tri.c[i] = x[i] * y[j] - x[j] * y[i];
+		}
+
+		float inv_area = 1.0f / area;
+
+		tri.za = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inv_area;
+		tri.zb = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inv_area;
+		tri.zc = z[0] - tri.za * x[0] - tri.zb * y[0];
+
+		unsigned index = static_cast<unsigned>(_tris.size());
+		_tris.push_back(tri);
+		_num_occluder_tris++;
+
+		int tx0 = tri.min_x / OCCL_TILE_WIDTH;
+		int tx1 = tri.max_x / OCCL_TILE_WIDTH;
+		int ty0 = tri.min_y / OCCL_TILE_HEIGHT;
+		int ty1 = tri.max_y / OCCL_TILE_HEIGHT;
+
+		for (int ty = ty0; ty <= ty1; ty++)
+			for (int tx = tx0; tx <= tx1; tx++)
+				_bins[ty * _tiles_x + tx].push_back(index);
+	}
+
+	void occlusion_rasterizer::rasterize()
+	{
+		int tiles = _tiles_x * _tiles_y;
+
+		core::job_system::get().parallel_for(tiles, 1, [this](size_t begin, size_t end)
+				{
+					for (size_t t = begin; t < end; t++)
+						rasterize_tile(static_cast<int>(t));
+				});
+	}
+
+	void occlusion_rasterizer::rasterize_tile(int tile)
+	{
+		const int x0 = (tile % _tiles_x) * OCCL_TILE_WIDTH;
+		const int y0 = (tile / _tiles_x) * OCCL_TILE_HEIGHT;
+		const int x1 = x0 + OCCL_TILE_WIDTH - 1;
+		const int y1 = y0 + OCCL_TILE_HEIGHT - 1;
+
+		for (int y = y0; y <= y1; y++)
+			std::fill_n(&_depth[y * _width + x0], OCCL_TILE_WIDTH, 1.0f);
+
+		for (unsigned index : _bins[tile])
+		{
+			const screen_tri& tri = _tris[index];
+
+			rasterize_tri(tri,
+					std::max(x0, tri.min_x), std::max(y0, tri.min_y),
+					std::min(x1, tri.max_x), std::min(y1, tri.max_y));
+		}
+
+		// Farthest depth in the tile, used to reject occludees without a per-pixel test
+		__m128 far = _mm_setzero_ps();
+
+		for (int y = y0; y <= y1; y++)
+		{
+			const float* row = &_depth[y * _width + x0];
+
+			for (int x = 0; x < OCCL_TILE_WIDTH; x += 4)
+				far = _mm_max_ps(far, _mm_loadu_ps(row + x));
+		}
+
+		far = _mm_max_ps(far, _mm_shuffle_ps(far, far, _MM_SHUFFLE(1, 0, 3, 2)));
+		far = _mm_max_ps(far, _mm_shuffle_ps(far, far, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		_tile_max[tile] = _mm_cvtss_f32(far);
+	}
+
+	void occlusion_rasterizer::rasterize_tri(const screen_tri& tri, int x0, int y0, int x1, int y1)
+	{
+		if (x0 > x1 || y0 > y1)
+			return;
+
+		// Tiles are a multiple of four wide, so aligning down stays inside the tile
+		x0 &= ~3;
+
+		const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		const __m128 a0 = _mm_set1_ps(tri.a[0]);
+		const __m128 a1 = _mm_set1_ps(tri.a[1]);
+		const __m128 a2 = _mm_set1_ps(tri.a[2]);
+		const __m128 za = _mm_set1_ps(tri.za);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			const float py = static_cast<float>(y) + 0.5f;
+
+			const __m128 r0 = _mm_set1_ps(tri.b[0] * py + tri.c[0]);
+			const __m128 r1 = _mm_set1_ps(tri.b[1] * py + tri.c[1]);
+			const __m128 r2 = _mm_set1_ps(tri.b[2] * py + tri.c[2]);
+			const __m128 rz = _mm_set1_ps(tri.zb * py + tri.zc);
+
+			float* row = &_depth[y * _width];
+
+			for (int x = x0; x <= x1; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+
+				const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(za, px), rz);
+				const __m128 depth = _mm_loadu_ps(row + x);
+				const __m128 closest = _mm_min_ps(depth, z);
+
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, depth)));
+			}
+		}
+	}
+
+	bool occlusion_rasterizer::test(const bounds& world_box)
+	{
+		_num_tested++;
+
+		float min_x = static_cast<float>(_width), min_y = static_cast<float>(_height);
+		float max_x = 0.0f, max_y = 0.0f;
+		float min_z = 1.0f;
+
+		for (int i = 0; i < 8; i++)
+		{
+			const vector3 corner(
+					(i & 1) ? world_box.max.x : world_box.min.x,
+					(i & 2) ? world_box.max.y : world_box.min.y,
+					(i & 4) ? world_box.max.z : world_box.min.z);
+
+			const vector4 clip = _view_projection * vector4(corner, 1.0f);
+
+			// Boxes crossing the near plane are always considered visible
+			if (clip.w < OCCL_MIN_W)
+				return true;
+
+			float inv_w = 1.0f / clip.w;
+			float x = (clip.x * inv_w * 0.5f + 0.5f) * _width;
+			float y = (clip.y * inv_w * 0.5f + 0.5f) * _height;
+			float z = clip.z * inv_w * 0.5f + 0.5f;
+
+			min_x = std::min(min_x, x);
+			min_y = std::min(min_y, y);
+			max_x = std::max(max_x, x);
+			max_y = std::max(max_y, y);
+			min_z = std::min(min_z, z);
+		}
+
+		if (min_z < 0.0f)
+			return true;
+
+		int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+		int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+		int x1 = std::min(_width - 1, static_cast<int>(std::ceil(max_x)));
+		int y1 = std::min(_height - 1, static_cast<int>(std::ceil(max_y)));
+
+		// Off-screen boxes are left to the frustum test
+		if (x0 > x1 || y0 > y1)
+			return true;
+
+		for (int ty = y0 / OCCL_TILE_HEIGHT; ty <= y1 / OCCL_TILE_HEIGHT; ty++)
+		{
+			for (int tx = x0 / OCCL_TILE_WIDTH; tx <= x1 / OCCL_TILE_WIDTH; tx++)
+			{
+				// Every pixel in the tile is closer than the box
+				if (_tile_max[ty * _tiles_x + tx] <= min_z)
+					continue;
+
+				int px0 = std::max(x0, tx * OCCL_TILE_WIDTH);
+				int py0 = std::max(y0, ty * OCCL_TILE_HEIGHT);
+				int px1 = std::min(x1, tx * OCCL_TILE_WIDTH + OCCL_TILE_WIDTH - 1);
+				int py1 = std::min(y1, ty * OCCL_TILE_HEIGHT + OCCL_TILE_HEIGHT - 1);
+
+				for (int y = py0; y <= py1; y++)
+				{
+					const float* row = &_depth[y * _width];
+
+					for (int x = px0; x <= px1; x++)
+					{
+						if (row[x] > min_z)
+							return true;
+					}
+				}
+			}
+		}
+
+		_num_occluded++;
+		return false;
+	}
+}
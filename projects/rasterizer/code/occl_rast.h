@@ -0,0 +1,97 @@
+#pragma once
+
+#include "matrix4.h"
+#include "bounds.h"
+
+#include <vector>
+#include <atomic>
+
+#define OCCL_TILE_WIDTH 32
+#define OCCL_TILE_HEIGHT 16
+
+namespace efiilj
+{
+	/**
+	 * \brief Low-resolution, depth-only software rasterizer used for occlusion culling.
+	 * Occluder triangles are binned into screen tiles, and tiles are rasterized in parallel.
+	 * Each tile keeps the farthest depth written to it, so most occludee tests
+	 * resolve without touching individual pixels.
+	 */
+	class occlusion_rasterizer
+	{
+		private:
+
+			struct screen_tri
+			{
+				// Edge functions e(x, y) = a * x + b * y + c, positive inside
+				float a[3], b[3], c[3];
+
+				// Depth plane z(x, y) = za * x + zb * y + zc
+				float za, zb, zc;
+
+				int min_x, min_y, max_x, max_y;
+			};
+
+			int _width, _height;
+			int _tiles_x, _tiles_y;
+
+			matrix4 _view_projection;
+
+			std::vector<float> _depth;
+			std::vector<float> _tile_max;
+
+			std::vector<screen_tri> _tris;
+			std::vector<std::vector<unsigned>> _bins;
+
+			std::vector<vector4> _clip;
+
+			size_t _num_occluder_tris;
+			std::atomic<size_t> _num_tested;
+			std::atomic<size_t> _num_occluded;
+
+			void setup_tri(const vector4& v0, const vector4& v1, const vector4& v2);
+			void rasterize_tile(int tile);
+			void rasterize_tri(const screen_tri& tri, int x0, int y0, int x1, int y1);
+
+		public:
+
+			/**
+			 * \brief Creates a new occlusion rasterizer.
+			 * \param width Width of the depth buffer, rounded up to a whole number of tiles
+			 * \param height Height of the depth buffer, rounded up to a whole number of tiles
+			 */
+			occlusion_rasterizer(int width = 256, int height = 128);
+
+			/**
+			 * \brief Clears the depth buffer and occluder list for a new frame.
+			 * \param view_projection Camera projection * view matrix
+			 */
+			void begin(const matrix4& view_projection);
+
+			/**
+			 * \brief Transforms and bins an indexed occluder mesh.
+			 * Triangles crossing the near plane are dropped, which can only make culling less aggressive.
+			 */
+			void add_occluder(const std::vector<vector3>& positions, const std::vector<unsigned>& indices, const matrix4& model);
+
+			/**
+			 * \brief Rasterizes all binned occluders, one job per tile.
+			 */
+			void rasterize();
+
+			/**
+			 * \brief Tests a world-space bounding box against the rasterized occluders.
+			 * \return True if any part of the box may be visible, false if it is fully hidden
+			 */
+			bool test(const bounds& world_box);
+
+			int get_width() const { return _width; }
+			int get_height() const { return _height; }
+
+			const float* get_depth_buffer() const { return _depth.data(); }
+
+			size_t get_occluder_tris() const { return _num_occluder_tris; }
+			size_t get_tested() const { return _num_tested; }
+			size_t get_occluded() const { return _num_occluded; }
+	};
+}
@@ -0,0 +1,119 @@
+#version 330
+#extension GL_ARB_explicit_uniform_location : require
+
+Include(lighting_common.glsl)
+
+#define LIGHT_TEXELS 5
+
+out vec4 FragColor;
+
+layout (location = 0) uniform sampler2D g_position;
+layout (location = 1) uniform sampler2D g_normal;
+layout (location = 2) uniform sampler2D g_albedo;
+layout (location = 3) uniform sampler2D g_orm;
+layout (location = 4) uniform sampler2D g_emissive;
+
+layout (std140) uniform Matrices
+{
+	mat4 projection;
+	mat4 view;
+};
+
+// Packed light list, cluster (offset, count) grid, and per-cluster light indices
+uniform samplerBuffer lights;
+uniform usamplerBuffer clusters;
+uniform usamplerBuffer light_indices;
+
+// Grid dimensions, and (width, height, near, far) of the screen and camera
+uniform vec3 cluster_size;
+uniform vec4 cluster_screen;
+
+light_source fetch_light(int idx)
+{
+	int base = idx * LIGHT_TEXELS;
+
+	vec4 t0 = texelFetch(lights, base);
+	vec4 t1 = texelFetch(lights, base + 1);
+	vec4 t2 = texelFetch(lights, base + 2);
+	vec4 t3 = texelFetch(lights, base + 3);
+	vec4 t4 = texelFetch(lights, base + 4);
+
+	light_source l;
+	l.position = t0.xyz;
+	l.type = int(t0.w);
+	l.base.color = t1.rgb;
+	l.base.diffuse_intensity = t1.w;
+	l.direction = t2.xyz;
+	l.base.ambient_intensity = t2.w;
+	l.falloff.constant = t3.x;
+	l.falloff.linear = t3.y;
+	l.falloff.exponential = t3.z;
+	l.cutoff.inner = t4.x;
+	l.cutoff.outer = t4.y;
+
+	return l;
+}
+
+vec4 calc_light(light_source l, vec3 position, vec3 normal, vec3 albedo, vec3 orm)
+{
+	vec3 light_dir = l.position - position;
+	float light_dist = length(light_dir);
+	light_dir = normalize(light_dir);
+
+	vec4 color = calc_base(l.base, light_dir, position, normal, albedo, orm);
+
+	float atten = l.falloff.constant +
+			l.falloff.linear * light_dist + 
+			l.falloff.exponential * light_dist * light_dist;
+
+	color /= max(1.0, atten);
+
+	if (l.type == LIGHT_SPOT)
+	{
+		float theta = dot(light_dir, normalize(-l.direction));
+		float epsilon = l.cutoff.inner - l.cutoff.outer;
+		color *= clamp((theta - l.cutoff.outer) / max(epsilon, 0.001), 0.0, 1.0);
+	}
+
+	return color;
+}
+
+int get_cluster(vec3 world_pos)
+{
+	float depth = -(view * vec4(world_pos, 1.0)).z;
+
+	float near = cluster_screen.z;
+	float far = cluster_screen.w;
+
+	int x = int(gl_FragCoord.x / cluster_screen.x * cluster_size.x);
+	int y = int(gl_FragCoord.y / cluster_screen.y * cluster_size.y);
+	int z = int(floor(log(max(depth, near) / near) / log(far / near) * cluster_size.z));
+
+	x = clamp(x, 0, int(cluster_size.x) - 1);
+	y = clamp(y, 0, int(cluster_size.y) - 1);
+	z = clamp(z, 0, int(cluster_size.z) - 1);
+
+	return x + int(cluster_size.x) * (y + int(cluster_size.y) * z);
+}
+
+void main()
+{
+	ivec2 Uv = ivec2(gl_FragCoord.xy);
+
+	vec3 Normal = texelFetch(g_normal, Uv, 0).rgb;
+	vec3 WorldPos = texelFetch(g_position, Uv, 0).rgb;
+	vec3 Color = texelFetch(g_albedo, Uv, 0).rgb;
+	vec3 ORM = texelFetch(g_orm, Uv, 0).rgb;
+
+	uvec2 cluster = texelFetch(clusters, get_cluster(WorldPos)).rg;
+
+	vec4 result = vec4(0.0);
+
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		int idx = int(texelFetch(light_indices, int(cluster.x + i)).r);
+		result += calc_light(fetch_light(idx), WorldPos, Normal, Color, ORM);
+	}
+
+	FragColor = vec4(result.rgb, 1.0);
+}
@@ -28,17 +28,39 @@ void main()
 {
 	gPosition = fs_in.Fragment;
 
-	vec3 normal = texture(tex_normal, fs_in.Uv).rgb;
-	normal = normal * 2.0 - 1.0;
+#ifdef HAS_NORMAL_MAP
+	// Z is rebuilt from XY so two-channel (BC5) normal maps work alike
+	vec3 normal;
+	normal.xy = texture(tex_normal, fs_in.Uv).rg * 2.0 - 1.0;
+	normal.z = sqrt(max(0.0, 1.0 - dot(normal.xy, normal.xy)));
 	gNormal = normalize(fs_in.TBN * normal);
+#else
+	gNormal = normalize(fs_in.TBN[2]);
+#endif
 	
-	vec4 albedo = base_color_factor * texture(tex_base, fs_in.Uv);
-	vec3 orm = texture(tex_orm, fs_in.Uv).rgb;
+	vec4 albedo = base_color_factor;
+
+#ifdef HAS_BASE_MAP
+	albedo *= texture(tex_base, fs_in.Uv);
+#endif
 
+#ifdef ALPHA_CUTOFF
 	if (albedo.a < alpha_cutoff)
 		discard;
+#endif
+
+#ifdef HAS_ORM_MAP
+	vec3 orm = texture(tex_orm, fs_in.Uv).rgb;
+#else
+	vec3 orm = vec3(1.0);
+#endif
 
 	gAlbedo = albedo.rgb; 
 	gORM = vec3(orm.x, roughness_factor * orm.y, metallic_factor * orm.z);
+
+#ifdef HAS_EMISSIVE_MAP
 	gEmissive = emissive_factor * texture(tex_emissive, fs_in.Uv).xyz;
+#else
+	gEmissive = emissive_factor;
+#endif
 }
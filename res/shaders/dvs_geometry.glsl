@@ -1,9 +1,12 @@
 #version 330
 
-layout (location = 0) in vec3 pos;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 uv;
-layout (location = 3) in vec4 tangent;
+Include(vertex_input.glsl)
+
+#ifdef INSTANCED
+layout (location = 4) in mat4 model;
+#else
+uniform mat4 model;
+#endif
 
 out VS_OUT
 {
@@ -19,15 +22,15 @@ layout (std140) uniform Matrices
 };
 
 uniform float dt;
-uniform mat4 model;
 
 void main()
 {
-	vec4 world_pos = model * vec4(pos, 1.0);
+	vec4 world_pos = model * get_position();
+	vec4 tangent_in = get_tangent();
 
-	vec3 T = normalize(vec3(model * tangent));
-	vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
-	vec3 B = cross(N, T) * tangent.w;
+	vec3 T = normalize(vec3(model * vec4(tangent_in.xyz, 0.0)));
+	vec3 N = normalize(vec3(model * vec4(get_normal(), 0.0)));
+	vec3 B = cross(N, T) * tangent_in.w;
 
 	vs_out.Fragment = world_pos.xyz;
 	vs_out.Uv = uv;
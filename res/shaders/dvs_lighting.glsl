@@ -1,10 +1,10 @@
 #version 330 core
 
-layout (location = 0) in vec4 pos;
+Include(vertex_input.glsl)
 
 uniform mat4 light_mvp;
 
 void main()
 {
-    gl_Position = light_mvp * pos;
+    gl_Position = light_mvp * get_position();
 }
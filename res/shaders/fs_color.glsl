@@ -8,10 +8,22 @@ in VS_OUT
 
 uniform vec4 camera_position;
 uniform vec4 base_color_factor;
+uniform float alpha_cutoff;
+
+uniform sampler2D tex_base;
 
 out vec4 Color;
 
 void main()
 {
 	Color = base_color_factor;
+
+#ifdef HAS_BASE_MAP
+	Color *= texture(tex_base, fs_in.Uv);
+#endif
+
+#ifdef ALPHA_CUTOFF
+	if (Color.a < alpha_cutoff)
+		discard;
+#endif
 }
@@ -0,0 +1,58 @@
+// Mesh vertex attributes, in the layout selected by mesh_server (see vertex_layout.h)
+
+layout (location = 0) in vec4 pos;
+
+#ifdef QUANTIZED_POSITION
+layout (location = 8) in vec4 position_offset;
+layout (location = 9) in vec4 position_scale;
+#endif
+
+#ifdef OCT_NORMALS
+layout (location = 1) in vec2 normal;
+layout (location = 3) in vec2 tangent;
+#else
+layout (location = 1) in vec3 normal;
+layout (location = 3) in vec4 tangent;
+#endif
+
+// Half float and unorm16 UVs arrive as floats either way
+layout (location = 2) in vec2 uv;
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec4 get_position()
+{
+#ifdef QUANTIZED_POSITION
+	return vec4(pos.xyz * position_scale.xyz + position_offset.xyz, 1.0);
+#else
+	return vec4(pos.xyz, 1.0);
+#endif
+}
+
+vec3 get_normal()
+{
+#ifdef OCT_NORMALS
+	return oct_decode(normal);
+#else
+	return normal;
+#endif
+}
+
+vec4 get_tangent()
+{
+#ifdef OCT_NORMALS
+	// The bitangent sign is folded into the second value, remapped to [0, 1] and offset by one step
+	float sign = tangent.y < 0.0 ? -1.0 : 1.0;
+	float unit = (abs(tangent.y) * 32767.0 - 1.0) / 32766.0;
+	return vec4(oct_decode(vec2(tangent.x, unit * 2.0 - 1.0)), sign);
+#else
+	return tangent;
+#endif
+}
@@ -1,9 +1,12 @@
 #version 330
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uv;
-layout(location = 3) in vec4 tangent;
+Include(vertex_input.glsl)
+
+#ifdef INSTANCED
+layout(location = 4) in mat4 model;
+#else
+uniform mat4 model;
+#endif
 
 out VS_OUT
 {
@@ -19,11 +22,10 @@ layout (std140) uniform Matrices
 
 uniform float time;
 uniform float deltatime;
-uniform mat4 model;
 
 void main()
 {
-	vec4 mod_pos = model * vec4(pos, 1.0);
+	vec4 mod_pos = model * get_position();
 	gl_Position = projection * view * mod_pos;
 
 	vs_out.Fragment = mod_pos.xyz;
@@ -1,9 +1,6 @@
 #version 330
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 uv;
-layout(location = 3) in vec4 tangent;
+Include(vertex_input.glsl)
 
 out VS_OUT
 {
@@ -22,12 +19,14 @@ uniform mat4 model;
 
 void main()
 {
-	vec4 mod_pos = model * vec4(pos, 1.0);
+	vec4 mod_pos = model * get_position();
 	gl_Position = projection * view * mod_pos;
 
-	vec3 T = normalize(vec3(model * tangent));
-	vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
-	vec3 B = cross(N, T) * tangent.w;
+	vec4 tangent_in = get_tangent();
+
+	vec3 T = normalize(vec3(model * vec4(tangent_in.xyz, 0.0)));
+	vec3 N = normalize(vec3(model * vec4(get_normal(), 0.0)));
+	vec3 B = cross(N, T) * tangent_in.w;
 
 	vs_out.Fragment = mod_pos.xyz;
 	vs_out.Uv = uv;